@@ -42,6 +42,16 @@ then
   export ENABLE_LUA="ON"
 fi
 
+if [ -z "${ENABLE_THUMBNAILS+x}" ]
+then
+  export ENABLE_THUMBNAILS="ON"
+fi
+
+if [ -z "${ENABLE_ZLIB+x}" ]
+then
+  export ENABLE_ZLIB="ON"
+fi
+
 if [ -z "${EMBEDDED_ASSETS+x}" ]
 then
   if [ "$ACTION" = "release" ]
@@ -339,7 +349,7 @@ buildrelease() {
   	-DENABLE_SSL="$ENABLE_SSL" -DENABLE_LIBID3TAG="$ENABLE_LIBID3TAG" \
   	-DENABLE_FLAC="$ENABLE_FLAC" -DENABLE_LUA="$ENABLE_LUA" \
     -DEMBEDDED_ASSETS="$EMBEDDED_ASSETS" -DENABLE_LIBASAN="$ENABLE_LIBASAN" \
-    -DENABLE_IPV6="$ENABLE_IPV6" $EXTRA_CMAKE_OPTIONS ..
+    -DENABLE_IPV6="$ENABLE_IPV6" -DENABLE_THUMBNAILS="$ENABLE_THUMBNAILS" -DENABLE_ZLIB="$ENABLE_ZLIB" $EXTRA_CMAKE_OPTIONS ..
   make
 }
 
@@ -416,7 +426,7 @@ builddebug() {
   	-DENABLE_SSL="$ENABLE_SSL" -DENABLE_LIBID3TAG="$ENABLE_LIBID3TAG" \
     -DENABLE_FLAC="$ENABLE_FLAC" -DENABLE_LUA="$ENABLE_LUA" \
     -DEMBEDDED_ASSETS="$EMBEDDED_ASSETS" -DENABLE_LIBASAN="$ENABLE_LIBASAN" \
-    -DENABLE_IPV6="$ENABLE_IPV6" $EXTRA_CMAKE_OPTIONS ..
+    -DENABLE_IPV6="$ENABLE_IPV6" -DENABLE_THUMBNAILS="$ENABLE_THUMBNAILS" -DENABLE_ZLIB="$ENABLE_ZLIB" $EXTRA_CMAKE_OPTIONS ..
   make VERBOSE=1
   echo "Linking compilation database"
   sed -e 's/\\t/ /g' -e 's/-Wformat-truncation//g' -e 's/-Wformat-overflow=2//g' -e 's/-fsanitize=bounds-strict//g' \
@@ -849,26 +859,26 @@ installdeps() {
       apt-get install -y --no-install-recommends liblua5.3-dev
     fi
     apt-get install -y --no-install-recommends \
-	    gcc cmake perl libssl-dev libid3tag0-dev libflac-dev \
+	    gcc cmake perl libssl-dev libid3tag0-dev libflac-dev libjpeg-dev libpng-dev zlib1g-dev \
 	    build-essential pkg-config libpcre2-dev gzip
   elif [ -f /etc/arch-release ]
   then
     #arch
-    pacman -S gcc cmake perl openssl libid3tag flac lua pkgconf pcre2 gzip
+    pacman -S gcc cmake perl openssl libid3tag flac libjpeg-turbo libpng zlib lua pkgconf pcre2 gzip
   elif [ -f /etc/alpine-release ]
   then
     #alpine
-    apk add cmake perl openssl-dev libid3tag-dev flac-dev lua5.4-dev \
+    apk add cmake perl openssl-dev libid3tag-dev flac-dev libjpeg-turbo-dev libpng-dev zlib-dev lua5.4-dev \
     	alpine-sdk linux-headers pkgconf pcre2-dev gzip
   elif [ -f /etc/SuSE-release ]
   then
     #suse
-    zypper install gcc cmake pkgconfig perl openssl-devel libid3tag-devel flac-devel \
+    zypper install gcc cmake pkgconfig perl openssl-devel libid3tag-devel flac-devel libjpeg8-devel libpng16-devel zlib-devel \
 	    lua-devel unzip pcre2-devel gzip
   elif [ -f /etc/redhat-release ]
   then
     #fedora
-    yum install gcc cmake pkgconfig perl openssl-devel libid3tag-devel flac-devel \
+    yum install gcc cmake pkgconfig perl openssl-devel libid3tag-devel flac-devel libjpeg-turbo-devel libpng-devel zlib-devel \
 	    lua-devel unzip pcre2-devel gzip
   else
     echo_warn "Unsupported distribution detected."
@@ -879,6 +889,9 @@ installdeps() {
     echo "  - openssl (devel)"
     echo "  - flac (devel)"
     echo "  - libid3tag (devel)"
+    echo "  - libjpeg (devel)"
+    echo "  - libpng (devel)"
+    echo "  - zlib (devel)"
     echo "  - liblua5.4 or liblua5.3 (devel)"
     echo "  - libpcre2 (devel)"
   fi
@@ -1538,6 +1551,8 @@ case "$ACTION" in
     echo "  - ENABLE_LIBID3TAG=\"ON\""
     echo "  - ENABLE_LUA=\"ON\""
     echo "  - ENABLE_SSL=\"ON\""
+    echo "  - ENABLE_THUMBNAILS=\"ON\""
+    echo "  - ENABLE_ZLIB=\"ON\""
     echo "  - EXTRA_CMAKE_OPTIONS=\"\""
     echo "  - MANPAGES=\"ON\""
     echo "  - MYMPD_INSTALL_PREFIX=\"/usr\""
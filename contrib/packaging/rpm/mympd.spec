@@ -14,6 +14,9 @@ Packager:       Juergen Mang <mail@jcgames.de>
 Source:         mympd-%{version}.tar.gz
 BuildRequires:  cmake
 BuildRequires:	flac-devel
+BuildRequires:	libjpeg-turbo-devel
+BuildRequires:	libpng-devel
+BuildRequires:	zlib-devel
 BuildRequires:  gcc
 BuildRequires:  libid3tag-devel
 BuildRequires:  lua-devel
@@ -432,6 +432,37 @@ const APImethods = {
             "searchstr": APIparams.searchstr
         }
     },
+    "MYMPD_API_PLAY_STATS_TOP_LIST": {
+        "desc": "Lists the most played or skipped artists, albums, songs or genres of the last days.",
+        "params": {
+            "type": {
+                "type": "text",
+                "example": "Artist",
+                "desc": "valid values are: \"Artist\", \"Album\", \"Song\", \"Genre\""
+            },
+            "days": {
+                "type": "uint",
+                "example": 7,
+                "desc": "Number of days including today (1 - 366)"
+            },
+            "sort": {
+                "type": "text",
+                "example": "plays",
+                "desc": "valid values are: \"plays\", \"skips\", \"skipRate\""
+            },
+            "limit": APIparams.limit
+        }
+    },
+    "MYMPD_API_PLAY_STATS_DAYS_LIST": {
+        "desc": "Lists the plays and skips per day, newest first.",
+        "params": {
+            "days": {
+                "type": "uint",
+                "example": 30,
+                "desc": "Number of days including today (1 - 366)"
+            }
+        }
+    },
     "MYMPD_API_PLAYLIST_RM": {
         "desc": "Removes the MPD playlist.",
         "params": {
@@ -1645,6 +1676,11 @@ const APImethods = {
         "desc": "Crops the covercache.",
         "params": {}
     },
+    "MYMPD_API_COVERCACHE_PREWARM": {
+        "desc": "Fills the covercache with the coverimages and thumbnails of all albums in the background.",
+        "protected": true,
+        "params": {}
+    },
     "MYMPD_API_LOGLEVEL": {
         "desc": "Sets the loglevel.",
         "protected": true,
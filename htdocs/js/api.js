@@ -275,65 +275,110 @@ function sendAPI(method, params, callback, onerror) {
             session.timeout = getTimestamp() + sessionLifetime;
             resetSessionTimer();
         }
-        let obj;
-        try {
-            obj = JSON.parse(ajaxRequest.responseText);
-        }
-        catch(error) {
-            showNotification(tn('Can not parse response to json object'), '', 'general', 'error');
-            logError('Can not parse response to json object:' + ajaxRequest.responseText);
-        }
-        if (obj.error &&
-            typeof obj.error.message === 'string')
-        {
-            //show error message
-            showNotification(tn(obj.error.message, obj.error.data), '', obj.error.facility, obj.error.severity);
-            logError(ajaxRequest.responseText);
-        }
-        else if (obj.result &&
-                 obj.result.message === 'ok')
-        {
-            //show no message
-            logDebug('Got API response: ' + ajaxRequest.responseText);
+        handleAPIresponse(ajaxRequest.responseText, callback, onerror);
+    };
+    ajaxRequest.send(JSON.stringify(request));
+    logDebug('Send API request: ' + method);
+    return true;
+}
+
+/**
+ * Handles a JSON-RPC API response and calls the callback function.
+ * @param {String} responseText the jsonrpc response
+ * @param {Callback} callback callback function
+ * @param {Boolean} onerror true = execute callback also on error
+ */
+function handleAPIresponse(responseText, callback, onerror) {
+    let obj;
+    try {
+        obj = JSON.parse(responseText);
+    }
+    catch(error) {
+        showNotification(tn('Can not parse response to json object'), '', 'general', 'error');
+        logError('Can not parse response to json object:' + responseText);
+    }
+    if (obj.error &&
+        typeof obj.error.message === 'string')
+    {
+        //show error message
+        showNotification(tn(obj.error.message, obj.error.data), '', obj.error.facility, obj.error.severity);
+        logError(responseText);
+    }
+    else if (obj.result &&
+             obj.result.message === 'ok')
+    {
+        //show no message
+        logDebug('Got API response: ' + responseText);
+    }
+    else if (obj.result &&
+             typeof obj.result.message === 'string')
+    {
+        //show message
+        logDebug('Got API response: ' + responseText);
+        if (ignoreMessages.includes(obj.result.message) === false) {
+            showNotification(tn(obj.result.message, obj.result.data), '', obj.result.facility, obj.result.severity);
         }
-        else if (obj.result &&
-                 typeof obj.result.message === 'string')
-        {
-            //show message
-            logDebug('Got API response: ' + ajaxRequest.responseText);
-            if (ignoreMessages.includes(obj.result.message) === false) {
-                showNotification(tn(obj.result.message, obj.result.data), '', obj.result.facility, obj.result.severity);
-            }
+    }
+    else if (obj.result &&
+             typeof obj.result.method === 'string')
+    {
+        //result is used in callback
+        logDebug('Got API response of type: ' + obj.result.method);
+    }
+    else {
+        //remaining results are invalid
+        logError('Got invalid API response: ' + responseText);
+        if (onerror !== true) {
+            return;
         }
-        else if (obj.result &&
-                 typeof obj.result.method === 'string')
+    }
+    if (callback !== undefined &&
+        typeof(callback) === 'function')
+    {
+        if (obj.result !== undefined ||
+            onerror === true)
         {
-            //result is used in callback
-            logDebug('Got API response of type: ' + obj.result.method);
+            logDebug('Calling ' + callback.name);
+            callback(obj);
         }
         else {
-            //remaining results are invalid
-            logError('Got invalid API response: ' + ajaxRequest.responseText);
-            if (onerror !== true) {
-                return;
-            }
+            logDebug('Undefined resultset, skip calling ' + callback.name);
         }
-        if (callback !== undefined &&
-            typeof(callback) === 'function')
-        {
-            if (obj.result !== undefined ||
-                onerror === true)
-            {
-                logDebug('Calling ' + callback.name);
-                callback(obj);
-            }
-            else {
-                logDebug('Undefined resultset, skip calling ' + callback.name);
-            }
-        }
-    };
-    ajaxRequest.send(JSON.stringify(request));
-    logDebug('Send API request: ' + method);
+    }
+}
+
+/**
+ * Sends a JSON-RPC API request over the websocket connection.
+ * The response is assigned by the jsonrpc id.
+ * Falls back to sendAPI for protected methods and if the websocket is not connected.
+ * @param {String} method jsonrpc api method
+ * @param {Object} params jsonrpc parameters
+ * @param {Callback} callback callback function
+ * @param {Boolean} onerror true = execute callback also on error
+ * @returns {Boolean} true on success, else false
+ */
+function sendAPIws(method, params, callback, onerror) {
+    if (socket === null ||
+        socket.readyState !== WebSocket.OPEN ||
+        websocketConnected === false ||
+        APImethods[method] === undefined ||
+        APImethods[method].protected === true)
+    {
+        return sendAPI(method, params, callback, onerror);
+    }
+    websocketRequestId++;
+    const id = websocketRequestId;
+    const request = {"jsonrpc": "2.0", "id": id, "method": method, "params": params};
+    //remove the pending request if no response is received
+    const timer = setTimeout(function() {
+        delete websocketRequests[id];
+        logError('Websocket API request timed out: ' + method);
+        handleAPIresponse(JSON.stringify({"jsonrpc": "2.0", "id": id, "error": {"method": method,
+            "facility": "general", "severity": "error", "message": "API request timed out", "data": {}}}), callback, onerror);
+    }, websocketRequestTimeout);
+    websocketRequests[id] = {"callback": callback, "onerror": onerror, "timer": timer};
+    socket.send(JSON.stringify(request));
+    logDebug('Send websocket API request: ' + method);
     return true;
 }
 
@@ -387,6 +432,19 @@ function webSocketConnect() {
                 logError("Websocket message is too large, discarding");
                 return;
             }
+            if (msg.data.indexOf('{"jsonrpc":"2.0","id":') === 0) {
+                //response for an api request sent by sendAPIws
+                const id = Number(msg.data.match(/^{"jsonrpc":"2.0","id":(\d+)/)[1]);
+                const request = websocketRequests[id];
+                if (request === undefined) {
+                    handleAPIresponse(msg.data);
+                    return;
+                }
+                clearTimeout(request.timer);
+                delete websocketRequests[id];
+                handleAPIresponse(msg.data, request.callback, request.onerror);
+                return;
+            }
             let obj;
             try {
                 obj = JSON.parse(msg.data);
@@ -412,7 +470,8 @@ function webSocketConnect() {
                     obj.result = obj.params;
                     delete obj.params;
                     if (app.id === 'QueueCurrent' &&
-                        obj.method === 'update_queue')
+                        obj.method === 'update_queue' &&
+                        applyQueueDelta(obj.result.delta) === false)
                     {
                         getQueue(document.getElementById('searchQueueStr').value);
                     }
@@ -532,6 +591,11 @@ function webSocketConnect() {
                 clearInterval(websocketKeepAliveTimer);
                 websocketKeepAliveTimer = null;
             }
+            //responses for pending requests are lost
+            for (const id in websocketRequests) {
+                clearTimeout(websocketRequests[id].timer);
+            }
+            websocketRequests = {};
             websocketTimer = setTimeout(function() {
                 logDebug('Reconnecting websocket');
                 toggleAlert('alertMympdState', true, tn('Websocket connection failed, trying to reconnect'));
@@ -8,6 +8,9 @@ let socket = null;
 let websocketConnected = false;
 let websocketTimer = null;
 let websocketKeepAliveTimer = null;
+let websocketRequestId = 0;
+let websocketRequests = {};
+const websocketRequestTimeout = 30000;
 let searchTimer = null;
 const searchTimerTimeout = 500;
 let currentSong = '';
@@ -28,6 +31,7 @@ let scriptsInited = false;
 let subdir = '';
 let uiEnabled = true;
 let allOutputs = null;
+let lastQueueList = null;
 const ligatureMore = 'menu';
 const progressBarTransition = 'width 1s linear';
 const smallSpace = '\u2009';
@@ -933,7 +933,7 @@ function initNavs() {
             currentState.totalTime > 0)
         {
             const seekVal = Math.ceil((currentState.totalTime * event.clientX) / domCache.progress.offsetWidth);
-            sendAPI("MYMPD_API_PLAYER_SEEK_CURRENT", {
+            sendAPIws("MYMPD_API_PLAYER_SEEK_CURRENT", {
                 "seek": seekVal,
                 "relative": false
             });
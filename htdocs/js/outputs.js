@@ -12,7 +12,7 @@ function initOutputs() {
     }
 
     document.getElementById('volumeBar').addEventListener('change', function() {
-        sendAPI("MYMPD_API_PLAYER_VOLUME_SET", {"volume": Number(document.getElementById('volumeBar').value)});
+        sendAPIws("MYMPD_API_PLAYER_VOLUME_SET", {"volume": Number(document.getElementById('volumeBar').value)});
     }, false);
 
     document.getElementById('volumeMenu').parentNode.addEventListener('show.bs.dropdown', function () {
@@ -191,7 +191,7 @@ function chVolume(increment) {
         newValue = settings.volumeMax;
     }
     volumeBar.value = newValue;
-    sendAPI("MYMPD_API_PLAYER_VOLUME_SET", {
+    sendAPIws("MYMPD_API_PLAYER_VOLUME_SET", {
         "volume": newValue
     });
 }
@@ -177,6 +177,58 @@ function getQueue(x) {
     }
 }
 
+function applyQueueDelta(delta) {
+    //the delta can only be applied to the unfiltered queue in queue order,
+    //the displayed page must reflect the previous queue version
+    if (delta === undefined ||
+        lastQueueList === null ||
+        lastQueueList.result.queueVersion !== delta.fromVersion ||
+        lastQueueList.result.offset !== app.current.offset ||
+        app.current.search !== '' ||
+        app.current.sort.tag !== 'Priority' ||
+        app.current.sort.desc === true)
+    {
+        return false;
+    }
+    //sorted by priority the queue order is kept only if all songs have the default priority
+    const songs = {};
+    for (let i = 0; i < lastQueueList.result.data.length; i++) {
+        const song = lastQueueList.result.data[i];
+        if (song.Priority !== 0 ||
+            song.Pos !== app.current.offset + i)
+        {
+            return false;
+        }
+        songs[song.Pos] = song;
+    }
+    for (const song of delta.songs) {
+        if (song.Priority !== 0) {
+            return false;
+        }
+        songs[song.Pos] = song;
+    }
+    const data = [];
+    let totalTime = 0;
+    const end = Math.min(app.current.offset + app.current.limit, delta.length);
+    for (let pos = app.current.offset; pos < end; pos++) {
+        if (songs[pos] === undefined) {
+            return false;
+        }
+        data.push(songs[pos]);
+        totalTime += songs[pos].Duration;
+    }
+    logDebug('Applying queue delta ' + delta.fromVersion + ' -> ' + delta.toVersion);
+    parseQueue({"result": {
+        "data": data,
+        "totalTime": totalTime,
+        "totalEntities": delta.length,
+        "queueVersion": delta.toVersion,
+        "offset": app.current.offset,
+        "returnedEntities": data.length
+    }});
+    return true;
+}
+
 function parseQueue(obj) {
     //goto playing song button
     if (obj.result &&
@@ -190,8 +242,11 @@ function parseQueue(obj) {
 
     const table = document.getElementById('QueueCurrentList');
     if (checkResultId(obj, 'QueueCurrentList') === false) {
+        lastQueueList = null;
         return;
     }
+    //remember the unfiltered queue listing for patching with queue deltas
+    lastQueueList = obj.result.queueVersion !== undefined && app.current.search === '' ? obj : null;
 
     if (obj.result.offset < app.current.offset) {
         gotoPage(obj.result.offset);
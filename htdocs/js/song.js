@@ -395,7 +395,7 @@ function createLyricsTabs(el, obj) {
                     textEls[i].addEventListener('click', function(event) {
                         const sec = event.target.getAttribute('data-sec');
                         if (sec !== null) {
-                            sendAPI("MYMPD_API_PLAYER_SEEK_CURRENT", {
+                            sendAPIws("MYMPD_API_PLAYER_SEEK_CURRENT", {
                                 "seek": Number(sec),
                                 "relative": false
                             });
@@ -383,7 +383,7 @@ function seekRelativeBackward() {
 }
 
 function seekRelative(offset) {
-    sendAPI("MYMPD_API_PLAYER_SEEK_CURRENT", {
+    sendAPIws("MYMPD_API_PLAYER_SEEK_CURRENT", {
         "seek": offset,
         "relative": true
     });
@@ -1471,6 +1471,11 @@ function cropCovercache() {
     sendAPI("MYMPD_API_COVERCACHE_CROP", {});
 }
 
+//eslint-disable-next-line no-unused-vars
+function prewarmCovercache() {
+    sendAPI("MYMPD_API_COVERCACHE_PREWARM", {});
+}
+
 //eslint-disable-next-line no-unused-vars
 function zoomPicture(el) {
     if (el.classList.contains('booklet')) {
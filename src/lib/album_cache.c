@@ -78,6 +78,28 @@ struct mpd_song *album_cache_get_album(struct t_cache *album_cache, sds key) {
     return (struct mpd_song *) data;
 }
 
+/**
+ * Appends the uris of the first song of each album to the list
+ * @param album_cache pointer to t_cache struct
+ * @param uris already initialized list to append the uris
+ * @return number of appended uris
+ */
+long album_cache_get_uris(struct t_cache *album_cache, struct t_list *uris) {
+    if (album_cache->cache == NULL) {
+        return 0;
+    }
+    long count = 0;
+    raxIterator iter;
+    raxStart(&iter, album_cache->cache);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        list_push(uris, mpd_song_get_uri((struct mpd_song *)iter.data), 0, NULL, NULL);
+        count++;
+    }
+    raxStop(&iter);
+    return count;
+}
+
 /**
  * Frees the album cache
  * @param album_cache pointer to t_cache struct
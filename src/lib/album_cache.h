@@ -9,12 +9,14 @@
 
 #include "../../dist/rax/rax.h"
 #include "../../dist/sds/sds.h"
+#include "../lib/list.h"
 #include "../lib/mympd_state.h"
 
 #include <stdbool.h>
 
 sds album_cache_get_key(struct mpd_song *song, sds albumkey);
 struct mpd_song *album_cache_get_album(struct t_cache *album_cache, sds key);
+long album_cache_get_uris(struct t_cache *album_cache, struct t_list *uris);
 void album_cache_free(struct t_cache *album_cache);
 
 unsigned album_get_discs(struct mpd_song *album);
@@ -8,21 +8,70 @@
 #include "api.h"
 
 #include "../../dist/mongoose/mongoose.h"
+#include "list.h"
 #include "log.h"
 #include "mem.h"
 #include "sds_extras.h"
 
 #include <mpd/client.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <string.h>
 
+/**
+ * Private definitions
+ */
+
 static const char *mympd_cmd_strs[] = { MYMPD_CMDS(GEN_STR) };
 
+/**
+ * Perfect hash table for the api method names.
+ * The method names are distributed to buckets with the first hash function,
+ * each bucket has its own seed for the second hash function that maps
+ * all names of the bucket to distinct free slots.
+ * The table is built once from mympd_cmd_strs, a lookup needs two hashes and one strcmp.
+ */
+#define API_HASH_BUCKETS (TOTAL_API_COUNT / 4 + 1)
+#define API_HASH_SLOTS (TOTAL_API_COUNT * 2)
+#define API_HASH_BUCKET_KEYS_MAX 32
+#define API_HASH_SEED_MAX 65535
+
+static unsigned api_hash_seeds[API_HASH_BUCKETS];  //!< second level seed for each bucket
+static unsigned api_hash_slots[API_HASH_SLOTS];    //!< cmd_id for each slot, GENERAL_API_UNKNOWN = empty
+static unsigned api_method_flags[TOTAL_API_COUNT]; //!< enum mympd_api_flags bitfield for each cmd_id
+static bool api_hash_valid;                        //!< false if no perfect hash was found
+static pthread_once_t api_table_once = PTHREAD_ONCE_INIT;
+
+static void api_table_build(void);
+static bool api_hash_build(void);
+static unsigned api_hash(unsigned seed, const char *str);
+static unsigned get_flags(enum mympd_cmd_ids cmd_id);
+static bool method_is_protected(enum mympd_cmd_ids cmd_id);
+static bool method_is_mympd_only(enum mympd_cmd_ids cmd_id);
+static bool method_is_webserver(enum mympd_cmd_ids cmd_id);
+static bool method_is_batch(enum mympd_cmd_ids cmd_id);
+static bool method_is_coalescable(enum mympd_cmd_ids cmd_id);
+static bool method_is_pool(enum mympd_cmd_ids cmd_id);
+static void list_free_cb_work_request(struct t_list_node *current);
+
+/**
+ * Public functions
+ */
+
 /**
  * Converts a string to the mympd_cmd_ids enum
  * @param cmd string to convert
  * @return enum mympd_cmd_ids
  */
 enum mympd_cmd_ids get_cmd_id(const char *cmd) {
+    pthread_once(&api_table_once, api_table_build);
+    if (api_hash_valid == true) {
+        unsigned bucket = api_hash(0, cmd) % API_HASH_BUCKETS;
+        unsigned i = api_hash_slots[api_hash(api_hash_seeds[bucket], cmd) % API_HASH_SLOTS];
+        return i != GENERAL_API_UNKNOWN && strcmp(cmd, mympd_cmd_strs[i]) == 0
+            ? i
+            : GENERAL_API_UNKNOWN;
+    }
     for (unsigned i = 0; i < TOTAL_API_COUNT; i++) {
         if (strcmp(cmd, mympd_cmd_strs[i]) == 0) {
             return i;
@@ -31,6 +80,15 @@ enum mympd_cmd_ids get_cmd_id(const char *cmd) {
     return GENERAL_API_UNKNOWN;
 }
 
+/**
+ * Returns the flags of an api method
+ * @param cmd_id myMPD API method
+ * @return enum mympd_api_flags bitfield
+ */
+unsigned get_api_method_flags(enum mympd_cmd_ids cmd_id) {
+    return get_flags(cmd_id);
+}
+
 /**
  * Converts the mympd_cmd_ids enum to the string
  * @param cmd_id myMPD API method
@@ -49,32 +107,7 @@ const char *get_cmd_id_method_name(enum mympd_cmd_ids cmd_id) {
  * @return true if protected else false
  */
 bool is_protected_api_method(enum mympd_cmd_ids cmd_id) {
-    switch(cmd_id) {
-        case MYMPD_API_CONNECTION_SAVE:
-        case MYMPD_API_COVERCACHE_CLEAR:
-        case MYMPD_API_COVERCACHE_CROP:
-        case MYMPD_API_MOUNT_MOUNT:
-        case MYMPD_API_MOUNT_UNMOUNT:
-        case MYMPD_API_PARTITION_NEW:
-        case MYMPD_API_PARTITION_RM:
-        case MYMPD_API_PARTITION_OUTPUT_MOVE:
-        case MYMPD_API_PLAYER_OUTPUT_ATTRIBUTS_SET:
-        case MYMPD_API_PLAYLIST_RM_ALL:
-        case MYMPD_API_SESSION_LOGOUT:
-        case MYMPD_API_SESSION_VALIDATE:
-        case MYMPD_API_SETTINGS_SET:
-        case MYMPD_API_SCRIPT_RM:
-        case MYMPD_API_SCRIPT_SAVE:
-        case MYMPD_API_TIMER_RM:
-        case MYMPD_API_TIMER_SAVE:
-        case MYMPD_API_TIMER_TOGGLE:
-        case MYMPD_API_TRIGGER_RM:
-        case MYMPD_API_TRIGGER_SAVE:
-        case MYMPD_API_LOGLEVEL:
-            return true;
-        default:
-            return false;
-    }
+    return (get_flags(cmd_id) & API_FLAG_PROTECTED) != 0;
 }
 
 /**
@@ -83,12 +116,7 @@ bool is_protected_api_method(enum mympd_cmd_ids cmd_id) {
  * @return true if public else false
  */
 bool is_public_api_method(enum mympd_cmd_ids cmd_id) {
-    if (cmd_id <= INTERNAL_API_COUNT ||
-        cmd_id >= TOTAL_API_COUNT)
-    {
-        return false;
-    }
-    return true;
+    return (get_flags(cmd_id) & API_FLAG_PUBLIC) != 0;
 }
 
 /**
@@ -98,14 +126,122 @@ bool is_public_api_method(enum mympd_cmd_ids cmd_id) {
  * @return true if method works with no mpd connection else false
  */
 bool is_mympd_only_api_method(enum mympd_cmd_ids cmd_id) {
+    return (get_flags(cmd_id) & API_FLAG_MYMPD_ONLY) != 0;
+}
+
+/**
+ * Defines methods that are handled in the webserver thread.
+ * These methods send http responses directly.
+ * @param cmd_id myMPD API method
+ * @return true if method is handled by the webserver else false
+ */
+bool is_webserver_api_method(enum mympd_cmd_ids cmd_id) {
+    return (get_flags(cmd_id) & API_FLAG_WEBSERVER) != 0;
+}
+
+/**
+ * Defines methods that can be used in jsonrpc batch requests.
+ * Methods handled by the webserver thread or by a mpd_worker thread
+ * can not be combined in a single mympd_api dispatch.
+ * @param cmd_id myMPD API method
+ * @return true if method can be batched else false
+ */
+bool is_batch_api_method(enum mympd_cmd_ids cmd_id) {
+    return (get_flags(cmd_id) & API_FLAG_BATCH) != 0;
+}
+
+/**
+ * Defines read only methods that are answered synchronously.
+ * Identical queued requests for this methods are executed only once.
+ * @param cmd_id myMPD API method
+ * @return true if requests can be coalesced else false
+ */
+bool is_coalescable_api_method(enum mympd_cmd_ids cmd_id) {
+    return (get_flags(cmd_id) & API_FLAG_COALESCABLE) != 0;
+}
+
+/**
+ * Defines read heavy methods that are handled by the mpd_worker pool
+ * with an auxiliary mpd connection.
+ * @param cmd_id myMPD API method
+ * @return true if method can be handled by the pool else false
+ */
+bool is_pool_api_method(enum mympd_cmd_ids cmd_id) {
+    return (get_flags(cmd_id) & API_FLAG_POOL) != 0;
+}
+
+/**
+ * Returns the priority class of an api method for the mympd_api_queue.
+ * Read only requests and player controls are moved ahead of long running jobs.
+ * @param cmd_id myMPD API method
+ * @return the priority
+ */
+enum mympd_queue_priorities get_api_method_priority(enum mympd_cmd_ids cmd_id) {
+    if (is_coalescable_api_method(cmd_id) == true) {
+        return QUEUE_PRIORITY_READ;
+    }
     switch(cmd_id) {
-        case MYMPD_API_CONNECTION_SAVE:
+        //long running jobs
+        case INTERNAL_API_CACHES_CREATE:
+        case INTERNAL_API_STATE_SAVE:
+        case MYMPD_API_COVERCACHE_CLEAR:
+        case MYMPD_API_COVERCACHE_CROP:
+        case MYMPD_API_COVERCACHE_PREWARM:
+        case MYMPD_API_DATABASE_RESCAN:
+        case MYMPD_API_DATABASE_UPDATE:
+        case MYMPD_API_PLAYLIST_CONTENT_APPEND_SEARCH:
+        case MYMPD_API_PLAYLIST_CONTENT_INSERT_SEARCH:
+        case MYMPD_API_PLAYLIST_CONTENT_REPLACE_SEARCH:
+        case MYMPD_API_PLAYLIST_CONTENT_SHUFFLE:
+        case MYMPD_API_PLAYLIST_CONTENT_SORT:
+        case MYMPD_API_PLAYLIST_RM_ALL:
+        case MYMPD_API_QUEUE_ADD_RANDOM:
+        case MYMPD_API_QUEUE_APPEND_PLAYLIST:
+        case MYMPD_API_QUEUE_APPEND_SEARCH:
+        case MYMPD_API_QUEUE_INSERT_PLAYLIST:
+        case MYMPD_API_QUEUE_INSERT_SEARCH:
+        case MYMPD_API_QUEUE_REPLACE_PLAYLIST:
+        case MYMPD_API_QUEUE_REPLACE_SEARCH:
+        case MYMPD_API_QUEUE_SAVE:
+        case MYMPD_API_SMARTPLS_UPDATE:
+        case MYMPD_API_SMARTPLS_UPDATE_ALL:
+        case MYMPD_API_SONG_FINGERPRINT:
+            return QUEUE_PRIORITY_BULK;
+        //read only views
+        case INTERNAL_API_ALBUMART:
+        case MYMPD_API_HOME_ICON_GET:
         case MYMPD_API_HOME_ICON_LIST:
+        case MYMPD_API_MOUNT_LIST:
+        case MYMPD_API_MOUNT_NEIGHBOR_LIST:
+        case MYMPD_API_MOUNT_URLHANDLER_LIST:
+        case MYMPD_API_PICTURE_LIST:
+        case MYMPD_API_QUEUE_SEARCH_ADV:
+        case MYMPD_API_SCRIPT_GET:
         case MYMPD_API_SCRIPT_LIST:
         case MYMPD_API_SETTINGS_GET:
-            return true;
+        case MYMPD_API_SMARTPLS_GET:
+        case MYMPD_API_SONG_COMMENTS:
+        case MYMPD_API_SONG_DETAILS:
+        case MYMPD_API_TIMER_GET:
+        case MYMPD_API_TIMER_LIST:
+        case MYMPD_API_TRIGGER_GET:
+        case MYMPD_API_TRIGGER_LIST:
+        case MYMPD_API_WEBRADIO_FAVORITE_GET:
+            return QUEUE_PRIORITY_READ;
+        //player control, does not depend on the queue content
+        case MYMPD_API_PLAYER_CLEARERROR:
+        case MYMPD_API_PLAYER_OUTPUT_ATTRIBUTS_SET:
+        case MYMPD_API_PLAYER_OUTPUT_TOGGLE:
+        case MYMPD_API_PLAYER_PAUSE:
+        case MYMPD_API_PLAYER_PLAY:
+        case MYMPD_API_PLAYER_RESUME:
+        case MYMPD_API_PLAYER_SEEK_CURRENT:
+        case MYMPD_API_PLAYER_STOP:
+        case MYMPD_API_PLAYER_VOLUME_SET:
+            return QUEUE_PRIORITY_INTERACTIVE;
+        //all other changes
         default:
-            return false;
+            return QUEUE_PRIORITY_CHANGE;
     }
 }
 
@@ -150,6 +286,27 @@ struct t_work_response *create_response_new(long long conn_id, long request_id,
     return response;
 }
 
+/**
+ * Copies a jsonrpc response for an identical request
+ * @param response the response to copy
+ * @param request the identical request
+ * @return the response with the jsonrpc id of the request
+ *         or NULL if the jsonrpc id could not be replaced
+ */
+struct t_work_response *copy_response(struct t_work_response *response, struct t_work_request *request) {
+    sds prefix = sdscatfmt(sdsempty(), "{\"jsonrpc\":\"2.0\",\"id\":%l,", response->id);
+    size_t prefix_len = sdslen(prefix);
+    bool found = strncmp(response->data, prefix, prefix_len) == 0;
+    FREE_SDS(prefix);
+    if (found == false) {
+        return NULL;
+    }
+    struct t_work_response *copy = create_response(request);
+    copy->data = sdscatfmt(copy->data, "{\"jsonrpc\":\"2.0\",\"id\":%l,", request->id);
+    copy->data = sdscatlen(copy->data, response->data + prefix_len, sdslen(response->data) - prefix_len);
+    return copy;
+}
+
 /**
  * Mallocs and initializes a t_work_request struct
  * @param conn_id connection id (from webserver)
@@ -172,6 +329,7 @@ struct t_work_request *create_request(long long conn_id, long request_id, enum m
         request->data = sdsnew(data);
     }
     request->extra = NULL;
+    request->stream = false;
     return request;
 }
 
@@ -181,6 +339,12 @@ struct t_work_request *create_request(long long conn_id, long request_id, enum m
  */
 void free_request(struct t_work_request *request) {
     if (request != NULL) {
+        if (request->cmd_id == INTERNAL_API_BATCH &&
+            request->extra != NULL)
+        {
+            //a batch request owns the requests it contains
+            list_free_user_data((struct t_list *)request->extra, list_free_cb_work_request);
+        }
         FREE_SDS(request->data);
         FREE_SDS(request->method);
         FREE_PTR(request);
@@ -199,3 +363,293 @@ void free_response(struct t_work_response *response) {
         FREE_PTR(response);
     }
 }
+
+/**
+ * Private functions
+ */
+
+/**
+ * Builds the perfect hash table and the flags for all api methods
+ */
+static void api_table_build(void) {
+    for (unsigned i = 0; i < TOTAL_API_COUNT; i++) {
+        unsigned flags = 0;
+        if (i > INTERNAL_API_COUNT) {
+            flags |= API_FLAG_PUBLIC;
+        }
+        if (method_is_protected(i) == true) {
+            flags |= API_FLAG_PROTECTED;
+        }
+        if (method_is_mympd_only(i) == true) {
+            flags |= API_FLAG_MYMPD_ONLY;
+        }
+        if (method_is_webserver(i) == true) {
+            flags |= API_FLAG_WEBSERVER;
+        }
+        if (method_is_batch(i) == true) {
+            flags |= API_FLAG_BATCH;
+        }
+        if (method_is_coalescable(i) == true) {
+            flags |= API_FLAG_COALESCABLE;
+        }
+        if (method_is_pool(i) == true) {
+            flags |= API_FLAG_POOL;
+        }
+        api_method_flags[i] = flags;
+    }
+    api_hash_valid = api_hash_build();
+    if (api_hash_valid == false) {
+        MYMPD_LOG_WARN("Could not build the api method hash table, falling back to linear search");
+    }
+}
+
+/**
+ * Finds the seeds for the perfect hash table.
+ * The buckets are processed from the largest to the smallest,
+ * the seeds are tried until all names of a bucket are mapped to free slots.
+ * @return true on success, else false
+ */
+static bool api_hash_build(void) {
+    unsigned bucket_of[TOTAL_API_COUNT];
+    unsigned bucket_size[API_HASH_BUCKETS] = { 0 };
+    unsigned max_size = 0;
+    for (unsigned i = GENERAL_API_UNKNOWN + 1; i < TOTAL_API_COUNT; i++) {
+        bucket_of[i] = api_hash(0, mympd_cmd_strs[i]) % API_HASH_BUCKETS;
+        bucket_size[bucket_of[i]]++;
+        if (bucket_size[bucket_of[i]] > max_size) {
+            max_size = bucket_size[bucket_of[i]];
+        }
+    }
+    if (max_size > API_HASH_BUCKET_KEYS_MAX) {
+        return false;
+    }
+    memset(api_hash_slots, 0, sizeof(api_hash_slots));
+    memset(api_hash_seeds, 0, sizeof(api_hash_seeds));
+    for (unsigned size = max_size; size > 0; size--) {
+        for (unsigned bucket = 0; bucket < API_HASH_BUCKETS; bucket++) {
+            if (bucket_size[bucket] != size) {
+                continue;
+            }
+            unsigned keys[API_HASH_BUCKET_KEYS_MAX];
+            unsigned key_count = 0;
+            for (unsigned i = GENERAL_API_UNKNOWN + 1; i < TOTAL_API_COUNT; i++) {
+                if (bucket_of[i] == bucket) {
+                    keys[key_count++] = i;
+                }
+            }
+            unsigned seed = 1;
+            for (; seed <= API_HASH_SEED_MAX; seed++) {
+                unsigned slots[API_HASH_BUCKET_KEYS_MAX];
+                bool found = true;
+                for (unsigned k = 0; k < key_count && found == true; k++) {
+                    slots[k] = api_hash(seed, mympd_cmd_strs[keys[k]]) % API_HASH_SLOTS;
+                    if (api_hash_slots[slots[k]] != GENERAL_API_UNKNOWN) {
+                        found = false;
+                    }
+                    for (unsigned j = 0; j < k && found == true; j++) {
+                        if (slots[j] == slots[k]) {
+                            found = false;
+                        }
+                    }
+                }
+                if (found == true) {
+                    for (unsigned k = 0; k < key_count; k++) {
+                        api_hash_slots[slots[k]] = keys[k];
+                    }
+                    api_hash_seeds[bucket] = seed;
+                    break;
+                }
+            }
+            if (seed > API_HASH_SEED_MAX) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Seeded FNV-1a hash
+ * @param seed the seed
+ * @param str string to hash
+ * @return the hash value
+ */
+static unsigned api_hash(unsigned seed, const char *str) {
+    uint32_t hash = 2166136261U ^ seed;
+    while (*str != '\0') {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/**
+ * Returns the flags of an api method
+ * @param cmd_id myMPD API method
+ * @return enum mympd_api_flags bitfield
+ */
+static unsigned get_flags(enum mympd_cmd_ids cmd_id) {
+    if (cmd_id >= TOTAL_API_COUNT) {
+        return 0;
+    }
+    pthread_once(&api_table_once, api_table_build);
+    return api_method_flags[cmd_id];
+}
+
+/**
+ * Defines methods that need authentication if a pin is set.
+ * @param cmd_id myMPD API method
+ * @return true if protected else false
+ */
+static bool method_is_protected(enum mympd_cmd_ids cmd_id) {
+    switch(cmd_id) {
+        case MYMPD_API_CONNECTION_SAVE:
+        case MYMPD_API_COVERCACHE_CLEAR:
+        case MYMPD_API_COVERCACHE_CROP:
+        case MYMPD_API_COVERCACHE_PREWARM:
+        case MYMPD_API_MOUNT_MOUNT:
+        case MYMPD_API_MOUNT_UNMOUNT:
+        case MYMPD_API_PARTITION_NEW:
+        case MYMPD_API_PARTITION_RM:
+        case MYMPD_API_PARTITION_OUTPUT_MOVE:
+        case MYMPD_API_PLAYER_OUTPUT_ATTRIBUTS_SET:
+        case MYMPD_API_PLAYLIST_RM_ALL:
+        case MYMPD_API_SESSION_LOGOUT:
+        case MYMPD_API_SESSION_VALIDATE:
+        case MYMPD_API_SETTINGS_SET:
+        case MYMPD_API_SCRIPT_RM:
+        case MYMPD_API_SCRIPT_SAVE:
+        case MYMPD_API_TIMER_RM:
+        case MYMPD_API_TIMER_SAVE:
+        case MYMPD_API_TIMER_TOGGLE:
+        case MYMPD_API_TRIGGER_RM:
+        case MYMPD_API_TRIGGER_SAVE:
+        case MYMPD_API_LOGLEVEL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Defines methods that should work with no mpd connection,
+ * this is necessary for correct startup and changing mpd connection settings.
+ * @param cmd_id myMPD API method
+ * @return true if method works with no mpd connection else false
+ */
+static bool method_is_mympd_only(enum mympd_cmd_ids cmd_id) {
+    switch(cmd_id) {
+        case MYMPD_API_CONNECTION_SAVE:
+        case MYMPD_API_HOME_ICON_LIST:
+        case MYMPD_API_SCRIPT_LIST:
+        case MYMPD_API_SETTINGS_GET:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Defines methods that are handled in the webserver thread.
+ * These methods send http responses directly.
+ * @param cmd_id myMPD API method
+ * @return true if method is handled by the webserver else false
+ */
+static bool method_is_webserver(enum mympd_cmd_ids cmd_id) {
+    switch(cmd_id) {
+        case MYMPD_API_CLOUD_RADIOBROWSER_CLICK_COUNT:
+        case MYMPD_API_CLOUD_RADIOBROWSER_NEWEST:
+        case MYMPD_API_CLOUD_RADIOBROWSER_SERVERLIST:
+        case MYMPD_API_CLOUD_RADIOBROWSER_SEARCH:
+        case MYMPD_API_CLOUD_RADIOBROWSER_STATION_DETAIL:
+        case MYMPD_API_CLOUD_WEBRADIODB_COMBINED_GET:
+        case MYMPD_API_SESSION_LOGIN:
+        case MYMPD_API_SESSION_LOGOUT:
+        case MYMPD_API_SESSION_VALIDATE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Defines methods that can be used in jsonrpc batch requests.
+ * Methods handled by the webserver thread or by a mpd_worker thread
+ * can not be combined in a single mympd_api dispatch.
+ * @param cmd_id myMPD API method
+ * @return true if method can be batched else false
+ */
+static bool method_is_batch(enum mympd_cmd_ids cmd_id) {
+    if (cmd_id <= INTERNAL_API_COUNT ||
+        cmd_id >= TOTAL_API_COUNT ||
+        method_is_webserver(cmd_id) == true)
+    {
+        return false;
+    }
+    switch(cmd_id) {
+        case MYMPD_API_COVERCACHE_PREWARM:
+        case MYMPD_API_SMARTPLS_UPDATE:
+        case MYMPD_API_SMARTPLS_UPDATE_ALL:
+            return false;
+        default:
+            return true;
+    }
+}
+
+/**
+ * Defines read only methods that are answered synchronously.
+ * Identical queued requests for this methods are executed only once.
+ * @param cmd_id myMPD API method
+ * @return true if requests can be coalesced else false
+ */
+static bool method_is_coalescable(enum mympd_cmd_ids cmd_id) {
+    switch(cmd_id) {
+        case MYMPD_API_DATABASE_ALBUMS_GET:
+        case MYMPD_API_DATABASE_FILESYSTEM_LIST:
+        case MYMPD_API_DATABASE_SEARCH:
+        case MYMPD_API_DATABASE_STATS:
+        case MYMPD_API_DATABASE_TAG_ALBUM_TITLE_LIST:
+        case MYMPD_API_DATABASE_TAG_LIST:
+        case MYMPD_API_JUKEBOX_LIST:
+        case MYMPD_API_LAST_PLAYED_LIST:
+        case MYMPD_API_PARTITION_LIST:
+        case MYMPD_API_PLAYER_CURRENT_SONG:
+        case MYMPD_API_PLAYER_OUTPUT_LIST:
+        case MYMPD_API_PLAYER_STATE:
+        case MYMPD_API_PLAYER_VOLUME_GET:
+        case MYMPD_API_PLAYLIST_CONTENT_LIST:
+        case MYMPD_API_PLAYLIST_LIST:
+        case MYMPD_API_PLAY_STATS_DAYS_LIST:
+        case MYMPD_API_PLAY_STATS_TOP_LIST:
+        case MYMPD_API_QUEUE_LIST:
+        case MYMPD_API_QUEUE_SEARCH:
+        case MYMPD_API_WEBRADIO_FAVORITE_LIST:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Callback for list_free_user_data to free the requests of a batch request
+ * @param current list node
+ */
+static void list_free_cb_work_request(struct t_list_node *current) {
+    free_request((struct t_work_request *)current->user_data);
+}
+
+/**
+ * Defines read heavy methods that are handled by the mpd_worker pool
+ * with an auxiliary mpd connection.
+ * @param cmd_id myMPD API method
+ * @return true if method can be handled by the pool else false
+ */
+static bool method_is_pool(enum mympd_cmd_ids cmd_id) {
+    switch(cmd_id) {
+        case INTERNAL_API_ALBUMART:
+        case MYMPD_API_PLAYLIST_CONTENT_LIST:
+            return true;
+        default:
+            return false;
+    }
+}
@@ -21,11 +21,14 @@
     X(GENERAL_API_UNKNOWN) \
     X(INTERNAL_API_ALBUMART) \
     X(INTERNAL_API_ALBUMCACHE_CREATED) \
+    X(INTERNAL_API_BATCH) \
     X(INTERNAL_API_CACHES_CREATE) \
     X(INTERNAL_API_SCRIPT_INIT) \
     X(INTERNAL_API_SCRIPT_POST_EXECUTE) \
     X(INTERNAL_API_STATE_SAVE) \
     X(INTERNAL_API_STICKERCACHE_CREATED) \
+    X(INTERNAL_API_STREAM_ABORT) \
+    X(INTERNAL_API_STREAM_CHUNK) \
     X(INTERNAL_API_TIMER_STARTPLAY) \
     X(INTERNAL_API_WEBSERVER_NOTIFY) \
     X(INTERNAL_API_WEBSERVER_SETTINGS) \
@@ -40,6 +43,7 @@
     X(MYMPD_API_CONNECTION_SAVE) \
     X(MYMPD_API_COVERCACHE_CLEAR) \
     X(MYMPD_API_COVERCACHE_CROP) \
+    X(MYMPD_API_COVERCACHE_PREWARM) \
     X(MYMPD_API_DATABASE_ALBUMS_GET) \
     X(MYMPD_API_DATABASE_FILESYSTEM_LIST) \
     X(MYMPD_API_DATABASE_RESCAN) \
@@ -106,6 +110,8 @@
     X(MYMPD_API_PLAYLIST_RENAME) \
     X(MYMPD_API_PLAYLIST_RM) \
     X(MYMPD_API_PLAYLIST_RM_ALL) \
+    X(MYMPD_API_PLAY_STATS_DAYS_LIST) \
+    X(MYMPD_API_PLAY_STATS_TOP_LIST) \
     X(MYMPD_API_QUEUE_ADD_RANDOM) \
     X(MYMPD_API_QUEUE_APPEND_PLAYLIST) \
     X(MYMPD_API_QUEUE_APPEND_SEARCH) \
@@ -176,6 +182,19 @@ enum mympd_cmd_ids {
     MYMPD_CMDS(GEN_ENUM)
 };
 
+/**
+ * Flags of the api methods
+ */
+enum mympd_api_flags {
+    API_FLAG_PUBLIC = 1 << 0,      //!< method can be called by clients
+    API_FLAG_PROTECTED = 1 << 1,   //!< method needs authentication if a pin is set
+    API_FLAG_MYMPD_ONLY = 1 << 2,  //!< method works without mpd connection
+    API_FLAG_WEBSERVER = 1 << 3,   //!< method is handled by the webserver thread
+    API_FLAG_BATCH = 1 << 4,       //!< method can be used in batch requests
+    API_FLAG_COALESCABLE = 1 << 5, //!< identical queued requests are executed only once
+    API_FLAG_POOL = 1 << 6         //!< method can be handled by the mpd_worker pool
+};
+
 /**
  * Jsonrpc request ids
  */
@@ -194,6 +213,7 @@ struct t_work_request {
     enum mympd_cmd_ids cmd_id; //!< the jsonrpc method as enum
     sds data;                  //!< full jsonrpc request
     void *extra;               //!< extra data for the request
+    bool stream;               //!< true if the response can be sent in chunks
 };
 
 /**
@@ -227,12 +247,19 @@ struct set_mg_user_data_request {
  */
 enum mympd_cmd_ids get_cmd_id(const char *cmd);
 const char *get_cmd_id_method_name(enum mympd_cmd_ids cmd_id);
+unsigned get_api_method_flags(enum mympd_cmd_ids cmd_id);
 bool is_protected_api_method(enum mympd_cmd_ids cmd_id);
 bool is_public_api_method(enum mympd_cmd_ids cmd_id);
 bool is_mympd_only_api_method(enum mympd_cmd_ids cmd_id);
+bool is_webserver_api_method(enum mympd_cmd_ids cmd_id);
+bool is_batch_api_method(enum mympd_cmd_ids cmd_id);
+bool is_coalescable_api_method(enum mympd_cmd_ids cmd_id);
+bool is_pool_api_method(enum mympd_cmd_ids cmd_id);
+enum mympd_queue_priorities get_api_method_priority(enum mympd_cmd_ids cmd_id);
 void ws_notify(sds message);
 struct t_work_response *create_response(struct t_work_request *request);
 struct t_work_response *create_response_new(long long conn_id, long request_id, enum mympd_cmd_ids cmd_id);
+struct t_work_response *copy_response(struct t_work_response *response, struct t_work_request *request);
 struct t_work_request *create_request(long long conn_id, long request_id, enum mympd_cmd_ids cmd_id, const char *data);
 void free_request(struct t_work_request *request);
 void free_response(struct t_work_response *response);
@@ -0,0 +1,241 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "compress.h"
+
+#include "jsonrpc.h"
+#include "log.h"
+#include "mem.h"
+
+#include <time.h>
+
+/**
+ * Privat definitions
+ */
+
+#ifdef ENABLE_ZLIB
+static unsigned long long get_thread_cpu_usec(void);
+#endif
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes the compression context, the deflate stream is allocated once
+ * @param compress pointer to t_compress struct
+ * @param level zlib compression level
+ */
+void compress_init(struct t_compress *compress, int level) {
+    compress->count = 0;
+    compress->bytes_in = 0;
+    compress->bytes_out = 0;
+    compress->cpu_usec = 0;
+    #ifdef ENABLE_ZLIB
+        compress->stream.zalloc = Z_NULL;
+        compress->stream.zfree = Z_NULL;
+        compress->stream.opaque = Z_NULL;
+        //windowBits + 16 writes a gzip header
+        compress->initialized = deflateInit2(&compress->stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK
+            ? true
+            : false;
+        if (compress->initialized == false) {
+            MYMPD_LOG_ERROR("Can not initialize zlib deflate stream");
+        }
+    #else
+        (void) level;
+    #endif
+}
+
+/**
+ * Frees the compression context
+ * @param compress pointer to t_compress struct
+ */
+void compress_free(struct t_compress *compress) {
+    #ifdef ENABLE_ZLIB
+        if (compress->initialized == true) {
+            deflateEnd(&compress->stream);
+            compress->initialized = false;
+        }
+    #else
+        (void) compress;
+    #endif
+}
+
+/**
+ * Compresses data with gzip
+ * @param compress pointer to t_compress struct
+ * @param data data to compress
+ * @param len length of data
+ * @param out pointer to an already allocated sds string for the compressed data
+ * @return true on success, false if compression is not available or the result is not smaller
+ */
+bool compress_gzip(struct t_compress *compress, const char *data, size_t len, sds *out) {
+    #ifdef ENABLE_ZLIB
+        if (compress->initialized == false) {
+            return false;
+        }
+        unsigned long long start = get_thread_cpu_usec();
+        sdsclear(*out);
+        //the compressed data must be smaller than the original
+        *out = sdsMakeRoomFor(*out, len);
+        compress->stream.next_in = (Bytef *)data;
+        compress->stream.avail_in = (uInt)len;
+        compress->stream.next_out = (Bytef *)*out;
+        compress->stream.avail_out = (uInt)len;
+        int rc = deflate(&compress->stream, Z_FINISH);
+        size_t out_len = len - compress->stream.avail_out;
+        deflateReset(&compress->stream);
+        if (rc != Z_STREAM_END) {
+            //not compressible
+            sdsclear(*out);
+            return false;
+        }
+        sdsIncrLen(*out, (ssize_t)out_len);
+        compress->count++;
+        compress->bytes_in += len;
+        compress->bytes_out += out_len;
+        compress->cpu_usec += get_thread_cpu_usec() - start;
+        return true;
+    #else
+        (void) compress;
+        (void) data;
+        (void) len;
+        (void) out;
+        return false;
+    #endif
+}
+
+/**
+ * Prints the compression statistics as json object
+ * @param buffer already allocated sds string to append the statistics
+ * @param compress pointer to t_compress struct
+ * @return pointer to buffer
+ */
+sds compress_stats(sds buffer, struct t_compress *compress) {
+    buffer = sdscatlen(buffer, "{", 1);
+    buffer = tojson_ulong(buffer, "count", compress->count, true);
+    buffer = tojson_ullong(buffer, "bytesIn", compress->bytes_in, true);
+    buffer = tojson_ullong(buffer, "bytesOut", compress->bytes_out, true);
+    buffer = tojson_ullong(buffer, "cpuUsec", compress->cpu_usec, false);
+    buffer = sdscatlen(buffer, "}", 1);
+    return buffer;
+}
+
+/**
+ * Creates a deflate stream for a chunked response
+ * @param level zlib compression level
+ * @return the deflate stream or NULL if compression is not available
+ */
+struct t_compress_stream *compress_stream_new(int level) {
+    #ifdef ENABLE_ZLIB
+        struct t_compress_stream *stream = malloc_assert(sizeof(struct t_compress_stream));
+        stream->stream.zalloc = Z_NULL;
+        stream->stream.zfree = Z_NULL;
+        stream->stream.opaque = Z_NULL;
+        stream->bytes_in = 0;
+        //windowBits + 16 writes a gzip header
+        if (deflateInit2(&stream->stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            MYMPD_LOG_ERROR("Can not initialize zlib deflate stream");
+            FREE_PTR(stream);
+            return NULL;
+        }
+        return stream;
+    #else
+        (void) level;
+        return NULL;
+    #endif
+}
+
+/**
+ * Compresses a chunk of a chunked response.
+ * The output is flushed, the client can decompress all chunks received so far.
+ * @param compress pointer to t_compress struct for the statistics
+ * @param stream the deflate stream
+ * @param data data to compress
+ * @param len length of data
+ * @param finish true for the last chunk
+ * @param out pointer to an already allocated sds string for the compressed data
+ * @return true on success, else false
+ */
+bool compress_stream_chunk(struct t_compress *compress, struct t_compress_stream *stream,
+        const char *data, size_t len, bool finish, sds *out)
+{
+    #ifdef ENABLE_ZLIB
+        unsigned long long start = get_thread_cpu_usec();
+        sdsclear(*out);
+        stream->stream.next_in = (Bytef *)data;
+        stream->stream.avail_in = (uInt)len;
+        int flush = finish == true
+            ? Z_FINISH
+            : Z_SYNC_FLUSH;
+        size_t room = deflateBound(&stream->stream, (uLong)len);
+        int rc;
+        do {
+            *out = sdsMakeRoomFor(*out, room);
+            size_t avail = sdsavail(*out);
+            stream->stream.next_out = (Bytef *)(*out + sdslen(*out));
+            stream->stream.avail_out = (uInt)avail;
+            rc = deflate(&stream->stream, flush);
+            if (rc == Z_STREAM_ERROR) {
+                MYMPD_LOG_ERROR("Error compressing chunk");
+                sdsclear(*out);
+                return false;
+            }
+            sdsIncrLen(*out, (ssize_t)(avail - stream->stream.avail_out));
+        } while (stream->stream.avail_out == 0 ||
+            (finish == true && rc != Z_STREAM_END));
+        stream->bytes_in += len;
+        compress->bytes_in += len;
+        compress->bytes_out += sdslen(*out);
+        compress->cpu_usec += get_thread_cpu_usec() - start;
+        if (finish == true) {
+            compress->count++;
+        }
+        return true;
+    #else
+        (void) compress;
+        (void) stream;
+        (void) data;
+        (void) len;
+        (void) finish;
+        (void) out;
+        return false;
+    #endif
+}
+
+/**
+ * Frees the deflate stream of a chunked response
+ * @param stream the deflate stream, can be NULL
+ */
+void compress_stream_free(struct t_compress_stream *stream) {
+    if (stream == NULL) {
+        return;
+    }
+    #ifdef ENABLE_ZLIB
+        deflateEnd(&stream->stream);
+    #endif
+    FREE_PTR(stream);
+}
+
+/**
+ * Private functions
+ */
+
+#ifdef ENABLE_ZLIB
+/**
+ * Gets the cpu time of the calling thread
+ * @return cpu time in microseconds
+ */
+static unsigned long long get_thread_cpu_usec(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return (unsigned long long)ts.tv_sec * 1000000 + (unsigned long long)ts.tv_nsec / 1000;
+}
+#endif
@@ -0,0 +1,51 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_COMPRESS_H
+#define MYMPD_COMPRESS_H
+
+#include "compile_time.h"
+#include "../../dist/sds/sds.h"
+
+#include <stdbool.h>
+
+#ifdef ENABLE_ZLIB
+    #include <zlib.h>
+#endif
+
+/**
+ * Reusable gzip compression context
+ */
+struct t_compress {
+    #ifdef ENABLE_ZLIB
+    z_stream stream;                //!< zlib deflate stream, reset for each response
+    bool initialized;               //!< true if the deflate stream is initialized
+    #endif
+    unsigned long count;            //!< number of compressed responses
+    unsigned long long bytes_in;    //!< uncompressed bytes
+    unsigned long long bytes_out;   //!< compressed bytes
+    unsigned long long cpu_usec;    //!< cpu time used for compression in microseconds
+};
+
+/**
+ * Deflate stream for a chunked response
+ */
+struct t_compress_stream {
+    #ifdef ENABLE_ZLIB
+    z_stream stream;                //!< zlib deflate stream
+    #endif
+    unsigned long long bytes_in;    //!< uncompressed bytes of the response
+};
+
+void compress_init(struct t_compress *compress, int level);
+void compress_free(struct t_compress *compress);
+bool compress_gzip(struct t_compress *compress, const char *data, size_t len, sds *out);
+sds compress_stats(sds buffer, struct t_compress *compress);
+struct t_compress_stream *compress_stream_new(int level);
+bool compress_stream_chunk(struct t_compress *compress, struct t_compress_stream *stream,
+        const char *data, size_t len, bool finish, sds *out);
+void compress_stream_free(struct t_compress_stream *stream);
+#endif
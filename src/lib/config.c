@@ -87,6 +87,12 @@ void mympd_config_defaults_initial(struct t_config *config) {
     #endif
     config->pin_hash = NULL;
     config->covercache_keep_days = CFG_COVERCACHE_KEEP_DAYS;
+    config->covercache_size = CFG_COVERCACHE_SIZE;
+    config->albumart_cache_size = CFG_ALBUMART_CACHE_SIZE;
+    config->thumbnail_size = CFG_THUMBNAIL_SIZE;
+    config->thumbnail_quality = CFG_THUMBNAIL_QUALITY;
+    config->covercache_prewarm = CFG_COVERCACHE_PREWARM;
+    config->covercache_prewarm_threads = CFG_COVERCACHE_PREWARM_THREADS;
 }
 
 /**
@@ -128,6 +134,12 @@ void mympd_config_defaults(struct t_config *config) {
     config->loglevel = CFG_MYMPD_LOGLEVEL;
     config->pin_hash = sdsnew(CFG_MYMPD_PIN_HASH);
     config->covercache_keep_days = mympd_getenv_int("MYMPD_COVERCACHE_KEEP_DAYS", CFG_COVERCACHE_KEEP_DAYS, COVERCACHE_AGE_MIN, COVERCACHE_AGE_MAX, config->first_startup);
+    config->covercache_size = mympd_getenv_int("MYMPD_COVERCACHE_SIZE", CFG_COVERCACHE_SIZE, COVERCACHE_SIZE_MIN, COVERCACHE_SIZE_MAX, config->first_startup);
+    config->albumart_cache_size = mympd_getenv_int("MYMPD_ALBUMART_CACHE_SIZE", CFG_ALBUMART_CACHE_SIZE, ALBUMART_CACHE_SIZE_MIN, ALBUMART_CACHE_SIZE_MAX, config->first_startup);
+    config->thumbnail_size = mympd_getenv_int("MYMPD_THUMBNAIL_SIZE", CFG_THUMBNAIL_SIZE, THUMBNAIL_SIZE_MIN, THUMBNAIL_SIZE_MAX, config->first_startup);
+    config->thumbnail_quality = mympd_getenv_int("MYMPD_THUMBNAIL_QUALITY", CFG_THUMBNAIL_QUALITY, THUMBNAIL_QUALITY_MIN, THUMBNAIL_QUALITY_MAX, config->first_startup);
+    config->covercache_prewarm = mympd_getenv_bool("MYMPD_COVERCACHE_PREWARM", CFG_COVERCACHE_PREWARM, config->first_startup);
+    config->covercache_prewarm_threads = mympd_getenv_int("MYMPD_COVERCACHE_PREWARM_THREADS", CFG_COVERCACHE_PREWARM_THREADS, COVERCACHE_PREWARM_THREADS_MIN, COVERCACHE_PREWARM_THREADS_MAX, config->first_startup);
 }
 
 /**
@@ -168,6 +180,12 @@ bool mympd_read_config(struct t_config *config) {
         config->lualibs = state_file_rw_string_sds(config->workdir, "config", "lualibs", config->lualibs, vcb_isname, false);
     #endif
     config->covercache_keep_days = state_file_rw_int(config->workdir, "config", "covercache_keep_days", config->covercache_keep_days, COVERCACHE_AGE_MIN, COVERCACHE_AGE_MAX, false);
+    config->covercache_size = state_file_rw_int(config->workdir, "config", "covercache_size", config->covercache_size, COVERCACHE_SIZE_MIN, COVERCACHE_SIZE_MAX, false);
+    config->albumart_cache_size = state_file_rw_int(config->workdir, "config", "albumart_cache_size", config->albumart_cache_size, ALBUMART_CACHE_SIZE_MIN, ALBUMART_CACHE_SIZE_MAX, false);
+    config->thumbnail_size = state_file_rw_int(config->workdir, "config", "thumbnail_size", config->thumbnail_size, THUMBNAIL_SIZE_MIN, THUMBNAIL_SIZE_MAX, false);
+    config->thumbnail_quality = state_file_rw_int(config->workdir, "config", "thumbnail_quality", config->thumbnail_quality, THUMBNAIL_QUALITY_MIN, THUMBNAIL_QUALITY_MAX, false);
+    config->covercache_prewarm = state_file_rw_bool(config->workdir, "config", "covercache_prewarm", config->covercache_prewarm, false);
+    config->covercache_prewarm_threads = state_file_rw_int(config->workdir, "config", "covercache_prewarm_threads", config->covercache_prewarm_threads, COVERCACHE_PREWARM_THREADS_MIN, COVERCACHE_PREWARM_THREADS_MAX, false);
     config->loglevel = state_file_rw_int(config->workdir, "config", "loglevel", config->loglevel, LOGLEVEL_MIN, LOGLEVEL_MAX, false);
     //overwrite configured loglevel
     config->loglevel = mympd_getenv_int("MYMPD_LOGLEVEL", config->loglevel, LOGLEVEL_MIN, LOGLEVEL_MAX, true);
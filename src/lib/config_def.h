@@ -42,6 +42,12 @@ struct t_config {
     bool bootstrap;           //!< true if bootstrap command line option is set
     sds pin_hash;             //!< hash of the pin
     int covercache_keep_days; //!< expiration time for covercache files
+    int covercache_size;      //!< maximum size of the covercache in MB, 0 = unlimited
+    int albumart_cache_size;  //!< size of the in-memory albumart cache in MB
+    int thumbnail_size;       //!< max width and height of generated thumbnails, 0 = disabled
+    int thumbnail_quality;    //!< jpeg quality of generated thumbnails
+    bool covercache_prewarm;  //!< pre-warm the covercache after the caches are created
+    int covercache_prewarm_threads; //!< number of threads for covercache pre-warming
 };
 
 #endif
@@ -7,19 +7,259 @@
 #include "compile_time.h"
 #include "covercache.h"
 
+#include "../../dist/rax/rax.h"
 #include "filehandler.h"
+#include "jsonrpc.h"
 #include "log.h"
+#include "mem.h"
 #include "mimetype.h"
 #include "sds_extras.h"
+#include "utility.h"
 
 #include <dirent.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
+/**
+ * Privat definitions
+ */
+
+/**
+ * Entry of the covercache index
+ */
+struct t_covercache_entry {
+    sds name;                           //!< filename in the shard directory
+    size_t size;                        //!< file size in bytes
+    time_t atime;                       //!< last access time
+    struct t_covercache_entry *prev;    //!< more recently used entry
+    struct t_covercache_entry *next;    //!< less recently used entry
+};
+
+/**
+ * The covercache index, entries are ordered by last access
+ */
+struct t_covercache_index {
+    sds cachedir;                       //!< myMPD cache directory
+    rax *entries;                       //!< entries by filename
+    struct t_covercache_entry *head;    //!< most recently used entry
+    struct t_covercache_entry *tail;    //!< least recently used entry
+    size_t size;                        //!< size of all files in bytes
+    size_t size_max;                    //!< maximum size in bytes, 0 = unlimited
+    unsigned long evictions;            //!< number of evicted files
+    FILE *journal;                      //!< journal of the index changes since the last save
+    unsigned journal_lines;             //!< number of lines in the journal
+};
+
+static bool covercache_write(sds cachedir, const char *uri, sds name, sds binary);
+static sds covercache_get_filepath(sds filepath, sds cachedir, const char *name);
+static sds covercache_thumbnail_name(sds name, sds hash, int offset, int thumbnail_size, bool skipped);
+static bool covercache_index_load(void);
+static bool covercache_index_save(void);
+static void covercache_index_compact(void);
+static void covercache_journal_replay(void);
+static void covercache_journal_add(struct t_covercache_entry *entry);
+static void covercache_journal_remove(struct t_covercache_entry *entry);
+static void covercache_journal_check(void);
+static bool is_dirent_type(sds dirpath, struct dirent *next_file, unsigned char type);
+static void covercache_index_rebuild(void);
+static long covercache_index_scan_dir(sds dirpath, const char *shard, struct t_covercache_entry ***list, long *len);
+static struct t_covercache_entry *covercache_index_touch(const char *name);
+static void covercache_index_add(const char *name, size_t size, time_t atime, bool most_recent);
+static void covercache_index_remove(struct t_covercache_entry *entry, bool remove_file);
+static void covercache_index_evict(void);
+static void entry_link_head(struct t_covercache_entry *entry);
+static void entry_link_tail(struct t_covercache_entry *entry);
+static void entry_unlink(struct t_covercache_entry *entry);
+static int entry_cmp_atime(const void *a, const void *b);
+
+/**
+ * The index is shared between the threads that read and write the covercache
+ */
+static struct t_covercache_index *covercache_index = NULL;
+static pthread_mutex_t covercache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes the covercache index. The index file is read and the journal
+ * of the changes since the last save is replayed. If no index file is found,
+ * the index is rebuild by scanning the covercache directory and files from
+ * the flat directory layout are moved to the shard directories.
+ * @param cachedir myMPD cache directory
+ * @param size_max maximum size of the covercache in bytes, 0 = unlimited
+ * @return true on success, else false
+ */
+bool covercache_init(sds cachedir, size_t size_max) {
+    pthread_mutex_lock(&covercache_mutex);
+    if (covercache_index != NULL) {
+        pthread_mutex_unlock(&covercache_mutex);
+        return false;
+    }
+    covercache_index = malloc_assert(sizeof(struct t_covercache_index));
+    covercache_index->cachedir = sdsdup(cachedir);
+    covercache_index->entries = raxNew();
+    covercache_index->head = NULL;
+    covercache_index->tail = NULL;
+    covercache_index->size = 0;
+    covercache_index->size_max = size_max;
+    covercache_index->evictions = 0;
+    covercache_index->journal = NULL;
+    covercache_index->journal_lines = 0;
+    if (covercache_index_load() == true) {
+        covercache_journal_replay();
+    }
+    else {
+        covercache_index_rebuild();
+    }
+    covercache_index_evict();
+    //save the index and start a new journal
+    covercache_index_compact();
+    MYMPD_LOG_NOTICE("Covercache contains %llu files with %llu bytes",
+        (unsigned long long)covercache_index->entries->numele, (unsigned long long)covercache_index->size);
+    pthread_mutex_unlock(&covercache_mutex);
+    return true;
+}
+
+/**
+ * Saves and frees the covercache index
+ */
+void covercache_free(void) {
+    pthread_mutex_lock(&covercache_mutex);
+    if (covercache_index == NULL) {
+        pthread_mutex_unlock(&covercache_mutex);
+        return;
+    }
+    covercache_index_save();
+    if (covercache_index->journal != NULL) {
+        (void) fclose(covercache_index->journal);
+        sds journal_file = sdscatfmt(sdsempty(), "%S/covercache/index.journal", covercache_index->cachedir);
+        try_rm_file(journal_file);
+        FREE_SDS(journal_file);
+    }
+    struct t_covercache_entry *current = covercache_index->head;
+    while (current != NULL) {
+        struct t_covercache_entry *next = current->next;
+        FREE_SDS(current->name);
+        FREE_PTR(current);
+        current = next;
+    }
+    raxFree(covercache_index->entries);
+    FREE_SDS(covercache_index->cachedir);
+    FREE_PTR(covercache_index);
+    pthread_mutex_unlock(&covercache_mutex);
+}
+
+/**
+ * Prints the covercache statistics as json object
+ * @param buffer already allocated sds string to append the statistics
+ * @return pointer to buffer
+ */
+sds covercache_stats(sds buffer) {
+    pthread_mutex_lock(&covercache_mutex);
+    buffer = sdscatlen(buffer, "{", 1);
+    if (covercache_index != NULL) {
+        buffer = tojson_ullong(buffer, "entries", covercache_index->entries->numele, true);
+        buffer = tojson_ullong(buffer, "size", (unsigned long long)covercache_index->size, true);
+        buffer = tojson_ullong(buffer, "sizeMax", (unsigned long long)covercache_index->size_max, true);
+        buffer = tojson_ulong(buffer, "evictions", covercache_index->evictions, false);
+    }
+    buffer = sdscatlen(buffer, "}", 1);
+    pthread_mutex_unlock(&covercache_mutex);
+    return buffer;
+}
+
+/**
+ * Looks up a coverimage in the covercache and marks it as recently used
+ * @param cachedir myMPD cache directory
+ * @param uri uri of the song for the cover
+ * @param offset number of the coverimage
+ * @param thumbnail_size size of the thumbnail to lookup, 0 = lookup the original image
+ * @param filepath already allocated sds string to populate with the full path
+ * @return pointer to filepath, empty if the image is not cached
+ */
+sds covercache_get_file(sds cachedir, const char *uri, int offset, int thumbnail_size, sds filepath) {
+    sdsclear(filepath);
+    sds hash = sds_hash(uri);
+    sds name = sdsempty();
+    pthread_mutex_lock(&covercache_mutex);
+    if (covercache_index == NULL) {
+        pthread_mutex_unlock(&covercache_mutex);
+        //no index, check the filesystem
+        if (thumbnail_size > 0) {
+            name = covercache_thumbnail_name(name, hash, offset, thumbnail_size, false);
+            filepath = covercache_get_filepath(filepath, cachedir, name);
+            if (access(filepath, F_OK) != 0) { /* Flawfinder: ignore */
+                sdsclear(filepath);
+            }
+        }
+        else {
+            name = sdscatfmt(name, "%S-%i", hash, offset);
+            filepath = covercache_get_filepath(filepath, cachedir, name);
+            filepath = find_image_file(filepath);
+        }
+        FREE_SDS(name);
+        FREE_SDS(hash);
+        return filepath;
+    }
+    if (thumbnail_size > 0) {
+        name = covercache_thumbnail_name(name, hash, offset, thumbnail_size, false);
+        if (covercache_index_touch(name) != NULL) {
+            filepath = covercache_get_filepath(filepath, cachedir, name);
+        }
+    }
+    else {
+        for (const char **p = image_file_extensions; *p != NULL; p++) {
+            sdsclear(name);
+            name = sdscatfmt(name, "%S-%i.%s", hash, offset, *p);
+            if (covercache_index_touch(name) != NULL) {
+                filepath = covercache_get_filepath(filepath, cachedir, name);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&covercache_mutex);
+    FREE_SDS(name);
+    FREE_SDS(hash);
+    return filepath;
+}
+
+/**
+ * Checks if the thumbnail creation for a coverimage was already skipped,
+ * because the image could not be decoded or the thumbnail was not smaller
+ * @param cachedir myMPD cache directory
+ * @param uri uri of the song for the cover
+ * @param offset number of the coverimage
+ * @param thumbnail_size size of the thumbnail
+ * @return true if a marker exists, else false
+ */
+bool covercache_thumbnail_skipped(sds cachedir, const char *uri, int offset, int thumbnail_size) {
+    sds hash = sds_hash(uri);
+    sds name = covercache_thumbnail_name(sdsempty(), hash, offset, thumbnail_size, true);
+    bool rc = false;
+    pthread_mutex_lock(&covercache_mutex);
+    if (covercache_index == NULL) {
+        pthread_mutex_unlock(&covercache_mutex);
+        sds filepath = covercache_get_filepath(sdsempty(), cachedir, name);
+        rc = access(filepath, F_OK) == 0 ? true : false; /* Flawfinder: ignore */
+        FREE_SDS(filepath);
+    }
+    else {
+        rc = covercache_index_touch(name) != NULL ? true : false;
+        pthread_mutex_unlock(&covercache_mutex);
+    }
+    FREE_SDS(name);
+    FREE_SDS(hash);
+    return rc;
+}
+
 /**
  * Writes the coverimage (as binary buffer) to the covercache,
  * filename is the hash of the full path
@@ -40,61 +280,653 @@ bool covercache_write_file(sds cachedir, const char *uri, const char *mime_type,
         MYMPD_LOG_WARN("Covercache file for \"%s\" not written, could not determine file extension", uri);
         return false;
     }
-    sds filename = sds_hash(uri);
-    sds filepath = sdscatfmt(sdsempty(), "%S/covercache/%S-%i.%s", cachedir, filename, offset, ext);
-    bool rc = write_data_to_file(filepath, binary, sdslen(binary));
-    FREE_SDS(filename);
-    FREE_SDS(filepath);
+    sds hash = sds_hash(uri);
+    sds name = sdscatfmt(sdsempty(), "%S-%i.%s", hash, offset, ext);
+    bool rc = covercache_write(cachedir, uri, name, binary);
+    FREE_SDS(hash);
+    FREE_SDS(name);
     return rc;
 }
 
 /**
- * Crops the covercache
+ * Writes a thumbnail (jpeg) of the coverimage to the covercache,
+ * it is saved next to the original image with the suffix -thumb<size>.
+ * An empty binary writes a marker to skip further thumbnail creation.
  * @param cachedir covercache directory
- * @param keepdays delete files older than days
+ * @param uri uri of the song for the cover
+ * @param binary the thumbnail or an empty string
+ * @param offset number of the coverimage
+ * @param thumbnail_size size of the thumbnail
+ * @return true on success else false
+ */
+bool covercache_write_thumbnail(sds cachedir, const char *uri, sds binary, int offset, int thumbnail_size) {
+    sds hash = sds_hash(uri);
+    sds name = covercache_thumbnail_name(sdsempty(), hash, offset, thumbnail_size, sdslen(binary) == 0);
+    bool rc = covercache_write(cachedir, uri, name, binary);
+    FREE_SDS(hash);
+    FREE_SDS(name);
+    return rc;
+}
+
+/**
+ * Crops the covercache, the files are found through the index
+ * @param keepdays delete files not accessed since days, 0 = delete all files
  * @return deleted filecount on success else -1
  */
-int covercache_clear(sds cachedir, int keepdays) {
+int covercache_clear(int keepdays) {
+    pthread_mutex_lock(&covercache_mutex);
+    if (covercache_index == NULL) {
+        pthread_mutex_unlock(&covercache_mutex);
+        MYMPD_LOG_WARN("Covercache is disabled");
+        return -1;
+    }
+    time_t expire_time = time(NULL) - (time_t)(keepdays * 24 * 60 * 60);
+    MYMPD_LOG_NOTICE("Cleaning covercache");
+    MYMPD_LOG_DEBUG("Remove files not accessed since %lld", (long long)expire_time);
     int num_deleted = 0;
+    //least recently used entries are at the tail
+    while (covercache_index->tail != NULL &&
+        (keepdays == 0 || covercache_index->tail->atime < expire_time))
+    {
+        covercache_index_remove(covercache_index->tail, true);
+        num_deleted++;
+    }
+    covercache_journal_check();
+    pthread_mutex_unlock(&covercache_mutex);
+    MYMPD_LOG_NOTICE("Deleted %d files from covercache", num_deleted);
+    return num_deleted;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Writes a file to the covercache and adds it to the index
+ * @param cachedir covercache directory
+ * @param uri uri of the song for the cover
+ * @param name filename in the shard directory
+ * @param binary data to write
+ * @return true on success, else false
+ */
+static bool covercache_write(sds cachedir, const char *uri, sds name, sds binary) {
+    sds filepath = covercache_get_filepath(sdsempty(), cachedir, name);
+    //create the shard directory
+    sds shard = sdsnewlen(filepath, sdslen(filepath) - sdslen(name) - 1);
+    errno = 0;
+    if (mkdir(shard, 0770) != 0 &&
+        errno != EEXIST)
+    {
+        MYMPD_LOG_ERROR("Creating covercache directory \"%s\" failed", shard);
+        MYMPD_LOG_ERRNO(errno);
+    }
+    FREE_SDS(shard);
+    bool rc = write_data_to_file(filepath, binary, sdslen(binary));
+    FREE_SDS(filepath);
+    if (rc == false) {
+        MYMPD_LOG_ERROR("Writing covercache file for \"%s\" failed", uri);
+        return false;
+    }
+    pthread_mutex_lock(&covercache_mutex);
+    if (covercache_index != NULL) {
+        covercache_index_add(name, sdslen(binary), time(NULL), true);
+        covercache_journal_add(covercache_index->head);
+        covercache_index_evict();
+        covercache_journal_check();
+    }
+    pthread_mutex_unlock(&covercache_mutex);
+    return true;
+}
+
+/**
+ * Builds the full path of a covercache file,
+ * the first two characters of the hash are used as shard directory
+ * @param filepath already allocated sds string to append the path
+ * @param cachedir covercache directory
+ * @param name filename
+ * @return pointer to filepath
+ */
+static sds covercache_get_filepath(sds filepath, sds cachedir, const char *name) {
+    return sdscatprintf(filepath, "%s/covercache/%.2s/%s", cachedir, name, name);
+}
+
+/**
+ * Builds the filename of a thumbnail or of the skipped thumbnail marker
+ * @param name already allocated sds string to append the name
+ * @param hash hash of the song uri
+ * @param offset number of the coverimage
+ * @param thumbnail_size size of the thumbnail
+ * @param skipped true = name of the marker
+ * @return pointer to name
+ */
+static sds covercache_thumbnail_name(sds name, sds hash, int offset, int thumbnail_size, bool skipped) {
+    return sdscatfmt(name, "%S-%i-thumb%i.%s", hash, offset, thumbnail_size, (skipped == true ? "none" : "jpg"));
+}
+
+/**
+ * Reads the index file, lines are ordered from the most to the least recently used entry:
+ * <name> <size> <atime>
+ * @return true on success, else false
+ */
+static bool covercache_index_load(void) {
+    sds index_file = sdscatfmt(sdsempty(), "%S/covercache/index", covercache_index->cachedir);
+    errno = 0;
+    FILE *fp = fopen(index_file, OPEN_FLAGS_READ);
+    if (fp == NULL) {
+        MYMPD_LOG_INFO("Can not open \"%s\"", index_file);
+        if (errno != ENOENT) {
+            MYMPD_LOG_ERRNO(errno);
+        }
+        FREE_SDS(index_file);
+        return false;
+    }
+    sds line = sdsempty();
     bool rc = true;
-    time_t expire_time = time(NULL) - (time_t)(keepdays * 24 * 60 * 60);
+    while (sds_getline(&line, fp, FILEPATH_LEN_MAX) == 0) {
+        int count = 0;
+        sds *tokens = sdssplitlen(line, (ssize_t)sdslen(line), " ", 1, &count);
+        if (count != 3 ||
+            sdslen(tokens[0]) < 3 ||
+            strchr(tokens[0], '/') != NULL)
+        {
+            MYMPD_LOG_ERROR("Invalid line in covercache index: \"%s\"", line);
+            sdsfreesplitres(tokens, count);
+            rc = false;
+            break;
+        }
+        size_t size = (size_t)strtoull(tokens[1], NULL, 10);
+        time_t atime = (time_t)strtoll(tokens[2], NULL, 10);
+        //the index file is in lru order
+        covercache_index_add(tokens[0], size, atime, false);
+        sdsfreesplitres(tokens, count);
+    }
+    (void) fclose(fp);
+    FREE_SDS(line);
+    FREE_SDS(index_file);
+    if (rc == false) {
+        //discard the partial index
+        while (covercache_index->head != NULL) {
+            covercache_index_remove(covercache_index->head, false);
+        }
+    }
+    return rc;
+}
+
+/**
+ * Saves the index file
+ * @return true on success, else false
+ */
+static bool covercache_index_save(void) {
+    sds index_file = sdscatfmt(sdsempty(), "%S/covercache/index", covercache_index->cachedir);
+    MYMPD_LOG_INFO("Saving covercache index to \"%s\"", index_file);
+    sds tmp_file = sdscatfmt(sdsempty(), "%S.XXXXXX", index_file);
+    FILE *fp = open_tmp_file(tmp_file);
+    if (fp == NULL) {
+        FREE_SDS(tmp_file);
+        FREE_SDS(index_file);
+        return false;
+    }
+    bool write_rc = true;
+    struct t_covercache_entry *current = covercache_index->head;
+    while (current != NULL) {
+        if (fprintf(fp, "%s %llu %lld\n", current->name, (unsigned long long)current->size, (long long)current->atime) < 0) {
+            MYMPD_LOG_ERROR("Could not write data to file");
+            write_rc = false;
+            break;
+        }
+        current = current->next;
+    }
+    bool rc = rename_tmp_file(fp, tmp_file, index_file, write_rc);
+    FREE_SDS(tmp_file);
+    FREE_SDS(index_file);
+    return rc;
+}
 
-    sds covercache = sdscatfmt(sdsempty(), "%S/covercache", cachedir);
-    MYMPD_LOG_NOTICE("Cleaning covercache \"%s\"", covercache);
-    MYMPD_LOG_DEBUG("Remove files older than %lld sec", (long long)expire_time);
+/**
+ * Saves the index file and truncates the journal
+ */
+static void covercache_index_compact(void) {
+    if (covercache_index->journal != NULL) {
+        (void) fclose(covercache_index->journal);
+        covercache_index->journal = NULL;
+    }
+    covercache_index->journal_lines = 0;
+    if (covercache_index_save() == false) {
+        //keep the journal, it is replayed on the next start
+        return;
+    }
+    sds journal_file = sdscatfmt(sdsempty(), "%S/covercache/index.journal", covercache_index->cachedir);
+    errno = 0;
+    covercache_index->journal = fopen(journal_file, OPEN_FLAGS_WRITE);
+    if (covercache_index->journal == NULL) {
+        MYMPD_LOG_ERROR("Can not open \"%s\"", journal_file);
+        MYMPD_LOG_ERRNO(errno);
+    }
+    FREE_SDS(journal_file);
+}
+
+/**
+ * Replays the journal of the index changes since the last save, lines are:
+ * + <name> <size> <atime>
+ * - <name>
+ * A partially written last line is ignored.
+ */
+static void covercache_journal_replay(void) {
+    sds journal_file = sdscatfmt(sdsempty(), "%S/covercache/index.journal", covercache_index->cachedir);
+    FILE *fp = fopen(journal_file, OPEN_FLAGS_READ);
+    FREE_SDS(journal_file);
+    if (fp == NULL) {
+        return;
+    }
+    sds line = sdsempty();
+    long replayed = 0;
+    while (sds_getline(&line, fp, FILEPATH_LEN_MAX) == 0) {
+        int count = 0;
+        sds *tokens = sdssplitlen(line, (ssize_t)sdslen(line), " ", 1, &count);
+        if (count == 4 &&
+            strcmp(tokens[0], "+") == 0 &&
+            sdslen(tokens[1]) >= 3 &&
+            strchr(tokens[1], '/') == NULL)
+        {
+            size_t size = (size_t)strtoull(tokens[2], NULL, 10);
+            time_t atime = (time_t)strtoll(tokens[3], NULL, 10);
+            covercache_index_add(tokens[1], size, atime, true);
+            replayed++;
+        }
+        else if (count == 2 &&
+            strcmp(tokens[0], "-") == 0)
+        {
+            void *data = raxFind(covercache_index->entries, (unsigned char *)tokens[1], sdslen(tokens[1]));
+            if (data != raxNotFound) {
+                covercache_index_remove((struct t_covercache_entry *)data, false);
+            }
+            replayed++;
+        }
+        else {
+            MYMPD_LOG_WARN("Invalid line in covercache journal: \"%s\"", line);
+            sdsfreesplitres(tokens, count);
+            break;
+        }
+        sdsfreesplitres(tokens, count);
+    }
+    (void) fclose(fp);
+    FREE_SDS(line);
+    if (replayed > 0) {
+        MYMPD_LOG_NOTICE("Replayed %ld changes from the covercache journal", replayed);
+    }
+}
+
+/**
+ * Appends an added file to the journal
+ * @param entry the added entry
+ */
+static void covercache_journal_add(struct t_covercache_entry *entry) {
+    if (covercache_index->journal == NULL) {
+        return;
+    }
+    if (fprintf(covercache_index->journal, "+ %s %llu %lld\n", entry->name,
+            (unsigned long long)entry->size, (long long)entry->atime) < 0 ||
+        fflush(covercache_index->journal) != 0)
+    {
+        MYMPD_LOG_ERROR("Could not write covercache journal");
+    }
+    covercache_index->journal_lines++;
+}
+
+/**
+ * Appends a removed file to the journal
+ * @param entry the removed entry
+ */
+static void covercache_journal_remove(struct t_covercache_entry *entry) {
+    if (covercache_index->journal == NULL) {
+        return;
+    }
+    if (fprintf(covercache_index->journal, "- %s\n", entry->name) < 0 ||
+        fflush(covercache_index->journal) != 0)
+    {
+        MYMPD_LOG_ERROR("Could not write covercache journal");
+    }
+    covercache_index->journal_lines++;
+}
+
+/**
+ * Saves the index if the journal has grown too large
+ */
+static void covercache_journal_check(void) {
+    if (covercache_index->journal_lines >= COVERCACHE_JOURNAL_LINES_MAX) {
+        covercache_index_compact();
+    }
+}
+
+/**
+ * Rebuilds the index by scanning the covercache directory,
+ * the modification time of the files is used as last access time
+ */
+static void covercache_index_rebuild(void) {
+    sds covercache = sdscatfmt(sdsempty(), "%S/covercache", covercache_index->cachedir);
+    MYMPD_LOG_NOTICE("Rebuilding covercache index for \"%s\"", covercache);
     errno = 0;
     DIR *covercache_dir = opendir(covercache);
     if (covercache_dir == NULL) {
         MYMPD_LOG_ERROR("Error opening directory \"%s\"", covercache);
         MYMPD_LOG_ERRNO(errno);
         FREE_SDS(covercache);
-        return -1;
+        return;
     }
-
+    struct t_covercache_entry **list = NULL;
+    long len = 0;
+    long migrated = 0;
     struct dirent *next_file;
     sds filepath = sdsempty();
     while ((next_file = readdir(covercache_dir)) != NULL ) {
-        if (next_file->d_type != DT_REG) {
+        if (next_file->d_name[0] == '.') {
             continue;
         }
         sdsclear(filepath);
         filepath = sdscatfmt(filepath, "%S/%s", covercache, next_file->d_name);
-        struct stat status;
-        if (stat(filepath, &status) != 0) {
+        if (is_dirent_type(covercache, next_file, DT_DIR) == true) {
+            if (strlen(next_file->d_name) == 2) {
+                covercache_index_scan_dir(filepath, next_file->d_name, &list, &len);
+            }
             continue;
         }
-        if (status.st_mtime < expire_time) {
-            MYMPD_LOG_DEBUG("Deleting \"%s\": %lld", filepath, (long long)status.st_mtime);
-            rc = rm_file(filepath);
-            if (rc == true) {
-                num_deleted++;
-            }
+        if (strlen(next_file->d_name) < 3 ||
+            strncmp(next_file->d_name, "index", 5) == 0 ||
+            is_dirent_type(covercache, next_file, DT_REG) == false)
+        {
+            continue;
+        }
+        //migrate file from the flat directory layout
+        sds new_filepath = covercache_get_filepath(sdsempty(), covercache_index->cachedir, next_file->d_name);
+        sds shard = sdsnewlen(new_filepath, sdslen(new_filepath) - strlen(next_file->d_name) - 1);
+        errno = 0;
+        if ((mkdir(shard, 0770) == 0 || errno == EEXIST) &&
+            rename(filepath, new_filepath) == 0)
+        {
+            migrated++;
         }
+        else {
+            MYMPD_LOG_ERROR("Error moving \"%s\" to \"%s\"", filepath, new_filepath);
+            MYMPD_LOG_ERRNO(errno);
+        }
+        FREE_SDS(shard);
+        FREE_SDS(new_filepath);
     }
     closedir(covercache_dir);
+    if (migrated > 0) {
+        //scan again to add the migrated files
+        MYMPD_LOG_NOTICE("Moved %ld files to the covercache shard directories", migrated);
+        for (long i = 0; i < len; i++) {
+            FREE_SDS(list[i]->name);
+            FREE_PTR(list[i]);
+        }
+        FREE_PTR(list);
+        len = 0;
+        covercache_dir = opendir(covercache);
+        if (covercache_dir != NULL) {
+            while ((next_file = readdir(covercache_dir)) != NULL ) {
+                if (next_file->d_name[0] != '.' &&
+                    strlen(next_file->d_name) == 2 &&
+                    is_dirent_type(covercache, next_file, DT_DIR) == true)
+                {
+                    sdsclear(filepath);
+                    filepath = sdscatfmt(filepath, "%S/%s", covercache, next_file->d_name);
+                    covercache_index_scan_dir(filepath, next_file->d_name, &list, &len);
+                }
+            }
+            closedir(covercache_dir);
+        }
+    }
     FREE_SDS(filepath);
-
-    MYMPD_LOG_NOTICE("Deleted %d files from covercache", num_deleted);
     FREE_SDS(covercache);
-    return rc == true ? num_deleted : -1;
+    //add the entries from the least to the most recently used
+    if (len > 0) {
+        qsort(list, (size_t)len, sizeof(struct t_covercache_entry *), entry_cmp_atime);
+    }
+    for (long i = 0; i < len; i++) {
+        if (raxTryInsert(covercache_index->entries, (unsigned char *)list[i]->name, sdslen(list[i]->name), list[i], NULL) == 1) {
+            entry_link_head(list[i]);
+            covercache_index->size += list[i]->size;
+        }
+        else {
+            FREE_SDS(list[i]->name);
+            FREE_PTR(list[i]);
+        }
+    }
+    FREE_PTR(list);
+}
+
+/**
+ * Adds all files of a shard directory to the list
+ * @param dirpath shard directory
+ * @param shard name of the shard directory
+ * @param list pointer to the array of entries to extend
+ * @param len pointer to the length of the array
+ * @return number of added files
+ */
+static long covercache_index_scan_dir(sds dirpath, const char *shard, struct t_covercache_entry ***list, long *len) {
+    errno = 0;
+    DIR *dir = opendir(dirpath);
+    if (dir == NULL) {
+        MYMPD_LOG_ERROR("Error opening directory \"%s\"", dirpath);
+        MYMPD_LOG_ERRNO(errno);
+        return 0;
+    }
+    long added = 0;
+    struct dirent *next_file;
+    sds filepath = sdsempty();
+    while ((next_file = readdir(dir)) != NULL ) {
+        if (strncmp(next_file->d_name, shard, 2) != 0) {
+            continue;
+        }
+        sdsclear(filepath);
+        filepath = sdscatfmt(filepath, "%S/%s", dirpath, next_file->d_name);
+        struct stat status;
+        //stat is also needed for the size, it replaces d_type checking
+        if (stat(filepath, &status) != 0 ||
+            S_ISREG(status.st_mode) == 0)
+        {
+            continue;
+        }
+        struct t_covercache_entry *entry = malloc_assert(sizeof(struct t_covercache_entry));
+        entry->name = sdsnew(next_file->d_name);
+        entry->size = (size_t)status.st_size;
+        entry->atime = status.st_mtime;
+        entry->prev = NULL;
+        entry->next = NULL;
+        *list = realloc_assert(*list, (size_t)(*len + 1) * sizeof(struct t_covercache_entry *));
+        (*list)[*len] = entry;
+        (*len)++;
+        added++;
+    }
+    closedir(dir);
+    FREE_SDS(filepath);
+    return added;
+}
+
+/**
+ * Looks up an index entry and moves it to the head of the lru list
+ * @param name filename
+ * @return the entry or NULL if not found
+ */
+static struct t_covercache_entry *covercache_index_touch(const char *name) {
+    void *data = raxFind(covercache_index->entries, (unsigned char *)name, strlen(name));
+    if (data == raxNotFound) {
+        return NULL;
+    }
+    struct t_covercache_entry *entry = (struct t_covercache_entry *)data;
+    entry->atime = time(NULL);
+    if (entry != covercache_index->head) {
+        entry_unlink(entry);
+        entry_link_head(entry);
+    }
+    return entry;
+}
+
+/**
+ * Adds or updates an index entry
+ * @param name filename
+ * @param size file size in bytes
+ * @param atime last access time
+ * @param most_recent true = insert at the head, false = append at the tail of the lru list
+ */
+static void covercache_index_add(const char *name, size_t size, time_t atime, bool most_recent) {
+    struct t_covercache_entry *entry = covercache_index_touch(name);
+    if (entry != NULL) {
+        covercache_index->size -= entry->size;
+        entry->size = size;
+        entry->atime = atime;
+        covercache_index->size += size;
+        return;
+    }
+    entry = malloc_assert(sizeof(struct t_covercache_entry));
+    entry->name = sdsnew(name);
+    entry->size = size;
+    entry->atime = atime;
+    entry->prev = NULL;
+    entry->next = NULL;
+    raxInsert(covercache_index->entries, (unsigned char *)entry->name, sdslen(entry->name), entry, NULL);
+    if (most_recent == true) {
+        entry_link_head(entry);
+    }
+    else {
+        entry_link_tail(entry);
+    }
+    covercache_index->size += size;
+}
+
+/**
+ * Removes an entry from the index
+ * @param entry entry to remove
+ * @param remove_file true = delete the file
+ */
+static void covercache_index_remove(struct t_covercache_entry *entry, bool remove_file) {
+    if (remove_file == true) {
+        covercache_journal_remove(entry);
+        sds filepath = covercache_get_filepath(sdsempty(), covercache_index->cachedir, entry->name);
+        MYMPD_LOG_DEBUG("Deleting \"%s\"", filepath);
+        try_rm_file(filepath);
+        FREE_SDS(filepath);
+    }
+    raxRemove(covercache_index->entries, (unsigned char *)entry->name, sdslen(entry->name), NULL);
+    entry_unlink(entry);
+    covercache_index->size -= entry->size;
+    FREE_SDS(entry->name);
+    FREE_PTR(entry);
+}
+
+/**
+ * Evicts the least recently used entries until the size is within the budget
+ */
+static void covercache_index_evict(void) {
+    if (covercache_index->size_max == 0) {
+        return;
+    }
+    int num_deleted = 0;
+    //keep the most recently used entry
+    while (covercache_index->size > covercache_index->size_max &&
+        covercache_index->tail != covercache_index->head)
+    {
+        covercache_index_remove(covercache_index->tail, true);
+        num_deleted++;
+    }
+    covercache_index->evictions += (unsigned long)num_deleted;
+    if (num_deleted > 0) {
+        MYMPD_LOG_DEBUG("Evicted %d files from covercache", num_deleted);
+    }
+}
+
+/**
+ * Inserts the entry at the head of the lru list
+ * @param entry entry to insert
+ */
+static void entry_link_head(struct t_covercache_entry *entry) {
+    entry->prev = NULL;
+    entry->next = covercache_index->head;
+    if (covercache_index->head != NULL) {
+        covercache_index->head->prev = entry;
+    }
+    covercache_index->head = entry;
+    if (covercache_index->tail == NULL) {
+        covercache_index->tail = entry;
+    }
+}
+
+/**
+ * Inserts the entry at the tail of the lru list
+ * @param entry entry to insert
+ */
+static void entry_link_tail(struct t_covercache_entry *entry) {
+    entry->next = NULL;
+    entry->prev = covercache_index->tail;
+    if (covercache_index->tail != NULL) {
+        covercache_index->tail->next = entry;
+    }
+    covercache_index->tail = entry;
+    if (covercache_index->head == NULL) {
+        covercache_index->head = entry;
+    }
+}
+
+/**
+ * Removes the entry from the lru list
+ * @param entry entry to remove
+ */
+static void entry_unlink(struct t_covercache_entry *entry) {
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    }
+    else {
+        covercache_index->head = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    }
+    else {
+        covercache_index->tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+/**
+ * Compares the last access time of two entries for qsort
+ * @param a pointer to first entry
+ * @param b pointer to second entry
+ * @return -1, 0 or 1
+ */
+static int entry_cmp_atime(const void *a, const void *b) {
+    const struct t_covercache_entry *entry_a = *(struct t_covercache_entry * const *)a;
+    const struct t_covercache_entry *entry_b = *(struct t_covercache_entry * const *)b;
+    if (entry_a->atime < entry_b->atime) {
+        return -1;
+    }
+    if (entry_a->atime > entry_b->atime) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Checks the type of a directory entry, falls back to stat
+ * if the filesystem does not report the type
+ * @param dirpath directory of the entry
+ * @param next_file the directory entry
+ * @param type DT_REG or DT_DIR
+ * @return true if the entry has the type, else false
+ */
+static bool is_dirent_type(sds dirpath, struct dirent *next_file, unsigned char type) {
+    if (next_file->d_type != DT_UNKNOWN) {
+        return next_file->d_type == type;
+    }
+    sds filepath = sdscatfmt(sdsempty(), "%S/%s", dirpath, next_file->d_name);
+    struct stat status;
+    bool rc = false;
+    if (stat(filepath, &status) == 0) {
+        rc = type == DT_DIR
+            ? S_ISDIR(status.st_mode) != 0
+            : S_ISREG(status.st_mode) != 0;
+    }
+    FREE_SDS(filepath);
+    return rc;
 }
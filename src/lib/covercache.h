@@ -11,6 +11,12 @@
 
 #include "../../dist/sds/sds.h"
 
+bool covercache_init(sds cachedir, size_t size_max);
+void covercache_free(void);
+sds covercache_stats(sds buffer);
+sds covercache_get_file(sds cachedir, const char *uri, int offset, int thumbnail_size, sds filepath);
+bool covercache_thumbnail_skipped(sds cachedir, const char *uri, int offset, int thumbnail_size);
 bool covercache_write_file(sds cachedir, const char *uri, const char *mime_type, sds binary, int offset);
-int covercache_clear(sds cachedir, int keepdays);
+bool covercache_write_thumbnail(sds cachedir, const char *uri, sds binary, int offset, int thumbnail_size);
+int covercache_clear(int keepdays);
 #endif
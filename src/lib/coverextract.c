@@ -0,0 +1,179 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "coverextract.h"
+
+#include "log.h"
+#include "mimetype.h"
+#include "sds_extras.h"
+
+#include <assert.h>
+#include <string.h>
+
+//optional includes
+#ifdef ENABLE_LIBID3TAG
+    #include <id3tag.h>
+#endif
+
+#ifdef ENABLE_FLAC
+    #include <FLAC/metadata.h>
+#endif
+
+/**
+ * Private definitions
+ */
+static bool coverextract_id3(const char *media_file, sds *binary, int offset);
+static bool coverextract_flac(const char *media_file, sds *binary, bool is_ogg, int offset);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Extracts an embedded coverimage from a media file
+ * @param media_file full path to the song
+ * @param binary pointer to already allocated sds string to hold the image
+ * @param offset number of embedded image to extract
+ * @return true on success, else false
+ */
+bool coverextract(const char *media_file, sds *binary, int offset) {
+    const char *mime_type_media_file = get_mime_type_by_ext(media_file);
+    MYMPD_LOG_DEBUG("Mimetype of %s is %s", media_file, mime_type_media_file);
+    if (strcmp(mime_type_media_file, "audio/mpeg") == 0) {
+        return coverextract_id3(media_file, binary, offset);
+    }
+    if (strcmp(mime_type_media_file, "audio/ogg") == 0) {
+        return coverextract_flac(media_file, binary, true, offset);
+    }
+    if (strcmp(mime_type_media_file, "audio/flac") == 0) {
+        return coverextract_flac(media_file, binary, false, offset);
+    }
+    return false;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Extracts albumart from id3v2 taged files
+ * @param media_file full path to the song
+ * @param binary pointer to already allocates sds string to hold the image
+ * @param offset number of embedded image to extract
+ * @return true on success, else false
+ */
+static bool coverextract_id3(const char *media_file, sds *binary, int offset) {
+    bool rc = false;
+    #ifdef ENABLE_LIBID3TAG
+    MYMPD_LOG_DEBUG("Exctracting coverimage from %s", media_file);
+    struct id3_file *file_struct = id3_file_open(media_file, ID3_FILE_MODE_READONLY);
+    if (file_struct == NULL) {
+        MYMPD_LOG_ERROR("Can't parse id3_file: %s", media_file);
+        return false;
+    }
+    struct id3_tag *tags = id3_file_tag(file_struct);
+    if (tags == NULL) {
+        MYMPD_LOG_ERROR("Can't read id3 tags from file: %s", media_file);
+        return false;
+    }
+    struct id3_frame *frame = id3_tag_findframe(tags, "APIC", (unsigned)offset);
+    if (frame != NULL) {
+        id3_length_t length = 0;
+        const id3_byte_t *pic = id3_field_getbinarydata(id3_frame_field(frame, 4), &length);
+        if (length > 0) {
+            *binary = sdscatlen(*binary, pic, length);
+            const char *mime_type = get_mime_type_by_magic_stream(*binary);
+            if (mime_type != NULL) {
+                MYMPD_LOG_DEBUG("Coverimage successfully extracted (%lu bytes)", (unsigned long)sdslen(*binary));
+                rc = true;
+            }
+            else {
+                MYMPD_LOG_WARN("Could not determine mimetype, discarding image");
+                sdsclear(*binary);
+            }
+        }
+        else {
+            MYMPD_LOG_WARN("Embedded picture size is zero");
+        }
+    }
+    else {
+        MYMPD_LOG_DEBUG("No embedded picture detected");
+    }
+    id3_file_close(file_struct);
+    #else
+    (void) media_file;
+    (void) binary;
+    (void) offset;
+    #endif
+    return rc;
+}
+
+/**
+ * Extracts albumart from vorbis tagged files
+ * @param media_file full path to the song
+ * @param binary pointer to already allocates sds string to hold the image
+ * @param is_ogg true if it is a ogg file, false if it is a flac file
+ * @param offset number of embedded image to extract
+ * @return true on success, else false
+ */
+static bool coverextract_flac(const char *media_file, sds *binary, bool is_ogg, int offset) {
+    bool rc = false;
+    #ifdef ENABLE_FLAC
+    MYMPD_LOG_DEBUG("Exctracting coverimage from %s", media_file);
+    FLAC__StreamMetadata *metadata = NULL;
+
+    FLAC__Metadata_Chain *chain = FLAC__metadata_chain_new();
+
+    if(! (is_ogg? FLAC__metadata_chain_read_ogg(chain, media_file) : FLAC__metadata_chain_read(chain, media_file)) ) {
+        MYMPD_LOG_DEBUG("%s: ERROR: reading metadata", media_file);
+        FLAC__metadata_chain_delete(chain);
+        return false;
+    }
+
+    FLAC__Metadata_Iterator *iterator = FLAC__metadata_iterator_new();
+    FLAC__metadata_iterator_init(iterator, chain);
+    assert(iterator);
+    int i = 0;
+    do {
+        FLAC__StreamMetadata *block = FLAC__metadata_iterator_get_block(iterator);
+        if (block->type == FLAC__METADATA_TYPE_PICTURE) {
+            if (i == offset) {
+                metadata = block;
+                break;
+            }
+            i++;
+        }
+    } while (FLAC__metadata_iterator_next(iterator) && metadata == NULL);
+
+    if (metadata == NULL) {
+        MYMPD_LOG_DEBUG("No embedded picture detected");
+    }
+    else if (metadata->data.picture.data_length > 0) {
+        *binary = sdscatlen(*binary, metadata->data.picture.data, metadata->data.picture.data_length);
+        const char *mime_type = get_mime_type_by_magic_stream(*binary);
+        if (mime_type != NULL) {
+            MYMPD_LOG_DEBUG("Coverimage successfully extracted (%lu bytes)", (unsigned long)sdslen(*binary));
+            rc = true;
+        }
+        else {
+            MYMPD_LOG_WARN("Could not determine mimetype, discarding image");
+            sdsclear(*binary);
+        }
+    }
+    else {
+        MYMPD_LOG_WARN("Embedded picture size is zero");
+    }
+    FLAC__metadata_iterator_delete(iterator);
+    FLAC__metadata_chain_delete(chain);
+    #else
+    (void) media_file;
+    (void) binary;
+    (void) is_ogg;
+    (void) offset;
+    #endif
+    return rc;
+}
@@ -0,0 +1,15 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_COVEREXTRACT_H
+#define MYMPD_COVEREXTRACT_H
+
+#include "../../dist/sds/sds.h"
+
+#include <stdbool.h>
+
+bool coverextract(const char *media_file, sds *binary, int offset);
+#endif
@@ -236,6 +236,44 @@ int try_rm_file(sds filepath) {
     return RM_FILE_OK;
 }
 
+/**
+ * Reads a binary file
+ * @param data pointer to an already allocated sds string to append the file content
+ * @param filepath file to read
+ * @param max max bytes to read
+ * @return true on success, false on error or if the file is too large
+ */
+bool read_data_from_file(sds *data, const char *filepath, size_t max) {
+    struct stat status;
+    if (stat(filepath, &status) != 0 ||
+        status.st_size <= 0)
+    {
+        return false;
+    }
+    if ((unsigned long long)status.st_size > max) {
+        MYMPD_LOG_WARN("File \"%s\" is too large, max size is %lu", filepath, (unsigned long)max);
+        return false;
+    }
+    errno = 0;
+    FILE *fp = fopen(filepath, OPEN_FLAGS_READ_BIN);
+    if (fp == NULL) {
+        MYMPD_LOG_ERROR("Error opening \"%s\"", filepath);
+        MYMPD_LOG_ERRNO(errno);
+        return false;
+    }
+    size_t len = (size_t)status.st_size;
+    size_t old_len = sdslen(*data);
+    *data = sdsMakeRoomFor(*data, len);
+    size_t read = fread(*data + old_len, 1, len, fp);
+    fclose(fp);
+    sdsIncrLen(*data, (ssize_t)read);
+    if (read != len) {
+        MYMPD_LOG_ERROR("Error reading \"%s\"", filepath);
+        return false;
+    }
+    return true;
+}
+
 /**
  * Writes data to a file
  * @param filepath filepath to write to
@@ -38,6 +38,7 @@ int sds_getfile(sds *s, FILE *fp, size_t max, bool remove_newline);
 int testdir(const char *name, const char *dirname, bool create);
 FILE *open_tmp_file(sds filepath);
 bool rename_tmp_file(FILE *fp, sds tmp_file, sds filepath, bool write_rc);
+bool read_data_from_file(sds *data, const char *filepath, size_t max);
 bool write_data_to_file(sds filepath, const char *data, size_t data_len);
 bool rm_file(sds filepath);
 int try_rm_file(sds filepath);
@@ -25,7 +25,9 @@
  * private definitions
  */
 static bool _icb_json_get_tag(sds key, sds value, int vtype, validate_callback vcb, void *userdata, sds *error);
-static bool _json_get_string(sds s, const char *path, size_t min, size_t max, sds *result, validate_callback vcb, sds *error);
+static bool _json_get_string(struct t_json_index *index, const char *path, size_t min, size_t max, sds *result, validate_callback vcb, sds *error);
+static int _json_find(struct t_json_index *index, const char *path, const char **p, int *n);
+static bool _json_get_number(struct t_json_index *index, const char *path, double *result);
 static void _set_parse_error(sds *error, const char *fmt, ...);
 static const char *jsonrpc_facility_name(enum jsonrpc_facilities facility);
 static const char *jsonrpc_severity_name(enum jsonrpc_severities severity);
@@ -68,6 +70,7 @@ static const char *jsonrpc_event_names[JSONRPC_EVENT_MAX] = {
     [JSONRPC_EVENT_MPD_DISCONNECTED] = "mpd_disconnected",
     [JSONRPC_EVENT_NOTIFY] = "notify",
     [JSONRPC_EVENT_UPDATE_ALBUM_CACHE] = "update_album_cache",
+    [JSONRPC_EVENT_UPDATE_COVERCACHE] = "update_covercache",
     [JSONRPC_EVENT_UPDATE_DATABASE] = "update_database",
     [JSONRPC_EVENT_UPDATE_FINISHED] = "update_finished",
     [JSONRPC_EVENT_UPDATE_JUKEBOX] = "update_jukebox",
@@ -535,6 +538,59 @@ sds list_to_json_array(sds s, struct t_list *l) {
  * All this functions are validating the result.
  */
 
+/**
+ * Initializes a json index without parsing,
+ * all lookups are searched by mjson
+ * @param index json index to initialize
+ * @param s json string
+ */
+void json_index_init(struct t_json_index *index, sds s) {
+    index->s = s;
+    index->params = NULL;
+    index->params_len = 0;
+    index->count = -1;
+}
+
+/**
+ * Indexes the keys of the params object of a jsonrpc request in a single pass.
+ * The tokens reference the json string, it must not be modified while the index is used.
+ * Lookups for other paths or params objects with more than JSONRPC_PARAMS_MAX keys
+ * are searched by mjson.
+ * @param index json index to populate
+ * @param s jsonrpc request
+ * @return true if the params object was indexed, else false
+ */
+bool json_index_parse(struct t_json_index *index, sds s) {
+    json_index_init(index, s);
+    const char *p;
+    int n;
+    if (mjson_find(s, (int)sdslen(s), "$.params", &p, &n) != MJSON_TOK_OBJECT) {
+        return false;
+    }
+    int count = 0;
+    int koff = 0;
+    int klen = 0;
+    int voff = 0;
+    int vlen = 0;
+    int vtype = 0;
+    int off = 0;
+    for (off = 0; (off = mjson_next(p, n, off, &koff, &klen, &voff, &vlen, &vtype)) != 0;) {
+        if (count == JSONRPC_PARAMS_MAX) {
+            return false;
+        }
+        struct t_json_token *token = &index->tokens[count++];
+        token->key = p + koff;
+        token->klen = klen;
+        token->value = p + voff;
+        token->vlen = vlen;
+        token->vtype = vtype;
+    }
+    index->params = p;
+    index->params_len = n;
+    index->count = count;
+    return true;
+}
+
 /**
  * Helper function to get myMPD columns out of a jsonrpc request
  * and return a validated json array
@@ -566,9 +622,25 @@ sds json_get_cols_as_string(sds s, sds cols, bool *rc) {
  * @return true on success else false
  */
 bool json_get_bool(sds s, const char *path, bool *result, sds *error) {
-    int v = 0;
-    if (mjson_get_bool(s, (int)sdslen(s), path, &v) != 0) {
-        *result = v == 1 ? true : false;
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_bool(&index, path, result, error);
+}
+
+/**
+ * Same as json_get_bool for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param result pointer to bool with the result
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_bool(struct t_json_index *index, const char *path, bool *result, sds *error) {
+    int vtype = _json_find(index, path, NULL, NULL);
+    if (vtype == MJSON_TOK_TRUE ||
+        vtype == MJSON_TOK_FALSE)
+    {
+        *result = vtype == MJSON_TOK_TRUE ? true : false;
         return true;
     }
     _set_parse_error(error, "JSON path \"%s\" not found", path);
@@ -584,7 +656,21 @@ bool json_get_bool(sds s, const char *path, bool *result, sds *error) {
  * @return true on success else false
  */
 bool json_get_int_max(sds s, const char *path, int *result, sds *error) {
-    return json_get_int(s, path, JSONRPC_INT_MIN, JSONRPC_INT_MAX, result, error);
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_int_max(&index, path, result, error);
+}
+
+/**
+ * Same as json_get_int_max for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param result pointer to int with the result
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_int_max(struct t_json_index *index, const char *path, int *result, sds *error) {
+    return json_index_get_int(index, path, JSONRPC_INT_MIN, JSONRPC_INT_MAX, result, error);
 }
 
 /**
@@ -598,8 +684,24 @@ bool json_get_int_max(sds s, const char *path, int *result, sds *error) {
  * @return true on success else false
  */
 bool json_get_int(sds s, const char *path, int min, int max, int *result, sds *error) {
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_int(&index, path, min, max, result, error);
+}
+
+/**
+ * Same as json_get_int for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param min minimum value (including)
+ * @param max maximum value (including)
+ * @param result pointer to int with the result
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_int(struct t_json_index *index, const char *path, int min, int max, int *result, sds *error) {
     long result_long;
-    bool rc = json_get_long(s, path, min, max, &result_long, error);
+    bool rc = json_index_get_long(index, path, min, max, &result_long, error);
     if (rc == true) {
         *result = (int)result_long;
     }
@@ -615,7 +717,21 @@ bool json_get_int(sds s, const char *path, int min, int max, int *result, sds *e
  * @return true on success else false
  */
 bool json_get_long_max(sds s, const char *path, long *result, sds *error) {
-    return json_get_long(s, path, JSONRPC_LONG_MIN, JSONRPC_LONG_MAX, result, error);
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_long_max(&index, path, result, error);
+}
+
+/**
+ * Same as json_get_long_max for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param result pointer to long with the result
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_long_max(struct t_json_index *index, const char *path, long *result, sds *error) {
+    return json_index_get_long(index, path, JSONRPC_LONG_MIN, JSONRPC_LONG_MAX, result, error);
 }
 
 /**
@@ -629,8 +745,24 @@ bool json_get_long_max(sds s, const char *path, long *result, sds *error) {
  * @return true on success else false
  */
 bool json_get_long(sds s, const char *path, long min, long max, long *result, sds *error) {
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_long(&index, path, min, max, result, error);
+}
+
+/**
+ * Same as json_get_long for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param min minimum value (including)
+ * @param max maximum value (including)
+ * @param result pointer to long with the result
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_long(struct t_json_index *index, const char *path, long min, long max, long *result, sds *error) {
     double value;
-    if (mjson_get_number(s, (int)sdslen(s), path, &value) != 0) {
+    if (_json_get_number(index, path, &value) == true) {
         long value_long = (long)value;
         if (value_long >= min && value_long <= max) {
             *result = value_long;
@@ -653,7 +785,21 @@ bool json_get_long(sds s, const char *path, long min, long max, long *result, sd
  * @return true on success else false
  */
 bool json_get_uint_max(sds s, const char *path, unsigned *result, sds *error) {
-    return json_get_uint(s, path, 0, JSONRPC_INT_MAX, result, error);
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_uint_max(&index, path, result, error);
+}
+
+/**
+ * Same as json_get_uint_max for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param result pointer to unsigned int with the result
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_uint_max(struct t_json_index *index, const char *path, unsigned *result, sds *error) {
+    return json_index_get_uint(index, path, 0, JSONRPC_INT_MAX, result, error);
 }
 
 /**
@@ -667,8 +813,24 @@ bool json_get_uint_max(sds s, const char *path, unsigned *result, sds *error) {
  * @return true on success else false
  */
 bool json_get_uint(sds s, const char *path, unsigned min, unsigned max, unsigned *result, sds *error) {
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_uint(&index, path, min, max, result, error);
+}
+
+/**
+ * Same as json_get_uint for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param min minimum value (including)
+ * @param max maximum value (including)
+ * @param result pointer to unsigned int with the result
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_uint(struct t_json_index *index, const char *path, unsigned min, unsigned max, unsigned *result, sds *error) {
     double value;
-    if (mjson_get_number(s, (int)sdslen(s), path, &value) != 0) {
+    if (_json_get_number(index, path, &value) == true) {
         if (value >= min && value <= max) {
             *result = (unsigned)value;
             return true;
@@ -691,11 +853,26 @@ bool json_get_uint(sds s, const char *path, unsigned min, unsigned max, unsigned
  * @return true on success else false
  */
 bool json_get_string_max(sds s, const char *path, sds *result, validate_callback vcb, sds *error) {
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_string_max(&index, path, result, vcb, error);
+}
+
+/**
+ * Same as json_get_string_max for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param result pointer to sds with the result
+ * @param vcb validation callback
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_string_max(struct t_json_index *index, const char *path, sds *result, validate_callback vcb, sds *error) {
     if (vcb == NULL) {
         _set_parse_error(error, "Validation callback is NULL");
         return false;
     }
-    return _json_get_string(s, path, 0, JSONRPC_STR_MAX, result, vcb, error);
+    return _json_get_string(index, path, 0, JSONRPC_STR_MAX, result, vcb, error);
 }
 
 /**
@@ -710,7 +887,24 @@ bool json_get_string_max(sds s, const char *path, sds *result, validate_callback
  * @return true on success else false
  */
 bool json_get_string_cmp(sds s, const char *path, size_t min, size_t max, const char *cmp, sds *result, sds *error) {
-    if (_json_get_string(s, path, min, max, result, NULL, error) == false) {
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_string_cmp(&index, path, min, max, cmp, result, error);
+}
+
+/**
+ * Same as json_get_string_cmp for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param result pointer to sds with the result
+ * @param min minimum length (inclusive)
+ * @param max maximum length (inclusive)
+ * @param cmp compare result against this string
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_string_cmp(struct t_json_index *index, const char *path, size_t min, size_t max, const char *cmp, sds *result, sds *error) {
+    if (_json_get_string(index, path, min, max, result, NULL, error) == false) {
         return false;
     }
     if (strcmp(*result, cmp) != 0) {
@@ -733,11 +927,28 @@ bool json_get_string_cmp(sds s, const char *path, size_t min, size_t max, const
  * @return true on success else false
  */
 bool json_get_string(sds s, const char *path, size_t min, size_t max, sds *result, validate_callback vcb, sds *error) {
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_string(&index, path, min, max, result, vcb, error);
+}
+
+/**
+ * Same as json_get_string for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param result pointer to int with the result
+ * @param min minimum length (inclusive)
+ * @param max maximum length (inclusive)
+ * @param vcb validation callback
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_string(struct t_json_index *index, const char *path, size_t min, size_t max, sds *result, validate_callback vcb, sds *error) {
     if (vcb == NULL) {
         _set_parse_error(error, "Validation callback is NULL");
         return false;
     }
-    return _json_get_string(s, path, min, max, result, vcb, error);
+    return _json_get_string(index, path, min, max, result, vcb, error);
 }
 
 /**
@@ -752,13 +963,30 @@ bool json_get_string(sds s, const char *path, size_t min, size_t max, sds *resul
  * @return true on success else false
  */
 bool json_iterate_object(sds s, const char *path, iterate_callback icb, void *icb_userdata, validate_callback vcb, int max_elements, sds *error) {
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_iterate_object(&index, path, icb, icb_userdata, vcb, max_elements, error);
+}
+
+/**
+ * Same as json_iterate_object for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param icb iteration callback
+ * @param icb_userdata custom data for iteration callback
+ * @param vcb validation callback
+ * @param max_elements maximum of elements
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_iterate_object(struct t_json_index *index, const char *path, iterate_callback icb, void *icb_userdata, validate_callback vcb, int max_elements, sds *error) {
     if (icb == NULL) {
         _set_parse_error(error, "Iteration callback is NULL");
         return false;
     }
     const char *p;
     int n;
-    int otype = mjson_find(s, (int)sdslen(s), path, &p, &n);
+    int otype = _json_find(index, path, &p, &n);
     if (otype != MJSON_TOK_OBJECT && otype != MJSON_TOK_ARRAY) {
         _set_parse_error(error, "Invalid json object type for JSON path \"%s\": %d", path, otype);
         return false;
@@ -877,7 +1105,23 @@ static bool icb_json_get_array_string(sds key, sds value, int vtype, validate_ca
  * @return true on success else false
  */
 bool json_get_array_string(sds s, const char *path, struct t_list *l, validate_callback vcb, int max_elements, sds *error) {
-    return json_iterate_object(s, path, icb_json_get_array_string, l, vcb, max_elements, error);
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_array_string(&index, path, l, vcb, max_elements, error);
+}
+
+/**
+ * Same as json_get_array_string for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param l t_list struct to populate
+ * @param vcb validation callback
+ * @param max_elements maximum of elements
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_array_string(struct t_json_index *index, const char *path, struct t_list *l, validate_callback vcb, int max_elements, sds *error) {
+    return json_index_iterate_object(index, path, icb_json_get_array_string, l, vcb, max_elements, error);
 }
 
 /**
@@ -915,7 +1159,23 @@ static bool icb_json_get_object_string(sds key, sds value, int vtype, validate_c
  * @return true on success else false
  */
 bool json_get_object_string(sds s, const char *path, struct t_list *l, validate_callback vcb, int max_elements, sds *error) {
-    return json_iterate_object(s, path, icb_json_get_object_string, l, vcb, max_elements, error);
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_object_string(&index, path, l, vcb, max_elements, error);
+}
+
+/**
+ * Same as json_get_object_string for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param l t_list struct to populate
+ * @param vcb validation callback
+ * @param max_elements maximum of elements
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_object_string(struct t_json_index *index, const char *path, struct t_list *l, validate_callback vcb, int max_elements, sds *error) {
+    return json_index_iterate_object(index, path, icb_json_get_object_string, l, vcb, max_elements, error);
 }
 
 /**
@@ -929,7 +1189,75 @@ bool json_get_object_string(sds s, const char *path, struct t_list *l, validate_
  * @return true on success else false
  */
 bool json_get_tags(sds s, const char *path, struct t_tags *tags, int max_elements, sds *error) {
-    return json_iterate_object(s, path, _icb_json_get_tag, tags, NULL, max_elements, error);
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_tags(&index, path, tags, max_elements, error);
+}
+
+/**
+ * Same as json_get_tags for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param tags t_tags struct to populate
+ * @param max_elements maximum of elements
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_tags(struct t_json_index *index, const char *path, struct t_tags *tags, int max_elements, sds *error) {
+    return json_index_iterate_object(index, path, _icb_json_get_tag, tags, NULL, max_elements, error);
+}
+
+/**
+ * Splits a json array of objects into a t_list struct.
+ * The raw json objects are saved as keys, this is used for jsonrpc batch requests.
+ * @param s json array to parse
+ * @param path mjson path expression
+ * @param l t_list struct to populate
+ * @param max_elements maximum of elements
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_get_array_object(sds s, const char *path, struct t_list *l, int max_elements, sds *error) {
+    struct t_json_index index;
+    json_index_init(&index, s);
+    return json_index_get_array_object(&index, path, l, max_elements, error);
+}
+
+/**
+ * Same as json_get_array_object for an indexed json object
+ * @param index json index
+ * @param path mjson path expression
+ * @param l t_list struct to populate
+ * @param max_elements maximum of elements
+ * @param error pointer for error string
+ * @return true on success else false
+ */
+bool json_index_get_array_object(struct t_json_index *index, const char *path, struct t_list *l, int max_elements, sds *error) {
+    const char *p;
+    int n;
+    int otype = _json_find(index, path, &p, &n);
+    if (otype != MJSON_TOK_ARRAY) {
+        _set_parse_error(error, "Invalid json object type for JSON path \"%s\": %d", path, otype);
+        return false;
+    }
+    int koff = 0;
+    int klen = 0;
+    int voff = 0;
+    int vlen = 0;
+    int vtype = 0;
+    int off = 0;
+    for (off = 0; (off = mjson_next(p, n, off, &koff, &klen, &voff, &vlen, &vtype)) != 0;) {
+        if (vtype != MJSON_TOK_OBJECT) {
+            _set_parse_error(error, "Invalid json value type for JSON path \"%s\": %d", path, vtype);
+            return false;
+        }
+        if (l->length == max_elements) {
+            _set_parse_error(error, "Too many elements in JSON path \"%s\"", path);
+            return false;
+        }
+        list_push_len(l, p + voff, (size_t)vlen, 0, NULL, 0, NULL);
+    }
+    return true;
 }
 
 /**
@@ -1055,7 +1383,7 @@ static void _set_parse_error(sds *error, const char *fmt, ...) {
 /**
  * Helper function to get a string from a json object
  * Enclosing quotes are removed and string is unescaped
- * @param s json object to parse
+ * @param index json index
  * @param path path to the string to extract
  * @param min minimum length
  * @param max maximum length
@@ -1063,14 +1391,14 @@ static void _set_parse_error(sds *error, const char *fmt, ...) {
  * @param vcb validation callback
  * @param error pointer for error string
  */
-static bool _json_get_string(sds s, const char *path, size_t min, size_t max, sds *result, validate_callback vcb, sds *error) {
+static bool _json_get_string(struct t_json_index *index, const char *path, size_t min, size_t max, sds *result, validate_callback vcb, sds *error) {
     if (*result != NULL) {
         MYMPD_LOG_ERROR("Result parameter must be NULL, path: \"%s\"", path);
         return false;
     }
     const char *p;
     int n;
-    int vtype = mjson_find(s, (int)sdslen(s), path, &p, &n);
+    int vtype = _json_find(index, path, &p, &n);
     if (vtype != MJSON_TOK_STRING) {
         *result = NULL;
         _set_parse_error(error, "JSON path \"%s\" not found or value is not string type, found type is \"%s\"",
@@ -1110,3 +1438,61 @@ static bool _json_get_string(sds s, const char *path, size_t min, size_t max, sd
 
     return true;
 }
+
+/**
+ * Finds the value for a json path.
+ * Top level keys of the params object are looked up in the index,
+ * all other paths are searched by mjson.
+ * @param index json index
+ * @param path mjson path expression
+ * @param p pointer to set to the start of the value, can be NULL
+ * @param n pointer to set to the length of the value, can be NULL
+ * @return mjson token type of the value or MJSON_TOK_INVALID if not found
+ */
+static int _json_find(struct t_json_index *index, const char *path, const char **p, int *n) {
+    if (index->count >= 0 &&
+        strncmp(path, "$.params", 8) == 0)
+    {
+        const char *key = path + 8;
+        if (key[0] == '\0') {
+            if (p != NULL) { *p = index->params; }
+            if (n != NULL) { *n = index->params_len; }
+            return MJSON_TOK_OBJECT;
+        }
+        if (key[0] == '.' &&
+            strpbrk(key + 1, ".[") == NULL)
+        {
+            key++;
+            size_t key_len = strlen(key);
+            for (int i = 0; i < index->count; i++) {
+                struct t_json_token *token = &index->tokens[i];
+                //keys include the enclosing quotes
+                if ((size_t)token->klen == key_len + 2 &&
+                    memcmp(token->key + 1, key, key_len) == 0)
+                {
+                    if (p != NULL) { *p = token->value; }
+                    if (n != NULL) { *n = token->vlen; }
+                    return token->vtype;
+                }
+            }
+            return MJSON_TOK_INVALID;
+        }
+    }
+    return mjson_find(index->s, (int)sdslen(index->s), path, p, n);
+}
+
+/**
+ * Gets a number by json path
+ * @param index json index
+ * @param path mjson path expression
+ * @param result pointer to double with the result
+ * @return true on success else false
+ */
+static bool _json_get_number(struct t_json_index *index, const char *path, double *result) {
+    const char *p;
+    int n;
+    if (_json_find(index, path, &p, &n) != MJSON_TOK_NUMBER) {
+        return false;
+    }
+    return mjson_get_number(p, n, "$", result) != 0;
+}
@@ -45,6 +45,7 @@ enum jsonrpc_events {
     JSONRPC_EVENT_MPD_DISCONNECTED,
     JSONRPC_EVENT_NOTIFY,
     JSONRPC_EVENT_UPDATE_ALBUM_CACHE,
+    JSONRPC_EVENT_UPDATE_COVERCACHE,
     JSONRPC_EVENT_UPDATE_DATABASE,
     JSONRPC_EVENT_UPDATE_FINISHED,
     JSONRPC_EVENT_UPDATE_JUKEBOX,
@@ -60,6 +61,29 @@ enum jsonrpc_events {
     JSONRPC_EVENT_MAX
 };
 
+/**
+ * Key/value pair of an indexed params object,
+ * the pointers reference the json string
+ */
+struct t_json_token {
+    const char *key;    //!< key including the enclosing quotes
+    int klen;           //!< length of the key
+    const char *value;  //!< raw value
+    int vlen;           //!< length of the value
+    int vtype;          //!< mjson token type of the value
+};
+
+/**
+ * Index for the params object of a jsonrpc request
+ */
+struct t_json_index {
+    sds s;                                           //!< the indexed json string
+    const char *params;                              //!< raw params object
+    int params_len;                                  //!< length of the params object
+    int count;                                       //!< number of indexed keys, -1 if not indexed
+    struct t_json_token tokens[JSONRPC_PARAMS_MAX];  //!< key/value pairs of the params object
+};
+
 typedef bool (*iterate_callback) (sds, sds, int, validate_callback, void *, sds *);
 
 void send_jsonrpc_notify(enum jsonrpc_facilities facility, enum jsonrpc_severities severity, const char *message);
@@ -104,8 +128,27 @@ bool json_get_array_string(sds s, const char *path, struct t_list *l, validate_c
 bool json_get_object_string(sds s, const char *path, struct t_list *l, validate_callback vcb, int max_elements, sds *error);
 bool json_iterate_object(sds s, const char *path, iterate_callback icb, void *icb_userdata, validate_callback vcb, int max_elements, sds *error);
 bool json_get_tags(sds s, const char *path, struct t_tags *tags, int max_elements, sds *error);
+bool json_get_array_object(sds s, const char *path, struct t_list *l, int max_elements, sds *error);
 bool json_find_key(sds s, const char *path);
 
+void json_index_init(struct t_json_index *index, sds s);
+bool json_index_parse(struct t_json_index *index, sds s);
+bool json_index_get_bool(struct t_json_index *index, const char *path, bool *result, sds *error);
+bool json_index_get_int_max(struct t_json_index *index, const char *path, int *result, sds *error);
+bool json_index_get_int(struct t_json_index *index, const char *path, int min, int max, int *result, sds *error);
+bool json_index_get_long_max(struct t_json_index *index, const char *path, long *result, sds *error);
+bool json_index_get_long(struct t_json_index *index, const char *path, long min, long max, long *result, sds *error);
+bool json_index_get_uint_max(struct t_json_index *index, const char *path, unsigned *result, sds *error);
+bool json_index_get_uint(struct t_json_index *index, const char *path, unsigned min, unsigned max, unsigned *result, sds *error);
+bool json_index_get_string_max(struct t_json_index *index, const char *path, sds *result, validate_callback vcb, sds *error);
+bool json_index_get_string(struct t_json_index *index, const char *path, size_t min, size_t max, sds *result, validate_callback vcb, sds *error);
+bool json_index_get_string_cmp(struct t_json_index *index, const char *path, size_t min, size_t max, const char *cmp, sds *result, sds *error);
+bool json_index_get_array_string(struct t_json_index *index, const char *path, struct t_list *l, validate_callback vcb, int max_elements, sds *error);
+bool json_index_get_object_string(struct t_json_index *index, const char *path, struct t_list *l, validate_callback vcb, int max_elements, sds *error);
+bool json_index_iterate_object(struct t_json_index *index, const char *path, iterate_callback icb, void *icb_userdata, validate_callback vcb, int max_elements, sds *error);
+bool json_index_get_tags(struct t_json_index *index, const char *path, struct t_tags *tags, int max_elements, sds *error);
+bool json_index_get_array_object(struct t_json_index *index, const char *path, struct t_list *l, int max_elements, sds *error);
+
 const char *get_mjson_toktype_name(int vtype);
 sds list_to_json_array(sds s, struct t_list *l);
 sds json_get_cols_as_string(sds s, sds cols, bool *rc);
@@ -0,0 +1,433 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "last_played_store.h"
+
+#include "filehandler.h"
+#include "log.h"
+#include "mem.h"
+#include "sds_extras.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The history is saved in state/last_played.log, one line for each played song:
+ * <timestamp>::<uri>
+ * New entries are appended, the offset index is kept in memory.
+ * The log is compacted to max_entries if it has grown to twice this size.
+ */
+
+/**
+ * Private definitions
+ */
+
+static bool store_build_index(struct t_last_played_store *store);
+static void store_index_grow(struct t_last_played_store *store);
+static bool store_read_entry(struct t_last_played_store *store, long pos, sds *line);
+static bool store_compact(struct t_last_played_store *store, long max_entries);
+static bool store_import_list(sds workdir, sds filepath);
+static sds import_line_cb(sds buffer, struct t_list_node *current);
+static void free_songs(rax *songs);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes the last played store struct
+ * @param store pointer to the last played store
+ */
+void last_played_store_init(struct t_last_played_store *store) {
+    store->fp = NULL;
+    store->filepath = NULL;
+    store->offsets = NULL;
+    store->length = 0;
+    store->capacity = 0;
+    store->songs = raxNew();
+}
+
+/**
+ * Opens the last played log and builds the offset index.
+ * The last_played file of older myMPD versions is imported.
+ * @param store pointer to the last played store
+ * @param workdir working directory
+ * @param max_entries number of entries to keep
+ * @return true on success else false
+ */
+bool last_played_store_open(struct t_last_played_store *store, sds workdir, long max_entries) {
+    store->filepath = sdscatfmt(sdsempty(), "%S/state/last_played.log", workdir);
+    if (access(store->filepath, F_OK) != 0) {
+        store_import_list(workdir, store->filepath);
+    }
+    errno = 0;
+    store->fp = fopen(store->filepath, OPEN_FLAGS_READ_APPEND);
+    if (store->fp == NULL) {
+        MYMPD_LOG_ERROR("Can not open file \"%s\"", store->filepath);
+        MYMPD_LOG_ERRNO(errno);
+        return false;
+    }
+    if (store_build_index(store) == false) {
+        return false;
+    }
+    MYMPD_LOG_DEBUG("Read %ld entries from the last played log", store->length);
+    if (store->length > max_entries) {
+        return store_compact(store, max_entries);
+    }
+    return true;
+}
+
+/**
+ * Appends a song to the last played log
+ * @param store pointer to the last played store
+ * @param uri song uri
+ * @param played timestamp when the song was played
+ * @param max_entries number of entries to keep
+ * @return true on success else false
+ */
+bool last_played_store_append(struct t_last_played_store *store, const char *uri, time_t played, long max_entries) {
+    if (store->fp == NULL) {
+        return false;
+    }
+    if (strchr(uri, '\n') != NULL) {
+        MYMPD_LOG_WARN("Not adding uri with newline to last played list");
+        return false;
+    }
+    int len = fprintf(store->fp, "%lld::%s\n", (long long)played, uri);
+    if (len < 0 ||
+        fflush(store->fp) != 0)
+    {
+        MYMPD_LOG_ERROR("Could not write to file \"%s\"", store->filepath);
+        return false;
+    }
+    store_index_grow(store);
+    store->offsets[store->length + 1] = store->offsets[store->length] + len;
+    store->length++;
+    if (store->length > max_entries * 2) {
+        return store_compact(store, max_entries);
+    }
+    return true;
+}
+
+/**
+ * Gets an entry from the last played log
+ * @param store pointer to the last played store
+ * @param idx index of the entry, 0 is the last played song
+ * @param played pointer to set the timestamp when the song was played
+ * @param uri pointer to an already allocated sds string to set the song uri
+ * @return true on success else false
+ */
+bool last_played_store_get(struct t_last_played_store *store, long idx, long long *played, sds *uri) {
+    if (idx < 0 ||
+        idx >= store->length)
+    {
+        return false;
+    }
+    if (store_read_entry(store, store->length - 1 - idx, uri) == false) {
+        return false;
+    }
+    char *data = NULL;
+    errno = 0;
+    *played = strtoimax(*uri, &data, 10);
+    if (errno != 0 ||
+        strncmp(data, "::", 2) != 0 ||
+        data[2] == '\0')
+    {
+        MYMPD_LOG_ERROR("Reading last played entry failed");
+        MYMPD_LOG_DEBUG("Errorneous line: %s", *uri);
+        return false;
+    }
+    sdsrange(*uri, data - *uri + 2, -1);
+    return true;
+}
+
+/**
+ * Returns the number of valid entries, the log holds up to twice
+ * the configured number of entries until it is compacted
+ * @param store pointer to the last played store
+ * @param max_entries max entries to keep
+ * @return number of entries
+ */
+long last_played_store_count(struct t_last_played_store *store, long max_entries) {
+    return store->length < max_entries ? store->length : max_entries;
+}
+
+/**
+ * Gets the cached song metadata for a uri
+ * @param store pointer to the last played store
+ * @param uri song uri
+ * @param song pointer to set to the cached song, NULL if the song is not known by mpd
+ * @return true if the uri is cached, else false
+ */
+bool last_played_store_song_get(struct t_last_played_store *store, const char *uri, const struct mpd_song **song) {
+    void *data = raxFind(store->songs, (unsigned char *)uri, strlen(uri));
+    if (data == raxNotFound) {
+        return false;
+    }
+    *song = (struct mpd_song *)data;
+    return true;
+}
+
+/**
+ * Caches a uri that is not known by mpd, it is not looked up again until
+ * the cache is cleared after the next database update
+ * @param store pointer to the last played store
+ * @param uri song uri
+ */
+void last_played_store_song_missing(struct t_last_played_store *store, const char *uri) {
+    if (raxSize(store->songs) >= LAST_PLAYED_SONG_CACHE_MAX) {
+        last_played_store_songs_clear(store);
+    }
+    void *old = NULL;
+    raxInsert(store->songs, (unsigned char *)uri, strlen(uri), NULL, &old);
+    if (old != NULL) {
+        mpd_song_free((struct mpd_song *)old);
+    }
+}
+
+/**
+ * Caches the song metadata, the store takes the ownership of the song
+ * @param store pointer to the last played store
+ * @param song song to cache
+ */
+void last_played_store_song_put(struct t_last_played_store *store, struct mpd_song *song) {
+    if (raxSize(store->songs) >= LAST_PLAYED_SONG_CACHE_MAX) {
+        last_played_store_songs_clear(store);
+    }
+    const char *uri = mpd_song_get_uri(song);
+    void *old = NULL;
+    raxInsert(store->songs, (unsigned char *)uri, strlen(uri), song, &old);
+    if (old != NULL) {
+        mpd_song_free((struct mpd_song *)old);
+    }
+}
+
+/**
+ * Clears the cached song metadata, must be called after a database update
+ * @param store pointer to the last played store
+ */
+void last_played_store_songs_clear(struct t_last_played_store *store) {
+    free_songs(store->songs);
+    store->songs = raxNew();
+}
+
+/**
+ * Closes the last played log and frees the index
+ * @param store pointer to the last played store
+ */
+void last_played_store_close(struct t_last_played_store *store) {
+    if (store->fp != NULL) {
+        (void) fclose(store->fp);
+        store->fp = NULL;
+    }
+    FREE_SDS(store->filepath);
+    FREE_PTR(store->offsets);
+    store->length = 0;
+    store->capacity = 0;
+    free_songs(store->songs);
+    store->songs = NULL;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Scans the log and builds the offset index,
+ * an incomplete last line is removed
+ * @param store pointer to the last played store
+ * @return true on success else false
+ */
+static bool store_build_index(struct t_last_played_store *store) {
+    store->length = 0;
+    store_index_grow(store);
+    store->offsets[0] = 0;
+    rewind(store->fp);
+    long long offset = 0;
+    int c;
+    while ((c = fgetc(store->fp)) != EOF) {
+        offset++;
+        if (c == '\n') {
+            store_index_grow(store);
+            store->offsets[store->length + 1] = offset;
+            store->length++;
+        }
+    }
+    long long end = store->offsets[store->length];
+    if (offset > end) {
+        MYMPD_LOG_WARN("Removing incomplete last line from \"%s\"", store->filepath);
+        errno = 0;
+        if (ftruncate(fileno(store->fp), (off_t)end) != 0) {
+            MYMPD_LOG_ERROR("Could not truncate file \"%s\"", store->filepath);
+            MYMPD_LOG_ERRNO(errno);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Grows the offset index to hold one more entry
+ * @param store pointer to the last played store
+ */
+static void store_index_grow(struct t_last_played_store *store) {
+    if (store->length + 2 > store->capacity) {
+        store->capacity = store->capacity == 0
+            ? 64
+            : store->capacity * 2;
+        store->offsets = realloc_assert(store->offsets, (size_t)store->capacity * sizeof(long long));
+    }
+}
+
+/**
+ * Reads an entry from the log
+ * @param store pointer to the last played store
+ * @param pos position of the entry in the log, 0 is the oldest entry
+ * @param line pointer to an already allocated sds string to set the line without newline
+ * @return true on success else false
+ */
+static bool store_read_entry(struct t_last_played_store *store, long pos, sds *line) {
+    size_t len = (size_t)(store->offsets[pos + 1] - store->offsets[pos]);
+    if (len > LINE_LENGTH_MAX) {
+        MYMPD_LOG_ERROR("Last played entry is too long");
+        return false;
+    }
+    sdsclear(*line);
+    *line = sdsMakeRoomFor(*line, len);
+    errno = 0;
+    ssize_t nread = pread(fileno(store->fp), *line, len, (off_t)store->offsets[pos]);
+    if (nread != (ssize_t)len) {
+        MYMPD_LOG_ERROR("Could not read from file \"%s\"", store->filepath);
+        MYMPD_LOG_ERRNO(errno);
+        return false;
+    }
+    //strip the newline
+    sdsIncrLen(*line, (ssize_t)len - 1);
+    return true;
+}
+
+/**
+ * Rewrites the log with the newest max_entries entries
+ * @param store pointer to the last played store
+ * @param max_entries number of entries to keep
+ * @return true on success else false
+ */
+static bool store_compact(struct t_last_played_store *store, long max_entries) {
+    MYMPD_LOG_INFO("Compacting the last played log to %ld entries", max_entries);
+    sds tmp_file = sdscatfmt(sdsempty(), "%S.XXXXXX", store->filepath);
+    FILE *fp = open_tmp_file(tmp_file);
+    if (fp == NULL) {
+        FREE_SDS(tmp_file);
+        return false;
+    }
+    bool write_rc = true;
+    sds line = sdsempty();
+    for (long pos = store->length - max_entries; pos < store->length; pos++) {
+        if (store_read_entry(store, pos, &line) == false ||
+            fprintf(fp, "%s\n", line) < 0)
+        {
+            write_rc = false;
+            break;
+        }
+    }
+    FREE_SDS(line);
+    if (write_rc == false) {
+        (void) fclose(fp);
+        rm_file(tmp_file);
+        FREE_SDS(tmp_file);
+        return false;
+    }
+    bool rc = rename_tmp_file(fp, tmp_file, store->filepath, write_rc);
+    FREE_SDS(tmp_file);
+    if (rc == false) {
+        return false;
+    }
+    (void) fclose(store->fp);
+    errno = 0;
+    store->fp = fopen(store->filepath, OPEN_FLAGS_READ_APPEND);
+    if (store->fp == NULL) {
+        MYMPD_LOG_ERROR("Can not open file \"%s\"", store->filepath);
+        MYMPD_LOG_ERRNO(errno);
+        return false;
+    }
+    //shift the index
+    long long start = store->offsets[store->length - max_entries];
+    long removed = store->length - max_entries;
+    for (long i = 0; i <= max_entries; i++) {
+        store->offsets[i] = store->offsets[i + removed] - start;
+    }
+    store->length = max_entries;
+    return true;
+}
+
+/**
+ * Imports the last_played file of older myMPD versions, it is sorted newest first
+ * @param workdir working directory
+ * @param filepath path of the last played log
+ * @return true on success else false
+ */
+static bool store_import_list(sds workdir, sds filepath) {
+    sds old_file = sdscatfmt(sdsempty(), "%S/state/last_played", workdir);
+    errno = 0;
+    FILE *fp = fopen(old_file, OPEN_FLAGS_READ);
+    if (fp == NULL) {
+        if (errno != ENOENT) {
+            MYMPD_LOG_ERROR("Can not open file \"%s\"", old_file);
+            MYMPD_LOG_ERRNO(errno);
+        }
+        FREE_SDS(old_file);
+        return false;
+    }
+    MYMPD_LOG_INFO("Importing \"%s\"", old_file);
+    struct t_list lines;
+    list_init(&lines);
+    sds line = sdsempty();
+    while (sds_getline(&line, fp, LINE_LENGTH_MAX) == 0) {
+        list_insert(&lines, line, 0, NULL, NULL);
+    }
+    (void) fclose(fp);
+    FREE_SDS(line);
+    bool rc = list_write_to_disk(filepath, &lines, import_line_cb);
+    list_clear(&lines);
+    if (rc == true) {
+        rm_file(old_file);
+    }
+    FREE_SDS(old_file);
+    return rc;
+}
+
+/**
+ * Callback for list_write_to_disk to write a line of the old last_played file
+ * @param buffer already allocated sds string to append the line
+ * @param current list node
+ * @return pointer to buffer
+ */
+static sds import_line_cb(sds buffer, struct t_list_node *current) {
+    return sdscatfmt(buffer, "%S\n", current->key);
+}
+
+/**
+ * Frees the cached songs
+ * @param songs rax tree with songs, NULL data marks a missing song
+ */
+static void free_songs(rax *songs) {
+    if (songs == NULL) {
+        return;
+    }
+    raxIterator iter;
+    raxStart(&iter, songs);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        if (iter.data != NULL) {
+            mpd_song_free((struct mpd_song *)iter.data);
+        }
+    }
+    raxStop(&iter);
+    raxFree(songs);
+}
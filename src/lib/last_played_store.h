@@ -0,0 +1,25 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_LAST_PLAYED_STORE_H
+#define MYMPD_LAST_PLAYED_STORE_H
+
+#include "../lib/mympd_state.h"
+
+#include <stdbool.h>
+
+void last_played_store_init(struct t_last_played_store *store);
+bool last_played_store_open(struct t_last_played_store *store, sds workdir, long max_entries);
+bool last_played_store_append(struct t_last_played_store *store, const char *uri, time_t played, long max_entries);
+bool last_played_store_get(struct t_last_played_store *store, long idx, long long *played, sds *uri);
+long last_played_store_count(struct t_last_played_store *store, long max_entries);
+bool last_played_store_song_get(struct t_last_played_store *store, const char *uri, const struct mpd_song **song);
+void last_played_store_song_missing(struct t_last_played_store *store, const char *uri);
+void last_played_store_song_put(struct t_last_played_store *store, struct mpd_song *song);
+void last_played_store_songs_clear(struct t_last_played_store *store);
+void last_played_store_close(struct t_last_played_store *store);
+
+#endif
@@ -7,24 +7,50 @@
 #include "compile_time.h"
 #include "msg_queue.h"
 
+#include "../../dist/mjson/mjson.h"
 #include "api.h"
+#include "list.h"
 #include "log.h"
 #include "lua_mympd_state.h"
 #include "mem.h"
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 /*
- Message queue implementation to transfer messages between threads asynchronously
+ Message queue implementation to transfer messages between threads asynchronously.
+ Producers push the messages lock-free into a bounded ring buffer (multi-producer).
+ The thread that holds the mutex moves the messages from the ring buffer to the
+ ordered message list (single-consumer), the list is indexed by id in a rax.
+ Consumers sleep on a futex word that is armed only before they sleep,
+ only the first producer after that issues the wakeup syscall.
 */
 
 //private definitions
-static void free_queue_node(struct t_mympd_msg *n, enum mympd_queue_types type);
+#define RING_MASK (MYMPD_QUEUE_RING_SIZE - 1)
+
+static bool ring_push(struct t_mympd_queue *queue, void *data, long id);
+static void ring_drain(struct t_mympd_queue *queue);
+static void append_node(struct t_mympd_queue *queue, void *data, long id, time_t timestamp, long long enqueued);
+static struct t_mympd_msg *find_node(struct t_mympd_queue *queue, long id);
+static void *shift_node(struct t_mympd_queue *queue, struct t_mympd_msg *node);
+static void free_queue_node(struct t_mympd_queue *queue, struct t_mympd_msg *node);
 static void free_queue_node_extra(void *extra, enum mympd_cmd_ids cmd_id);
 static int unlock_mutex(pthread_mutex_t *mutex);
 static void set_wait_time(int timeout, struct timespec *max_wait);
+static bool wait_for_message(struct t_mympd_queue *queue, long id, int timeout, struct timespec *max_wait);
+static void wake_waiters(struct t_mympd_queue *queue);
+static bool is_duplicate_request(struct t_work_request *request1, struct t_work_request *request2);
+static void insert_request_node(struct t_mympd_queue *queue, struct t_mympd_msg *new_node);
+static void remove_node(struct t_mympd_queue *queue, struct t_mympd_msg *node);
+static long long get_monotonic_ms(void);
 
 //public functions
 
@@ -38,11 +64,20 @@ struct t_mympd_queue *mympd_queue_create(const char *name, enum mympd_queue_type
     struct t_mympd_queue *queue = malloc_assert(sizeof(struct t_mympd_queue));
     queue->head = NULL;
     queue->tail = NULL;
-    queue->length = 0;
+    queue->ids = raxNew();
+    queue->free_nodes = NULL;
+    queue->free_nodes_count = 0;
+    queue->ring = malloc_assert(sizeof(struct t_mympd_ring_slot) * MYMPD_QUEUE_RING_SIZE);
+    for (size_t i = 0; i < MYMPD_QUEUE_RING_SIZE; i++) {
+        atomic_init(&queue->ring[i].sequence, i);
+    }
+    atomic_init(&queue->enqueue_pos, 0);
+    queue->dequeue_pos = 0;
+    atomic_init(&queue->sleeping, 0);
+    atomic_init(&queue->length, 0);
     queue->name = name;
     queue->type = type;
     queue->mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
-    queue->wakeup = (pthread_cond_t)PTHREAD_COND_INITIALIZER;
     return queue;
 }
 
@@ -52,49 +87,56 @@ struct t_mympd_queue *mympd_queue_create(const char *name, enum mympd_queue_type
  */
 void *mympd_queue_free(struct t_mympd_queue *queue) {
     mympd_queue_expire(queue, 0);
+    while (queue->free_nodes != NULL) {
+        struct t_mympd_msg *node = queue->free_nodes;
+        queue->free_nodes = node->next;
+        FREE_PTR(node);
+    }
+    raxFree(queue->ids);
+    FREE_PTR(queue->ring);
     FREE_PTR(queue);
     return NULL;
 }
 
 /**
- * Appends data to the queue
+ * Appends data to the queue.
+ * The data is pushed lock-free to the ring buffer, only if the
+ * ring buffer is full the message is appended with the mutex held.
+ * Read only requests and player controls are moved ahead of long running jobs,
+ * requests of the same connection are never reordered.
  * @param queue pointer to the queue
  * @param data struct t_work_request or t_work_response
  * @param id id of the queue entry
  * @return true on success else false
  */
 bool mympd_queue_push(struct t_mympd_queue *queue, void *data, long id) {
-    int rc = pthread_mutex_lock(&queue->mutex);
-    if (rc != 0) {
-        MYMPD_LOG_ERROR("Error in pthread_mutex_lock: %d", rc);
-        return false;
-    }
-    struct t_mympd_msg* new_node = malloc_assert(sizeof(struct t_mympd_msg));
-    new_node->data = data;
-    new_node->id = id;
-    new_node->timestamp = time(NULL);
-    new_node->next = NULL;
-    queue->length++;
-    if (queue->head == NULL &&
-        queue->tail == NULL)
-    {
-        queue->head = queue->tail = new_node;
-    }
-    else {
-        queue->tail->next = new_node;
-        queue->tail = new_node;
-    }
-    if (unlock_mutex(&queue->mutex) != 0) {
-        return false;
-    }
-    rc = pthread_cond_signal(&queue->wakeup);
-    if (rc != 0) {
-        MYMPD_LOG_ERROR("Error in pthread_cond_signal: %d", rc);
-        return 0;
+    atomic_fetch_add(&queue->length, 1);
+    if (ring_push(queue, data, id) == false) {
+        MYMPD_LOG_DEBUG("Ring buffer of queue \"%s\" is full", queue->name);
+        int rc = pthread_mutex_lock(&queue->mutex);
+        if (rc != 0) {
+            MYMPD_LOG_ERROR("Error in pthread_mutex_lock: %d", rc);
+            atomic_fetch_sub(&queue->length, 1);
+            return false;
+        }
+        //keep the order of the messages
+        ring_drain(queue);
+        append_node(queue, data, id, time(NULL), get_monotonic_ms());
+        unlock_mutex(&queue->mutex);
     }
+    wake_waiters(queue);
     return true;
 }
 
+/**
+ * Wakes up all threads sleeping for a message of this queue.
+ * The syscall is async-signal-safe.
+ * @param queue pointer to the queue
+ */
+void mympd_queue_wakeup(struct t_mympd_queue *queue) {
+    wake_waiters(queue);
+}
+
 /**
  * Gets the first entry or the entry with specific id
  * @param queue pointer to the queue
@@ -109,63 +151,95 @@ void *mympd_queue_shift(struct t_mympd_queue *queue, int timeout, long id) {
         MYMPD_LOG_ERROR("Error in pthread_mutex_lock: %d", rc);
         assert(NULL);
     }
-    if (queue->length == 0) {
-        if (timeout > 0) {
-            struct timespec max_wait = {0, 0};
-            set_wait_time(timeout, &max_wait);
-            errno = 0;
-            rc = pthread_cond_timedwait(&queue->wakeup, &queue->mutex, &max_wait);
-        }
-        else {
-            //wait infinite for a queue entry
-            errno = 0;
-            rc = pthread_cond_wait(&queue->wakeup, &queue->mutex);
-        }
-
-        if (rc != 0) {
-            if (rc != ETIMEDOUT) {
-                MYMPD_LOG_ERROR("Error in pthread_cond_timedwait: %d", rc);
-                MYMPD_LOG_ERRNO(errno);
-            }
+    struct timespec max_wait = {0, 0};
+    if (timeout > 0) {
+        set_wait_time(timeout, &max_wait);
+    }
+    struct t_mympd_msg *node;
+    ring_drain(queue);
+    while ((node = find_node(queue, id)) == NULL) {
+        if (wait_for_message(queue, id, timeout, &max_wait) == false) {
             unlock_mutex(&queue->mutex);
             return NULL;
         }
     }
-    //queue has entry
-    if (queue->head != NULL) {
-        struct t_mympd_msg *current = NULL;
-        struct t_mympd_msg *previous = NULL;
-
-        for (current = queue->head; current != NULL; previous = current, current = current->next) {
-            if (id == 0 ||
-                id == current->id)
-            {
-                void *data = current->data;
-
-                if (previous == NULL) {
-                    //Fix beginning pointer
-                    queue->head = current->next;
-                }
-                else {
-                    //Fix previous nodes next to skip over the removed node.
-                    previous->next = current->next;
-                }
-                //Fix tail
-                if (queue->tail == current) {
-                    queue->tail = previous;
-                }
+    void *data = shift_node(queue, node);
+    unlock_mutex(&queue->mutex);
+    return data;
+}
 
-                FREE_PTR(current);
-                queue->length--;
-                unlock_mutex(&queue->mutex);
-                return data;
-            }
-            MYMPD_LOG_DEBUG("Skipping queue entry with id %ld", current->id);
+/**
+ * Removes the requests from the queue that are identical to the given request.
+ * Requests are identical if the method and the params are equal.
+ * The scan stops at the first request that is not coalescable, identical requests
+ * are never merged across a request that could change the result.
+ * @param queue pointer to the queue, must be of type QUEUE_TYPE_REQUEST
+ * @param request the request to compare
+ * @param duplicates list to append the removed requests as user_data
+ * @return number of removed requests
+ */
+int mympd_queue_shift_duplicates(struct t_mympd_queue *queue, struct t_work_request *request, struct t_list *duplicates) {
+    if (queue->type != QUEUE_TYPE_REQUEST) {
+        return 0;
+    }
+    int rc = pthread_mutex_lock(&queue->mutex);
+    if (rc != 0) {
+        MYMPD_LOG_ERROR("Error in pthread_mutex_lock: %d", rc);
+        return 0;
+    }
+    ring_drain(queue);
+    int shifted_count = 0;
+    struct t_mympd_msg *current = queue->head;
+    while (current != NULL) {
+        struct t_mympd_msg *next = current->next;
+        struct t_work_request *queued = (struct t_work_request *)current->data;
+        if (is_coalescable_api_method(queued->cmd_id) == false) {
+            //mutating or unknown request
+            break;
+        }
+        if (is_duplicate_request(request, queued) == true) {
+            list_push(duplicates, "", 0, NULL, shift_node(queue, current));
+            shifted_count++;
         }
+        current = next;
     }
+    unlock_mutex(&queue->mutex);
+    return shifted_count;
+}
 
+/**
+ * Removes and frees all read only requests of a connection from the queue.
+ * Requests with side effects are not canceled.
+ * @param queue pointer to the queue, must be of type QUEUE_TYPE_REQUEST
+ * @param conn_id connection id
+ * @return number of canceled requests
+ */
+int mympd_queue_cancel(struct t_mympd_queue *queue, long long conn_id) {
+    if (queue->type != QUEUE_TYPE_REQUEST) {
+        return 0;
+    }
+    int rc = pthread_mutex_lock(&queue->mutex);
+    if (rc != 0) {
+        MYMPD_LOG_ERROR("Error in pthread_mutex_lock: %d", rc);
+        return 0;
+    }
+    ring_drain(queue);
+    int canceled_count = 0;
+    struct t_mympd_msg *current = queue->head;
+    while (current != NULL) {
+        struct t_mympd_msg *next = current->next;
+        struct t_work_request *request = (struct t_work_request *)current->data;
+        if (request->conn_id == conn_id &&
+            current->priority == QUEUE_PRIORITY_READ)
+        {
+            MYMPD_LOG_DEBUG("Canceling request \"%s\" for connection %lld", request->method, conn_id);
+            free_queue_node(queue, current);
+            canceled_count++;
+        }
+        current = next;
+    }
     unlock_mutex(&queue->mutex);
-    return NULL;
+    return canceled_count;
 }
 
 /**
@@ -180,61 +254,199 @@ int mympd_queue_expire(struct t_mympd_queue *queue, time_t max_age) {
         MYMPD_LOG_ERROR("Error in pthread_mutex_lock: %d", rc);
         return 0;
     }
-    //queue has entry
+    ring_drain(queue);
     int expired_count = 0;
-    if (queue->head != NULL) {
-        struct t_mympd_msg *current = NULL;
-        struct t_mympd_msg *previous = NULL;
+    time_t expire_time = time(NULL) - max_age;
+    struct t_mympd_msg *current = queue->head;
+    while (current != NULL) {
+        struct t_mympd_msg *next = current->next;
+        if (max_age == 0 ||
+            current->timestamp < expire_time)
+        {
+            free_queue_node(queue, current);
+            expired_count++;
+        }
+        else if (queue->type == QUEUE_TYPE_RESPONSE) {
+            //responses are sorted by age, all following nodes are younger
+            break;
+        }
+        current = next;
+    }
+    unlock_mutex(&queue->mutex);
+    return expired_count;
+}
 
-        time_t expire_time = time(NULL) - max_age;
+//privat functions
 
-        for (current = queue->head; current != NULL;) {
-            if (max_age == 0 ||
-                current->timestamp < expire_time)
+/**
+ * Pushes a message lock-free to the ring buffer.
+ * This is the bounded multi-producer queue from Dmitry Vyukov.
+ * @param queue pointer to the queue
+ * @param data struct t_work_request or t_work_response
+ * @param id id of the queue entry
+ * @return true on success, false if the ring buffer is full
+ */
+static bool ring_push(struct t_mympd_queue *queue, void *data, long id) {
+    struct t_mympd_ring_slot *slot;
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        slot = &queue->ring[pos & RING_MASK];
+        size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            //slot is free, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed))
             {
-                struct t_mympd_msg *to_remove = current;
-                if (queue->tail == current) {
-                    //Fix tail
-                    queue->tail = previous;
-                }
-                if (previous == NULL) {
-                    //Fix beginning pointer
-                    queue->head = current->next;
-                    //Set current to queue head
-                    current = queue->head;
-                }
-                else {
-                    //Fix previous nodes next to skip over the removed node.
-                    previous->next = current->next;
-                    //Set current to previous
-                    current = previous;
-                }
-                free_queue_node(to_remove, queue->type);
-                queue->length--;
-                expired_count++;
+                break;
             }
-            else {
-                //skip this node
-                previous = current;
-                current = current->next;
+        }
+        else if (diff < 0) {
+            //ring buffer is full
+            return false;
+        }
+        else {
+            //another producer claimed the slot
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    slot->data = data;
+    slot->id = id;
+    slot->timestamp = time(NULL);
+    slot->enqueued = get_monotonic_ms();
+    //publish the message
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Moves all published messages from the ring buffer to the message list.
+ * The caller must hold the mutex.
+ * @param queue pointer to the queue
+ */
+static void ring_drain(struct t_mympd_queue *queue) {
+    for (;;) {
+        struct t_mympd_ring_slot *slot = &queue->ring[queue->dequeue_pos & RING_MASK];
+        size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (seq != queue->dequeue_pos + 1) {
+            //empty or not yet published
+            return;
+        }
+        append_node(queue, slot->data, slot->id, slot->timestamp, slot->enqueued);
+        //release the slot for the next round
+        atomic_store_explicit(&slot->sequence, queue->dequeue_pos + MYMPD_QUEUE_RING_SIZE, memory_order_release);
+        queue->dequeue_pos++;
+    }
+}
+
+/**
+ * Appends a message to the message list and the id index.
+ * The caller must hold the mutex.
+ * @param queue pointer to the queue
+ * @param data struct t_work_request or t_work_response
+ * @param id id of the queue entry
+ * @param timestamp messages added timestamp
+ * @param enqueued messages added timestamp in ms
+ */
+static void append_node(struct t_mympd_queue *queue, void *data, long id, time_t timestamp, long long enqueued) {
+    struct t_mympd_msg *new_node;
+    if (queue->free_nodes != NULL) {
+        new_node = queue->free_nodes;
+        queue->free_nodes = new_node->next;
+        queue->free_nodes_count--;
+    }
+    else {
+        new_node = malloc_assert(sizeof(struct t_mympd_msg));
+    }
+    new_node->data = data;
+    new_node->id = id;
+    new_node->timestamp = timestamp;
+    new_node->enqueued = enqueued;
+    new_node->priority = queue->type == QUEUE_TYPE_REQUEST
+        ? get_api_method_priority(((struct t_work_request *)data)->cmd_id)
+        : QUEUE_PRIORITY_INTERACTIVE;
+    new_node->next = NULL;
+    new_node->prev = NULL;
+    new_node->id_next = NULL;
+    if (queue->head == NULL) {
+        queue->head = queue->tail = new_node;
+    }
+    else if (queue->type == QUEUE_TYPE_REQUEST) {
+        insert_request_node(queue, new_node);
+    }
+    else {
+        new_node->prev = queue->tail;
+        queue->tail->next = new_node;
+        queue->tail = new_node;
+    }
+    if (id != 0) {
+        //add to the id index, messages with the same id are chained
+        void *first = raxFind(queue->ids, (unsigned char *)&id, sizeof(id));
+        if (first == raxNotFound) {
+            raxInsert(queue->ids, (unsigned char *)&id, sizeof(id), new_node, NULL);
+        }
+        else {
+            struct t_mympd_msg *current = (struct t_mympd_msg *)first;
+            while (current->id_next != NULL) {
+                current = current->id_next;
             }
+            current->id_next = new_node;
         }
     }
+}
 
-    unlock_mutex(&queue->mutex);
-    return expired_count;
+/**
+ * Finds the first message or the first message with specific id.
+ * The caller must hold the mutex.
+ * @param queue pointer to the queue
+ * @param id 0 for first message or specific id
+ * @return the message node or NULL if not found
+ */
+static struct t_mympd_msg *find_node(struct t_mympd_queue *queue, long id) {
+    if (id == 0) {
+        return queue->head;
+    }
+    void *node = raxFind(queue->ids, (unsigned char *)&id, sizeof(id));
+    return node == raxNotFound
+        ? NULL
+        : (struct t_mympd_msg *)node;
 }
 
-//privat functions
+/**
+ * Removes a message from the queue and returns its data.
+ * The caller must hold the mutex.
+ * @param queue pointer to the queue
+ * @param node message node to remove
+ * @return t_work_request or t_work_response
+ */
+static void *shift_node(struct t_mympd_queue *queue, struct t_mympd_msg *node) {
+    void *data = node->data;
+    if (queue->type == QUEUE_TYPE_REQUEST) {
+        MYMPD_LOG_DEBUG("Request \"%s\" waited %lld ms in %s",
+            ((struct t_work_request *)data)->method, get_monotonic_ms() - node->enqueued, queue->name);
+    }
+    remove_node(queue, node);
+    //recycle the node
+    if (queue->free_nodes_count < MYMPD_QUEUE_RING_SIZE) {
+        node->next = queue->free_nodes;
+        queue->free_nodes = node;
+        queue->free_nodes_count++;
+    }
+    else {
+        FREE_PTR(node);
+    }
+    return data;
+}
 
 /**
- * Frees a queue node, node must be detached from queue
- * @param node to free
- * @param type type of the queue QUEUE_TYPE_REQUEST or QUEUE_TYPE_RESPONSE
+ * Removes a message from the queue and frees it
+ * @param queue pointer to the queue
+ * @param node message node to free
  */
-static void free_queue_node(struct t_mympd_msg *node, enum mympd_queue_types type) {
+static void free_queue_node(struct t_mympd_queue *queue, struct t_mympd_msg *node) {
+    remove_node(queue, node);
     //free data
-    if (type == QUEUE_TYPE_REQUEST) {
+    if (queue->type == QUEUE_TYPE_REQUEST) {
         struct t_work_request *request = node->data;
         free_queue_node_extra(request->extra, request->cmd_id);
         free_request(request);
@@ -262,11 +474,80 @@ static void free_queue_node_extra(void *extra, enum mympd_cmd_ids cmd_id) {
     if (cmd_id == INTERNAL_API_SCRIPT_INIT) {
         lua_mympd_state_free(extra);
     }
+    else if (cmd_id == INTERNAL_API_BATCH) {
+        //freed by free_request
+        return;
+    }
     else {
         FREE_PTR(extra);
     }
 }
 
+/**
+ * Wakes up all threads sleeping for a message.
+ * The message is published before the futex word is checked,
+ * a waiter arms the futex word before it checks the ring buffer a last time.
+ * Only the producer that disarms the futex word issues the syscall.
+ * @param queue pointer to the queue
+ */
+static void wake_waiters(struct t_mympd_queue *queue) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&queue->sleeping, memory_order_relaxed) == 0 ||
+        atomic_exchange(&queue->sleeping, 0) == 0)
+    {
+        return;
+    }
+    //wakeup all threads, they could wait for different ids
+    if (syscall(SYS_futex, &queue->sleeping, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0) == -1) {
+        MYMPD_LOG_ERROR("Error waking up the waiters of queue \"%s\"", queue->name);
+        MYMPD_LOG_ERRNO(errno);
+    }
+}
+
+/**
+ * Waits for the next pushed message.
+ * The futex word is armed before the ring buffer is checked a last time,
+ * producers that do not see the armed futex word have published the message before.
+ * The caller must hold the mutex, it is released while sleeping.
+ * @param queue pointer to the queue
+ * @param id 0 for first message or specific id
+ * @param timeout timeout in ms, 0 to wait infinite
+ * @param max_wait absolute end of the wait time
+ * @return true if the queue should be checked again, false on timeout or error
+ */
+static bool wait_for_message(struct t_mympd_queue *queue, long id, int timeout, struct timespec *max_wait) {
+    atomic_store(&queue->sleeping, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    ring_drain(queue);
+    if (find_node(queue, id) != NULL) {
+        return true;
+    }
+    unlock_mutex(&queue->mutex);
+    //returns immediately if a producer has disarmed the futex word
+    errno = 0;
+    long rc = syscall(SYS_futex, &queue->sleeping, FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME,
+        1, (timeout > 0 ? max_wait : NULL), NULL, FUTEX_BITSET_MATCH_ANY);
+    int wait_errno = errno;
+    rc = pthread_mutex_lock(&queue->mutex);
+    if (rc != 0) {
+        MYMPD_LOG_ERROR("Error in pthread_mutex_lock: %ld", rc);
+        assert(NULL);
+    }
+    ring_drain(queue);
+    if (wait_errno == ETIMEDOUT) {
+        return false;
+    }
+    if (wait_errno != 0 &&
+        wait_errno != EAGAIN &&
+        wait_errno != EINTR)
+    {
+        MYMPD_LOG_ERROR("Error waiting for the futex of queue \"%s\"", queue->name);
+        MYMPD_LOG_ERRNO(wait_errno);
+        return false;
+    }
+    return true;
+}
+
 /**
  * Unlocks the queue mutex
  * @param mutex the mutex to unlock
@@ -279,6 +560,143 @@ static int unlock_mutex(pthread_mutex_t *mutex) {
     return rc;
 }
 
+/**
+ * Inserts a request node.
+ * Read only requests and player controls are inserted before the first long running job
+ * that is not waiting longer than MYMPD_QUEUE_AGING_MS, all other changes are appended.
+ * Player controls are never inserted before other changes and the node is never
+ * inserted before a request of the same connection.
+ * @param queue pointer to the queue
+ * @param new_node node to insert
+ */
+static void insert_request_node(struct t_mympd_queue *queue, struct t_mympd_msg *new_node) {
+    if (new_node->priority == QUEUE_PRIORITY_BULK ||
+        new_node->priority == QUEUE_PRIORITY_CHANGE)
+    {
+        //changes are kept in fifo order
+        new_node->prev = queue->tail;
+        queue->tail->next = new_node;
+        queue->tail = new_node;
+        return;
+    }
+    long long conn_id = ((struct t_work_request *)new_node->data)->conn_id;
+    struct t_mympd_msg *insert_after = NULL;
+    bool lower_found = false;
+    for (struct t_mympd_msg *current = queue->head; current != NULL; current = current->next) {
+        if (current->priority == QUEUE_PRIORITY_BULK &&
+            new_node->enqueued - current->enqueued <= MYMPD_QUEUE_AGING_MS)
+        {
+            lower_found = true;
+        }
+        if (lower_found == false ||
+            ((struct t_work_request *)current->data)->conn_id == conn_id ||
+            (new_node->priority == QUEUE_PRIORITY_INTERACTIVE &&
+                (current->priority == QUEUE_PRIORITY_CHANGE ||
+                 current->priority == QUEUE_PRIORITY_INTERACTIVE)))
+        {
+            //player controls are not reordered against other changes
+            insert_after = current;
+        }
+    }
+    if (insert_after == NULL) {
+        new_node->next = queue->head;
+        queue->head->prev = new_node;
+        queue->head = new_node;
+    }
+    else {
+        new_node->next = insert_after->next;
+        new_node->prev = insert_after;
+        if (insert_after->next != NULL) {
+            insert_after->next->prev = new_node;
+        }
+        insert_after->next = new_node;
+        if (queue->tail == insert_after) {
+            queue->tail = new_node;
+        }
+    }
+}
+
+/**
+ * Detaches a node from the queue and the id index
+ * @param queue pointer to the queue
+ * @param node node to detach
+ */
+static void remove_node(struct t_mympd_queue *queue, struct t_mympd_msg *node) {
+    if (node->prev == NULL) {
+        //Fix beginning pointer
+        queue->head = node->next;
+    }
+    else {
+        //Fix previous nodes next to skip over the removed node.
+        node->prev->next = node->next;
+    }
+    if (node->next == NULL) {
+        //Fix tail
+        queue->tail = node->prev;
+    }
+    else {
+        node->next->prev = node->prev;
+    }
+    if (node->id != 0) {
+        long id = node->id;
+        struct t_mympd_msg *first = (struct t_mympd_msg *)raxFind(queue->ids, (unsigned char *)&id, sizeof(id));
+        if (first == node) {
+            if (node->id_next == NULL) {
+                raxRemove(queue->ids, (unsigned char *)&id, sizeof(id), NULL);
+            }
+            else {
+                raxInsert(queue->ids, (unsigned char *)&id, sizeof(id), node->id_next, NULL);
+            }
+        }
+        else if (first != raxNotFound) {
+            while (first->id_next != NULL) {
+                if (first->id_next == node) {
+                    first->id_next = node->id_next;
+                    break;
+                }
+                first = first->id_next;
+            }
+        }
+    }
+    atomic_fetch_sub(&queue->length, 1);
+}
+
+/**
+ * Compares the method and the params of two requests
+ * @param request1 first request
+ * @param request2 second request
+ * @return true if the requests are identical, else false
+ */
+static bool is_duplicate_request(struct t_work_request *request1, struct t_work_request *request2) {
+    if (request1->cmd_id != request2->cmd_id ||
+        request1->extra != NULL ||
+        request2->extra != NULL)
+    {
+        return false;
+    }
+    const char *p1;
+    const char *p2;
+    int n1;
+    int n2;
+    if (mjson_find(request1->data, (int)sdslen(request1->data), "$.params", &p1, &n1) != MJSON_TOK_OBJECT ||
+        mjson_find(request2->data, (int)sdslen(request2->data), "$.params", &p2, &n2) != MJSON_TOK_OBJECT)
+    {
+        return false;
+    }
+    return n1 == n2 &&
+        memcmp(p1, p2, (size_t)n1) == 0;
+}
+
+/**
+ * Gets the monotonic time in milliseconds
+ * @return milliseconds
+ */
+static long long get_monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
 /**
  * Populates the timespec struct with time now + timeout
  * @param timeout timeout in ms
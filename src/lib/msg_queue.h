@@ -7,41 +7,87 @@
 #ifndef MYMPD_QUEUE_H
 #define MYMPD_QUEUE_H
 
+#include "../../dist/rax/rax.h"
+
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <time.h>
 
+struct t_list;
+struct t_work_request;
+
 enum mympd_queue_types {
     QUEUE_TYPE_REQUEST,  //!< queue holds only t_work_request entries
     QUEUE_TYPE_RESPONSE  //!< queue holds only t_work_response entries
 };
 
+/**
+ * Priority classes for requests.
+ * Read only requests and player controls are moved ahead of long running jobs,
+ * all other changes are shifted in the order they were pushed.
+ */
+enum mympd_queue_priorities {
+    QUEUE_PRIORITY_BULK,        //!< long running jobs
+    QUEUE_PRIORITY_CHANGE,      //!< all other changes
+    QUEUE_PRIORITY_READ,        //!< read only views
+    QUEUE_PRIORITY_INTERACTIVE  //!< player control and volume
+};
+
 /**
  * A message in the queue
  */
 struct t_mympd_msg {
-    void *data;                //!< data t_work_request or t_work_response
-    long id;                   //!< id of the message
-    time_t timestamp;          //!< messages added timestamp
-    struct t_mympd_msg *next;  //!< pointer to next message
+    void *data;                             //!< data t_work_request or t_work_response
+    long id;                                //!< id of the message
+    time_t timestamp;                       //!< messages added timestamp
+    long long enqueued;                     //!< messages added timestamp in ms (monotonic clock)
+    enum mympd_queue_priorities priority;   //!< priority of the request
+    struct t_mympd_msg *next;               //!< pointer to next message
+    struct t_mympd_msg *prev;               //!< pointer to previous message
+    struct t_mympd_msg *id_next;            //!< pointer to next message with the same id
+};
+
+/**
+ * A slot in the ring buffer
+ */
+struct t_mympd_ring_slot {
+    _Atomic size_t sequence;  //!< sequence number of the slot
+    void *data;               //!< data t_work_request or t_work_response
+    long id;                  //!< id of the message
+    time_t timestamp;         //!< messages added timestamp
+    long long enqueued;       //!< messages added timestamp in ms (monotonic clock)
 };
 
 /**
- * Struct for the thread save message queue
+ * Struct for the thread save message queue.
+ * Messages are pushed lock-free to a bounded ring buffer and are moved
+ * to the ordered message list by the thread that holds the mutex.
+ * Consumers sleep on a futex word, producers only wake them if it is armed.
  */
 struct t_mympd_queue {
-    int length;                   //!< length of the queue
-    struct t_mympd_msg *head;     //!< pointer to first message
-    struct t_mympd_msg *tail;     //!< pointer to last message
-    pthread_mutex_t mutex;        //!< the mutex
-    pthread_cond_t wakeup;        //!< condition varibale for the mutex
-    const char *name;             //!< descriptive name
-    enum mympd_queue_types type;  //!< the queue type (request or response)
+    _Atomic int length;                 //!< length of the queue
+    struct t_mympd_msg *head;           //!< pointer to first message
+    struct t_mympd_msg *tail;           //!< pointer to last message
+    rax *ids;                           //!< side table: id -> first message with this id
+    struct t_mympd_msg *free_nodes;     //!< recycled message nodes
+    int free_nodes_count;               //!< number of recycled message nodes
+    struct t_mympd_ring_slot *ring;     //!< the ring buffer
+    _Atomic size_t enqueue_pos;         //!< next write position in the ring buffer
+    size_t dequeue_pos;                 //!< next read position in the ring buffer, guarded by mutex
+    _Atomic int sleeping;               //!< futex word, armed (1) before a consumer sleeps
+    pthread_mutex_t mutex;              //!< the mutex
+    const char *name;                   //!< descriptive name
+    enum mympd_queue_types type;        //!< the queue type (request or response)
 };
 
 struct t_mympd_queue *mympd_queue_create(const char *name, enum mympd_queue_types type);
 void *mympd_queue_free(struct t_mympd_queue *queue);
 bool mympd_queue_push(struct t_mympd_queue *queue, void *data, long id);
+void mympd_queue_wakeup(struct t_mympd_queue *queue);
 void *mympd_queue_shift(struct t_mympd_queue *queue, int timeout, long id);
+int mympd_queue_shift_duplicates(struct t_mympd_queue *queue, struct t_work_request *request, struct t_list *duplicates);
+int mympd_queue_cancel(struct t_mympd_queue *queue, long long conn_id);
 int mympd_queue_expire(struct t_mympd_queue *queue, time_t max_age);
 #endif
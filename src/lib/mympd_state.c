@@ -8,11 +8,15 @@
 #include "mympd_state.h"
 
 #include "../lib/album_cache.h"
+#include "../lib/last_played_store.h"
+#include "../lib/play_stats.h"
+#include "../lib/response_cache.h"
 #include "../lib/sticker_cache.h"
+#include "../lib/sticker_journal.h"
 #include "../mpd_client/jukebox.h"
+#include "../mpd_client/queue_mirror.h"
 #include "../mpd_client/tags.h"
 #include "../mympd_api/home.h"
-#include "../mympd_api/last_played.h"
 #include "../mympd_api/timer.h"
 #include "../mympd_api/trigger.h"
 #include "log.h"
@@ -28,8 +32,6 @@
  */
 void mympd_state_save(struct t_mympd_state *mympd_state) {
     mympd_api_home_file_save(&mympd_state->home_list, mympd_state->config->workdir);
-    mympd_api_last_played_file_save(&mympd_state->mpd_state->last_played,
-        mympd_state->mpd_state->last_played_count, mympd_state->config->workdir);
     mympd_api_timer_file_save(&mympd_state->timer_list, mympd_state->config->workdir);
     mympd_api_trigger_file_save(&mympd_state->trigger_list, mympd_state->config->workdir);
 }
@@ -104,8 +106,13 @@ void mympd_state_free(struct t_mympd_state *mympd_state) {
     mympd_api_timer_timerlist_clear(&mympd_state->timer_list);
     //mpd shared state
     mpd_state_free(mympd_state->mpd_state);
-    //partition state
-    partition_state_free(mympd_state->partition_state);
+    //partition states
+    struct t_partition_state *partition_state = mympd_state->partition_state;
+    while (partition_state != NULL) {
+        struct t_partition_state *next = partition_state->next;
+        partition_state_free(partition_state);
+        partition_state = next;
+    }
     //sds
     FREE_SDS(mympd_state->tag_list_search);
     FREE_SDS(mympd_state->tag_list_browse);
@@ -162,11 +169,17 @@ void mpd_state_default(struct t_mpd_state *mpd_state) {
     //album cache
     mpd_state->album_cache.building = false;
     mpd_state->album_cache.cache = NULL;
+    //response cache
+    response_cache_init(&mpd_state->response_cache);
     //init last played songs list
-    list_init(&mpd_state->last_played);
+    last_played_store_init(&mpd_state->last_played);
     mpd_state->last_played_count = MYMPD_LAST_PLAYED_COUNT;
+    //init listening statistics
+    play_stats_init(&mpd_state->play_stats);
     //init sticker queue
     list_init(&mpd_state->sticker_queue);
+    list_init(&mpd_state->sticker_writes);
+    sticker_journal_init(&mpd_state->sticker_journal);
 
     mpd_state->booklet_name = sdsnew(MYMPD_BOOKLET_NAME);
     //features
@@ -203,10 +216,14 @@ void mpd_state_free(struct t_mpd_state *mpd_state) {
     FREE_SDS(mpd_state->music_directory_value);
     //lists
     list_clear(&mpd_state->sticker_queue);
-    list_clear(&mpd_state->last_played);
+    list_clear(&mpd_state->sticker_writes);
+    sticker_journal_close(&mpd_state->sticker_journal);
+    last_played_store_close(&mpd_state->last_played);
+    play_stats_close(&mpd_state->play_stats);
     //caches
     sticker_cache_free(&mpd_state->sticker_cache);
     album_cache_free(&mpd_state->album_cache);
+    response_cache_free(&mpd_state->response_cache);
 
     FREE_SDS(mpd_state->booklet_name);
     //struct itself
@@ -253,6 +270,8 @@ void partition_state_default(struct t_partition_state *partition_state, const ch
     partition_state->jukebox_last_played = MYMPD_JUKEBOX_LAST_PLAYED;
     partition_state->jukebox_queue_length = MYMPD_JUKEBOX_QUEUE_LENGTH;
     partition_state->jukebox_enforce_unique = MYMPD_JUKEBOX_ENFORCE_UNIQUE;
+    queue_mirror_init(&partition_state->queue_mirror);
+    partition_state->next = NULL;
 }
 
 /**
@@ -266,6 +285,7 @@ void partition_state_free(struct t_partition_state *partition_state) {
     //jukebox
     jukebox_clear(&partition_state->jukebox_queue);
     jukebox_clear(&partition_state->jukebox_queue_tmp);
+    queue_mirror_clear(&partition_state->queue_mirror);
     FREE_SDS(partition_state->jukebox_playlist);
     //struct itself
     FREE_PTR(partition_state);
@@ -13,6 +13,8 @@
 #include "list.h"
 
 #include <mpd/client.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <time.h>
 
 /**
@@ -54,6 +56,69 @@ struct t_cache {
     rax *cache;     //!< pointer to the cache
 };
 
+/**
+ * Response cache for read only api methods
+ */
+struct t_response_cache {
+    rax *cache;           //!< method and params as key, cached response as data
+    struct t_response_cache_entry *head;  //!< most recently used entry
+    struct t_response_cache_entry *tail;  //!< least recently used entry
+    size_t size;          //!< size of all cached responses in bytes
+    unsigned long hits;   //!< number of cache hits
+    unsigned long misses; //!< number of cache misses
+    unsigned long generation; //!< incremented on each invalidation
+    pthread_mutex_t mutex;    //!< the mpd_worker pool threads also add responses
+};
+
+/**
+ * Local mirror of the mpd queue, updated incrementally with plchanges
+ */
+struct t_queue_mirror {
+    struct mpd_song **songs;         //!< songs ordered by queue position
+    unsigned length;                 //!< number of songs in the mirror
+    unsigned capacity;               //!< allocated slots of the songs array
+    unsigned version;                //!< queue version the mirror reflects
+    bool valid;                      //!< false if the mirror must be reloaded completely
+    unsigned long long total_time;   //!< sum of the song durations in seconds
+};
+
+/**
+ * Last played history, an append-only log file with an in-memory offset index
+ */
+struct t_last_played_store {
+    FILE *fp;                 //!< log file opened for reading and appending, NULL if not opened
+    sds filepath;             //!< path of the log file
+    long long *offsets;       //!< file offsets of the entries, oldest first, one more for the end of the log
+    long length;              //!< number of entries
+    long capacity;            //!< allocated entries of the offsets array
+    rax *songs;               //!< cached song metadata, key: uri, data: struct mpd_song or NULL if not known by mpd
+};
+
+/**
+ * Listening history, an append-only play event log with daily aggregates
+ */
+struct t_play_stats {
+    FILE *fp;                 //!< event log opened for appending, NULL if not opened
+    struct t_list buckets;    //!< daily aggregates newest first, user_data: struct t_play_stats_bucket
+};
+
+/**
+ * Journal for sticker updates, written by an own thread
+ */
+struct t_sticker_journal {
+    sds filepath;                     //!< path of the journal file, NULL if not opened
+    FILE *fp;                         //!< journal file opened for appending, accessed only by the writer thread
+    pthread_t thread;                 //!< the writer thread
+    bool running;                     //!< true if the writer thread was started
+    pthread_mutex_t mutex;            //!< protects the fields below
+    pthread_cond_t wakeup;            //!< signals new entries and stop
+    bool stop;                        //!< true to stop the writer thread
+    sds pending;                      //!< entries for the next group commit
+    sds rewrite;                      //!< new content of the journal or NULL
+    unsigned long rewrite_requested;  //!< number of requested rewrites
+    unsigned long rewrite_synced;     //!< number of requested rewrites that are synced to disc
+};
+
 /**
  * Holds MPD specific states shared across all partitions
  */
@@ -93,10 +158,14 @@ struct t_mpd_state {
     //caches
     struct t_cache album_cache;         //!< the album cache created by the mpd_worker thread
     struct t_cache sticker_cache;       //!< the sticker cache created by the mpd_worker thread
+    struct t_response_cache response_cache; //!< cached responses of read only api methods
     //lists
-    struct t_list last_played;          //!< last_played list
+    struct t_last_played_store last_played; //!< last played history
+    struct t_play_stats play_stats;     //!< listening history aggregates
     long last_played_count;             //!< number of songs to keep in the last played list (disk + memory)
     struct t_list sticker_queue;        //!< queue for stickers to set (cache if sticker cache is rebuilding) 
+    struct t_list sticker_writes;       //!< resolved sticker values that are written to mpd after they are journaled
+    struct t_sticker_journal sticker_journal; //!< journal for the sticker queue
     sds booklet_name;                   //!< name of the booklet files
 };
 
@@ -139,6 +208,8 @@ struct t_partition_state {
     bool jukebox_enforce_unique;           //!< flag indicating if unique constraint is enabled
     struct t_list jukebox_queue;           //!< the jukebox queue itself
     struct t_list jukebox_queue_tmp;       //!< temporaray jukebox queue for the add random to queue function
+    //queue
+    struct t_queue_mirror queue_mirror;    //!< local mirror of the queue
     struct t_mpd_state *mpd_state;         //!< pointer to shared MPD state
     //partition
     sds name;                              //!< partition name
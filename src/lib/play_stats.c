@@ -0,0 +1,523 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "play_stats.h"
+
+#include "filehandler.h"
+#include "jsonrpc.h"
+#include "log.h"
+#include "mem.h"
+#include "sds_extras.h"
+#include "validate.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The play events are saved in state/play_events, one json object per line.
+ * The aggregates are kept in memory in daily buckets and are updated with each event.
+ * Events older than PLAY_STATS_DAYS_MAX days are removed from the log on startup.
+ */
+
+/**
+ * Private definitions
+ */
+
+static void aggregate_event(struct t_play_stats *stats, const struct t_play_event *event);
+static struct t_play_stats_bucket *get_bucket(struct t_play_stats *stats, time_t day);
+static void counter_inc(rax *r, const char *key, const char *key2, bool skipped);
+static bool parse_event(sds line, struct t_play_event *event, sds *values);
+static bool compact_log(sds filepath, long offset);
+static time_t day_sub(time_t day, int days);
+static void free_counters(rax *r);
+static void free_bucket(struct t_list_node *current);
+
+/**
+ * Names of the dimensions for the api
+ */
+static const char *dim_names[PLAY_STATS_DIM_COUNT] = {
+    [PLAY_STATS_DIM_ARTIST] = "Artist",
+    [PLAY_STATS_DIM_ALBUM] = "Album",
+    [PLAY_STATS_DIM_SONG] = "Song",
+    [PLAY_STATS_DIM_GENRE] = "Genre"
+};
+
+/**
+ * Tags in the event log
+ */
+enum event_values {
+    EVENT_URI = 0,
+    EVENT_TITLE,
+    EVENT_ARTIST,
+    EVENT_ALBUM,
+    EVENT_ALBUMARTIST,
+    EVENT_GENRE,
+    EVENT_VALUE_COUNT
+};
+
+static const char *event_keys[EVENT_VALUE_COUNT] = {
+    [EVENT_URI] = "uri",
+    [EVENT_TITLE] = "Title",
+    [EVENT_ARTIST] = "Artist",
+    [EVENT_ALBUM] = "Album",
+    [EVENT_ALBUMARTIST] = "AlbumArtist",
+    [EVENT_GENRE] = "Genre"
+};
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes the play stats struct
+ * @param stats pointer to the play stats
+ */
+void play_stats_init(struct t_play_stats *stats) {
+    stats->fp = NULL;
+    list_init(&stats->buckets);
+}
+
+/**
+ * Reads the play event log, builds the aggregates and opens the log for appending
+ * @param stats pointer to the play stats
+ * @param workdir working directory
+ * @param now current time
+ * @return number of read events or -1 on error
+ */
+long play_stats_open(struct t_play_stats *stats, sds workdir, time_t now) {
+    sds filepath = sdscatfmt(sdsempty(), "%S/state/play_events", workdir);
+    time_t oldest = day_sub(play_stats_day(now), PLAY_STATS_DAYS_MAX - 1);
+    long count = 0;
+    long expired_offset = 0;
+    errno = 0;
+    FILE *fp = fopen(filepath, OPEN_FLAGS_READ);
+    if (fp != NULL) {
+        sds line = sdsempty();
+        sds values[EVENT_VALUE_COUNT] = { NULL };
+        struct t_play_event event;
+        while (sds_getline(&line, fp, LINE_LENGTH_MAX) == 0) {
+            if (parse_event(line, &event, values) == false) {
+                MYMPD_LOG_WARN("Skipping invalid play event");
+                MYMPD_LOG_DEBUG("Errorneous line: %s", line);
+                continue;
+            }
+            if (event.time < oldest) {
+                //events are appended in chronological order
+                expired_offset = ftell(fp);
+                continue;
+            }
+            aggregate_event(stats, &event);
+            count++;
+        }
+        (void) fclose(fp);
+        FREE_SDS(line);
+        for (int i = 0; i < EVENT_VALUE_COUNT; i++) {
+            FREE_SDS(values[i]);
+        }
+        if (expired_offset > 0) {
+            compact_log(filepath, expired_offset);
+        }
+    }
+    else if (errno != ENOENT) {
+        MYMPD_LOG_ERROR("Can not open file \"%s\"", filepath);
+        MYMPD_LOG_ERRNO(errno);
+    }
+    MYMPD_LOG_DEBUG("Read %ld play events", count);
+    errno = 0;
+    stats->fp = fopen(filepath, OPEN_FLAGS_APPEND);
+    if (stats->fp == NULL) {
+        MYMPD_LOG_ERROR("Can not open file \"%s\" for appending", filepath);
+        MYMPD_LOG_ERRNO(errno);
+        count = -1;
+    }
+    FREE_SDS(filepath);
+    return count;
+}
+
+/**
+ * Appends a play event to the log and updates the aggregates
+ * @param stats pointer to the play stats
+ * @param event the event to add
+ * @return true on success else false
+ */
+bool play_stats_add(struct t_play_stats *stats, const struct t_play_event *event) {
+    aggregate_event(stats, event);
+    if (stats->fp == NULL) {
+        return false;
+    }
+    const char *values[EVENT_VALUE_COUNT] = {
+        [EVENT_URI] = event->uri,
+        [EVENT_TITLE] = event->title,
+        [EVENT_ARTIST] = event->artist,
+        [EVENT_ALBUM] = event->album,
+        [EVENT_ALBUMARTIST] = event->albumartist,
+        [EVENT_GENRE] = event->genre
+    };
+    sds line = sdsnewlen("{", 1);
+    line = tojson_llong(line, "time", (long long)event->time, true);
+    line = tojson_bool(line, "skipped", event->skipped, false);
+    for (int i = 0; i < EVENT_VALUE_COUNT; i++) {
+        if (values[i] != NULL &&
+            values[i][0] != '\0')
+        {
+            line = sdscatlen(line, ",", 1);
+            line = tojson_char(line, event_keys[i], values[i], false);
+        }
+    }
+    line = sdscatlen(line, "}\n", 2);
+    bool rc = true;
+    if (fputs(line, stats->fp) == EOF ||
+        fflush(stats->fp) != 0)
+    {
+        MYMPD_LOG_ERROR("Could not write play event");
+        rc = false;
+    }
+    FREE_SDS(line);
+    return rc;
+}
+
+/**
+ * Closes the play event log and frees the aggregates
+ * @param stats pointer to the play stats
+ */
+void play_stats_close(struct t_play_stats *stats) {
+    if (stats->fp != NULL) {
+        (void) fclose(stats->fp);
+        stats->fp = NULL;
+    }
+    list_clear_user_data(&stats->buckets, free_bucket);
+}
+
+/**
+ * Parses the name of a dimension
+ * @param name the name: Artist, Album, Song or Genre
+ * @return the dimension or PLAY_STATS_DIM_UNKNOWN
+ */
+enum play_stats_dims play_stats_dim_parse(const char *name) {
+    for (int i = 0; i < PLAY_STATS_DIM_COUNT; i++) {
+        if (strcmp(name, dim_names[i]) == 0) {
+            return (enum play_stats_dims)i;
+        }
+    }
+    return PLAY_STATS_DIM_UNKNOWN;
+}
+
+/**
+ * Calculates the start of the day in local time
+ * @param t timestamp
+ * @return timestamp of the start of the day
+ */
+time_t play_stats_day(time_t t) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+/**
+ * Merges the aggregates of a dimension for the last days
+ * @param stats pointer to the play stats
+ * @param dim dimension to merge
+ * @param days number of days including today
+ * @param now current time
+ * @param total pointer to a counter to set the totals of this days
+ * @return newly allocated rax tree with the merged counters,
+ *         free it with play_stats_merge_free
+ */
+rax *play_stats_merge(struct t_play_stats *stats, enum play_stats_dims dim, int days, time_t now,
+        struct t_play_stats_counter *total)
+{
+    rax *merged = raxNew();
+    total->plays = 0;
+    total->skips = 0;
+    time_t oldest = day_sub(play_stats_day(now), days - 1);
+    struct t_list_node *current = stats->buckets.head;
+    while (current != NULL) {
+        struct t_play_stats_bucket *bucket = (struct t_play_stats_bucket *)current->user_data;
+        if (bucket->day < oldest) {
+            break;
+        }
+        total->plays += bucket->total.plays;
+        total->skips += bucket->total.skips;
+        raxIterator iter;
+        raxStart(&iter, bucket->dims[dim]);
+        raxSeek(&iter, "^", NULL, 0);
+        while (raxNext(&iter)) {
+            struct t_play_stats_counter *src = (struct t_play_stats_counter *)iter.data;
+            void *data = raxFind(merged, iter.key, iter.key_len);
+            struct t_play_stats_counter *dst;
+            if (data == raxNotFound) {
+                dst = malloc_assert(sizeof(struct t_play_stats_counter));
+                dst->plays = 0;
+                dst->skips = 0;
+                raxInsert(merged, iter.key, iter.key_len, dst, NULL);
+            }
+            else {
+                dst = (struct t_play_stats_counter *)data;
+            }
+            dst->plays += src->plays;
+            dst->skips += src->skips;
+        }
+        raxStop(&iter);
+        current = current->next;
+    }
+    return merged;
+}
+
+/**
+ * Frees the result of play_stats_merge
+ * @param merged rax tree to free
+ */
+void play_stats_merge_free(rax *merged) {
+    free_counters(merged);
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Updates the aggregates with an event
+ * @param stats pointer to the play stats
+ * @param event the event
+ */
+static void aggregate_event(struct t_play_stats *stats, const struct t_play_event *event) {
+    struct t_play_stats_bucket *bucket = get_bucket(stats, play_stats_day(event->time));
+    if (event->skipped == true) {
+        bucket->total.skips++;
+    }
+    else {
+        bucket->total.plays++;
+    }
+    counter_inc(bucket->dims[PLAY_STATS_DIM_ARTIST], event->artist, NULL, event->skipped);
+    counter_inc(bucket->dims[PLAY_STATS_DIM_ALBUM], event->album, event->albumartist, event->skipped);
+    counter_inc(bucket->dims[PLAY_STATS_DIM_SONG], event->uri, event->title, event->skipped);
+    counter_inc(bucket->dims[PLAY_STATS_DIM_GENRE], event->genre, NULL, event->skipped);
+}
+
+/**
+ * Gets or creates the bucket for a day, expired buckets are removed
+ * @param stats pointer to the play stats
+ * @param day start of the day
+ * @return pointer to the bucket
+ */
+static struct t_play_stats_bucket *get_bucket(struct t_play_stats *stats, time_t day) {
+    //the bucket for the current day is the first one
+    long idx = 0;
+    struct t_list_node *current = stats->buckets.head;
+    while (current != NULL) {
+        struct t_play_stats_bucket *bucket = (struct t_play_stats_bucket *)current->user_data;
+        if (bucket->day == day) {
+            return bucket;
+        }
+        if (bucket->day < day) {
+            break;
+        }
+        idx++;
+        current = current->next;
+    }
+    struct t_play_stats_bucket *bucket = malloc_assert(sizeof(struct t_play_stats_bucket));
+    bucket->day = day;
+    bucket->total.plays = 0;
+    bucket->total.skips = 0;
+    for (int i = 0; i < PLAY_STATS_DIM_COUNT; i++) {
+        bucket->dims[i] = raxNew();
+    }
+    if (idx == 0) {
+        list_insert(&stats->buckets, "", 0, NULL, bucket);
+    }
+    else {
+        //keep the buckets ordered by day
+        list_push(&stats->buckets, "", 0, NULL, bucket);
+        list_move_item_pos(&stats->buckets, stats->buckets.length - 1, idx);
+    }
+    //remove expired buckets
+    struct t_play_stats_bucket *newest = (struct t_play_stats_bucket *)stats->buckets.head->user_data;
+    time_t oldest = day_sub(newest->day, PLAY_STATS_DAYS_MAX - 1);
+    while (stats->buckets.length > 1) {
+        struct t_play_stats_bucket *last = (struct t_play_stats_bucket *)stats->buckets.tail->user_data;
+        if (last->day >= oldest ||
+            last == bucket)
+        {
+            break;
+        }
+        list_remove_node_user_data(&stats->buckets, stats->buckets.length - 1, free_bucket);
+    }
+    return bucket;
+}
+
+/**
+ * Increments the counter for a key
+ * @param r rax tree with the counters
+ * @param key the key, empty keys are ignored
+ * @param key2 optional second part of the key, appended after a null byte
+ * @param skipped true to increment the skips, else the plays
+ */
+static void counter_inc(rax *r, const char *key, const char *key2, bool skipped) {
+    if (key == NULL ||
+        key[0] == '\0')
+    {
+        return;
+    }
+    sds k = sdsnew(key);
+    if (key2 != NULL &&
+        key2[0] != '\0')
+    {
+        k = sdscatlen(k, "\0", 1);
+        k = sdscat(k, key2);
+    }
+    struct t_play_stats_counter *counter;
+    void *data = raxFind(r, (unsigned char *)k, sdslen(k));
+    if (data == raxNotFound) {
+        counter = malloc_assert(sizeof(struct t_play_stats_counter));
+        counter->plays = 0;
+        counter->skips = 0;
+        raxInsert(r, (unsigned char *)k, sdslen(k), counter, NULL);
+    }
+    else {
+        counter = (struct t_play_stats_counter *)data;
+    }
+    if (skipped == true) {
+        counter->skips++;
+    }
+    else {
+        counter->plays++;
+    }
+    FREE_SDS(k);
+}
+
+/**
+ * Parses a line of the play event log
+ * @param line line to parse
+ * @param event pointer to the event to populate
+ * @param values array of sds strings for the tag values,
+ *               the event points to this strings, they are freed on the next call
+ * @return true on success else false
+ */
+static bool parse_event(sds line, struct t_play_event *event, sds *values) {
+    for (int i = 0; i < EVENT_VALUE_COUNT; i++) {
+        FREE_SDS(values[i]);
+    }
+    sds json = sdscatfmt(sdsempty(), "{\"params\":%S}", line);
+    struct t_json_index index;
+    long t;
+    bool rc = json_index_parse(&index, json) == true &&
+        json_index_get_long_max(&index, "$.params.time", &t, NULL) == true &&
+        json_index_get_bool(&index, "$.params.skipped", &event->skipped, NULL) == true &&
+        json_index_get_string_max(&index, "$.params.uri", &values[EVENT_URI], vcb_istext, NULL) == true;
+    if (rc == true) {
+        event->time = (time_t)t;
+        //tags are optional
+        sds path = sdsempty();
+        for (int i = EVENT_TITLE; i < EVENT_VALUE_COUNT; i++) {
+            sdsclear(path);
+            path = sdscatfmt(path, "$.params.%s", event_keys[i]);
+            if (json_index_get_string_max(&index, path, &values[i], vcb_istext, NULL) == false) {
+                FREE_SDS(values[i]);
+            }
+        }
+        FREE_SDS(path);
+        event->uri = values[EVENT_URI];
+        event->title = values[EVENT_TITLE];
+        event->artist = values[EVENT_ARTIST];
+        event->album = values[EVENT_ALBUM];
+        event->albumartist = values[EVENT_ALBUMARTIST];
+        event->genre = values[EVENT_GENRE];
+    }
+    FREE_SDS(json);
+    return rc;
+}
+
+/**
+ * Removes the expired events from the start of the log
+ * @param filepath path of the log
+ * @param offset offset of the first event to keep
+ * @return true on success else false
+ */
+static bool compact_log(sds filepath, long offset) {
+    MYMPD_LOG_INFO("Removing expired play events");
+    errno = 0;
+    FILE *fi = fopen(filepath, OPEN_FLAGS_READ);
+    if (fi == NULL) {
+        MYMPD_LOG_ERROR("Can not open file \"%s\"", filepath);
+        MYMPD_LOG_ERRNO(errno);
+        return false;
+    }
+    sds tmp_file = sdscatfmt(sdsempty(), "%S.XXXXXX", filepath);
+    FILE *fp = open_tmp_file(tmp_file);
+    if (fp == NULL) {
+        (void) fclose(fi);
+        FREE_SDS(tmp_file);
+        return false;
+    }
+    bool write_rc = fseek(fi, offset, SEEK_SET) == 0;
+    char buf[4096];
+    size_t n;
+    while (write_rc == true &&
+        (n = fread(buf, 1, sizeof(buf), fi)) > 0)
+    {
+        if (fwrite(buf, 1, n, fp) != n) {
+            write_rc = false;
+        }
+    }
+    (void) fclose(fi);
+    if (write_rc == false) {
+        MYMPD_LOG_ERROR("Could not write play events");
+        (void) fclose(fp);
+        rm_file(tmp_file);
+        FREE_SDS(tmp_file);
+        return false;
+    }
+    bool rc = rename_tmp_file(fp, tmp_file, filepath, write_rc);
+    FREE_SDS(tmp_file);
+    return rc;
+}
+
+/**
+ * Subtracts days from the start of a day in local time
+ * @param day start of the day
+ * @param days number of days to subtract
+ * @return start of the resulting day
+ */
+static time_t day_sub(time_t day, int days) {
+    struct tm tm;
+    localtime_r(&day, &tm);
+    tm.tm_mday -= days;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+/**
+ * Frees the counters of a rax tree and the tree itself
+ * @param r rax tree
+ */
+static void free_counters(rax *r) {
+    raxIterator iter;
+    raxStart(&iter, r);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        FREE_PTR(iter.data);
+    }
+    raxStop(&iter);
+    raxFree(r);
+}
+
+/**
+ * Callback for list_clear_user_data to free a bucket
+ * @param current list node
+ */
+static void free_bucket(struct t_list_node *current) {
+    struct t_play_stats_bucket *bucket = (struct t_play_stats_bucket *)current->user_data;
+    for (int i = 0; i < PLAY_STATS_DIM_COUNT; i++) {
+        free_counters(bucket->dims[i]);
+    }
+    FREE_PTR(current->user_data);
+}
@@ -0,0 +1,70 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_PLAY_STATS_H
+#define MYMPD_PLAY_STATS_H
+
+#include "../../dist/rax/rax.h"
+#include "../lib/mympd_state.h"
+
+#include <stdbool.h>
+
+/**
+ * Dimensions of the aggregates
+ */
+enum play_stats_dims {
+    PLAY_STATS_DIM_UNKNOWN = -1,
+    PLAY_STATS_DIM_ARTIST = 0,
+    PLAY_STATS_DIM_ALBUM,
+    PLAY_STATS_DIM_SONG,
+    PLAY_STATS_DIM_GENRE,
+    PLAY_STATS_DIM_COUNT
+};
+
+/**
+ * Play and skip counter
+ */
+struct t_play_stats_counter {
+    long plays;  //!< number of plays
+    long skips;  //!< number of skips
+};
+
+/**
+ * Aggregates of one day
+ */
+struct t_play_stats_bucket {
+    time_t day;                          //!< start of the day in local time
+    struct t_play_stats_counter total;   //!< counter for all songs
+    rax *dims[PLAY_STATS_DIM_COUNT];     //!< counter by dimension, data: struct t_play_stats_counter
+};
+
+/**
+ * A play or skip event.
+ * The keys of the album and song dimension are the album or uri,
+ * followed by a null byte and the albumartist or title.
+ */
+struct t_play_event {
+    time_t time;              //!< timestamp of the event
+    bool skipped;             //!< true if the song was skipped
+    const char *uri;          //!< song uri
+    const char *title;        //!< title tag
+    const char *artist;       //!< artist tag
+    const char *album;        //!< album tag
+    const char *albumartist;  //!< albumartist tag
+    const char *genre;        //!< genre tag
+};
+
+void play_stats_init(struct t_play_stats *stats);
+long play_stats_open(struct t_play_stats *stats, sds workdir, time_t now);
+bool play_stats_add(struct t_play_stats *stats, const struct t_play_event *event);
+void play_stats_close(struct t_play_stats *stats);
+enum play_stats_dims play_stats_dim_parse(const char *name);
+time_t play_stats_day(time_t t);
+rax *play_stats_merge(struct t_play_stats *stats, enum play_stats_dims dim, int days, time_t now,
+        struct t_play_stats_counter *total);
+void play_stats_merge_free(rax *merged);
+
+#endif
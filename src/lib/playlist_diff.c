@@ -0,0 +1,166 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "playlist_diff.h"
+
+#include "../../dist/rax/rax.h"
+#include "mem.h"
+#include "rax_extras.h"
+
+#include <stdlib.h>
+
+/**
+ * Private definitions
+ */
+
+static void free_positions(void *data);
+static void mark_longest_increasing(const long *assigned, long len, bool *keep);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Calculates the operations to transform a playlist into the target playlist.
+ * The songs that are in the longest common ordered subsequence are kept,
+ * all other songs are deleted and (re-)added at their new position.
+ * The deletes must be applied first, in the returned order (descending positions),
+ * then the adds in the returned order (ascending positions).
+ * @param current current playlist content, key: song uri
+ * @param target target playlist content, key: song uri
+ * @param deletes list to append the positions to delete, value_i: position
+ * @param adds list to append the songs to add, key: song uri, value_i: position
+ * @return number of operations, 0 if the playlists are identical
+ */
+long playlist_diff(struct t_list *current, struct t_list *target,
+        struct t_list *deletes, struct t_list *adds)
+{
+    //target positions of each uri
+    rax *positions = raxNew();
+    long i = 0;
+    struct t_list_node *node = target->head;
+    while (node != NULL) {
+        struct t_list *l;
+        void *data = raxFind(positions, (unsigned char *)node->key, sdslen(node->key));
+        if (data == raxNotFound) {
+            l = list_new();
+            raxInsert(positions, (unsigned char *)node->key, sdslen(node->key), l, NULL);
+        }
+        else {
+            l = (struct t_list *)data;
+        }
+        list_push(l, "", i, NULL, NULL);
+        i++;
+        node = node->next;
+    }
+    //assign the target position to the songs of the current playlist,
+    //-1 marks songs that are not in the target playlist
+    long *assigned = malloc_assert((size_t)(current->length + 1) * sizeof(long));
+    bool *keep = malloc_assert((size_t)(current->length + 1) * sizeof(bool));
+    bool *target_kept = malloc_assert((size_t)(target->length + 1) * sizeof(bool));
+    for (i = 0; i < target->length; i++) {
+        target_kept[i] = false;
+    }
+    i = 0;
+    node = current->head;
+    while (node != NULL) {
+        assigned[i] = -1;
+        void *data = raxFind(positions, (unsigned char *)node->key, sdslen(node->key));
+        if (data != raxNotFound) {
+            struct t_list_node *pos = list_shift_first((struct t_list *)data);
+            if (pos != NULL) {
+                assigned[i] = (long)pos->value_i;
+                list_node_free(pos);
+            }
+        }
+        i++;
+        node = node->next;
+    }
+    rax_free_data(positions, free_positions);
+    //songs in ascending target order are kept
+    mark_longest_increasing(assigned, current->length, keep);
+
+    long ops = 0;
+    for (i = current->length - 1; i >= 0; i--) {
+        if (keep[i] == true) {
+            target_kept[assigned[i]] = true;
+        }
+        else {
+            list_push(deletes, "", i, NULL, NULL);
+            ops++;
+        }
+    }
+    i = 0;
+    node = target->head;
+    while (node != NULL) {
+        if (target_kept[i] == false) {
+            list_push(adds, node->key, i, NULL, NULL);
+            ops++;
+        }
+        i++;
+        node = node->next;
+    }
+    FREE_PTR(assigned);
+    FREE_PTR(keep);
+    FREE_PTR(target_kept);
+    return ops;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Callback for rax_free_data to free the position lists
+ * @param data pointer to a t_list
+ */
+static void free_positions(void *data) {
+    list_free((struct t_list *)data);
+}
+
+/**
+ * Marks the longest strictly increasing subsequence, ignoring negative values.
+ * Patience sorting with O(n log n).
+ * @param assigned values
+ * @param len number of values
+ * @param keep array to set true for the elements of the subsequence
+ */
+static void mark_longest_increasing(const long *assigned, long len, bool *keep) {
+    //tails[k]: index of the smallest tail of all increasing subsequences with length k + 1
+    long *tails = malloc_assert((size_t)(len + 1) * sizeof(long));
+    long *prev = malloc_assert((size_t)(len + 1) * sizeof(long));
+    long found = 0;
+    for (long i = 0; i < len; i++) {
+        keep[i] = false;
+        if (assigned[i] < 0) {
+            continue;
+        }
+        long lo = 0;
+        long hi = found;
+        while (lo < hi) {
+            long mid = lo + (hi - lo) / 2;
+            if (assigned[tails[mid]] < assigned[i]) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        prev[i] = lo > 0 ? tails[lo - 1] : -1;
+        tails[lo] = i;
+        if (lo == found) {
+            found++;
+        }
+    }
+    if (found > 0) {
+        for (long i = tails[found - 1]; i >= 0; i = prev[i]) {
+            keep[i] = true;
+        }
+    }
+    FREE_PTR(tails);
+    FREE_PTR(prev);
+}
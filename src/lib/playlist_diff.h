@@ -0,0 +1,14 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_PLAYLIST_DIFF_H
+#define MYMPD_PLAYLIST_DIFF_H
+
+#include "list.h"
+
+long playlist_diff(struct t_list *current, struct t_list *target,
+        struct t_list *deletes, struct t_list *adds);
+#endif
@@ -0,0 +1,415 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "response_cache.h"
+
+#include "../../dist/mjson/mjson.h"
+#include "log.h"
+#include "mem.h"
+#include "sds_extras.h"
+
+#include <string.h>
+
+/**
+ * The response cache holds the responses of read only api methods.
+ * The key is the method name followed by the normalized params,
+ * the jsonrpc id is stripped from the cached response.
+ * Entries are dropped if a state they depend on changes,
+ * the least recently used entries are evicted if the cache is full.
+ * The mympd_api thread owns the cache, the mpd_worker pool threads only add responses.
+ */
+
+/**
+ * Privat definitions
+ */
+
+/**
+ * Cached response
+ */
+struct t_response_cache_entry {
+    sds key;                               //!< cache key
+    sds response;                          //!< jsonrpc response without the "jsonrpc" and "id" members
+    unsigned deps;                         //!< bitmask of enum response_cache_deps
+    struct t_response_cache_entry *prev;   //!< more recently used entry
+    struct t_response_cache_entry *next;   //!< less recently used entry
+};
+
+static unsigned get_deps(enum mympd_cmd_ids cmd_id);
+static bool add_entry(struct t_response_cache *response_cache, struct t_work_request *request, sds response);
+static sds get_key(struct t_work_request *request, sds key);
+static void remove_entry(struct t_response_cache *response_cache, struct t_response_cache_entry *entry);
+static void free_entry(struct t_response_cache_entry *entry);
+static void entry_unlink(struct t_response_cache *response_cache, struct t_response_cache_entry *entry);
+static void entry_link_head(struct t_response_cache *response_cache, struct t_response_cache_entry *entry);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes the response cache
+ * @param response_cache pointer to response cache
+ */
+void response_cache_init(struct t_response_cache *response_cache) {
+    response_cache->cache = raxNew();
+    response_cache->head = NULL;
+    response_cache->tail = NULL;
+    response_cache->size = 0;
+    response_cache->hits = 0;
+    response_cache->misses = 0;
+    response_cache->generation = 0;
+    pthread_mutex_init(&response_cache->mutex, NULL);
+}
+
+/**
+ * Frees the response cache
+ * @param response_cache pointer to response cache
+ */
+void response_cache_free(struct t_response_cache *response_cache) {
+    if (response_cache->cache == NULL) {
+        return;
+    }
+    struct t_response_cache_entry *current = response_cache->head;
+    while (current != NULL) {
+        struct t_response_cache_entry *next = current->next;
+        free_entry(current);
+        current = next;
+    }
+    raxFree(response_cache->cache);
+    response_cache->cache = NULL;
+    response_cache->head = NULL;
+    response_cache->tail = NULL;
+    response_cache->size = 0;
+    pthread_mutex_destroy(&response_cache->mutex);
+}
+
+/**
+ * Serves a request from the response cache
+ * @param response_cache pointer to response cache
+ * @param request the jsonrpc request
+ * @param buffer pointer to already allocated sds string to replace with the response
+ * @return true if response was found in the cache, else false
+ */
+bool response_cache_get(struct t_response_cache *response_cache, struct t_work_request *request, sds *buffer) {
+    if (response_cache->cache == NULL ||
+        get_deps(request->cmd_id) == RESPONSE_CACHE_DEP_NONE)
+    {
+        return false;
+    }
+    sds key = get_key(request, sdsempty());
+    pthread_mutex_lock(&response_cache->mutex);
+    void *data = raxFind(response_cache->cache, (unsigned char *)key, sdslen(key));
+    FREE_SDS(key);
+    if (data == raxNotFound) {
+        response_cache->misses++;
+        pthread_mutex_unlock(&response_cache->mutex);
+        return false;
+    }
+    response_cache->hits++;
+    struct t_response_cache_entry *entry = (struct t_response_cache_entry *)data;
+    if (entry != response_cache->head) {
+        entry_unlink(response_cache, entry);
+        entry_link_head(response_cache, entry);
+    }
+    sdsclear(*buffer);
+    *buffer = sdscatfmt(*buffer, "{\"jsonrpc\":\"2.0\",\"id\":%l,", request->id);
+    *buffer = sdscatsds(*buffer, entry->response);
+    pthread_mutex_unlock(&response_cache->mutex);
+    MYMPD_LOG_DEBUG("Serving response for \"%s\" from the response cache", request->method);
+    return true;
+}
+
+/**
+ * Adds a successful response to the response cache
+ * @param response_cache pointer to response cache
+ * @param request the jsonrpc request
+ * @param response the jsonrpc response
+ * @return true if the response was cached, else false
+ */
+bool response_cache_add(struct t_response_cache *response_cache, struct t_work_request *request, sds response) {
+    if (response_cache->cache == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&response_cache->mutex);
+    bool rc = add_entry(response_cache, request, response);
+    pthread_mutex_unlock(&response_cache->mutex);
+    return rc;
+}
+
+/**
+ * Returns the generation of the response cache,
+ * must be fetched before the response is created
+ * @param response_cache pointer to response cache
+ * @return the generation
+ */
+unsigned long response_cache_generation(struct t_response_cache *response_cache) {
+    pthread_mutex_lock(&response_cache->mutex);
+    unsigned long generation = response_cache->generation;
+    pthread_mutex_unlock(&response_cache->mutex);
+    return generation;
+}
+
+/**
+ * Adds a successful response to the response cache, if the cache was not
+ * invalidated since the response was created. Called from the mpd_worker pool threads.
+ * @param response_cache pointer to response cache
+ * @param request the jsonrpc request
+ * @param response the jsonrpc response
+ * @param generation the generation fetched before the response was created
+ * @return true if the response was cached, else false
+ */
+bool response_cache_add_generation(struct t_response_cache *response_cache, struct t_work_request *request,
+        sds response, unsigned long generation)
+{
+    if (response_cache->cache == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&response_cache->mutex);
+    bool rc = response_cache->generation == generation
+        ? add_entry(response_cache, request, response)
+        : false;
+    pthread_mutex_unlock(&response_cache->mutex);
+    return rc;
+}
+
+/**
+ * Drops all cached responses that depend on one of the states
+ * @param response_cache pointer to response cache
+ * @param deps bitmask of enum response_cache_deps
+ */
+void response_cache_invalidate(struct t_response_cache *response_cache, unsigned deps) {
+    if (response_cache->cache == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&response_cache->mutex);
+    //responses created before are not added anymore
+    response_cache->generation++;
+    if (response_cache->cache->numele == 0) {
+        pthread_mutex_unlock(&response_cache->mutex);
+        return;
+    }
+    struct t_response_cache_entry *current = response_cache->head;
+    while (current != NULL) {
+        struct t_response_cache_entry *next = current->next;
+        if ((current->deps & deps) != 0) {
+            remove_entry(response_cache, current);
+        }
+        current = next;
+    }
+    MYMPD_LOG_DEBUG("Response cache invalidated (%u), %llu entries left", deps, (unsigned long long)response_cache->cache->numele);
+    pthread_mutex_unlock(&response_cache->mutex);
+}
+
+/**
+ * Drops the cached responses that depend on states changed by an api method
+ * @param response_cache pointer to response cache
+ * @param cmd_id the handled api method
+ */
+void response_cache_invalidate_by_method(struct t_response_cache *response_cache, enum mympd_cmd_ids cmd_id) {
+    switch(cmd_id) {
+        case INTERNAL_API_ALBUMCACHE_CREATED:
+            response_cache_invalidate(response_cache, RESPONSE_CACHE_DEP_DATABASE);
+            break;
+        case INTERNAL_API_STICKERCACHE_CREATED:
+            response_cache_invalidate(response_cache, RESPONSE_CACHE_DEP_STICKERS);
+            break;
+        case MYMPD_API_WEBRADIO_FAVORITE_RM:
+        case MYMPD_API_WEBRADIO_FAVORITE_SAVE:
+            response_cache_invalidate(response_cache, RESPONSE_CACHE_DEP_WEBRADIOS);
+            break;
+        case MYMPD_API_SMARTPLS_NEWEST_SAVE:
+        case MYMPD_API_SMARTPLS_SEARCH_SAVE:
+        case MYMPD_API_SMARTPLS_STICKER_SAVE:
+            response_cache_invalidate(response_cache, RESPONSE_CACHE_DEP_PLAYLISTS);
+            break;
+        case MYMPD_API_CONNECTION_SAVE:
+        case MYMPD_API_PARTITION_SWITCH:
+        case MYMPD_API_SETTINGS_SET:
+            response_cache_invalidate(response_cache, RESPONSE_CACHE_DEP_ALL);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Adds a successful response to the response cache.
+ * The caller must hold the mutex.
+ * @param response_cache pointer to response cache
+ * @param request the jsonrpc request
+ * @param response the jsonrpc response
+ * @return true if the response was cached, else false
+ */
+static bool add_entry(struct t_response_cache *response_cache, struct t_work_request *request, sds response) {
+    unsigned deps = get_deps(request->cmd_id);
+    if (deps == RESPONSE_CACHE_DEP_NONE ||
+        sdslen(response) > RESPONSE_CACHE_SIZE / 4)
+    {
+        return false;
+    }
+    //only successful responses are cached
+    sds prefix = sdscatfmt(sdsempty(), "{\"jsonrpc\":\"2.0\",\"id\":%l,\"result\":", request->id);
+    size_t id_len = sdslen(prefix) - strlen("\"result\":");
+    bool success = strncmp(response, prefix, sdslen(prefix)) == 0;
+    FREE_SDS(prefix);
+    if (success == false) {
+        return false;
+    }
+    sds key = get_key(request, sdsempty());
+    //replace an existing entry
+    void *old_data = raxFind(response_cache->cache, (unsigned char *)key, sdslen(key));
+    if (old_data != raxNotFound) {
+        remove_entry(response_cache, (struct t_response_cache_entry *)old_data);
+    }
+    //evict the least recently used entries to make room for the new entry
+    while (response_cache->tail != NULL &&
+        response_cache->size + sdslen(response) > RESPONSE_CACHE_SIZE)
+    {
+        remove_entry(response_cache, response_cache->tail);
+    }
+    struct t_response_cache_entry *entry = malloc_assert(sizeof(struct t_response_cache_entry));
+    entry->key = key;
+    entry->response = sdsnewlen(response + id_len, sdslen(response) - id_len);
+    entry->deps = deps;
+    raxInsert(response_cache->cache, (unsigned char *)entry->key, sdslen(entry->key), entry, NULL);
+    entry_link_head(response_cache, entry);
+    response_cache->size += sdslen(entry->response);
+    return true;
+}
+
+/**
+ * Returns the states the response of an api method depends on
+ * @param cmd_id myMPD API method
+ * @return bitmask of enum response_cache_deps
+ */
+static unsigned get_deps(enum mympd_cmd_ids cmd_id) {
+    switch(cmd_id) {
+        case MYMPD_API_DATABASE_ALBUMS_GET:
+        case MYMPD_API_DATABASE_TAG_LIST:
+            return RESPONSE_CACHE_DEP_DATABASE;
+        case MYMPD_API_DATABASE_SEARCH:
+        case MYMPD_API_DATABASE_TAG_ALBUM_TITLE_LIST:
+            return RESPONSE_CACHE_DEP_DATABASE | RESPONSE_CACHE_DEP_STICKERS;
+        case MYMPD_API_DATABASE_FILESYSTEM_LIST:
+            return RESPONSE_CACHE_DEP_DATABASE | RESPONSE_CACHE_DEP_PLAYLISTS | RESPONSE_CACHE_DEP_STICKERS;
+        case MYMPD_API_PLAYLIST_LIST:
+            return RESPONSE_CACHE_DEP_PLAYLISTS;
+        case MYMPD_API_PLAYLIST_CONTENT_LIST:
+            return RESPONSE_CACHE_DEP_DATABASE | RESPONSE_CACHE_DEP_PLAYLISTS | RESPONSE_CACHE_DEP_STICKERS |
+                RESPONSE_CACHE_DEP_WEBRADIOS;
+        case MYMPD_API_QUEUE_LIST:
+            return RESPONSE_CACHE_DEP_DATABASE | RESPONSE_CACHE_DEP_QUEUE | RESPONSE_CACHE_DEP_STICKERS |
+                RESPONSE_CACHE_DEP_WEBRADIOS;
+        case MYMPD_API_WEBRADIO_FAVORITE_LIST:
+            return RESPONSE_CACHE_DEP_WEBRADIOS;
+        default:
+            return RESPONSE_CACHE_DEP_NONE;
+    }
+}
+
+/**
+ * Creates the cache key from the method and the params of the request.
+ * Whitespace outside of strings is removed from the params.
+ * @param request the jsonrpc request
+ * @param key already allocated sds string to append the key
+ * @return pointer to key
+ */
+static sds get_key(struct t_work_request *request, sds key) {
+    key = sdscatsds(key, request->method);
+    key = sdscatlen(key, ":", 1);
+    const char *p;
+    int n;
+    if (mjson_find(request->data, (int)sdslen(request->data), "$.params", &p, &n) != MJSON_TOK_OBJECT) {
+        return key;
+    }
+    bool in_string = false;
+    for (int i = 0; i < n; i++) {
+        if (in_string == true) {
+            if (p[i] == '\\' && i + 1 < n) {
+                key = sdscatlen(key, p + i, 2);
+                i++;
+                continue;
+            }
+            if (p[i] == '"') {
+                in_string = false;
+            }
+        }
+        else if (p[i] == '"') {
+            in_string = true;
+        }
+        else if (p[i] == ' ' || p[i] == '\t' || p[i] == '\n' || p[i] == '\r') {
+            continue;
+        }
+        key = sdscatlen(key, p + i, 1);
+    }
+    return key;
+}
+
+/**
+ * Removes an entry from the response cache
+ * @param response_cache pointer to response cache
+ * @param entry entry to remove
+ */
+static void remove_entry(struct t_response_cache *response_cache, struct t_response_cache_entry *entry) {
+    raxRemove(response_cache->cache, (unsigned char *)entry->key, sdslen(entry->key), NULL);
+    entry_unlink(response_cache, entry);
+    response_cache->size -= sdslen(entry->response);
+    free_entry(entry);
+}
+
+/**
+ * Frees a response cache entry
+ * @param entry entry to free
+ */
+static void free_entry(struct t_response_cache_entry *entry) {
+    FREE_SDS(entry->key);
+    FREE_SDS(entry->response);
+    FREE_PTR(entry);
+}
+
+/**
+ * Removes the entry from the lru list
+ * @param response_cache pointer to response cache
+ * @param entry entry to unlink
+ */
+static void entry_unlink(struct t_response_cache *response_cache, struct t_response_cache_entry *entry) {
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    }
+    else {
+        response_cache->head = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    }
+    else {
+        response_cache->tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+/**
+ * Inserts the entry at the head of the lru list
+ * @param response_cache pointer to response cache
+ * @param entry entry to insert
+ */
+static void entry_link_head(struct t_response_cache *response_cache, struct t_response_cache_entry *entry) {
+    entry->prev = NULL;
+    entry->next = response_cache->head;
+    if (response_cache->head != NULL) {
+        response_cache->head->prev = entry;
+    }
+    response_cache->head = entry;
+    if (response_cache->tail == NULL) {
+        response_cache->tail = entry;
+    }
+}
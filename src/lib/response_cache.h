@@ -0,0 +1,39 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_RESPONSE_CACHE_H
+#define MYMPD_RESPONSE_CACHE_H
+
+#include "../../dist/sds/sds.h"
+#include "api.h"
+#include "mympd_state.h"
+
+#include <stdbool.h>
+
+/**
+ * States a cached response depends on, used as bitmask
+ */
+enum response_cache_deps {
+    RESPONSE_CACHE_DEP_NONE = 0,           //!< response can not be cached
+    RESPONSE_CACHE_DEP_DATABASE = 1 << 0,  //!< mpd database and album cache
+    RESPONSE_CACHE_DEP_PLAYLISTS = 1 << 1, //!< stored playlists
+    RESPONSE_CACHE_DEP_QUEUE = 1 << 2,     //!< queue version
+    RESPONSE_CACHE_DEP_STICKERS = 1 << 3,  //!< sticker cache
+    RESPONSE_CACHE_DEP_WEBRADIOS = 1 << 4, //!< webradio favorites
+    RESPONSE_CACHE_DEP_ALL = 0xff          //!< all of the above
+};
+
+void response_cache_init(struct t_response_cache *response_cache);
+void response_cache_free(struct t_response_cache *response_cache);
+bool response_cache_get(struct t_response_cache *response_cache, struct t_work_request *request, sds *buffer);
+bool response_cache_add(struct t_response_cache *response_cache, struct t_work_request *request, sds response);
+unsigned long response_cache_generation(struct t_response_cache *response_cache);
+bool response_cache_add_generation(struct t_response_cache *response_cache, struct t_work_request *request,
+        sds response, unsigned long generation);
+void response_cache_invalidate(struct t_response_cache *response_cache, unsigned deps);
+void response_cache_invalidate_by_method(struct t_response_cache *response_cache, enum mympd_cmd_ids cmd_id);
+
+#endif
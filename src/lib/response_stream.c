@@ -0,0 +1,262 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "response_stream.h"
+
+#include "../../dist/rax/rax.h"
+#include "log.h"
+#include "mem.h"
+#include "sds_extras.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Large jsonrpc responses are sent in chunks to the webserver thread,
+ * the webserver forwards them with chunked transfer encoding.
+ * The size of the chunks waiting in the web_server_queue and in the send buffer
+ * is limited per connection, the producer waits until the webserver has written
+ * them to the socket. A connection that does not read its response for
+ * RESPONSE_STREAM_WAIT_MAX is aborted, the producer is never blocked longer.
+ */
+
+/**
+ * Privat definitions
+ */
+
+#define STREAM_WAIT_SLICE 100 //ms, the shutdown flag is checked after this time
+
+/**
+ * Pending bytes of a connection
+ */
+struct t_stream_pending {
+    size_t bytes;  //!< size of the chunks not yet written to the socket
+    bool active;   //!< true while a response is streamed
+};
+
+static rax *pending_conns; //!< conn_id -> struct t_stream_pending
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER; //!< protects pending_conns
+static pthread_cond_t pending_sent = PTHREAD_COND_INITIALIZER; //!< signals written chunks
+
+static struct t_stream_pending *pending_get(long long conn_id, bool create);
+static void pending_release(long long conn_id, struct t_stream_pending *pending);
+static long long get_monotonic_ms(void);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes the response stream for a request
+ * @param stream pointer to the stream struct
+ * @param request the jsonrpc request
+ */
+void response_stream_init(struct t_response_stream *stream, struct t_work_request *request) {
+    stream->request = request != NULL && request->stream == true && request->conn_id > 0
+        ? request
+        : NULL;
+    stream->started = false;
+    stream->aborted = false;
+    stream->sent = 0;
+    stream->wait_left = RESPONSE_STREAM_WAIT_MAX;
+}
+
+/**
+ * Sends the buffer as chunk to the webserver, if it is large enough.
+ * If the connection does not read the chunks in time, the stream is aborted
+ * and the buffer is discarded.
+ * @param stream pointer to the stream struct, can be NULL
+ * @param buffer the response buffer
+ * @return the buffer or a new empty buffer if it was sent
+ */
+sds response_stream_flush(struct t_response_stream *stream, sds buffer) {
+    if (stream == NULL ||
+        stream->request == NULL ||
+        sdslen(buffer) < RESPONSE_STREAM_CHUNK_SIZE)
+    {
+        return buffer;
+    }
+    if (stream->aborted == true) {
+        sdsclear(buffer);
+        return buffer;
+    }
+    size_t len = sdslen(buffer);
+    long long conn_id = stream->request->conn_id;
+    //wait for the webserver
+    pthread_mutex_lock(&pending_mutex);
+    struct t_stream_pending *pending = pending_get(conn_id, true);
+    pending->active = true;
+    while (pending->bytes > RESPONSE_STREAM_PENDING_MAX &&
+        stream->wait_left > 0 &&
+        s_signal_received == 0)
+    {
+        long long wait = stream->wait_left < STREAM_WAIT_SLICE
+            ? stream->wait_left
+            : STREAM_WAIT_SLICE;
+        long long wait_start = get_monotonic_ms();
+        struct timespec max_wait;
+        clock_gettime(CLOCK_REALTIME, &max_wait);
+        max_wait.tv_nsec += (long)(wait * 1000000L);
+        if (max_wait.tv_nsec > 999999999) {
+            max_wait.tv_sec++;
+            max_wait.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&pending_sent, &pending_mutex, &max_wait);
+        stream->wait_left -= get_monotonic_ms() - wait_start;
+    }
+    if (pending->bytes > RESPONSE_STREAM_PENDING_MAX) {
+        pthread_mutex_unlock(&pending_mutex);
+        MYMPD_LOG_ERROR("Connection %lld does not read the response for \"%s\", aborting the stream",
+            conn_id, stream->request->method);
+        //the final response aborts the connection
+        stream->aborted = true;
+        stream->started = true;
+        sdsclear(buffer);
+        return buffer;
+    }
+    pending->bytes += len;
+    pthread_mutex_unlock(&pending_mutex);
+    struct t_work_response *response = create_response_new(conn_id,
+        stream->request->id, INTERNAL_API_STREAM_CHUNK);
+    //the buffer is moved to the response
+    FREE_SDS(response->data);
+    response->data = buffer;
+    mympd_queue_push(web_server_queue, response, 0);
+    stream->started = true;
+    stream->sent += len;
+    return sdsempty();
+}
+
+/**
+ * Finishes the stream.
+ * A response that replaces the already sent chunks (an error occurred)
+ * can not be sent, the response is changed to abort the connection.
+ * @param stream pointer to the stream struct
+ * @param response the final response
+ */
+void response_stream_end(struct t_response_stream *stream, struct t_work_response *response) {
+    if (stream->started == false) {
+        return;
+    }
+    pthread_mutex_lock(&pending_mutex);
+    struct t_stream_pending *pending = pending_get(stream->request->conn_id, false);
+    if (pending != NULL) {
+        pending->active = false;
+        pending_release(stream->request->conn_id, pending);
+    }
+    pthread_mutex_unlock(&pending_mutex);
+    if (stream->aborted == true) {
+        response->cmd_id = INTERNAL_API_STREAM_ABORT;
+        return;
+    }
+    if (strncmp(response->data, "{\"jsonrpc\":", 11) == 0) {
+        MYMPD_LOG_ERROR("Error after %lu bytes of the response for \"%s\" were sent, aborting the connection",
+            (unsigned long)stream->sent, stream->request->method);
+        response->cmd_id = INTERNAL_API_STREAM_ABORT;
+        return;
+    }
+    MYMPD_LOG_DEBUG("Streamed %lu bytes of the response for \"%s\"",
+        (unsigned long)(stream->sent + sdslen(response->data)), stream->request->method);
+}
+
+/**
+ * Called from the webserver after chunk data was written to the socket
+ * or the chunk was discarded
+ * @param conn_id connection id
+ * @param len number of bytes
+ */
+void response_stream_chunk_sent(long long conn_id, size_t len) {
+    pthread_mutex_lock(&pending_mutex);
+    struct t_stream_pending *pending = pending_get(conn_id, false);
+    if (pending != NULL) {
+        pending->bytes = len < pending->bytes
+            ? pending->bytes - len
+            : 0;
+        if (pending->bytes <= RESPONSE_STREAM_PENDING_MAX) {
+            pthread_cond_broadcast(&pending_sent);
+        }
+        pending_release(conn_id, pending);
+    }
+    pthread_mutex_unlock(&pending_mutex);
+}
+
+/**
+ * Returns the size of the chunks not yet written to the socket
+ * @param conn_id connection id
+ * @return size in bytes
+ */
+size_t response_stream_pending(long long conn_id) {
+    pthread_mutex_lock(&pending_mutex);
+    struct t_stream_pending *pending = pending_get(conn_id, false);
+    size_t len = pending != NULL
+        ? pending->bytes
+        : 0;
+    pthread_mutex_unlock(&pending_mutex);
+    return len;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Gets the pending bytes of a connection, pending_mutex must be held
+ * @param conn_id connection id
+ * @param create true to create a missing entry
+ * @return pointer to the entry or NULL if not found
+ */
+static struct t_stream_pending *pending_get(long long conn_id, bool create) {
+    if (pending_conns == NULL) {
+        if (create == false) {
+            return NULL;
+        }
+        pending_conns = raxNew();
+    }
+    void *data = raxFind(pending_conns, (unsigned char *)&conn_id, sizeof(conn_id));
+    if (data != raxNotFound) {
+        return (struct t_stream_pending *)data;
+    }
+    if (create == false) {
+        return NULL;
+    }
+    struct t_stream_pending *pending = malloc_assert(sizeof(struct t_stream_pending));
+    pending->bytes = 0;
+    pending->active = false;
+    raxInsert(pending_conns, (unsigned char *)&conn_id, sizeof(conn_id), pending, NULL);
+    return pending;
+}
+
+/**
+ * Removes the entry of a connection if the stream is finished
+ * and all chunks are written, pending_mutex must be held
+ * @param conn_id connection id
+ * @param pending the entry of the connection
+ */
+static void pending_release(long long conn_id, struct t_stream_pending *pending) {
+    if (pending->active == true ||
+        pending->bytes > 0)
+    {
+        return;
+    }
+    raxRemove(pending_conns, (unsigned char *)&conn_id, sizeof(conn_id), NULL);
+    FREE_PTR(pending);
+    if (raxSize(pending_conns) == 0) {
+        raxFree(pending_conns);
+        pending_conns = NULL;
+    }
+}
+
+/**
+ * Gets the monotonic time in milliseconds
+ * @return milliseconds
+ */
+static long long get_monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
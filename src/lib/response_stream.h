@@ -0,0 +1,32 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_RESPONSE_STREAM_H
+#define MYMPD_RESPONSE_STREAM_H
+
+#include "../../dist/sds/sds.h"
+#include "api.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * State of a streamed jsonrpc response
+ */
+struct t_response_stream {
+    struct t_work_request *request; //!< the request, NULL if the response is not streamed
+    bool started;                   //!< true if chunks were already sent
+    bool aborted;                   //!< true if the connection did not read the chunks in time
+    size_t sent;                    //!< bytes sent in chunks
+    long long wait_left;            //!< ms the producer can still wait for the connection
+};
+
+void response_stream_init(struct t_response_stream *stream, struct t_work_request *request);
+sds response_stream_flush(struct t_response_stream *stream, sds buffer);
+void response_stream_end(struct t_response_stream *stream, struct t_work_response *response);
+void response_stream_chunk_sent(long long conn_id, size_t len);
+size_t response_stream_pending(long long conn_id);
+#endif
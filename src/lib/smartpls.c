@@ -7,13 +7,18 @@
 #include "compile_time.h"
 #include "smartpls.h"
 
+#include "../mpd_client/search_local.h"
+#include "../mpd_client/tags.h"
 #include "filehandler.h"
 #include "jsonrpc.h"
 #include "log.h"
+#include "mem.h"
 #include "sds_extras.h"
 #include "state_files.h"
+#include "validate.h"
 
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -22,6 +27,9 @@
 static bool _smartpls_save(sds workdir, const char *smartpltype,
         const char *playlist, const char *expression, int max_entries,
         int timerange, const char *sort);
+static bool smartpls_sticker_value(const struct t_sticker *sticker, const char *name,
+        long long *value, long long *value_default);
+static int smartpls_sticker_value_cmp(const void *a, const void *b);
 
 //public functions
 
@@ -152,8 +160,267 @@ bool smartpls_update_all(void) {
     return mympd_queue_push(mympd_api_queue, request, 0);
 }
 
+/**
+ * Reads the definition of a smart playlist
+ * @param workdir myMPD working directory
+ * @param playlist name of the smart playlist
+ * @return allocated rule or NULL on error
+ */
+struct t_smartpls_rule *smartpls_rule_read(sds workdir, const char *playlist) {
+    sds filename = sdscatfmt(sdsempty(), "%S/smartpls/%s", workdir, playlist);
+    FILE *fp = fopen(filename, OPEN_FLAGS_READ);
+    if (fp == NULL) {
+        MYMPD_LOG_ERROR("Cant open smart playlist file \"%s\"", playlist);
+        FREE_SDS(filename);
+        return NULL;
+    }
+    sds content = sdsempty();
+    sds_getfile(&content, fp, SMARTPLS_SIZE_MAX, true);
+    (void) fclose(fp);
+
+    struct t_smartpls_rule *rule = malloc_assert(sizeof(struct t_smartpls_rule));
+    rule->name = sdsnew(playlist);
+    rule->type = SMARTPLS_TYPE_UNKNOWN;
+    rule->sticker = NULL;
+    rule->maxentries = 0;
+    rule->minvalue = 0;
+    rule->timerange = 0;
+    rule->expression = NULL;
+    rule->expr_list = NULL;
+    rule->sort = NULL;
+    rule->sort_tag = MPD_TAG_UNKNOWN;
+    rule->local = false;
+    rule->since = 0;
+    rule->value_max = 0;
+    list_init(&rule->content);
+
+    sds smartpltype = NULL;
+    bool rc = json_get_string(content, "$.type", 1, 200, &smartpltype, vcb_isalnum, NULL);
+    if (rc == true) {
+        if (strcmp(smartpltype, "sticker") == 0) {
+            rule->type = SMARTPLS_TYPE_STICKER;
+            rc = json_get_string(content, "$.sticker", 1, 200, &rule->sticker, vcb_isalnum, NULL) &&
+                json_get_int(content, "$.maxentries", 0, MPD_PLAYLIST_LENGTH_MAX, &rule->maxentries, NULL) &&
+                json_get_int(content, "$.minvalue", 0, 100, &rule->minvalue, NULL);
+        }
+        else if (strcmp(smartpltype, "newest") == 0) {
+            rule->type = SMARTPLS_TYPE_NEWEST;
+            rc = json_get_int(content, "$.timerange", 0, JSONRPC_INT_MAX, &rule->timerange, NULL);
+        }
+        else if (strcmp(smartpltype, "search") == 0) {
+            rule->type = SMARTPLS_TYPE_SEARCH;
+            rc = json_get_string(content, "$.expression", 1, 200, &rule->expression, vcb_isname, NULL);
+        }
+    }
+    if (json_get_string(content, "$.sort", 0, 100, &rule->sort, vcb_ismpdsort, NULL) == false) {
+        rule->sort = sdsempty();
+    }
+    rule->sort_tag = mpd_tag_name_parse(rule->sort);
+    if (rc == false) {
+        MYMPD_LOG_ERROR("Can't parse smart playlist file \"%s\"", filename);
+        rule = smartpls_rule_free(rule);
+    }
+    FREE_SDS(smartpltype);
+    FREE_SDS(content);
+    FREE_SDS(filename);
+    return rule;
+}
+
+/**
+ * Frees the smart playlist rule
+ * @param rule pointer to the rule
+ * @return NULL
+ */
+void *smartpls_rule_free(struct t_smartpls_rule *rule) {
+    FREE_SDS(rule->name);
+    FREE_SDS(rule->sticker);
+    FREE_SDS(rule->expression);
+    if (rule->expr_list != NULL) {
+        free_search_expression_list(rule->expr_list);
+    }
+    FREE_SDS(rule->sort);
+    list_clear(&rule->content);
+    FREE_PTR(rule);
+    return NULL;
+}
+
+/**
+ * Checks if the rule can be evaluated against the sticker cache and a listing of all songs
+ * and prepares the local evaluation.
+ * Sticker rules are restricted to the stickers of the sticker cache,
+ * search rules to expressions of tags that are included in the song listing.
+ * @param rule pointer to the rule
+ * @param tags tags that are included in the song listing
+ * @return true if the rule can be evaluated locally, else false
+ */
+bool smartpls_rule_set_local(struct t_smartpls_rule *rule, const struct t_tags *tags) {
+    rule->local = false;
+    if (rule->sort_tag != MPD_TAG_UNKNOWN &&
+        mpd_client_tag_exists(tags, rule->sort_tag) == false)
+    {
+        return false;
+    }
+    switch(rule->type) {
+        case SMARTPLS_TYPE_STICKER: {
+            long long value;
+            long long value_default;
+            struct t_sticker sticker = { 0, 0, 0, 0, 1 };
+            rule->local = smartpls_sticker_value(&sticker, rule->sticker, &value, &value_default);
+            break;
+        }
+        case SMARTPLS_TYPE_NEWEST:
+            rule->local = true;
+            break;
+        case SMARTPLS_TYPE_SEARCH:
+            rule->expr_list = parse_search_expression_to_list(rule->expression);
+            rule->local = search_expression_is_local(rule->expr_list, rule->expression) &&
+                search_expression_is_local_db(rule->expr_list) &&
+                search_expression_tags_exist(rule->expr_list, tags);
+            break;
+        default:
+            break;
+    }
+    return rule->local;
+}
+
+/**
+ * Evaluates a sticker rule for a song of the sticker cache.
+ * Songs with the default value of the sticker have no sticker set.
+ * @param rule pointer to the rule
+ * @param uri song uri
+ * @param sticker sticker values of the song
+ */
+void smartpls_rule_eval_sticker(struct t_smartpls_rule *rule, const char *uri, const struct t_sticker *sticker) {
+    long long value;
+    long long value_default;
+    if (smartpls_sticker_value(sticker, rule->sticker, &value, &value_default) == true &&
+        value != value_default &&
+        value >= rule->minvalue)
+    {
+        list_push(&rule->content, uri, value, NULL, NULL);
+        if (value > rule->value_max) {
+            rule->value_max = value;
+        }
+    }
+}
+
+/**
+ * Limits the songs of a sticker rule after all songs are evaluated.
+ * A minimum value of zero is replaced by the half of the maximum value.
+ * The songs are ordered by sticker value and uri and cut to maxentries.
+ * @param rule pointer to the rule
+ */
+void smartpls_rule_eval_sticker_finish(struct t_smartpls_rule *rule) {
+    const long long value_min = rule->minvalue > 0 ? rule->minvalue :
+        rule->value_max > 2 ? rule->value_max / 2 : rule->value_max;
+
+    struct t_list_node **nodes = malloc_assert((size_t)(rule->content.length + 1) * sizeof(struct t_list_node *));
+    long count = 0;
+    struct t_list_node *current;
+    while ((current = list_shift_first(&rule->content)) != NULL) {
+        if (current->value_i >= value_min) {
+            nodes[count++] = current;
+        }
+        else {
+            list_node_free(current);
+        }
+    }
+    qsort(nodes, (size_t)count, sizeof(struct t_list_node *), smartpls_sticker_value_cmp);
+    for (long i = 0; i < count; i++) {
+        if (i < rule->maxentries) {
+            list_push(&rule->content, nodes[i]->key, nodes[i]->value_i, NULL, NULL);
+        }
+        list_node_free(nodes[i]);
+    }
+    FREE_PTR(nodes);
+    MYMPD_LOG_DEBUG("Sticker \"%s\": %ld songs, minimum value: %lld", rule->sticker, rule->content.length, value_min);
+}
+
+/**
+ * Evaluates a newest or search rule for a song
+ * @param rule pointer to the rule
+ * @param song pointer to the mpd song struct
+ * @param any_tags tags for the special "any" tag in search expressions
+ */
+void smartpls_rule_eval_song(struct t_smartpls_rule *rule, struct mpd_song *song, struct t_tags *any_tags) {
+    const char *uri = mpd_song_get_uri(song);
+    struct t_list_node *node = NULL;
+    switch(rule->type) {
+        case SMARTPLS_TYPE_NEWEST:
+            if (mpd_song_get_last_modified(song) < rule->since) {
+                return;
+            }
+            list_push(&rule->content, uri, 0, NULL, NULL);
+            node = rule->content.tail;
+            break;
+        case SMARTPLS_TYPE_SEARCH:
+            if (search_song_expression(song, rule->expr_list, any_tags) == false) {
+                return;
+            }
+            list_push(&rule->content, uri, 0, NULL, NULL);
+            node = rule->content.tail;
+            break;
+        default:
+            return;
+    }
+    if (rule->sort_tag != MPD_TAG_UNKNOWN) {
+        sds value = mpd_client_get_tag_value_string(song, rule->sort_tag, sdsempty());
+        FREE_SDS(node->value_p);
+        node->value_p = value;
+    }
+}
+
 //privat functions
 
+/**
+ * Gets the value of a sticker from the sticker cache struct
+ * @param sticker pointer to the sticker values of a song
+ * @param name sticker name
+ * @param value pointer to set the value
+ * @param value_default pointer to set the value of songs without this sticker
+ * @return true if the sticker is cached, else false
+ */
+static bool smartpls_sticker_value(const struct t_sticker *sticker, const char *name,
+        long long *value, long long *value_default)
+{
+    *value_default = 0;
+    if (strcmp(name, "playCount") == 0) {
+        *value = sticker->play_count;
+    }
+    else if (strcmp(name, "skipCount") == 0) {
+        *value = sticker->skip_count;
+    }
+    else if (strcmp(name, "lastPlayed") == 0) {
+        *value = (long long)sticker->last_played;
+    }
+    else if (strcmp(name, "lastSkipped") == 0) {
+        *value = (long long)sticker->last_skipped;
+    }
+    else if (strcmp(name, "like") == 0) {
+        *value = sticker->like;
+        *value_default = 1;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Compares list nodes by sticker value and uri, used by qsort
+ * @param a pointer to the first list node pointer
+ * @param b pointer to the second list node pointer
+ * @return less than, equal to, or greater than zero
+ */
+static int smartpls_sticker_value_cmp(const void *a, const void *b) {
+    const struct t_list_node *node_a = *(struct t_list_node * const *)a;
+    const struct t_list_node *node_b = *(struct t_list_node * const *)b;
+    if (node_a->value_i != node_b->value_i) {
+        return node_a->value_i < node_b->value_i ? -1 : 1;
+    }
+    return strcmp(node_a->key, node_b->key);
+}
+
 /**
  * Saves the smart playlist to disk.
  * @param workdir myMPD working directory
@@ -7,10 +7,44 @@
 #ifndef MYMPD_SMARTPLS_H
 #define MYMPD_SMARTPLS_H
 
+#include "../../dist/libmpdclient/include/mpd/client.h"
 #include "../../dist/sds/sds.h"
+#include "list.h"
+#include "mympd_state.h"
+#include "sticker_cache.h"
 
 #include <stdbool.h>
 
+/**
+ * Smart playlist types
+ */
+enum smartpls_types {
+    SMARTPLS_TYPE_UNKNOWN = -1,
+    SMARTPLS_TYPE_STICKER,
+    SMARTPLS_TYPE_NEWEST,
+    SMARTPLS_TYPE_SEARCH
+};
+
+/**
+ * Definition of a smart playlist and its evaluated content
+ */
+struct t_smartpls_rule {
+    sds name;                    //!< name of the smart playlist
+    enum smartpls_types type;    //!< type of the smart playlist
+    sds sticker;                 //!< sticker name (sticker)
+    int maxentries;              //!< maximum number of entries (sticker)
+    int minvalue;                //!< minimum sticker value, 0 = autodetect (sticker)
+    int timerange;               //!< timerange in seconds before the database update (newest)
+    sds expression;              //!< mpd search expression (search)
+    struct t_list *expr_list;    //!< parsed search expression for the local evaluation (search)
+    sds sort;                    //!< empty, shuffle, filename or mpd tag
+    enum mpd_tag_type sort_tag;  //!< tag to sort by or MPD_TAG_UNKNOWN
+    bool local;                  //!< true if the rule can be evaluated without mpd
+    time_t since;                //!< minimum last-modified time of songs (newest)
+    long long value_max;         //!< maximum sticker value found (sticker)
+    struct t_list content;       //!< songs, key: uri, value_i: sticker value, value_p: value of the sort tag
+};
+
 bool smartpls_save_sticker(sds workdir, const char *playlist, const char *sticker,
     int max_entries, int min_value, const char *sort);
 bool smartpls_save_newest(sds workdir, const char *playlist, int timerange, const char *sort);
@@ -22,4 +56,11 @@ bool smartpls_default(sds workdir);
 
 bool is_smartpls(sds workdir, const char *playlist);
 time_t smartpls_get_mtime(sds workdir, const char *playlist);
+
+struct t_smartpls_rule *smartpls_rule_read(sds workdir, const char *playlist);
+void *smartpls_rule_free(struct t_smartpls_rule *rule);
+bool smartpls_rule_set_local(struct t_smartpls_rule *rule, const struct t_tags *tags);
+void smartpls_rule_eval_sticker(struct t_smartpls_rule *rule, const char *uri, const struct t_sticker *sticker);
+void smartpls_rule_eval_sticker_finish(struct t_smartpls_rule *rule);
+void smartpls_rule_eval_song(struct t_smartpls_rule *rule, struct mpd_song *song, struct t_tags *any_tags);
 #endif
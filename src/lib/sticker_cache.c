@@ -11,15 +11,17 @@
 #include "log.h"
 #include "mem.h"
 #include "sds_extras.h"
+#include "sticker_journal.h"
 #include "utility.h"
 
 #include <string.h>
 
 //privat definitions
-static bool _sticker_inc(struct t_cache *sticker_cache, struct t_partition_state *partition_state, 
-        const char *uri, const char *name, long value);
-static bool _sticker_set(struct t_cache *sticker_cache, struct t_partition_state *partition_state,
+static bool sticker_queue_push(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal,
         const char *uri, const char *name, long long value);
+static bool sticker_cache_apply(struct t_cache *sticker_cache, const char *uri, const char *name, long long *value, bool absolute);
+static void sticker_writes_apply(struct t_list *sticker_writes, struct t_cache *sticker_cache);
+static bool sticker_write_batch(struct t_partition_state *partition_state, struct t_list *writes);
 
 //public functions
 
@@ -70,79 +72,126 @@ void sticker_cache_free(struct t_cache *sticker_cache) {
 /**
  * Increments the play count sticker by one
  * @param sticker_queue pointer to sticker queue
+ * @param sticker_journal pointer to sticker journal, NULL to disable journaling
  * @param uri song uri
  * @return true on success else false
  */
-bool sticker_inc_play_count(struct t_list *sticker_queue, const char *uri) {
+bool sticker_inc_play_count(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal, const char *uri) {
     if (is_streamuri(uri) == true) {
         return true;
     }
-    return list_push(sticker_queue, uri, 1, "playCount", NULL);
+    return sticker_queue_push(sticker_queue, sticker_journal, uri, "playCount", 1);
 }
 
 /**
  * Increments the skip count sticker by one
  * @param sticker_queue pointer to sticker queue
+ * @param sticker_journal pointer to sticker journal, NULL to disable journaling
  * @param uri song uri
  * @return true on success else false
  */
-bool sticker_inc_skip_count(struct t_list *sticker_queue, const char *uri) {
+bool sticker_inc_skip_count(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal, const char *uri) {
     if (is_streamuri(uri) == true) {
         return true;
     }
-    return list_push(sticker_queue, uri, 1, "skipCount", NULL);
+    return sticker_queue_push(sticker_queue, sticker_journal, uri, "skipCount", 1);
 }
 
 /**
  * Sets the like sticker value
  * @param sticker_queue pointer to sticker queue
+ * @param sticker_journal pointer to sticker journal, NULL to disable journaling
  * @param uri song uri
  * @param value 0 = hate, 1 = neutral, 2 = like
  * @return true on success else false
  */
-bool sticker_set_like(struct t_list *sticker_queue, const char *uri, int value) {
+bool sticker_set_like(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal, const char *uri, int value) {
     if (is_streamuri(uri) == true) {
         return true;
     }
-    return list_push(sticker_queue, uri, value, "like", NULL);
+    return sticker_queue_push(sticker_queue, sticker_journal, uri, "like", value);
 }
 
 /**
  * Sets the last played time sticker
  * @param sticker_queue pointer to sticker queue
+ * @param sticker_journal pointer to sticker journal, NULL to disable journaling
  * @param uri song uri
  * @param song_start_time start time of song
  * @return true on success else false
  */
-bool sticker_set_last_played(struct t_list *sticker_queue, const char *uri, time_t song_start_time) {
+bool sticker_set_last_played(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal, const char *uri, time_t song_start_time) {
     if (is_streamuri(uri) == true) {
         return true;
     }
-    return list_push(sticker_queue, uri, (long long)song_start_time, "lastPlayed", NULL);
+    return sticker_queue_push(sticker_queue, sticker_journal, uri, "lastPlayed", (long long)song_start_time);
 }
 
 /**
  * Sets the last skipped time sticker
  * @param sticker_queue pointer to sticker queue
+ * @param sticker_journal pointer to sticker journal, NULL to disable journaling
  * @param uri song uri
  * @return true on success else false
  */
-bool sticker_set_last_skipped(struct t_list *sticker_queue, const char *uri) {
+bool sticker_set_last_skipped(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal, const char *uri) {
     if (is_streamuri(uri) == true) {
         return true;
     }
     time_t now = time(NULL);
-    return list_push(sticker_queue, uri, (long long)now, "lastSkipped", NULL);
+    return sticker_queue_push(sticker_queue, sticker_journal, uri, "lastSkipped", (long long)now);
 }
 
 /**
- * Shifts through the sticker queue
+ * Shifts through the sticker queue, applies the values to the sticker cache
+ * and coalesces them per uri and sticker name.
+ * Increments are resolved to the resulting absolute value, the last value wins.
  * @param sticker_queue pointer to sticker queue struct
  * @param sticker_cache pointer to sticker cache struct
+ * @param writes already initialized list to append the sticker values to write,
+ *               key: uri, value_i: sticker value, value_p: sticker name
+ */
+void sticker_queue_coalesce(struct t_list *sticker_queue, struct t_cache *sticker_cache, struct t_list *writes) {
+    rax *index = raxNew();
+    sds key = sdsempty();
+    struct t_list_node *current;
+    while ((current = list_shift_first(sticker_queue)) != NULL) {
+        MYMPD_LOG_DEBUG("Setting %s = %lld for \"%s\"", current->value_p, current->value_i, current->key);
+        long long value = current->value_i;
+        if (sticker_cache_apply(sticker_cache, current->key, current->value_p, &value, false) == true) {
+            sdsclear(key);
+            key = sdscatfmt(key, "%s::%s", current->value_p, current->key);
+            void *data = raxFind(index, (unsigned char *)key, sdslen(key));
+            if (data == raxNotFound) {
+                list_push(writes, current->key, value, current->value_p, NULL);
+                raxInsert(index, (unsigned char *)key, sdslen(key), writes->tail, NULL);
+            }
+            else {
+                ((struct t_list_node *)data)->value_i = value;
+            }
+        }
+        list_node_free(current);
+    }
+    FREE_SDS(key);
+    raxFree(index);
+}
+
+/**
+ * Processes the sticker queue.
+ * The queue is coalesced to the list of resolved sticker values.
+ * This list is journaled and written to mpd after the journal is synced,
+ * the values are written with command lists of STICKER_QUEUE_BATCH_MAX commands.
+ * @param sticker_queue pointer to sticker queue struct
+ * @param sticker_writes pointer to the list of resolved sticker values
+ * @param sticker_cache pointer to sticker cache struct
+ * @param sticker_journal pointer to sticker journal, NULL to disable journaling
  * @param partition_state pointer to partition specific states
- * @return true on success else false
+ * @return true if all sticker values are written or rejected by mpd,
+ *         false if delayed or on connection error
  */
-bool sticker_dequeue(struct t_list *sticker_queue, struct t_cache *sticker_cache, struct t_partition_state *partition_state) {
+bool sticker_dequeue(struct t_list *sticker_queue, struct t_list *sticker_writes, struct t_cache *sticker_cache,
+        struct t_sticker_journal *sticker_journal, struct t_partition_state *partition_state)
+{
     if (sticker_cache->cache == NULL ||
         sticker_cache->building == true)
     {
@@ -151,22 +200,32 @@ bool sticker_dequeue(struct t_list *sticker_queue, struct t_cache *sticker_cache
         MYMPD_LOG_INFO("Delay setting stickers, sticker_cache is building");
         return false;
     }
-
-    struct t_list_node *current;
-    while ((current = list_shift_first(sticker_queue)) != NULL) {
-        MYMPD_LOG_DEBUG("Setting %s = %lld for \"%s\"", current->value_p, current->value_i, current->key);
-        if (strcmp(current->value_p, "playCount") == 0 ||
-            strcmp(current->value_p, "skipCount") == 0)
-        {
-            _sticker_inc(sticker_cache, partition_state, current->key, current->value_p, (long)current->value_i);
+    if (sticker_writes->length == 0) {
+        sticker_queue_coalesce(sticker_queue, sticker_cache, sticker_writes);
+        if (sticker_journal != NULL) {
+            //journal the absolute values, replaying them is idempotent
+            sticker_journal_rewrite(sticker_journal, sticker_writes, NULL);
         }
-        else if (strcmp(current->value_p, "like") == 0 ||
-                 strcmp(current->value_p, "lastPlayed") == 0 ||
-                 strcmp(current->value_p, "lastSkipped") == 0)
-        {
-            _sticker_set(sticker_cache, partition_state, current->key, current->value_p, current->value_i);
+    }
+    else {
+        //values from the journal or a rebuilt sticker cache
+        sticker_writes_apply(sticker_writes, sticker_cache);
+    }
+    if (sticker_journal != NULL &&
+        sticker_journal_synced(sticker_journal) == false)
+    {
+        MYMPD_LOG_DEBUG("Delay setting stickers, journal is not synced");
+        return false;
+    }
+    MYMPD_LOG_INFO("Writing %ld stickers", sticker_writes->length);
+    while (sticker_writes->length > 0) {
+        if (sticker_write_batch(partition_state, sticker_writes) == false) {
+            return false;
         }
-        list_node_free(current);
+    }
+    if (sticker_journal != NULL) {
+        //keep only the updates that were queued in the meantime
+        sticker_journal_rewrite(sticker_journal, NULL, sticker_queue);
     }
     return true;
 }
@@ -174,89 +233,134 @@ bool sticker_dequeue(struct t_list *sticker_queue, struct t_cache *sticker_cache
 //private functions
 
 /**
- * Increments a sticker by one in the cache and the mpd sticker database
- * @param sticker_cache pointer to sticker cache struct
- * @param partition_state pointer to partition specific states
+ * Appends a sticker update to the journal and the sticker queue
+ * @param sticker_queue pointer to sticker queue
+ * @param sticker_journal pointer to sticker journal, NULL to disable journaling
  * @param uri song uri
  * @param name sticker name
- * @param value value to increment by
+ * @param value sticker value or increment
  * @return true on success else false
  */
-static bool _sticker_inc(struct t_cache *sticker_cache, struct t_partition_state *partition_state,
-        const char *uri, const char *name, long value)
+static bool sticker_queue_push(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal,
+        const char *uri, const char *name, long long value)
 {
-    struct t_sticker *sticker = get_sticker_from_cache(sticker_cache, uri);
-    if (sticker == NULL) {
-        return false;
-    }
-    //update sticker cache
-    long new_value = 0;
-    if (strcmp(name, "playCount") == 0) {
-        if (sticker->play_count + value > STICKER_PLAY_COUNT_MAX) {
-            sticker->play_count = STICKER_PLAY_COUNT_MAX;
-        }
-        else {
-            sticker->play_count += value;
-        }
-        new_value = sticker->play_count;
-    }
-    else if (strcmp(name, "skipCount") == 0) {
-        if (sticker->skip_count + value > STICKER_SKIP_COUNT_MAX) {
-            sticker->skip_count = STICKER_SKIP_COUNT_MAX;
-        }
-        else {
-            sticker->skip_count += value;
-        }
-        new_value = sticker->skip_count;
+    if (sticker_journal != NULL) {
+        //errors are logged, the update is still queued
+        sticker_journal_append(sticker_journal, uri, name, value);
     }
-    else {
-        MYMPD_LOG_ERROR("Invalid sticker name \"%s\"", name);
-        return false;
-    }
-
-    //update mpd sticker
-    sds value_str = sdsfromlonglong((long long)new_value);
-    MYMPD_LOG_INFO("Setting sticker: \"%s\" -> %s: %s", uri, name, value_str);
-    bool rc = mpd_run_sticker_set(partition_state->conn, "song", uri, name, value_str);
-    FREE_SDS(value_str);
-    return mympd_check_rc_error_and_recover(partition_state, rc, "mpd_run_sticker_set");
+    return list_push(sticker_queue, uri, value, name, NULL);
 }
 
 /**
- * Sets a sticker in the cache and the mpd sticker database
+ * Applies a sticker value to the sticker cache
  * @param sticker_cache pointer to sticker cache struct
- * @param partition_state pointer to partition specific states
  * @param uri song uri
  * @param name sticker name
- * @param value value to set
+ * @param value pointer to the value, increments are replaced by the resulting value
+ * @param absolute true if the value of the count stickers is absolute, else it is an increment
  * @return true on success else false
  */
-static bool _sticker_set(struct t_cache *sticker_cache, struct t_partition_state *partition_state,
-        const char *uri, const char *name, long long value)
-{
-    sds value_str = sdsfromlonglong(value);
-    MYMPD_LOG_INFO("Setting sticker: \"%s\" -> %s: %s", uri, name, value_str);
-    //update sticker cache
+static bool sticker_cache_apply(struct t_cache *sticker_cache, const char *uri, const char *name, long long *value, bool absolute) {
     struct t_sticker *sticker = get_sticker_from_cache(sticker_cache, uri);
     if (sticker == NULL) {
         return false;
     }
-    if (strcmp(name, "like") == 0) {
-        sticker->like = (long)value;
+    if (strcmp(name, "playCount") == 0) {
+        long long count = absolute == true ? *value : sticker->play_count + *value;
+        sticker->play_count = count > STICKER_PLAY_COUNT_MAX ? STICKER_PLAY_COUNT_MAX : (long)count;
+        *value = sticker->play_count;
+    }
+    else if (strcmp(name, "skipCount") == 0) {
+        long long count = absolute == true ? *value : sticker->skip_count + *value;
+        sticker->skip_count = count > STICKER_SKIP_COUNT_MAX ? STICKER_SKIP_COUNT_MAX : (long)count;
+        *value = sticker->skip_count;
+    }
+    else if (strcmp(name, "like") == 0) {
+        sticker->like = (long)*value;
     }
     else if (strcmp(name, "lastPlayed") == 0) {
-        sticker->last_played = (time_t)value;
+        sticker->last_played = (time_t)*value;
     }
     else if (strcmp(name, "lastSkipped") == 0) {
-        sticker->last_skipped = (time_t)value;
+        sticker->last_skipped = (time_t)*value;
     }
     else {
         MYMPD_LOG_ERROR("Invalid sticker name \"%s\"", name);
         return false;
     }
+    return true;
+}
 
-    //update mpd sticker
-    bool rc = mpd_run_sticker_set(partition_state->conn, "song", uri, name, value_str);
-    FREE_SDS(value_str);
-    return mympd_check_rc_error_and_recover(partition_state, rc, "mpd_run_sticker_set");
+/**
+ * Applies the resolved sticker values to the sticker cache,
+ * values for songs that are not in the cache are removed
+ * @param sticker_writes pointer to the list of resolved sticker values
+ * @param sticker_cache pointer to sticker cache struct
+ */
+static void sticker_writes_apply(struct t_list *sticker_writes, struct t_cache *sticker_cache) {
+    long idx = 0;
+    struct t_list_node *current = sticker_writes->head;
+    while (current != NULL) {
+        struct t_list_node *next = current->next;
+        if (sticker_cache_apply(sticker_cache, current->key, current->value_p, &current->value_i, true) == false) {
+            list_remove_node(sticker_writes, idx);
+        }
+        else {
+            idx++;
+        }
+        current = next;
+    }
+}
+
+/**
+ * Writes the first STICKER_QUEUE_BATCH_MAX sticker values with one command list
+ * and removes them from the list.
+ * If mpd rejects a command, all values up to the rejected command are removed,
+ * the remaining values are written by the next call.
+ * @param partition_state pointer to partition specific states
+ * @param writes list of sticker values
+ * @return true on success, false on connection error
+ */
+static bool sticker_write_batch(struct t_partition_state *partition_state, struct t_list *writes) {
+    long count = 0;
+    if (mpd_command_list_begin(partition_state->conn, false)) {
+        struct t_list_node *current = writes->head;
+        while (current != NULL &&
+            count < STICKER_QUEUE_BATCH_MAX)
+        {
+            sds value_str = sdsfromlonglong(current->value_i);
+            MYMPD_LOG_DEBUG("Setting sticker: \"%s\" -> %s: %s", current->key, current->value_p, value_str);
+            bool rc = mpd_send_sticker_set(partition_state->conn, "song", current->key, current->value_p, value_str);
+            FREE_SDS(value_str);
+            if (rc == false) {
+                MYMPD_LOG_ERROR("Error adding command to command list mpd_send_sticker_set");
+                break;
+            }
+            count++;
+            current = current->next;
+        }
+        if (mpd_command_list_end(partition_state->conn)) {
+            mpd_response_finish(partition_state->conn);
+        }
+    }
+    long done = count;
+    if (mpd_connection_get_error(partition_state->conn) == MPD_ERROR_SERVER) {
+        //mpd stops at the rejected command, skip it and send the remaining ones again
+        done = (long)mpd_connection_get_server_error_location(partition_state->conn) + 1;
+        if (done > count) {
+            done = count;
+        }
+    }
+    mympd_check_error_and_recover(partition_state);
+    if (count == 0 ||
+        partition_state->conn_state != MPD_CONNECTED)
+    {
+        //connection error, the sticker values are written after reconnect
+        return false;
+    }
+    while (done > 0) {
+        list_remove_node(writes, 0);
+        done--;
+    }
+    return true;
 }
@@ -27,12 +27,14 @@ struct t_sticker {
 struct t_sticker *get_sticker_from_cache(struct t_cache *sticker_cache, const char *uri);
 void sticker_cache_free(struct t_cache *sticker_cache);
 
-bool sticker_inc_play_count(struct t_list *sticker_queue, const char *uri);
-bool sticker_inc_skip_count(struct t_list *sticker_queue, const char *uri);
-bool sticker_set_like(struct t_list *sticker_queue, const char *uri, int value);
-bool sticker_set_last_played(struct t_list *sticker_queue, const char *uri, time_t song_start_time);
-bool sticker_set_last_skipped(struct t_list *sticker_queue, const char *uri);
-
-bool sticker_dequeue(struct t_list *sticker_queue, struct t_cache *sticker_cache, struct t_partition_state *partition_state);
+bool sticker_inc_play_count(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal, const char *uri);
+bool sticker_inc_skip_count(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal, const char *uri);
+bool sticker_set_like(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal, const char *uri, int value);
+bool sticker_set_last_played(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal, const char *uri, time_t song_start_time);
+bool sticker_set_last_skipped(struct t_list *sticker_queue, struct t_sticker_journal *sticker_journal, const char *uri);
+
+void sticker_queue_coalesce(struct t_list *sticker_queue, struct t_cache *sticker_cache, struct t_list *writes);
+bool sticker_dequeue(struct t_list *sticker_queue, struct t_list *sticker_writes, struct t_cache *sticker_cache,
+        struct t_sticker_journal *sticker_journal, struct t_partition_state *partition_state);
 
 #endif
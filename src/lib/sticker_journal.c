@@ -0,0 +1,429 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "sticker_journal.h"
+
+#include "filehandler.h"
+#include "log.h"
+#include "mem.h"
+#include "sds_extras.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+/**
+ * The journal holds one line for each sticker update:
+ * <type><value>::<sticker name>::<uri>
+ * Type "+" is a queued update, the value of the count stickers is an increment.
+ * Type "=" is a resolved absolute value, that is written to mpd.
+ * Resolved values are journaled before they are written to mpd,
+ * therefore replaying them after a crash is idempotent.
+ *
+ * All file operations are done by a writer thread.
+ * Entries are appended and synced to disc in groups,
+ * all entries that arrive while the thread syncs are committed together.
+ */
+
+/**
+ * Private definitions
+ */
+
+static void *sticker_journal_run(void *arg);
+static bool journal_replace(struct t_sticker_journal *journal, sds content);
+static bool journal_write(struct t_sticker_journal *journal, sds lines);
+static sds journal_lines(sds buffer, struct t_list *list, char type);
+static bool parse_journal_line(const char *line, char *type, long long *value, sds *name, sds *uri);
+static bool is_sticker_name(const char *name);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes the sticker journal struct
+ * @param journal pointer to the sticker journal
+ */
+void sticker_journal_init(struct t_sticker_journal *journal) {
+    journal->filepath = NULL;
+    journal->fp = NULL;
+    journal->running = false;
+    journal->stop = false;
+    journal->pending = NULL;
+    journal->rewrite = NULL;
+    journal->rewrite_requested = 0;
+    journal->rewrite_synced = 0;
+}
+
+/**
+ * Replays the sticker journal and starts the writer thread
+ * @param journal pointer to the sticker journal
+ * @param sticker_queue pointer to the sticker queue for queued updates
+ * @param sticker_writes pointer to the list for resolved sticker values
+ * @param workdir working directory
+ * @return number of replayed entries or -1 on error
+ */
+long sticker_journal_open(struct t_sticker_journal *journal, struct t_list *sticker_queue,
+        struct t_list *sticker_writes, sds workdir)
+{
+    sds filepath = sdscatfmt(sdsempty(), "%S/state/sticker_journal", workdir);
+    long replayed = 0;
+    errno = 0;
+    FILE *fp = fopen(filepath, OPEN_FLAGS_READ);
+    if (fp != NULL) {
+        char *line = NULL;
+        size_t line_size = 0;
+        ssize_t read;
+        off_t complete_len = 0;
+        bool torn = false;
+        sds name = sdsempty();
+        sds uri = sdsempty();
+        char type;
+        long long value;
+        while ((read = getline(&line, &line_size, fp)) != -1) {
+            //only complete lines are replayed, the last line is torn after a crash
+            if (line[read - 1] != '\n') {
+                MYMPD_LOG_WARN("Skipping incomplete sticker journal line");
+                torn = true;
+                break;
+            }
+            complete_len += read;
+            line[read - 1] = '\0';
+            if (parse_journal_line(line, &type, &value, &name, &uri) == true) {
+                list_push(type == '=' ? sticker_writes : sticker_queue, uri, value, name, NULL);
+                replayed++;
+            }
+            else {
+                MYMPD_LOG_WARN("Skipping invalid sticker journal line");
+                MYMPD_LOG_DEBUG("Errorneous line: %s", line);
+            }
+        }
+        (void) fclose(fp);
+        FREE_PTR(line);
+        FREE_SDS(name);
+        FREE_SDS(uri);
+        //new entries must not be appended to the torn line
+        if (torn == true &&
+            truncate(filepath, complete_len) != 0)
+        {
+            MYMPD_LOG_ERROR("Can not truncate file \"%s\"", filepath);
+            MYMPD_LOG_ERRNO(errno);
+        }
+        if (replayed > 0) {
+            MYMPD_LOG_NOTICE("Replayed %ld sticker updates from journal", replayed);
+        }
+    }
+    else if (errno != ENOENT) {
+        MYMPD_LOG_ERROR("Can not open file \"%s\"", filepath);
+        MYMPD_LOG_ERRNO(errno);
+    }
+    errno = 0;
+    journal->fp = fopen(filepath, OPEN_FLAGS_APPEND);
+    if (journal->fp == NULL) {
+        MYMPD_LOG_ERROR("Can not open file \"%s\" for appending", filepath);
+        MYMPD_LOG_ERRNO(errno);
+        FREE_SDS(filepath);
+        return -1;
+    }
+    journal->filepath = filepath;
+    journal->stop = false;
+    journal->pending = sdsempty();
+    journal->rewrite = NULL;
+    journal->rewrite_requested = 0;
+    journal->rewrite_synced = 0;
+    pthread_mutex_init(&journal->mutex, NULL);
+    pthread_cond_init(&journal->wakeup, NULL);
+    if (pthread_create(&journal->thread, NULL, sticker_journal_run, journal) != 0) {
+        MYMPD_LOG_ERROR("Can not create sticker journal thread");
+        sticker_journal_close(journal);
+        return -1;
+    }
+    journal->running = true;
+    return replayed;
+}
+
+/**
+ * Appends a queued sticker update to the journal.
+ * The entry is written and synced to disc by the writer thread.
+ * @param journal pointer to the sticker journal
+ * @param uri song uri
+ * @param name sticker name
+ * @param value sticker value
+ * @return true on success else false
+ */
+bool sticker_journal_append(struct t_sticker_journal *journal, const char *uri, const char *name, long long value) {
+    if (journal->running == false) {
+        return false;
+    }
+    if (strchr(uri, '\n') != NULL) {
+        MYMPD_LOG_WARN("Not journaling sticker for uri with newline");
+        return false;
+    }
+    pthread_mutex_lock(&journal->mutex);
+    journal->pending = sdscatfmt(journal->pending, "+%I::%s::%s\n", value, name, uri);
+    pthread_cond_signal(&journal->wakeup);
+    pthread_mutex_unlock(&journal->mutex);
+    return true;
+}
+
+/**
+ * Replaces the content of the journal.
+ * The new content supersedes all entries appended before,
+ * use sticker_journal_synced to check if it is synced to disc.
+ * @param journal pointer to the sticker journal
+ * @param sticker_writes resolved sticker values, journaled as absolute values, or NULL
+ * @param sticker_queue queued sticker updates or NULL
+ */
+void sticker_journal_rewrite(struct t_sticker_journal *journal, struct t_list *sticker_writes, struct t_list *sticker_queue) {
+    if (journal->running == false) {
+        return;
+    }
+    sds content = sdsempty();
+    if (sticker_writes != NULL) {
+        content = journal_lines(content, sticker_writes, '=');
+    }
+    if (sticker_queue != NULL) {
+        content = journal_lines(content, sticker_queue, '+');
+    }
+    pthread_mutex_lock(&journal->mutex);
+    sdsclear(journal->pending);
+    FREE_SDS(journal->rewrite);
+    journal->rewrite = content;
+    journal->rewrite_requested++;
+    pthread_cond_signal(&journal->wakeup);
+    pthread_mutex_unlock(&journal->mutex);
+}
+
+/**
+ * Checks if the last requested rewrite is synced to disc
+ * @param journal pointer to the sticker journal
+ * @return true if synced or the journal is not opened, else false
+ */
+bool sticker_journal_synced(struct t_sticker_journal *journal) {
+    if (journal->running == false) {
+        return true;
+    }
+    pthread_mutex_lock(&journal->mutex);
+    bool synced = journal->rewrite_synced == journal->rewrite_requested;
+    pthread_mutex_unlock(&journal->mutex);
+    return synced;
+}
+
+/**
+ * Stops the writer thread after it has synced all entries and closes the journal
+ * @param journal pointer to the sticker journal
+ */
+void sticker_journal_close(struct t_sticker_journal *journal) {
+    if (journal->filepath == NULL) {
+        return;
+    }
+    if (journal->running == true) {
+        pthread_mutex_lock(&journal->mutex);
+        journal->stop = true;
+        pthread_cond_signal(&journal->wakeup);
+        pthread_mutex_unlock(&journal->mutex);
+        pthread_join(journal->thread, NULL);
+        journal->running = false;
+    }
+    pthread_mutex_destroy(&journal->mutex);
+    pthread_cond_destroy(&journal->wakeup);
+    if (journal->fp != NULL) {
+        (void) fclose(journal->fp);
+        journal->fp = NULL;
+    }
+    FREE_SDS(journal->pending);
+    FREE_SDS(journal->rewrite);
+    FREE_SDS(journal->filepath);
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Main function of the sticker journal writer thread
+ * @param arg pointer to the sticker journal
+ * @return NULL
+ */
+static void *sticker_journal_run(void *arg) {
+    struct t_sticker_journal *journal = (struct t_sticker_journal *)arg;
+    thread_logname = sds_replace(thread_logname, "stickerjournal");
+    prctl(PR_SET_NAME, thread_logname, 0, 0, 0);
+    while (true) {
+        pthread_mutex_lock(&journal->mutex);
+        while (sdslen(journal->pending) == 0 &&
+            journal->rewrite == NULL &&
+            journal->stop == false)
+        {
+            pthread_cond_wait(&journal->wakeup, &journal->mutex);
+        }
+        if (sdslen(journal->pending) == 0 &&
+            journal->rewrite == NULL)
+        {
+            //stop requested and all entries are synced
+            pthread_mutex_unlock(&journal->mutex);
+            break;
+        }
+        sds content = journal->rewrite;
+        journal->rewrite = NULL;
+        unsigned long generation = journal->rewrite_requested;
+        sds lines = journal->pending;
+        journal->pending = sdsempty();
+        pthread_mutex_unlock(&journal->mutex);
+
+        if (content != NULL) {
+            journal_replace(journal, content);
+            FREE_SDS(content);
+        }
+        if (sdslen(lines) > 0) {
+            journal_write(journal, lines);
+        }
+        FREE_SDS(lines);
+
+        pthread_mutex_lock(&journal->mutex);
+        journal->rewrite_synced = generation;
+        pthread_mutex_unlock(&journal->mutex);
+    }
+    FREE_SDS(thread_logname);
+    return NULL;
+}
+
+/**
+ * Atomically replaces the journal file and reopens it for appending
+ * @param journal pointer to the sticker journal
+ * @param content new content
+ * @return true on success else false
+ */
+static bool journal_replace(struct t_sticker_journal *journal, sds content) {
+    sds tmp_file = sdscatfmt(sdsempty(), "%S.XXXXXX", journal->filepath);
+    FILE *fp = open_tmp_file(tmp_file);
+    if (fp == NULL) {
+        FREE_SDS(tmp_file);
+        return false;
+    }
+    errno = 0;
+    if (fwrite(content, 1, sdslen(content), fp) != sdslen(content) ||
+        fflush(fp) != 0 ||
+        fdatasync(fileno(fp)) != 0 ||
+        fclose(fp) != 0 ||
+        rename(tmp_file, journal->filepath) != 0)
+    {
+        MYMPD_LOG_ERROR("Could not rewrite sticker journal");
+        MYMPD_LOG_ERRNO(errno);
+        rm_file(tmp_file);
+        FREE_SDS(tmp_file);
+        return false;
+    }
+    FREE_SDS(tmp_file);
+    if (journal->fp != NULL) {
+        (void) fclose(journal->fp);
+    }
+    errno = 0;
+    journal->fp = fopen(journal->filepath, OPEN_FLAGS_APPEND);
+    if (journal->fp == NULL) {
+        MYMPD_LOG_ERROR("Can not open file \"%s\" for appending", journal->filepath);
+        MYMPD_LOG_ERRNO(errno);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Appends lines to the journal file and syncs it to disc
+ * @param journal pointer to the sticker journal
+ * @param lines lines to append
+ * @return true on success else false
+ */
+static bool journal_write(struct t_sticker_journal *journal, sds lines) {
+    if (journal->fp == NULL) {
+        return false;
+    }
+    errno = 0;
+    if (fwrite(lines, 1, sdslen(lines), journal->fp) != sdslen(lines) ||
+        fflush(journal->fp) != 0 ||
+        fdatasync(fileno(journal->fp)) != 0)
+    {
+        MYMPD_LOG_ERROR("Could not write to sticker journal");
+        MYMPD_LOG_ERRNO(errno);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Prints the journal lines for a list of sticker values
+ * @param buffer already allocated sds string to append the lines
+ * @param list sticker values, key: uri, value_i: sticker value, value_p: sticker name
+ * @param type line type
+ * @return pointer to buffer
+ */
+static sds journal_lines(sds buffer, struct t_list *list, char type) {
+    for (struct t_list_node *current = list->head; current != NULL; current = current->next) {
+        if (strchr(current->key, '\n') != NULL) {
+            continue;
+        }
+        buffer = sdscatlen(buffer, &type, 1);
+        buffer = sdscatfmt(buffer, "%I::%S::%S\n", current->value_i, current->value_p, current->key);
+    }
+    return buffer;
+}
+
+/**
+ * Parses a line of the sticker journal, the uri is not trimmed
+ * @param line line to parse without the newline
+ * @param type pointer to the line type to set
+ * @param value pointer to the sticker value to set
+ * @param name pointer to an already allocated sds string for the sticker name
+ * @param uri pointer to an already allocated sds string for the uri
+ * @return true on success else false
+ */
+static bool parse_journal_line(const char *line, char *type, long long *value, sds *name, sds *uri) {
+    if (line[0] != '+' &&
+        line[0] != '=')
+    {
+        return false;
+    }
+    *type = line[0];
+    const char *start = line + 1;
+    char *data = NULL;
+    errno = 0;
+    *value = strtoimax(start, &data, 10);
+    if (errno != 0 ||
+        data == start ||
+        strncmp(data, "::", 2) != 0)
+    {
+        return false;
+    }
+    data += 2;
+    char *sep = strstr(data, "::");
+    if (sep == NULL ||
+        sep[2] == '\0')
+    {
+        return false;
+    }
+    *name = sds_replacelen(*name, data, (size_t)(sep - data));
+    if (is_sticker_name(*name) == false) {
+        return false;
+    }
+    *uri = sds_replace(*uri, sep + 2);
+    return true;
+}
+
+/**
+ * Checks for a sticker name that is handled by the sticker queue
+ * @param name sticker name
+ * @return true if valid else false
+ */
+static bool is_sticker_name(const char *name) {
+    return strcmp(name, "playCount") == 0 ||
+        strcmp(name, "skipCount") == 0 ||
+        strcmp(name, "like") == 0 ||
+        strcmp(name, "lastPlayed") == 0 ||
+        strcmp(name, "lastSkipped") == 0;
+}
@@ -0,0 +1,22 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_STICKER_JOURNAL_H
+#define MYMPD_STICKER_JOURNAL_H
+
+#include "../lib/mympd_state.h"
+
+#include <stdbool.h>
+
+void sticker_journal_init(struct t_sticker_journal *journal);
+long sticker_journal_open(struct t_sticker_journal *journal, struct t_list *sticker_queue,
+        struct t_list *sticker_writes, sds workdir);
+bool sticker_journal_append(struct t_sticker_journal *journal, const char *uri, const char *name, long long value);
+void sticker_journal_rewrite(struct t_sticker_journal *journal, struct t_list *sticker_writes, struct t_list *sticker_queue);
+bool sticker_journal_synced(struct t_sticker_journal *journal);
+void sticker_journal_close(struct t_sticker_journal *journal);
+
+#endif
@@ -0,0 +1,348 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "thumbnail.h"
+
+#include "log.h"
+#include "mem.h"
+
+#include <string.h>
+
+//optional includes
+#ifdef ENABLE_THUMBNAILS
+    #include <setjmp.h>
+    #include <stdio.h>
+    #include <jpeglib.h>
+    #include <png.h>
+#endif
+
+#ifdef ENABLE_THUMBNAILS
+/**
+ * Private definitions
+ */
+
+/**
+ * Decoded image with 3 bytes (rgb) per pixel
+ */
+struct t_image {
+    unsigned char *pixels;  //!< rgb pixel data
+    unsigned width;         //!< image width
+    unsigned height;        //!< image height
+};
+
+/**
+ * Error handler for libjpeg, jumps back to the caller instead of calling exit()
+ */
+struct t_jpeg_error {
+    struct jpeg_error_mgr pub;  //!< libjpeg error manager
+    jmp_buf setjmp_buffer;      //!< return point
+    unsigned char *buffer;      //!< output buffer of the encoder, freed after longjmp
+    unsigned long buffer_len;   //!< length of the output buffer
+};
+
+static bool decode_jpeg(const char *binary, size_t len, unsigned size, struct t_image *image);
+static bool decode_png(const char *binary, size_t len, unsigned size, struct t_image *image);
+static void scale_image(const struct t_image *src, struct t_image *dst);
+static bool encode_jpeg(const struct t_image *image, int quality, sds *thumbnail);
+static void jpeg_error_exit(j_common_ptr cinfo);
+static void jpeg_output_message(j_common_ptr cinfo);
+#endif
+
+/**
+ * Public functions
+ */
+
+/**
+ * Creates a jpeg thumbnail from a jpeg or png image,
+ * the image is scaled down to fit in a size x size box
+ * @param binary the source image
+ * @param len length of binary
+ * @param size max width and height of the thumbnail
+ * @param quality jpeg quality
+ * @param thumbnail pointer to already allocated sds string to append the thumbnail
+ * @return true on success, false if the image is not supported or already small enough
+ */
+bool thumbnail_create(const char *binary, size_t len, int size, int quality, sds *thumbnail) {
+    #ifdef ENABLE_THUMBNAILS
+    if (size <= 0) {
+        return false;
+    }
+    struct t_image src = { NULL, 0, 0 };
+    bool rc = false;
+    if (len > 3 &&
+        memcmp(binary, "\xff\xd8\xff", 3) == 0)
+    {
+        rc = decode_jpeg(binary, len, (unsigned)size, &src);
+    }
+    else if (len > 8 &&
+        memcmp(binary, "\x89PNG\r\n\x1a\n", 8) == 0)
+    {
+        rc = decode_png(binary, len, (unsigned)size, &src);
+    }
+    else {
+        MYMPD_LOG_DEBUG("Unsupported image format for thumbnail creation");
+    }
+    if (rc == false) {
+        return false;
+    }
+    //keep the aspect ratio
+    struct t_image dst = { NULL, (unsigned)size, (unsigned)size };
+    if (src.width > src.height) {
+        dst.height = (unsigned)((unsigned long long)src.height * (unsigned)size / src.width);
+    }
+    else if (src.height > src.width) {
+        dst.width = (unsigned)((unsigned long long)src.width * (unsigned)size / src.height);
+    }
+    if (dst.width == 0) {
+        dst.width = 1;
+    }
+    if (dst.height == 0) {
+        dst.height = 1;
+    }
+    if (dst.width > src.width ||
+        dst.height > src.height)
+    {
+        //decoded image is already smaller
+        dst.width = src.width;
+        dst.height = src.height;
+    }
+    scale_image(&src, &dst);
+    FREE_PTR(src.pixels);
+    size_t old_len = sdslen(*thumbnail);
+    rc = encode_jpeg(&dst, quality, thumbnail);
+    FREE_PTR(dst.pixels);
+    if (rc == true &&
+        sdslen(*thumbnail) - old_len >= len)
+    {
+        MYMPD_LOG_DEBUG("Thumbnail is not smaller than the original image, discarding");
+        sdsrange(*thumbnail, 0, (ssize_t)old_len - 1);
+        return false;
+    }
+    if (rc == true) {
+        MYMPD_LOG_DEBUG("Created thumbnail %ux%u (%lu bytes)", dst.width, dst.height, (unsigned long)(sdslen(*thumbnail) - old_len));
+    }
+    return rc;
+    #else
+    (void) binary;
+    (void) len;
+    (void) size;
+    (void) quality;
+    (void) thumbnail;
+    return false;
+    #endif
+}
+
+#ifdef ENABLE_THUMBNAILS
+/**
+ * Private functions
+ */
+
+/**
+ * Decodes a jpeg image, uses the dct scaling of libjpeg to decode
+ * directly to the smallest size that is not below the thumbnail size
+ * @param binary the jpeg image
+ * @param len length of binary
+ * @param size thumbnail size
+ * @param image pointer to struct for the decoded image
+ * @return true on success, else false
+ */
+static bool decode_jpeg(const char *binary, size_t len, unsigned size, struct t_image *image) {
+    struct jpeg_decompress_struct cinfo;
+    struct t_jpeg_error jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpeg_error_exit;
+    jerr.pub.output_message = jpeg_output_message;
+    if (setjmp(jerr.setjmp_buffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        FREE_PTR(image->pixels);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (const unsigned char *)binary, (unsigned long)len);
+    jpeg_read_header(&cinfo, TRUE);
+    if (cinfo.image_width <= size &&
+        cinfo.image_height <= size)
+    {
+        MYMPD_LOG_DEBUG("Image is already smaller than the thumbnail size");
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    if ((unsigned long long)cinfo.image_width * cinfo.image_height > THUMBNAIL_PIXELS_MAX) {
+        MYMPD_LOG_WARN("Image is too large for thumbnail creation");
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    unsigned longest = cinfo.image_width > cinfo.image_height ? cinfo.image_width : cinfo.image_height;
+    unsigned denom = 8;
+    while (denom > 1 &&
+           longest / denom < size)
+    {
+        denom /= 2;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    image->width = cinfo.output_width;
+    image->height = cinfo.output_height;
+    size_t row_stride = (size_t)image->width * 3;
+    image->pixels = malloc_assert(row_stride * image->height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = image->pixels + cinfo.output_scanline * row_stride;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+/**
+ * Decodes a png image, transparent pixels are composed on a white background
+ * @param binary the png image
+ * @param len length of binary
+ * @param size thumbnail size
+ * @param image pointer to struct for the decoded image
+ * @return true on success, else false
+ */
+static bool decode_png(const char *binary, size_t len, unsigned size, struct t_image *image) {
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if (png_image_begin_read_from_memory(&png, binary, len) == 0) {
+        MYMPD_LOG_WARN("libpng: %s", png.message);
+        return false;
+    }
+    if (png.width <= size &&
+        png.height <= size)
+    {
+        MYMPD_LOG_DEBUG("Image is already smaller than the thumbnail size");
+        png_image_free(&png);
+        return false;
+    }
+    if ((unsigned long long)png.width * png.height > THUMBNAIL_PIXELS_MAX) {
+        MYMPD_LOG_WARN("Image is too large for thumbnail creation");
+        png_image_free(&png);
+        return false;
+    }
+    png.format = PNG_FORMAT_RGB;
+    image->width = png.width;
+    image->height = png.height;
+    image->pixels = malloc_assert((size_t)image->width * image->height * 3);
+    png_color background = { 255, 255, 255 };
+    if (png_image_finish_read(&png, &background, image->pixels, 0, NULL) == 0) {
+        MYMPD_LOG_WARN("libpng: %s", png.message);
+        png_image_free(&png);
+        FREE_PTR(image->pixels);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Scales an image down by averaging the source pixels covered by each destination pixel
+ * @param src source image
+ * @param dst destination image, width and height must be set
+ */
+static void scale_image(const struct t_image *src, struct t_image *dst) {
+    size_t src_stride = (size_t)src->width * 3;
+    dst->pixels = malloc_assert((size_t)dst->width * dst->height * 3);
+    unsigned char *out = dst->pixels;
+    for (unsigned dy = 0; dy < dst->height; dy++) {
+        unsigned sy0 = (unsigned)((unsigned long long)dy * src->height / dst->height);
+        unsigned sy1 = (unsigned)((unsigned long long)(dy + 1) * src->height / dst->height);
+        if (sy1 == sy0) {
+            sy1++;
+        }
+        for (unsigned dx = 0; dx < dst->width; dx++) {
+            unsigned sx0 = (unsigned)((unsigned long long)dx * src->width / dst->width);
+            unsigned sx1 = (unsigned)((unsigned long long)(dx + 1) * src->width / dst->width);
+            if (sx1 == sx0) {
+                sx1++;
+            }
+            unsigned long sum[3] = { 0, 0, 0 };
+            for (unsigned sy = sy0; sy < sy1; sy++) {
+                const unsigned char *p = src->pixels + sy * src_stride + (size_t)sx0 * 3;
+                for (unsigned sx = sx0; sx < sx1; sx++) {
+                    sum[0] += p[0];
+                    sum[1] += p[1];
+                    sum[2] += p[2];
+                    p += 3;
+                }
+            }
+            unsigned long count = (unsigned long)(sy1 - sy0) * (sx1 - sx0);
+            for (int c = 0; c < 3; c++) {
+                *out++ = (unsigned char)((sum[c] + count / 2) / count);
+            }
+        }
+    }
+}
+
+/**
+ * Encodes an image as jpeg
+ * @param image image to encode
+ * @param quality jpeg quality
+ * @param thumbnail pointer to already allocated sds string to append the jpeg
+ * @return true on success, else false
+ */
+static bool encode_jpeg(const struct t_image *image, int quality, sds *thumbnail) {
+    struct jpeg_compress_struct cinfo;
+    struct t_jpeg_error jerr;
+    //the buffer is set by libjpeg after setjmp, it is kept in jerr
+    //because non-volatile locals are indeterminate after longjmp
+    jerr.buffer = NULL;
+    jerr.buffer_len = 0;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpeg_error_exit;
+    jerr.pub.output_message = jpeg_output_message;
+    if (setjmp(jerr.setjmp_buffer)) {
+        jpeg_destroy_compress(&cinfo);
+        FREE_PTR(jerr.buffer);
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &jerr.buffer, &jerr.buffer_len);
+    cinfo.image_width = image->width;
+    cinfo.image_height = image->height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    size_t row_stride = (size_t)image->width * 3;
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = image->pixels + cinfo.next_scanline * row_stride;
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    *thumbnail = sdscatlen(*thumbnail, jerr.buffer, jerr.buffer_len);
+    jpeg_destroy_compress(&cinfo);
+    FREE_PTR(jerr.buffer);
+    return true;
+}
+
+/**
+ * Replaces the default libjpeg error_exit handler
+ * @param cinfo libjpeg struct
+ */
+static void jpeg_error_exit(j_common_ptr cinfo) {
+    struct t_jpeg_error *jerr = (struct t_jpeg_error *)cinfo->err;
+    char buffer[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, buffer);
+    MYMPD_LOG_WARN("libjpeg: %s", buffer);
+    longjmp(jerr->setjmp_buffer, 1);
+}
+
+/**
+ * Redirects the libjpeg warnings to the myMPD log
+ * @param cinfo libjpeg struct
+ */
+static void jpeg_output_message(j_common_ptr cinfo) {
+    char buffer[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, buffer);
+    MYMPD_LOG_DEBUG("libjpeg: %s", buffer);
+}
+#endif
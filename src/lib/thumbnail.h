@@ -0,0 +1,15 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_THUMBNAIL_H
+#define MYMPD_THUMBNAIL_H
+
+#include "../../dist/sds/sds.h"
+
+#include <stdbool.h>
+
+bool thumbnail_create(const char *binary, size_t len, int size, int quality, sds *thumbnail);
+#endif
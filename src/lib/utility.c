@@ -30,6 +30,41 @@ static sds get_local_ip(void);
 
 //public functions
 
+/**
+ * Image file extensions to detect
+ */
+const char *image_file_extensions[] = {
+    "webp", "jpg", "jpeg", "png", "svg", "avif",
+    "WEBP", "JPG", "JPEG", "PNG", "SVG", "AVIF",
+    NULL};
+
+/**
+ * Finds the first image with basefilename by trying out extentions
+ * @param basefilename basefilename to append extensions
+ * @return pointer to basefilename
+ */
+sds find_image_file(sds basefilename) {
+    MYMPD_LOG_DEBUG("Searching image file for basename \"%s\"", basefilename);
+    const char **p = image_file_extensions;
+    sds testfilename = sdsempty();
+    while (*p != NULL) {
+        testfilename = sdscatfmt(testfilename, "%S.%s", basefilename, *p);
+        if (access(testfilename, F_OK) == 0) { /* Flawfinder: ignore */
+            break;
+        }
+        sdsclear(testfilename);
+        p++;
+    }
+    FREE_SDS(testfilename);
+    if (*p != NULL) {
+        basefilename = sdscatfmt(basefilename, ".%s", *p);
+    }
+    else {
+        sdsclear(basefilename);
+    }
+    return basefilename;
+}
+
 /**
  * Gets an environment variable and checks its length
  * @param env_var environment variable name
@@ -13,6 +13,9 @@
 
 #include "../../dist/sds/sds.h"
 
+extern const char *image_file_extensions[];
+
+sds find_image_file(sds basefilename);
 bool is_streamuri(const char *uri);
 bool is_virtual_cuedir(sds music_directory, sds filename);
 const char *get_extension_from_filename(const char *filename);
@@ -12,6 +12,7 @@
 #include "lib/api.h"
 #include "lib/config.h"
 #include "lib/config_def.h"
+#include "lib/covercache.h"
 #include "lib/filehandler.h"
 #include "lib/handle_options.h"
 #include "lib/log.h"
@@ -79,9 +80,9 @@ static void mympd_signal_handler(int sig_num) {
             //Set loop end condition for threads
             s_signal_received = sig_num;
             //Wakeup queue loops
-            pthread_cond_signal(&mympd_api_queue->wakeup);
-            pthread_cond_signal(&mympd_script_queue->wakeup);
-            pthread_cond_signal(&web_server_queue->wakeup);
+            mympd_queue_wakeup(mympd_api_queue);
+            mympd_queue_wakeup(mympd_script_queue);
+            mympd_queue_wakeup(web_server_queue);
             MYMPD_LOG_NOTICE("Signal \"%s\" received, exiting", (sig_num == SIGTERM ? "SIGTERM" : "SIGINT"));
             break;
         }
@@ -497,6 +498,11 @@ int main(int argc, char **argv) {
         goto cleanup;
     }
 
+    //covercache index
+    if (config->covercache_keep_days > 0) {
+        covercache_init(config->cachedir, (size_t)config->covercache_size * 1024 * 1024);
+    }
+
     //default smart playlists
     if (config->first_startup == true) {
         smartpls_default(config->workdir);
@@ -546,6 +552,9 @@ int main(int argc, char **argv) {
     mympd_queue_free(mympd_api_queue);
     mympd_queue_free(mympd_script_queue);
 
+    //save the covercache index
+    covercache_free();
+
     //free config
     mympd_free_config(config);
 
@@ -13,6 +13,7 @@
 #include "../lib/sds_extras.h"
 #include "../lib/utility.h"
 #include "errorhandler.h"
+#include "queue_mirror.h"
 
 #include <string.h>
 
@@ -117,4 +118,6 @@ void mpd_client_disconnect(struct t_partition_state *partition_state) {
         mpd_connection_free(partition_state->conn);
     }
     partition_state->conn = NULL;
+    //the mirror can not be updated incrementally after a reconnect
+    queue_mirror_clear(&partition_state->queue_mirror);
 }
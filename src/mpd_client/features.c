@@ -14,6 +14,7 @@
 #include "../lib/sds_extras.h"
 #include "../lib/utility.h"
 #include "../mpd_client/tags.h"
+#include "../mpd_worker/pool.h"
 #include "../mympd_api/status.h"
 #include "errorhandler.h"
 
@@ -111,6 +112,9 @@ void mpd_client_mpd_features(struct t_mympd_state *mympd_state) {
     struct t_work_response *web_server_response = create_response_new(-1, 0, INTERNAL_API_WEBSERVER_SETTINGS);
     web_server_response->extra = extra;
     mympd_queue_push(web_server_queue, web_server_response, 0);
+
+    //publish settings to the mpd_worker pool
+    mpd_worker_pool_configure(mympd_state);
 }
 
 /**
@@ -8,13 +8,18 @@
 #include "idle.h"
 
 #include "../lib/jsonrpc.h"
+#include "../lib/last_played_store.h"
 #include "../lib/log.h"
+#include "../lib/response_cache.h"
 #include "../lib/sds_extras.h"
 #include "../lib/sticker_cache.h"
+#include "../lib/sticker_journal.h"
 #include "../lib/utility.h"
 #include "../mpd_worker/mpd_worker.h"
+#include "../mpd_worker/pool.h"
 #include "../mympd_api/mympd_api_handler.h"
 #include "../mympd_api/last_played.h"
+#include "../mympd_api/play_stats.h"
 #include "../mympd_api/queue.h"
 #include "../mympd_api/status.h"
 #include "../mympd_api/timer.h"
@@ -24,6 +29,7 @@
 #include "errorhandler.h"
 #include "features.h"
 #include "jukebox.h"
+#include "partitions.h"
 #include "tags.h"
 
 #include <poll.h>
@@ -36,7 +42,12 @@
 static bool update_mympd_caches(struct t_mpd_state *mpd_state,
         struct t_timer_list *timer_list, time_t timeout);
 static void mpd_client_parse_idle(struct t_partition_state *partition_state, unsigned idle_bitmask,
-    struct t_timer_list *timer_list, struct t_list *trigger_list);
+    struct t_timer_list *timer_list, struct t_list *trigger_list, bool primary);
+static void mpd_client_idle_partition(struct t_mympd_state *mympd_state, struct t_partition_state *partition_state,
+    bool idle_event_waiting);
+static void check_play_state(struct t_partition_state *partition_state, bool *jukebox_add_song, bool *set_played);
+static void handle_play_state(struct t_mympd_state *mympd_state, struct t_partition_state *partition_state,
+    bool jukebox_add_song, bool set_played);
 
 /**
  * Public functions
@@ -60,8 +71,11 @@ void mpd_client_idle(struct t_mympd_state *mympd_state) {
             struct t_work_request *request = mympd_queue_shift(mympd_api_queue, 100, 0);
             if (request != NULL) {
                 MYMPD_LOG_DEBUG("Handle request (mpd disconnected)");
-                if (is_mympd_only_api_method(request->cmd_id) == true) {
-                    //request that are handled without a mpd connection
+                if (is_mympd_only_api_method(request->cmd_id) == true ||
+                    request->cmd_id == INTERNAL_API_BATCH)
+                {
+                    //request that are handled without a mpd connection,
+                    //batch requests are checked for each contained request
                     mympd_api_handler(mympd_state, request);
                 }
                 else {
@@ -94,6 +108,8 @@ void mpd_client_idle(struct t_mympd_state *mympd_state) {
             send_jsonrpc_event(JSONRPC_EVENT_MPD_CONNECTED);
             //get mpd features
             mpd_client_mpd_features(mympd_state);
+            //connect the additional partitions
+            mpd_client_partitions_populate(mympd_state);
             //initiate cache updates
             update_mympd_caches(mympd_state->mpd_state, &mympd_state->timer_list, 2);
             //set timer for smart playlist update
@@ -117,6 +133,10 @@ void mpd_client_idle(struct t_mympd_state *mympd_state) {
         case MPD_DISCONNECT:
         case MPD_DISCONNECT_INSTANT:
             mpd_client_disconnect(mympd_state->partition_state);
+            mpd_client_partitions_clear(mympd_state);
+            mpd_worker_pool_disable();
+            //mpd state changes are not tracked while disconnected
+            response_cache_invalidate(&mympd_state->mpd_state->response_cache, RESPONSE_CACHE_DEP_ALL);
             //set wait time for next connection attempt
             if (mympd_state->partition_state->conn_state != MPD_DISCONNECT_INSTANT) {
                 mympd_state->partition_state->conn_state = MPD_WAIT;
@@ -133,46 +153,46 @@ void mpd_client_idle(struct t_mympd_state *mympd_state) {
             }
             break;
         case MPD_CONNECTED: {
-            //check for waiting mpd idle events
-            struct pollfd fds[1];
-            fds[0].fd = mpd_connection_get_fd(mympd_state->partition_state->conn);
-            fds[0].events = POLLIN;
-            int pollrc = poll(fds, 1, 50);
+            //check for waiting mpd idle events of all partitions
+            struct pollfd fds[MPD_PARTITIONS_MAX + 1];
+            struct t_partition_state *partitions[MPD_PARTITIONS_MAX + 1];
+            nfds_t nfds = 0;
+            for (struct t_partition_state *partition_state = mympd_state->partition_state;
+                partition_state != NULL && nfds <= MPD_PARTITIONS_MAX;
+                partition_state = partition_state->next)
+            {
+                if (partition_state->conn_state != MPD_CONNECTED) {
+                    continue;
+                }
+                fds[nfds].fd = mpd_connection_get_fd(partition_state->conn);
+                fds[nfds].events = POLLIN;
+                fds[nfds].revents = 0;
+                partitions[nfds] = partition_state;
+                nfds++;
+            }
+            poll(fds, nfds, 50);
+            //handle the additional partitions, the primary partition is the first entry
+            for (nfds_t i = 1; i < nfds; i++) {
+                mpd_client_idle_partition(mympd_state, partitions[i], fds[i].revents != 0);
+            }
+            mpd_client_partitions_reconnect(mympd_state);
             //initial states
+            bool idle_event_waiting = fds[0].revents != 0;
             bool jukebox_add_song = false;
             bool set_played = false;
             //check the queue
             struct t_work_request *request = mympd_queue_shift(mympd_api_queue, 50, 0);
             //handle jukebox and last played only in mpd play state
-            if (mympd_state->partition_state->play_state == MPD_STATE_PLAY) {
-                time_t now = time(NULL);
-                //check if we should set the played state of current song
-                if (now > mympd_state->partition_state->set_song_played_time &&
-                    mympd_state->partition_state->set_song_played_time > 0 &&
-                    mympd_state->partition_state->last_last_played_id != mympd_state->partition_state->song_id)
-                {
-                    MYMPD_LOG_DEBUG("Song has played half: %lld", (long long)mympd_state->partition_state->set_song_played_time);
-                    set_played = true;
-                }
-                //check if the jukebox should add a song
-                if (mympd_state->partition_state->jukebox_mode != JUKEBOX_OFF) {
-                    //add time is crossfade + 10s before song end time
-                    time_t add_time = mympd_state->partition_state->song_end_time - (mympd_state->partition_state->crossfade + 10);
-                    if (now > add_time &&
-                        add_time > 0 &&
-                        mympd_state->partition_state->queue_length <= mympd_state->partition_state->jukebox_queue_length)
-                    {
-                        MYMPD_LOG_DEBUG("Jukebox should add song");
-                        jukebox_add_song = true;
-                    }
-                }
-            }
+            check_play_state(mympd_state->partition_state, &jukebox_add_song, &set_played);
             //check if we need to exit the idle mode
-            if (pollrc > 0 ||                                            //idle event waiting
+            if (idle_event_waiting == true ||                            //idle event waiting
                 request != NULL ||                                       //api was called
                 jukebox_add_song == true ||                              //jukebox trigger
                 set_played == true ||                                    //playstate of song must be set
-                mympd_state->mpd_state->sticker_queue.length > 0) //we must set waiting stickers
+                (mympd_state->mpd_state->feat_stickers == true &&
+                 (mympd_state->mpd_state->sticker_queue.length > 0 ||            //we must set waiting stickers
+                  (mympd_state->mpd_state->sticker_writes.length > 0 &&
+                   sticker_journal_synced(&mympd_state->mpd_state->sticker_journal) == true))))
             {
                 MYMPD_LOG_DEBUG("Leaving mpd idle mode");
                 if (mpd_send_noidle(mympd_state->partition_state->conn) == false) {
@@ -180,48 +200,43 @@ void mpd_client_idle(struct t_mympd_state *mympd_state) {
                     mympd_state->partition_state->conn_state = MPD_FAILURE;
                     break;
                 }
-                if (pollrc > 0) {
-                    //Handle idle events
-                    MYMPD_LOG_DEBUG("Checking for idle events");
-                    enum mpd_idle idle_bitmask = mpd_recv_idle(mympd_state->partition_state->conn, false);
+                //Handle idle events, events can also arrive between poll and noidle
+                MYMPD_LOG_DEBUG("Checking for idle events");
+                enum mpd_idle idle_bitmask = mpd_recv_idle(mympd_state->partition_state->conn, false);
+                if (idle_bitmask != 0) {
                     mpd_client_parse_idle(mympd_state->partition_state, idle_bitmask, &mympd_state->timer_list,
-                        &mympd_state->trigger_list);
-                }
-                else {
-                    mpd_response_finish(mympd_state->partition_state->conn);
-                }
-                //set song played state
-                if (set_played == true) {
-                    mympd_state->partition_state->last_last_played_id = mympd_state->partition_state->song_id;
-
-                    if (mympd_state->mpd_state->last_played_count > 0) {
-                        mympd_api_last_played_add_song(mympd_state->partition_state, mympd_state->partition_state->song_id);
-                    }
-                    if (mympd_state->mpd_state->feat_stickers == true) {
-                        sticker_inc_play_count(&mympd_state->mpd_state->sticker_queue,
-                            mympd_state->partition_state->song_uri);
-                        sticker_set_last_played(&mympd_state->mpd_state->sticker_queue,
-                            mympd_state->partition_state->song_uri, mympd_state->partition_state->last_song_start_time);
+                        &mympd_state->trigger_list, true);
+                    if (idle_bitmask & MPD_IDLE_PARTITION) {
+                        //partitions are added or removed
+                        mpd_client_partitions_populate(mympd_state);
                     }
-                    mympd_api_trigger_execute(&mympd_state->trigger_list, TRIGGER_MYMPD_SCROBBLE);
-                }
-                //trigger jukebox
-                if (jukebox_add_song == true) {
-                    jukebox_run(mympd_state->partition_state);
                 }
+                //set song played state and trigger jukebox
+                handle_play_state(mympd_state, mympd_state->partition_state, jukebox_add_song, set_played);
                 //an api request is there
                 if (request != NULL) {
                     //Handle request
                     MYMPD_LOG_DEBUG("Handle API request");
                     mympd_api_handler(mympd_state, request);
                 }
+                //replace the sticker cache, if the swap was deferred
+                if (mpd_worker_pool_sticker_cache_swap(&mympd_state->mpd_state->sticker_cache) == true) {
+                    MYMPD_LOG_INFO("Sticker cache was replaced");
+                    response_cache_invalidate(&mympd_state->mpd_state->response_cache, RESPONSE_CACHE_DEP_STICKERS);
+                }
                 //process sticker queue
+                //skipped while a mpd_worker pool thread reads the sticker cache
                 if (mympd_state->mpd_state->feat_stickers == true &&
-                    mympd_state->mpd_state->sticker_queue.length > 0)
+                    (mympd_state->mpd_state->sticker_queue.length > 0 ||
+                     mympd_state->mpd_state->sticker_writes.length > 0) &&
+                    mpd_worker_pool_sticker_cache_lock(false) == true)
                 {
                     MYMPD_LOG_DEBUG("Processing sticker queue");
-                    sticker_dequeue(&mympd_state->mpd_state->sticker_queue,
-                        &mympd_state->mpd_state->sticker_cache, mympd_state->partition_state);
+                    sticker_dequeue(&mympd_state->mpd_state->sticker_queue, &mympd_state->mpd_state->sticker_writes,
+                        &mympd_state->mpd_state->sticker_cache, &mympd_state->mpd_state->sticker_journal,
+                        mympd_state->partition_state);
+                    mpd_worker_pool_sticker_cache_unlock();
+                    response_cache_invalidate(&mympd_state->mpd_state->response_cache, RESPONSE_CACHE_DEP_STICKERS);
                 }
                 //reenter idle mode
                 MYMPD_LOG_DEBUG("Entering mpd idle mode");
@@ -241,15 +256,125 @@ void mpd_client_idle(struct t_mympd_state *mympd_state) {
  * Private functions
  */
 
+/**
+ * Handles idle events, jukebox and last played for an additional partition.
+ * The connection of the partition is in idle mode before and after this function.
+ * @param mympd_state pointer to the mympd state struct
+ * @param partition_state pointer to the partition state
+ * @param idle_event_waiting true if poll reported data on the connection
+ */
+static void mpd_client_idle_partition(struct t_mympd_state *mympd_state, struct t_partition_state *partition_state,
+    bool idle_event_waiting)
+{
+    bool jukebox_add_song = false;
+    bool set_played = false;
+    check_play_state(partition_state, &jukebox_add_song, &set_played);
+    if (idle_event_waiting == false &&
+        jukebox_add_song == false &&
+        set_played == false)
+    {
+        return;
+    }
+    MYMPD_LOG_DEBUG("Leaving mpd idle mode for partition \"%s\"", partition_state->name);
+    if (mpd_send_noidle(partition_state->conn) == false) {
+        mympd_check_error_and_recover(partition_state);
+        partition_state->conn_state = MPD_FAILURE;
+        return;
+    }
+    enum mpd_idle idle_bitmask = mpd_recv_idle(partition_state->conn, false);
+    if (mympd_check_error_and_recover(partition_state) == false) {
+        partition_state->conn_state = MPD_FAILURE;
+        return;
+    }
+    mpd_client_parse_idle(partition_state, idle_bitmask, &mympd_state->timer_list,
+        &mympd_state->trigger_list, false);
+    handle_play_state(mympd_state, partition_state, jukebox_add_song, set_played);
+    if (mpd_client_partition_send_idle(partition_state) == false) {
+        partition_state->conn_state = MPD_FAILURE;
+    }
+}
+
+/**
+ * Checks if the played state of the current song must be set and if the jukebox should add a song.
+ * Jukebox and last played are only handled in mpd play state.
+ * @param partition_state pointer to the partition state
+ * @param jukebox_add_song set to true if the jukebox should add a song
+ * @param set_played set to true if the played state must be set
+ */
+static void check_play_state(struct t_partition_state *partition_state, bool *jukebox_add_song, bool *set_played) {
+    if (partition_state->play_state != MPD_STATE_PLAY) {
+        return;
+    }
+    time_t now = time(NULL);
+    //check if we should set the played state of current song
+    if (now > partition_state->set_song_played_time &&
+        partition_state->set_song_played_time > 0 &&
+        partition_state->last_last_played_id != partition_state->song_id)
+    {
+        MYMPD_LOG_DEBUG("Song has played half: %lld", (long long)partition_state->set_song_played_time);
+        *set_played = true;
+    }
+    //check if the jukebox should add a song
+    if (partition_state->jukebox_mode != JUKEBOX_OFF) {
+        //add time is crossfade + 10s before song end time
+        time_t add_time = partition_state->song_end_time - (partition_state->crossfade + 10);
+        if (now > add_time &&
+            add_time > 0 &&
+            partition_state->queue_length <= partition_state->jukebox_queue_length)
+        {
+            MYMPD_LOG_DEBUG("Jukebox should add song");
+            *jukebox_add_song = true;
+        }
+    }
+}
+
+/**
+ * Sets the played state of the current song and triggers the jukebox.
+ * The connection must not be in idle mode.
+ * @param mympd_state pointer to the mympd state struct
+ * @param partition_state pointer to the partition state
+ * @param jukebox_add_song true if the jukebox should add a song
+ * @param set_played true if the played state must be set
+ */
+static void handle_play_state(struct t_mympd_state *mympd_state, struct t_partition_state *partition_state,
+    bool jukebox_add_song, bool set_played)
+{
+    //set song played state
+    if (set_played == true) {
+        partition_state->last_last_played_id = partition_state->song_id;
+
+        if (mympd_state->mpd_state->last_played_count > 0) {
+            mympd_api_last_played_add_song(partition_state, partition_state->song_id);
+        }
+        mympd_api_play_stats_add(partition_state, partition_state->song_uri, partition_state->last_song_start_time, false);
+        if (mympd_state->mpd_state->feat_stickers == true) {
+            sticker_inc_play_count(&mympd_state->mpd_state->sticker_queue,
+                &mympd_state->mpd_state->sticker_journal, partition_state->song_uri);
+            sticker_set_last_played(&mympd_state->mpd_state->sticker_queue,
+                &mympd_state->mpd_state->sticker_journal, partition_state->song_uri, partition_state->last_song_start_time);
+        }
+        //triggers are bound to the partition controlled by the api
+        if (partition_state == mympd_state->partition_state) {
+            mympd_api_trigger_execute(&mympd_state->trigger_list, TRIGGER_MYMPD_SCROBBLE);
+        }
+    }
+    //trigger jukebox
+    if (jukebox_add_song == true) {
+        jukebox_run(partition_state);
+    }
+}
+
 /**
  * Handles mpd idle events
  * @param partition_state pointer to partition specific states
  * @param idle_bitmask triggered mpd idle events as bitmask
  * @param timer_list pointer to the timer_list
  * @param trigger_list pointer to the trigger_list
+ * @param primary true for the partition controlled by the api,
+ *                triggers and notifications are only handled for this partition
  */
 static void mpd_client_parse_idle(struct t_partition_state *partition_state, unsigned idle_bitmask,
-    struct t_timer_list *timer_list, struct t_list *trigger_list) {
+    struct t_timer_list *timer_list, struct t_list *trigger_list, bool primary) {
     sds buffer = sdsempty();
     for (unsigned j = 0;; j++) {
         enum mpd_idle idle_event = 1 << j;
@@ -264,23 +389,27 @@ static void mpd_client_parse_idle(struct t_partition_state *partition_state, uns
                     //database has changed
                     MYMPD_LOG_INFO("MPD database has changed");
                     buffer = jsonrpc_event(buffer, JSONRPC_EVENT_UPDATE_DATABASE);
+                    response_cache_invalidate(&partition_state->mpd_state->response_cache, RESPONSE_CACHE_DEP_DATABASE);
+                    last_played_store_songs_clear(&partition_state->mpd_state->last_played);
                     //add timer for cache updates
                     update_mympd_caches(partition_state->mpd_state, timer_list, 10);
                     break;
                 case MPD_IDLE_STORED_PLAYLIST:
                     //a playlist has changed
                     buffer = jsonrpc_event(buffer, JSONRPC_EVENT_UPDATE_STORED_PLAYLIST);
+                    response_cache_invalidate(&partition_state->mpd_state->response_cache, RESPONSE_CACHE_DEP_PLAYLISTS);
                     break;
                 case MPD_IDLE_QUEUE: {
                     //queue has changed
                     unsigned old_queue_version = partition_state->queue_version;
-                    buffer = mympd_api_queue_status(partition_state, buffer);
+                    buffer = mympd_api_queue_status_delta(partition_state, buffer);
                     if (partition_state->queue_version == old_queue_version) {
                         //ignore this idle event, queue version has not changed in this partition
                         sdsclear(buffer);
                         MYMPD_LOG_DEBUG("Queue version has not changed, ignoring idle event MPD_IDLE_QUEUE");
                         break;
                     }
+                    response_cache_invalidate(&partition_state->mpd_state->response_cache, RESPONSE_CACHE_DEP_QUEUE);
                     //jukebox enabled
                     if (partition_state->jukebox_mode != JUKEBOX_OFF &&
                         partition_state->queue_length < partition_state->jukebox_queue_length)
@@ -314,9 +443,8 @@ static void mpd_client_parse_idle(struct t_partition_state *partition_state, uns
                         partition_state->last_song_uri != NULL)
                     {
                         time_t now = time(NULL);
-                        if (partition_state->mpd_state->feat_stickers == true &&          //stickers enabled
-                            partition_state->last_song_set_song_played_time > now) //time in the future
-                        {
+                        //played time in the future
+                        if (partition_state->last_song_set_song_played_time > now) {
                             //last song skipped
                             time_t elapsed = now - partition_state->last_song_start_time;
                             if (elapsed > 10 &&
@@ -325,9 +453,12 @@ static void mpd_client_parse_idle(struct t_partition_state *partition_state, uns
                             {
                                 MYMPD_LOG_DEBUG("Song \"%s\" skipped", partition_state->last_song_uri);
                                 if (partition_state->mpd_state->feat_stickers == true) {
-                                    sticker_inc_skip_count(&partition_state->mpd_state->sticker_queue, partition_state->last_song_uri);
-                                    sticker_set_last_skipped(&partition_state->mpd_state->sticker_queue, partition_state->last_song_uri);
+                                    sticker_inc_skip_count(&partition_state->mpd_state->sticker_queue,
+                                        &partition_state->mpd_state->sticker_journal, partition_state->last_song_uri);
+                                    sticker_set_last_skipped(&partition_state->mpd_state->sticker_queue,
+                                        &partition_state->mpd_state->sticker_journal, partition_state->last_song_uri);
                                 }
+                                mympd_api_play_stats_add(partition_state, partition_state->last_song_uri, now, true);
                                 partition_state->last_skipped_id = partition_state->last_song_id;
                             }
                         }
@@ -350,10 +481,19 @@ static void mpd_client_parse_idle(struct t_partition_state *partition_state, uns
                     //database update has started or is finished
                     buffer = mympd_api_status_updatedb_state(partition_state, buffer);
                     break;
+                case MPD_IDLE_STICKER:
+                    //stickers are changed
+                    response_cache_invalidate(&partition_state->mpd_state->response_cache, RESPONSE_CACHE_DEP_STICKERS);
+                    break;
                 default: {
                     //other idle events not used
                 }
             }
+            if (primary == false) {
+                //no websocket client is bound to additional partitions
+                sdsclear(buffer);
+                continue;
+            }
             //check for attached triggers
             mympd_api_trigger_execute(trigger_list, (enum trigger_events)idle_event);
             //broadcast event to all websockets
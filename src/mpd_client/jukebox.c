@@ -8,14 +8,15 @@
 #include "jukebox.h"
 
 #include "../../dist/utf8/utf8.h"
-#include "../lib/filehandler.h"
 #include "../lib/jsonrpc.h"
+#include "../lib/last_played_store.h"
 #include "../lib/log.h"
 #include "../lib/mem.h"
 #include "../lib/random.h"
 #include "../lib/sds_extras.h"
 #include "../lib/sticker_cache.h"
 #include "../lib/utility.h"
+#include "../mympd_api/last_played.h"
 #include "../mympd_api/queue.h"
 #include "../mympd_api/sticker.h"
 #include "errorhandler.h"
@@ -23,7 +24,6 @@
 #include "search_local.h"
 #include "tags.h"
 
-#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -473,86 +473,34 @@ static struct t_list *jukebox_get_last_played(struct t_partition_state *partitio
     mympd_check_error_and_recover(partition_state);
 
     //append last_played to queue list
-    struct t_list_node *current = partition_state->mpd_state->last_played.head;
-    while (current != NULL) {
-        rc = mpd_send_list_meta(partition_state->conn, current->key);
-        if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_send_list_meta") == true) {
-            song = mpd_recv_song(partition_state->conn);
-            if (song != NULL) {
-                if (jukebox_mode == JUKEBOX_ADD_SONG) {
-                    if (partition_state->jukebox_unique_tag.tags[0] != MPD_TAG_TITLE) {
-                        tag_value = mpd_client_get_tag_value_string(song, partition_state->jukebox_unique_tag.tags[0], tag_value);
-                    }
-                    list_push(queue_list, current->key, 0, tag_value, NULL);
-                    sdsclear(tag_value);
-                }
-                else if (jukebox_mode == JUKEBOX_ADD_ALBUM) {
-                    album = mpd_client_get_tag_value_string(song, MPD_TAG_ALBUM, album);
-                    albumartist = mpd_client_get_tag_value_string(song, partition_state->mpd_state->tag_albumartist, albumartist);
-                    list_push(queue_list, album, 0, albumartist, NULL);
-                    sdsclear(album);
-                    sdsclear(albumartist);
-                }
-                mpd_song_free(song);
-            }
+    struct t_last_played_store *store = &partition_state->mpd_state->last_played;
+    sds uri = sdsempty();
+    long long last_played;
+    long length = last_played_store_count(store, partition_state->mpd_state->last_played_count);
+    for (long i = 0; i < length && queue_list->length < 20; i++) {
+        if (last_played_store_get(store, i, &last_played, &uri) == false) {
+            continue;
+        }
+        const struct mpd_song *lp_song = mympd_api_last_played_song(partition_state, uri);
+        if (lp_song == NULL) {
+            continue;
         }
-        mpd_response_finish(partition_state->conn);
-        mympd_check_error_and_recover(partition_state);
-        current = current->next;
-    }
-    //get last_played from disc
-    if (queue_list->length < 20) {
-        sds line = sdsempty();
-        char *data = NULL;
-        sds lp_file = sdscatfmt(sdsempty(), "%S/state/last_played", partition_state->mpd_state->config->workdir);
-        errno = 0;
-        FILE *fp = fopen(lp_file, OPEN_FLAGS_READ);
-        if (fp != NULL) {
-            while (sds_getline(&line, fp, LINE_LENGTH_MAX) == 0 &&
-                   queue_list->length < 20)
-            {
-                int value = (int)strtoimax(line, &data, 10);
-                if (value > 0 && strlen(data) > 2) {
-                    data = data + 2;
-                    rc = mpd_send_list_meta(partition_state->conn, data);
-                    if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_send_list_meta") == true) {
-                        song = mpd_recv_song(partition_state->conn);
-                        if (song != NULL) {
-                            if (jukebox_mode == JUKEBOX_ADD_SONG) {
-                                if (partition_state->jukebox_unique_tag.tags[0] != MPD_TAG_TITLE) {
-                                    tag_value = mpd_client_get_tag_value_string(song, partition_state->jukebox_unique_tag.tags[0], tag_value);
-                                }
-                                list_push(queue_list, data, 0, tag_value, NULL);
-                                sdsclear(tag_value);
-                            }
-                            else if (jukebox_mode == JUKEBOX_ADD_ALBUM) {
-                                album = mpd_client_get_tag_value_string(song, MPD_TAG_ALBUM, album);
-                                albumartist = mpd_client_get_tag_value_string(song, partition_state->mpd_state->tag_albumartist, albumartist);
-                                list_push(queue_list, album, 0, albumartist, NULL);
-                                sdsclear(album);
-                                sdsclear(albumartist);
-                            }
-                            mpd_song_free(song);
-                        }
-                    }
-                    mpd_response_finish(partition_state->conn);
-                    mympd_check_error_and_recover(partition_state);
-                }
-                else {
-                    MYMPD_LOG_ERROR("Reading last_played line failed");
-                    MYMPD_LOG_DEBUG("Erroneous line: %s", line);
-                }
+        if (jukebox_mode == JUKEBOX_ADD_SONG) {
+            if (partition_state->jukebox_unique_tag.tags[0] != MPD_TAG_TITLE) {
+                tag_value = mpd_client_get_tag_value_string(lp_song, partition_state->jukebox_unique_tag.tags[0], tag_value);
             }
-            (void) fclose(fp);
-            FREE_SDS(line);
+            list_push(queue_list, uri, 0, tag_value, NULL);
+            sdsclear(tag_value);
         }
-        else {
-            //ignore missing last_played file
-            MYMPD_LOG_DEBUG("Can not open \"%s\"", lp_file);
-            MYMPD_LOG_ERRNO(errno);
+        else if (jukebox_mode == JUKEBOX_ADD_ALBUM) {
+            album = mpd_client_get_tag_value_string(lp_song, MPD_TAG_ALBUM, album);
+            albumartist = mpd_client_get_tag_value_string(lp_song, partition_state->mpd_state->tag_albumartist, albumartist);
+            list_push(queue_list, album, 0, albumartist, NULL);
+            sdsclear(album);
+            sdsclear(albumartist);
         }
-        FREE_SDS(lp_file);
     }
+    FREE_SDS(uri);
     FREE_SDS(album);
     FREE_SDS(albumartist);
     FREE_SDS(tag_value);
@@ -0,0 +1,321 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "partitions.h"
+
+#include "../lib/jsonrpc.h"
+#include "../lib/log.h"
+#include "../lib/mem.h"
+#include "../lib/sds_extras.h"
+#include "../mympd_api/settings.h"
+#include "../mympd_api/status.h"
+#include "connection.h"
+#include "errorhandler.h"
+#include "jukebox.h"
+#include "tags.h"
+
+#include <string.h>
+
+/**
+ * Private definitions
+ */
+
+static struct t_partition_state *partition_new(struct t_mympd_state *mympd_state, const char *name);
+static bool partition_connect(struct t_partition_state *partition_state);
+static void partition_free(struct t_partition_state *partition_state);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Synchronizes the list of additional partitions with the partitions of mpd.
+ * The head of the list is the primary partition, it is controlled by the api.
+ * All other partitions get an own connection that is multiplexed in the idle loop.
+ * Must be called while the connection of the primary partition is not in idle mode.
+ * @param mympd_state pointer to the mympd state struct
+ * @return true on success else false
+ */
+bool mpd_client_partitions_populate(struct t_mympd_state *mympd_state) {
+    struct t_partition_state *primary = mympd_state->partition_state;
+    if (mympd_state->mpd_state->feat_partitions == false) {
+        mpd_client_partitions_clear(mympd_state);
+        return true;
+    }
+    //a fresh connection starts in the default partition
+    if (strcmp(primary->name, "default") != 0) {
+        struct mpd_status *status = mpd_run_status(primary->conn);
+        if (status == NULL) {
+            return mympd_check_error_and_recover(primary);
+        }
+        if (strcmp(mpd_status_get_partition(status), primary->name) != 0 &&
+            mpd_run_switch_partition(primary->conn, primary->name) == false)
+        {
+            MYMPD_LOG_WARN("Partition \"%s\" does not exist anymore, switching to default partition", primary->name);
+            mympd_check_error_and_recover(primary);
+            primary->name = sds_replace(primary->name, "default");
+            //the settings and the jukebox queue belong to the partition
+            mympd_api_settings_partition_read(mympd_state->config->workdir, primary);
+            jukebox_clear(&primary->jukebox_queue);
+        }
+        mpd_status_free(status);
+    }
+    //get the partitions from mpd
+    struct t_list partitions;
+    list_init(&partitions);
+    if (mpd_send_listpartitions(primary->conn) == true) {
+        struct mpd_pair *pair;
+        while ((pair = mpd_recv_partition_pair(primary->conn)) != NULL) {
+            list_push(&partitions, pair->value, 0, NULL, NULL);
+            mpd_return_pair(primary->conn, pair);
+        }
+    }
+    mpd_response_finish(primary->conn);
+    if (mympd_check_error_and_recover(primary) == false) {
+        list_clear(&partitions);
+        return false;
+    }
+    //remove partitions that are deleted or are now the primary partition
+    struct t_partition_state *prev = primary;
+    struct t_partition_state *current = primary->next;
+    while (current != NULL) {
+        if (strcmp(current->name, primary->name) == 0 ||
+            list_get_node(&partitions, current->name) == NULL)
+        {
+            MYMPD_LOG_INFO("Removing connection for partition \"%s\"", current->name);
+            prev->next = current->next;
+            partition_free(current);
+            current = prev->next;
+            continue;
+        }
+        prev = current;
+        current = current->next;
+    }
+    //add connections for new partitions
+    int count = 0;
+    for (current = primary->next; current != NULL; current = current->next) {
+        count++;
+    }
+    struct t_list_node *node = partitions.head;
+    while (node != NULL) {
+        if (strcmp(node->key, primary->name) != 0 &&
+            mpd_client_partitions_get(mympd_state, node->key) == NULL)
+        {
+            if (count == MPD_PARTITIONS_MAX) {
+                MYMPD_LOG_WARN("Too many partitions, not adding a connection for \"%s\"", node->key);
+                break;
+            }
+            MYMPD_LOG_INFO("Adding connection for partition \"%s\"", node->key);
+            struct t_partition_state *partition_state = partition_new(mympd_state, node->key);
+            partition_connect(partition_state);
+            //append to the list, failed connections are retried
+            prev->next = partition_state;
+            prev = partition_state;
+            count++;
+        }
+        node = node->next;
+    }
+    list_clear(&partitions);
+    return true;
+}
+
+/**
+ * Disconnects and frees all additional partitions
+ * @param mympd_state pointer to the mympd state struct
+ */
+void mpd_client_partitions_clear(struct t_mympd_state *mympd_state) {
+    struct t_partition_state *current = mympd_state->partition_state->next;
+    while (current != NULL) {
+        struct t_partition_state *next = current->next;
+        partition_free(current);
+        current = next;
+    }
+    mympd_state->partition_state->next = NULL;
+}
+
+/**
+ * Handles failed connections of the additional partitions and reconnects them after a wait time
+ * @param mympd_state pointer to the mympd state struct
+ */
+void mpd_client_partitions_reconnect(struct t_mympd_state *mympd_state) {
+    time_t now = time(NULL);
+    for (struct t_partition_state *current = mympd_state->partition_state->next; current != NULL; current = current->next) {
+        switch(current->conn_state) {
+            case MPD_CONNECTED:
+                break;
+            case MPD_WAIT:
+                if (now > current->reconnect_time) {
+                    MYMPD_LOG_INFO("Reconnecting partition \"%s\"", current->name);
+                    partition_connect(current);
+                }
+                break;
+            default:
+                //failure or disconnect
+                mpd_client_disconnect(current);
+                current->conn_state = MPD_WAIT;
+                if (current->reconnect_interval < MPD_PARTITIONS_RECONNECT_MAX) {
+                    current->reconnect_interval += 2;
+                }
+                current->reconnect_time = now + current->reconnect_interval;
+        }
+    }
+}
+
+/**
+ * Removes the connection for a partition, mpd can not delete partitions with connected clients
+ * @param mympd_state pointer to the mympd state struct
+ * @param name partition name
+ * @return true if the partition was found, else false
+ */
+bool mpd_client_partitions_remove(struct t_mympd_state *mympd_state, const char *name) {
+    struct t_partition_state *prev = mympd_state->partition_state;
+    for (struct t_partition_state *current = prev->next; current != NULL; current = current->next) {
+        if (strcmp(current->name, name) == 0) {
+            prev->next = current->next;
+            partition_free(current);
+            return true;
+        }
+        prev = current;
+    }
+    return false;
+}
+
+/**
+ * Makes an additional partition to the primary partition.
+ * The partition states are moved together with their connections,
+ * the previous primary partition remains connected as additional partition.
+ * Must be called while the connection of the primary partition is not in idle mode.
+ * @param mympd_state pointer to the mympd state struct
+ * @param name partition name
+ * @return true on success, false if there is no connected partition with this name
+ */
+bool mpd_client_partitions_switch(struct t_mympd_state *mympd_state, const char *name) {
+    struct t_partition_state *primary = mympd_state->partition_state;
+    struct t_partition_state *prev = primary;
+    struct t_partition_state *current = primary->next;
+    while (current != NULL &&
+           strcmp(current->name, name) != 0)
+    {
+        prev = current;
+        current = current->next;
+    }
+    if (current == NULL ||
+        current->conn_state != MPD_CONNECTED)
+    {
+        return false;
+    }
+    //leave idle mode of the new primary partition, pending events are reflected by the status below
+    if (mpd_send_noidle(current->conn) == false) {
+        mympd_check_error_and_recover(current);
+        current->conn_state = MPD_FAILURE;
+        return false;
+    }
+    mpd_recv_idle(current->conn, false);
+    if (mympd_check_error_and_recover(current) == false) {
+        current->conn_state = MPD_FAILURE;
+        return false;
+    }
+    //enter idle mode for the previous primary partition
+    if (mpd_client_partition_send_idle(primary) == false) {
+        //the connection is reestablished by the idle loop
+        primary->conn_state = MPD_FAILURE;
+    }
+    //reorder the list
+    prev->next = current->next;
+    current->next = primary;
+    mympd_state->partition_state = current;
+    //protocol version is owned by the connection
+    mympd_state->mpd_state->protocol = mpd_connection_get_server_version(current->conn);
+    sds buffer = mympd_api_status_get(current, sdsempty(), REQUEST_ID_NOTIFY);
+    FREE_SDS(buffer);
+    MYMPD_LOG_INFO("Switched to partition \"%s\"", name);
+    return true;
+}
+
+/**
+ * Finds an additional partition by name
+ * @param mympd_state pointer to the mympd state struct
+ * @param name partition name
+ * @return pointer to the partition state or NULL if not found
+ */
+struct t_partition_state *mpd_client_partitions_get(struct t_mympd_state *mympd_state, const char *name) {
+    for (struct t_partition_state *current = mympd_state->partition_state->next; current != NULL; current = current->next) {
+        if (strcmp(current->name, name) == 0) {
+            return current;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Enters the idle mode for an additional partition
+ * @param partition_state pointer to the partition state
+ * @return true on success else false
+ */
+bool mpd_client_partition_send_idle(struct t_partition_state *partition_state) {
+    bool rc = mpd_send_idle_mask(partition_state->conn, MPD_IDLE_PARTITION_MASK);
+    return mympd_check_rc_error_and_recover(partition_state, rc, "mpd_send_idle_mask");
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Creates a new partition state
+ * @param mympd_state pointer to the mympd state struct
+ * @param name partition name
+ * @return pointer to the allocated partition state
+ */
+static struct t_partition_state *partition_new(struct t_mympd_state *mympd_state, const char *name) {
+    struct t_partition_state *partition_state = malloc_assert(sizeof(struct t_partition_state));
+    partition_state_default(partition_state, name);
+    partition_state->mpd_state = mympd_state->mpd_state;
+    mympd_api_settings_partition_read(mympd_state->config->workdir, partition_state);
+    return partition_state;
+}
+
+/**
+ * Connects an additional partition and enters the idle mode
+ * @param partition_state pointer to the partition state
+ * @return true on success else false
+ */
+static bool partition_connect(struct t_partition_state *partition_state) {
+    if (mpd_client_connect(partition_state) == false) {
+        partition_state->conn_state = MPD_FAILURE;
+        return false;
+    }
+    if (mpd_run_switch_partition(partition_state->conn, partition_state->name) == false) {
+        MYMPD_LOG_ERROR("Switching to partition \"%s\" failed", partition_state->name);
+        mympd_check_error_and_recover(partition_state);
+        partition_state->conn_state = MPD_FAILURE;
+        return false;
+    }
+    enable_mpd_tags(partition_state, &partition_state->mpd_state->tags_mympd);
+    //initial player states
+    sds buffer = mympd_api_status_get(partition_state, sdsempty(), REQUEST_ID_NOTIFY);
+    FREE_SDS(buffer);
+    if (partition_state->jukebox_mode != JUKEBOX_OFF) {
+        jukebox_run(partition_state);
+    }
+    if (partition_state->conn_state != MPD_CONNECTED ||
+        mpd_client_partition_send_idle(partition_state) == false)
+    {
+        partition_state->conn_state = MPD_FAILURE;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Disconnects and frees an additional partition
+ * @param partition_state pointer to the partition state
+ */
+static void partition_free(struct t_partition_state *partition_state) {
+    mpd_client_disconnect(partition_state);
+    partition_state_free(partition_state);
+}
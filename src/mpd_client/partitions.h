@@ -0,0 +1,25 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_MPD_CLIENT_PARTITIONS_H
+#define MYMPD_MPD_CLIENT_PARTITIONS_H
+
+#include "../lib/mympd_state.h"
+
+/**
+ * Idle events that are handled for the additional partitions,
+ * global events are only handled by the connection of the primary partition
+ */
+#define MPD_IDLE_PARTITION_MASK (MPD_IDLE_QUEUE | MPD_IDLE_PLAYER | MPD_IDLE_MIXER | MPD_IDLE_OUTPUT | MPD_IDLE_OPTIONS)
+
+bool mpd_client_partitions_populate(struct t_mympd_state *mympd_state);
+void mpd_client_partitions_clear(struct t_mympd_state *mympd_state);
+void mpd_client_partitions_reconnect(struct t_mympd_state *mympd_state);
+bool mpd_client_partitions_remove(struct t_mympd_state *mympd_state, const char *name);
+bool mpd_client_partitions_switch(struct t_mympd_state *mympd_state, const char *name);
+struct t_partition_state *mpd_client_partitions_get(struct t_mympd_state *mympd_state, const char *name);
+bool mpd_client_partition_send_idle(struct t_partition_state *partition_state);
+#endif
@@ -167,6 +167,35 @@ bool mpd_client_playlist_sort(struct t_partition_state *partition_state, const c
     return rc;
 }
 
+/**
+ * Adds a song to a rax tree that is ordered by the playlist sort key.
+ * The key is the lowercase value of the sort tag followed by the uri,
+ * or only the lowercase uri to sort by filename. Duplicates get a suffix.
+ * @param plist rax tree to insert the song, data: uri as sds string
+ * @param key already allocated sds string, it is used as buffer
+ * @param tag_value value of the sort tag or NULL to sort by filename
+ * @param uri song uri
+ * @return pointer to key
+ */
+sds mpd_client_playlist_sort_add(rax *plist, sds key, const char *tag_value, const char *uri) {
+    sdsclear(key);
+    if (tag_value != NULL) {
+        //sort by tag
+        key = sdscatfmt(key, "%s::%s", tag_value, uri);
+    }
+    else {
+        //sort by filename
+        key = sdscat(key, uri);
+    }
+    sds_utf8_tolower(key);
+    sds data = sdsnew(uri);
+    while (raxTryInsert(plist, (unsigned char *)key, sdslen(key), data, NULL) == 0) {
+        //duplicate - add chars until it is uniq
+        key = sdscatlen(key, ":", 1);
+    }
+    return key;
+}
+
 /**
  * Private functions
  */
@@ -204,28 +233,21 @@ static bool _mpd_client_playlist_sort(struct t_partition_state *partition_state,
 
     rax *plist = raxNew();
     sds key = sdsempty();
+    sds value = sdsempty();
     struct mpd_song *song;
     while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
-        const char *song_uri = mpd_song_get_uri(song);
-        sdsclear(key);
         if (sort_tags.tags[0] != MPD_TAG_UNKNOWN) {
-            //sort by tag
-            key = mpd_client_get_tag_value_string(song, sort_tags.tags[0], key);
-            key = sdscatfmt(key, "::%s", song_uri);
+            sdsclear(value);
+            value = mpd_client_get_tag_value_string(song, sort_tags.tags[0], value);
+            key = mpd_client_playlist_sort_add(plist, key, value, mpd_song_get_uri(song));
         }
         else {
-            //sort by filename
-            key = sdscat(key, song_uri);
-        }
-        sds_utf8_tolower(key);
-        sds data = sdsnew(song_uri);
-        while (raxTryInsert(plist, (unsigned char *)key, sdslen(key), data, NULL) == 0) {
-            //duplicate - add chars until it is uniq
-            key = sdscatlen(key, ":", 1);
+            key = mpd_client_playlist_sort_add(plist, key, NULL, mpd_song_get_uri(song));
         }
         mpd_song_free(song);
     }
     FREE_SDS(key);
+    FREE_SDS(value);
     mpd_response_finish(partition_state->conn);
     if (mympd_check_error_and_recover(partition_state) == false) {
         //free data
@@ -18,6 +18,7 @@ enum playlist_types {
 
 bool mpd_client_playlist_shuffle(struct t_partition_state *partition_state, const char *uri);
 bool mpd_client_playlist_sort(struct t_partition_state *partition_state, const char *uri, const char *tagstr);
+sds mpd_client_playlist_sort_add(rax *plist, sds key, const char *tag_value, const char *uri);
 time_t mpd_client_get_playlist_mtime(struct t_partition_state *partition_state, const char *playlist);
 time_t mpd_client_get_db_mtime(struct t_partition_state *partition_state);
 int mpd_client_enum_playlist(struct t_partition_state *partition_state, const char *playlist, bool empty_check);
@@ -0,0 +1,176 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "queue_mirror.h"
+
+#include "../lib/log.h"
+#include "../lib/mem.h"
+#include "errorhandler.h"
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes an empty and invalid queue mirror
+ * @param mirror pointer to the queue mirror
+ */
+void queue_mirror_init(struct t_queue_mirror *mirror) {
+    mirror->songs = NULL;
+    mirror->length = 0;
+    mirror->capacity = 0;
+    mirror->version = 0;
+    mirror->valid = false;
+    mirror->total_time = 0;
+}
+
+/**
+ * Frees all songs of the queue mirror and invalidates it
+ * @param mirror pointer to the queue mirror
+ */
+void queue_mirror_clear(struct t_queue_mirror *mirror) {
+    queue_mirror_set_length(mirror, 0);
+    FREE_PTR(mirror->songs);
+    queue_mirror_init(mirror);
+}
+
+/**
+ * Truncates or extends the queue mirror.
+ * Songs behind the new length are freed, new slots are empty.
+ * @param mirror pointer to the queue mirror
+ * @param length new queue length
+ */
+void queue_mirror_set_length(struct t_queue_mirror *mirror, unsigned length) {
+    for (unsigned i = length; i < mirror->length; i++) {
+        if (mirror->songs[i] != NULL) {
+            mirror->total_time -= mpd_song_get_duration(mirror->songs[i]);
+            mpd_song_free(mirror->songs[i]);
+        }
+    }
+    if (length > mirror->capacity) {
+        unsigned capacity = mirror->capacity == 0 ? 64 : mirror->capacity;
+        while (capacity < length) {
+            capacity *= 2;
+        }
+        mirror->songs = realloc_assert(mirror->songs, capacity * sizeof(struct mpd_song *));
+        mirror->capacity = capacity;
+    }
+    for (unsigned i = mirror->length; i < length; i++) {
+        mirror->songs[i] = NULL;
+    }
+    mirror->length = length;
+}
+
+/**
+ * Replaces the song at the position of the song, the mirror takes the ownership of the song
+ * @param mirror pointer to the queue mirror
+ * @param song song from the plchanges or playlistinfo response
+ * @return true on success, false if the position is out of range
+ */
+bool queue_mirror_replace(struct t_queue_mirror *mirror, struct mpd_song *song) {
+    unsigned pos = mpd_song_get_pos(song);
+    if (pos >= mirror->length) {
+        return false;
+    }
+    if (mirror->songs[pos] != NULL) {
+        mirror->total_time -= mpd_song_get_duration(mirror->songs[pos]);
+        mpd_song_free(mirror->songs[pos]);
+    }
+    mirror->songs[pos] = song;
+    mirror->total_time += mpd_song_get_duration(song);
+    return true;
+}
+
+/**
+ * Checks if all positions of the queue mirror are populated
+ * @param mirror pointer to the queue mirror
+ * @return true if complete, else false
+ */
+bool queue_mirror_is_complete(const struct t_queue_mirror *mirror) {
+    for (unsigned i = 0; i < mirror->length; i++) {
+        if (mirror->songs[i] == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Updates the queue mirror to the current queue version.
+ * Nothing is sent to mpd if the tracked queue version has not changed,
+ * else only the changes since the mirrored version are fetched.
+ * The connection must not be in idle mode.
+ * @param partition_state pointer to the partition state
+ * @param changes list to append the changed positions or NULL
+ * @return true on success else false
+ */
+bool queue_mirror_sync(struct t_partition_state *partition_state, struct t_list *changes) {
+    struct t_queue_mirror *mirror = &partition_state->queue_mirror;
+    if (mirror->valid == true &&
+        mirror->version == partition_state->queue_version)
+    {
+        return true;
+    }
+    struct mpd_status *status = mpd_run_status(partition_state->conn);
+    if (status == NULL) {
+        mympd_check_error_and_recover(partition_state);
+        return false;
+    }
+    partition_state->queue_version = mpd_status_get_queue_version(status);
+    partition_state->queue_length = (long long)mpd_status_get_queue_length(status);
+    mpd_status_free(status);
+    if (mirror->valid == true &&
+        mirror->version == partition_state->queue_version)
+    {
+        return true;
+    }
+
+    bool full_reload = mirror->valid == false;
+    bool rc;
+    if (full_reload == true) {
+        queue_mirror_clear(mirror);
+        rc = mpd_send_list_queue_meta(partition_state->conn);
+    }
+    else {
+        rc = mpd_send_queue_changes_meta(partition_state->conn, mirror->version);
+    }
+    if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_send_queue_changes_meta") == false) {
+        queue_mirror_clear(mirror);
+        return false;
+    }
+    queue_mirror_set_length(mirror, (unsigned)partition_state->queue_length);
+    unsigned change_count = 0;
+    struct mpd_song *song;
+    while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
+        unsigned pos = mpd_song_get_pos(song);
+        if (queue_mirror_replace(mirror, song) == false) {
+            //queue has changed since the status command
+            mpd_song_free(song);
+        }
+        else if (changes != NULL) {
+            list_push(changes, "", (long long)pos, NULL, NULL);
+        }
+        change_count++;
+    }
+    mpd_response_finish(partition_state->conn);
+    if (mympd_check_error_and_recover(partition_state) == false) {
+        queue_mirror_clear(mirror);
+        return false;
+    }
+    if (queue_mirror_is_complete(mirror) == false) {
+        MYMPD_LOG_WARN("Queue mirror is incomplete");
+        queue_mirror_clear(mirror);
+        //reload the complete queue once
+        return full_reload == false
+            ? queue_mirror_sync(partition_state, changes)
+            : false;
+    }
+    mirror->version = partition_state->queue_version;
+    mirror->valid = true;
+    MYMPD_LOG_DEBUG("Queue mirror updated to version %u with %u changes", mirror->version, change_count);
+    return true;
+}
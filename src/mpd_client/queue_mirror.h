@@ -0,0 +1,18 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_MPD_CLIENT_QUEUE_MIRROR_H
+#define MYMPD_MPD_CLIENT_QUEUE_MIRROR_H
+
+#include "../lib/mympd_state.h"
+
+void queue_mirror_init(struct t_queue_mirror *mirror);
+void queue_mirror_clear(struct t_queue_mirror *mirror);
+void queue_mirror_set_length(struct t_queue_mirror *mirror, unsigned length);
+bool queue_mirror_replace(struct t_queue_mirror *mirror, struct mpd_song *song);
+bool queue_mirror_is_complete(const struct t_queue_mirror *mirror);
+bool queue_mirror_sync(struct t_partition_state *partition_state, struct t_list *changes);
+#endif
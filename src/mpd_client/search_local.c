@@ -12,6 +12,7 @@
 #include "../lib/utility.h"
 #include "../lib/mem.h"
 #include "../lib/sds_extras.h"
+#include "tags.h"
 
 #define PCRE2_CODE_UNIT_WIDTH 8
 #include <pcre2.h>
@@ -52,6 +53,26 @@ static bool _cmp_regex(pcre2_code *re_compiled, const char *value);
  * Public functions
  */
 
+/**
+ * Checks if all tags of a parsed search expression are included in the song data
+ * @param expr_list expression list returned by parse_search_expression_to_list
+ * @param tags tags that are included in the song data
+ * @return true if all tags are included, else false
+ */
+bool search_expression_tags_exist(struct t_list *expr_list, const struct t_tags *tags) {
+    struct t_list_node *current = expr_list->head;
+    while (current != NULL) {
+        struct t_search_expression *expr = (struct t_search_expression *)current->user_data;
+        if (expr->tag >= 0 &&
+            mpd_client_tag_exists(tags, (enum mpd_tag_type)expr->tag) == false)
+        {
+            return false;
+        }
+        current = current->next;
+    }
+    return true;
+}
+
 /**
  * Searches for a string in mpd tag values
  * @param song pointer to mpd song struct
@@ -181,6 +202,61 @@ void *free_search_expression_list(struct t_list *expr_list) {
     return list_free_user_data(expr_list, free_search_expression_node);
 }
 
+/**
+ * Checks if a parsed search expression can be evaluated with search_song_expression
+ * @param expr_list expression list returned by parse_search_expression_to_list
+ * @param expression the unparsed mpd search expression
+ * @return true if all parts of the expression are parsed and reference only tags, else false
+ */
+bool search_expression_is_local(struct t_list *expr_list, sds expression) {
+    if (strchr(expression, '\\') != NULL) {
+        //the parser does not unescape values
+        return false;
+    }
+    long count = 1;
+    const char *p = expression;
+    while ((p = strstr(p, ") AND (")) != NULL) {
+        count++;
+        p += 7;
+    }
+    if (expr_list->length != count) {
+        return false;
+    }
+    struct t_list_node *current = expr_list->head;
+    while (current != NULL) {
+        struct t_search_expression *expr = (struct t_search_expression *)current->user_data;
+        if (expr->tag == -1 ||
+            ((expr->op == SEARCH_OP_REGEX || expr->op == SEARCH_OP_NOT_REGEX) && expr->re_compiled == NULL))
+        {
+            return false;
+        }
+        current = current->next;
+    }
+    return true;
+}
+
+/**
+ * Checks if the local evaluation of an expression gives the same results as the
+ * mpd database search. The exact match operators compare case insensitive and
+ * the special "any" tag uses only the enabled tags of myMPD.
+ * @param expr_list expression list returned by parse_search_expression
+ * @return true if the expression can be evaluated locally, else false
+ */
+bool search_expression_is_local_db(struct t_list *expr_list) {
+    struct t_list_node *current = expr_list->head;
+    while (current != NULL) {
+        struct t_search_expression *expr = (struct t_search_expression *)current->user_data;
+        if (expr->tag == -2 ||
+            expr->op == SEARCH_OP_EQUAL ||
+            expr->op == SEARCH_OP_NOT_EQUAL)
+        {
+            return false;
+        }
+        current = current->next;
+    }
+    return true;
+}
+
 /**
  * Searches for a string in mpd tag values
  * @param song pointer to mpd song struct
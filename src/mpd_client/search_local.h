@@ -12,5 +12,8 @@
 bool search_mpd_song(const struct mpd_song *song, sds searchstr, const struct t_tags *tags);
 struct t_list *parse_search_expression_to_list(sds expression);
 void *free_search_expression_list(struct t_list *expr_list);
+bool search_expression_is_local(struct t_list *expr_list, sds expression);
+bool search_expression_is_local_db(struct t_list *expr_list);
+bool search_expression_tags_exist(struct t_list *expr_list, const struct t_tags *tags);
 bool search_song_expression(struct mpd_song *song, struct t_list *expr_list, struct t_tags *browse_tag_types);
 #endif
@@ -11,6 +11,7 @@
 #include "../lib/log.h"
 #include "../lib/sds_extras.h"
 #include "cache.h"
+#include "covercache.h"
 #include "smartpls.h"
 
 #include <stdlib.h>
@@ -79,6 +80,23 @@ void mpd_worker_api(struct t_mpd_worker_state *mpd_worker_state) {
                 }
             }
             break;
+        case MYMPD_API_COVERCACHE_PREWARM: {
+            struct t_list *uris = (struct t_list *)request->extra;
+            response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+                JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_INFO, "Covercache pre-warming started");
+            if (request->conn_id > -1) {
+                MYMPD_LOG_DEBUG("Push response to queue for connection %lld: %s", request->conn_id, response->data);
+                mympd_queue_push(web_server_queue, response, 0);
+            }
+            else {
+                free_response(response);
+            }
+            free_request(request);
+            mpd_worker_covercache_prewarm(mpd_worker_state, uris);
+            list_free(uris);
+            async = true;
+            break;
+        }
         case INTERNAL_API_CACHES_CREATE:
             mpd_worker_cache_init(mpd_worker_state);
             async = true;
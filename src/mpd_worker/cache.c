@@ -15,6 +15,7 @@
 #include "../lib/sticker_cache.h"
 #include "../mpd_client/errorhandler.h"
 #include "../mpd_client/tags.h"
+#include "covercache.h"
 
 #include <inttypes.h>
 #include <stdio.h>
@@ -55,6 +56,18 @@ bool mpd_worker_cache_init(struct t_mpd_worker_state *mpd_worker_state) {
         rc =_cache_init(mpd_worker_state, album_cache.cache, sticker_cache.cache);
     }
 
+    //collect the album uris for the covercache pre-warming before the album cache is handed over
+    struct t_config *config = mpd_worker_state->mpd_state->config;
+    struct t_list *prewarm_uris = NULL;
+    if (rc == true &&
+        mpd_worker_state->mpd_state->feat_tags == true &&
+        config->covercache_prewarm == true &&
+        config->covercache_keep_days > 0)
+    {
+        prewarm_uris = list_new();
+        album_cache_get_uris(&album_cache, prewarm_uris);
+    }
+
     //push album cache building response to mpd_client thread
     if (mpd_worker_state->partition_state->mpd_state->feat_tags == true) {
         if (rc == true) {
@@ -90,6 +103,11 @@ bool mpd_worker_cache_init(struct t_mpd_worker_state *mpd_worker_state) {
     else {
         MYMPD_LOG_INFO("Skipped sticker cache creation, stickers are disabled");
     }
+
+    if (prewarm_uris != NULL) {
+        mpd_worker_covercache_prewarm(mpd_worker_state, prewarm_uris);
+        list_free(prewarm_uris);
+    }
     return rc;
 }
 
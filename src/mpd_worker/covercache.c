@@ -0,0 +1,393 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "covercache.h"
+
+#include "../lib/api.h"
+#include "../lib/coverextract.h"
+#include "../lib/covercache.h"
+#include "../lib/filehandler.h"
+#include "../lib/jsonrpc.h"
+#include "../lib/log.h"
+#include "../lib/mem.h"
+#include "../lib/mimetype.h"
+#include "../lib/sds_extras.h"
+#include "../lib/thumbnail.h"
+#include "../lib/utility.h"
+#include "../mympd_api/albumart.h"
+
+#include <errno.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+/**
+ * Privat definitions
+ */
+
+/**
+ * Shared state of the pre-warming threads
+ */
+struct t_prewarm_state {
+    struct t_config *config;       //!< pointer to myMPD config
+    sds music_directory;           //!< mpd music directory, empty if not accessible
+    sds *coverimage_names;         //!< coverimage names
+    int coverimage_names_len;      //!< number of coverimage names
+    sds *thumbnail_names;          //!< thumbnail names
+    int thumbnail_names_len;       //!< number of thumbnail names
+    bool thumbnails;               //!< true if thumbnails should be created
+    const char **uris;             //!< the album uris to process
+    long total;                    //!< number of album uris
+    _Atomic long next;             //!< index of the next uri to process
+    _Atomic long processed;        //!< number of processed uris
+    _Atomic long created;          //!< number of images added to the covercache
+};
+
+/**
+ * State of a pre-warming thread
+ */
+struct t_prewarm_thread {
+    pthread_t thread;                //!< thread id
+    struct t_prewarm_state *state;   //!< pointer to the shared state
+    struct t_list mpd_uris;          //!< uris without local coverimage, they are fetched from mpd
+};
+
+static void *prewarm_thread_run(void *arg);
+static void prewarm_process(struct t_prewarm_thread *prewarm_thread);
+static bool prewarm_local(struct t_prewarm_state *state, const char *uri);
+static void prewarm_mpd(struct t_mpd_worker_state *mpd_worker_state, struct t_prewarm_state *state, const char *uri);
+static sds prewarm_find_coverfile(struct t_prewarm_state *state, sds path, sds *names, int names_len, sds coverfile);
+static void prewarm_thumbnail_file(struct t_prewarm_state *state, const char *uri, sds filepath);
+static void prewarm_thumbnail(struct t_prewarm_state *state, const char *uri, sds binary);
+static void prewarm_progress(struct t_prewarm_state *state, long processed);
+
+/**
+ * Only one pre-warming job should run at once
+ */
+static _Atomic bool prewarm_running;
+
+/**
+ * Public functions
+ */
+
+/**
+ * Pre-warms the covercache for the given album uris.
+ * Coverimages are searched in the covercache, the music directory, embedded in the media files
+ * and at last they are fetched from mpd. Missing thumbnails are generated.
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ * @param uris list of album uris (uri of the first song of each album)
+ * @return true on success, else false
+ */
+bool mpd_worker_covercache_prewarm(struct t_mpd_worker_state *mpd_worker_state, struct t_list *uris) {
+    struct t_config *config = mpd_worker_state->mpd_state->config;
+    if (config->covercache_keep_days == 0) {
+        send_jsonrpc_notify(JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Covercache is disabled");
+        return false;
+    }
+    if (atomic_exchange(&prewarm_running, true) == true) {
+        send_jsonrpc_notify(JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_WARN, "Covercache pre-warming is already running");
+        return false;
+    }
+    MYMPD_LOG_NOTICE("Pre-warming covercache for %ld albums", uris->length);
+    //lower the priority of this thread, the helper threads inherit it
+    errno = 0;
+    if (nice(19) == -1 &&
+        errno != 0)
+    {
+        MYMPD_LOG_WARN("Can not lower the priority of the covercache pre-warming thread");
+        MYMPD_LOG_ERRNO(errno);
+    }
+
+    struct t_prewarm_state state;
+    state.config = config;
+    state.music_directory = mpd_worker_state->mpd_state->music_directory_value;
+    state.coverimage_names = sds_split_comma_trim(mpd_worker_state->coverimage_names, &state.coverimage_names_len);
+    state.thumbnail_names = sds_split_comma_trim(mpd_worker_state->thumbnail_names, &state.thumbnail_names_len);
+    #ifdef ENABLE_THUMBNAILS
+        state.thumbnails = config->thumbnail_size > 0 ? true : false;
+    #else
+        state.thumbnails = false;
+    #endif
+    state.total = uris->length;
+    state.uris = malloc_assert((size_t)(uris->length + 1) * sizeof(char *));
+    long i = 0;
+    struct t_list_node *current = uris->head;
+    while (current != NULL) {
+        state.uris[i++] = current->key;
+        current = current->next;
+    }
+    atomic_store(&state.next, 0);
+    atomic_store(&state.processed, 0);
+    atomic_store(&state.created, 0);
+
+    //the calling thread is the first pre-warming thread
+    int thread_count = config->covercache_prewarm_threads;
+    struct t_prewarm_thread *threads = malloc_assert((size_t)thread_count * sizeof(struct t_prewarm_thread));
+    for (int j = 0; j < thread_count; j++) {
+        threads[j].state = &state;
+        list_init(&threads[j].mpd_uris);
+    }
+    int started = 1;
+    for (int j = 1; j < thread_count; j++) {
+        if (pthread_create(&threads[j].thread, NULL, prewarm_thread_run, &threads[j]) != 0) {
+            MYMPD_LOG_ERROR("Can not create covercache pre-warming thread");
+            break;
+        }
+        started++;
+    }
+    prewarm_process(&threads[0]);
+    for (int j = 1; j < started; j++) {
+        pthread_join(threads[j].thread, NULL);
+    }
+
+    //mpd can only be queried through the connection of this thread
+    for (int j = 0; j < thread_count; j++) {
+        current = threads[j].mpd_uris.head;
+        while (current != NULL) {
+            prewarm_mpd(mpd_worker_state, &state, current->key);
+            prewarm_progress(&state, ++state.processed);
+            current = current->next;
+        }
+        list_clear(&threads[j].mpd_uris);
+    }
+    FREE_PTR(threads);
+    FREE_PTR(state.uris);
+    sdsfreesplitres(state.coverimage_names, state.coverimage_names_len);
+    sdsfreesplitres(state.thumbnail_names, state.thumbnail_names_len);
+
+    MYMPD_LOG_NOTICE("Covercache pre-warming finished, added %ld images for %ld albums", (long)state.created, state.total);
+    sds total_str = sdsfromlonglong((long long)state.total);
+    sds created_str = sdsfromlonglong((long long)state.created);
+    sds buffer = jsonrpc_notify_phrase(sdsempty(), JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_INFO,
+        "Covercache pre-warming finished: %{created} images added for %{total} albums", 4, "created", created_str, "total", total_str);
+    ws_notify(buffer);
+    FREE_SDS(buffer);
+    FREE_SDS(total_str);
+    FREE_SDS(created_str);
+    send_jsonrpc_event(JSONRPC_EVENT_UPDATE_COVERCACHE);
+    atomic_store(&prewarm_running, false);
+    return true;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Main function of the additional pre-warming threads
+ * @param arg void pointer to t_prewarm_thread struct
+ * @return NULL
+ */
+static void *prewarm_thread_run(void *arg) {
+    thread_logname = sdsnew("covercache");
+    prctl(PR_SET_NAME, thread_logname, 0, 0, 0);
+    prewarm_process((struct t_prewarm_thread *) arg);
+    FREE_SDS(thread_logname);
+    return NULL;
+}
+
+/**
+ * Processes uris until all uris are processed
+ * @param prewarm_thread pointer to t_prewarm_thread struct
+ */
+static void prewarm_process(struct t_prewarm_thread *prewarm_thread) {
+    struct t_prewarm_state *state = prewarm_thread->state;
+    long i;
+    while ((i = state->next++) < state->total) {
+        const char *uri = state->uris[i];
+        if (prewarm_local(state, uri) == true) {
+            prewarm_progress(state, ++state->processed);
+        }
+        else {
+            list_push(&prewarm_thread->mpd_uris, uri, 0, NULL, NULL);
+        }
+    }
+}
+
+/**
+ * Pre-warms the covercache from local files
+ * @param state pointer to shared pre-warming state
+ * @param uri album uri
+ * @return true if the uri was handled, false if mpd should be asked
+ */
+static bool prewarm_local(struct t_prewarm_state *state, const char *uri) {
+    struct t_config *config = state->config;
+    //check covercache
+    sds coverfile = sdsempty();
+    coverfile = covercache_get_file(config->cachedir, uri, 0, 0, coverfile);
+    if (sdslen(coverfile) > 0) {
+        prewarm_thumbnail_file(state, uri, coverfile);
+        FREE_SDS(coverfile);
+        return true;
+    }
+    if (sdslen(state->music_directory) == 0) {
+        FREE_SDS(coverfile);
+        return false;
+    }
+    //check for images in the album folder
+    sds path = sdsnew(uri);
+    dirname(path);
+    sdsupdatelen(path);
+    if (is_virtual_cuedir(state->music_directory, path) == true) {
+        //fix virtual cue sheet directories
+        dirname(path);
+        sdsupdatelen(path);
+    }
+    //thumbnail images are served as they are
+    coverfile = prewarm_find_coverfile(state, path, state->thumbnail_names, state->thumbnail_names_len, coverfile);
+    if (sdslen(coverfile) > 0) {
+        FREE_SDS(path);
+        FREE_SDS(coverfile);
+        return true;
+    }
+    coverfile = prewarm_find_coverfile(state, path, state->coverimage_names, state->coverimage_names_len, coverfile);
+    FREE_SDS(path);
+    if (sdslen(coverfile) > 0) {
+        prewarm_thumbnail_file(state, uri, coverfile);
+        FREE_SDS(coverfile);
+        return true;
+    }
+    //try to extract embedded coverimages
+    sds mediafile = sdscatfmt(coverfile, "%S/%s", state->music_directory, uri);
+    sds binary = sdsempty();
+    bool rc = false;
+    if (coverextract(mediafile, &binary, 0) == true) {
+        const char *mime_type = get_mime_type_by_magic_stream(binary);
+        if (covercache_write_file(config->cachedir, uri, mime_type, binary, 0) == true) {
+            state->created++;
+        }
+        prewarm_thumbnail(state, uri, binary);
+        rc = true;
+    }
+    FREE_SDS(binary);
+    FREE_SDS(mediafile);
+    return rc;
+}
+
+/**
+ * Fetches the coverimage from mpd, mympd_api_albumart_getcover writes it to the covercache
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ * @param state pointer to shared pre-warming state
+ * @param uri album uri
+ */
+static void prewarm_mpd(struct t_mpd_worker_state *mpd_worker_state, struct t_prewarm_state *state, const char *uri) {
+    if (mpd_worker_state->mpd_state->feat_albumart == false &&
+        mpd_worker_state->mpd_state->feat_readpicture == false)
+    {
+        return;
+    }
+    sds binary = sdsempty();
+    sds buffer = mympd_api_albumart_getcover(mpd_worker_state->partition_state, sdsempty(), 0, uri, &binary);
+    if (sdslen(binary) > 0) {
+        state->created++;
+        prewarm_thumbnail(state, uri, binary);
+    }
+    FREE_SDS(buffer);
+    FREE_SDS(binary);
+}
+
+/**
+ * Searches for a coverimage in the music directory
+ * @param state pointer to shared pre-warming state
+ * @param path directory relative to the music directory
+ * @param names coverimage names to check
+ * @param names_len number of coverimage names
+ * @param coverfile already allocated sds string to populate with the found file
+ * @return pointer to coverfile, empty if no image was found
+ */
+static sds prewarm_find_coverfile(struct t_prewarm_state *state, sds path, sds *names, int names_len, sds coverfile) {
+    for (int j = 0; j < names_len; j++) {
+        sdsclear(coverfile);
+        coverfile = sdscatfmt(coverfile, "%S/%S/%S", state->music_directory, path, names[j]);
+        if (strchr(names[j], '.') == NULL) {
+            //basename, try extensions
+            coverfile = find_image_file(coverfile);
+        }
+        if (sdslen(coverfile) > 0 &&
+            access(coverfile, F_OK) == 0) /* Flawfinder: ignore */
+        {
+            return coverfile;
+        }
+    }
+    sdsclear(coverfile);
+    return coverfile;
+}
+
+/**
+ * Reads the image and creates the thumbnail
+ * @param state pointer to shared pre-warming state
+ * @param uri album uri
+ * @param filepath image to create the thumbnail from
+ */
+static void prewarm_thumbnail_file(struct t_prewarm_state *state, const char *uri, sds filepath) {
+    if (state->thumbnails == false) {
+        return;
+    }
+    sds thumbfile = sdsempty();
+    thumbfile = covercache_get_file(state->config->cachedir, uri, 0, state->config->thumbnail_size, thumbfile);
+    if (sdslen(thumbfile) > 0 ||
+        covercache_thumbnail_skipped(state->config->cachedir, uri, 0, state->config->thumbnail_size) == true)
+    {
+        FREE_SDS(thumbfile);
+        return;
+    }
+    FREE_SDS(thumbfile);
+    sds binary = sdsempty();
+    if (read_data_from_file(&binary, filepath, MPD_BINARY_SIZE_MAX) == true) {
+        prewarm_thumbnail(state, uri, binary);
+    }
+    FREE_SDS(binary);
+}
+
+/**
+ * Creates the thumbnail and writes it to the covercache,
+ * a marker is written if no thumbnail could be created
+ * @param state pointer to shared pre-warming state
+ * @param uri album uri
+ * @param binary image to create the thumbnail from
+ */
+static void prewarm_thumbnail(struct t_prewarm_state *state, const char *uri, sds binary) {
+    if (state->thumbnails == false) {
+        return;
+    }
+    sds thumbnail = sdsempty();
+    if (thumbnail_create(binary, sdslen(binary), state->config->thumbnail_size, state->config->thumbnail_quality, &thumbnail) == false) {
+        sdsclear(thumbnail);
+    }
+    if (covercache_write_thumbnail(state->config->cachedir, uri, thumbnail, 0, state->config->thumbnail_size) == true &&
+        sdslen(thumbnail) > 0)
+    {
+        state->created++;
+    }
+    FREE_SDS(thumbnail);
+}
+
+/**
+ * Sends a progress notification in COVERCACHE_PREWARM_PROGRESS_STEPS steps
+ * @param state pointer to shared pre-warming state
+ * @param processed number of processed uris
+ */
+static void prewarm_progress(struct t_prewarm_state *state, long processed) {
+    long step = state->total / COVERCACHE_PREWARM_PROGRESS_STEPS;
+    if (step == 0 ||
+        processed % step != 0 ||
+        processed == state->total)
+    {
+        return;
+    }
+    sds processed_str = sdsfromlonglong((long long)processed);
+    sds total_str = sdsfromlonglong((long long)state->total);
+    sds buffer = jsonrpc_notify_phrase(sdsempty(), JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_INFO,
+        "Covercache pre-warming: %{processed} of %{total} albums", 4, "processed", processed_str, "total", total_str);
+    ws_notify(buffer);
+    FREE_SDS(buffer);
+    FREE_SDS(processed_str);
+    FREE_SDS(total_str);
+}
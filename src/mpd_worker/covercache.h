@@ -0,0 +1,14 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_MPD_WORKER_COVERCACHE_H
+#define MYMPD_MPD_WORKER_COVERCACHE_H
+
+#include "../lib/list.h"
+#include "state.h"
+
+bool mpd_worker_covercache_prewarm(struct t_mpd_worker_state *mpd_worker_state, struct t_list *uris);
+#endif
@@ -57,6 +57,8 @@ bool mpd_worker_start(struct t_mympd_state *mympd_state, struct t_work_request *
     mpd_worker_state->smartpls_sort = sdsdup(mympd_state->smartpls_sort);
     mpd_worker_state->smartpls_prefix = sdsdup(mympd_state->smartpls_prefix);
     copy_tag_types(&mympd_state->smartpls_generate_tag_types, &mpd_worker_state->smartpls_generate_tag_types);
+    mpd_worker_state->coverimage_names = sdsdup(mympd_state->coverimage_names);
+    mpd_worker_state->thumbnail_names = sdsdup(mympd_state->thumbnail_names);
 
     //mpd state
     mpd_worker_state->mpd_state = malloc_assert(sizeof(struct t_mpd_state));
@@ -73,6 +75,10 @@ bool mpd_worker_start(struct t_mympd_state *mympd_state, struct t_work_request *
     mpd_worker_state->mpd_state->feat_stickers = mympd_state->mpd_state->feat_stickers;
     mpd_worker_state->mpd_state->feat_playlists = mympd_state->mpd_state->feat_playlists;
     mpd_worker_state->mpd_state->feat_whence = mympd_state->mpd_state->feat_whence;
+    mpd_worker_state->mpd_state->feat_albumart = mympd_state->mpd_state->feat_albumart;
+    mpd_worker_state->mpd_state->feat_readpicture = mympd_state->mpd_state->feat_readpicture;
+    mpd_worker_state->mpd_state->mpd_binarylimit = mympd_state->mpd_state->mpd_binarylimit;
+    mpd_worker_state->mpd_state->music_directory_value = sds_replace(mpd_worker_state->mpd_state->music_directory_value, mympd_state->mpd_state->music_directory_value);
     mpd_worker_state->mpd_state->tag_albumartist = mympd_state->partition_state->mpd_state->tag_albumartist;
     copy_tag_types(&mympd_state->mpd_state->tags_mympd, &mpd_worker_state->mpd_state->tags_mympd);
 
@@ -0,0 +1,454 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "pool.h"
+
+#include "../lib/jsonrpc.h"
+#include "../lib/list.h"
+#include "../lib/log.h"
+#include "../lib/mem.h"
+#include "../lib/response_cache.h"
+#include "../lib/response_stream.h"
+#include "../lib/sds_extras.h"
+#include "../lib/sticker_cache.h"
+#include "../mpd_client/connection.h"
+#include "../mpd_client/tags.h"
+#include "../mympd_api/albumart.h"
+#include "../mympd_api/playlists.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/prctl.h>
+
+/**
+ * The mpd_worker pool serves read heavy api requests with auxiliary mpd connections.
+ * The mympd_api thread keeps the primary connection for idle handling and control,
+ * the pool threads connect lazily and use a snapshot of the mpd settings.
+ */
+
+/**
+ * Privat definitions
+ */
+
+/**
+ * State of the mpd_worker pool
+ */
+struct t_mpd_worker_pool {
+    pthread_t threads[MPD_WORKER_POOL_SIZE];  //!< the pool threads
+    int thread_count;                         //!< number of started threads
+    struct t_mympd_queue *queue;              //!< requests for the pool threads
+    pthread_mutex_t mutex;                    //!< protects the settings snapshot
+    struct t_mpd_state *settings;             //!< snapshot of the mpd settings and features
+    _Atomic unsigned generation;              //!< incremented on each settings change
+    _Atomic bool available;                   //!< true if the primary connection is established
+    _Atomic bool stop;                        //!< true to stop the pool threads
+    pthread_rwlock_t sticker_lock;            //!< protects the sticker cache of the mympd_api thread
+    struct t_cache *sticker_cache;            //!< sticker cache of the mympd_api thread
+    rax *sticker_cache_pending;               //!< new sticker cache, swapped if no pool thread reads the cache
+    struct t_response_cache *response_cache;  //!< response cache of the mympd_api thread
+};
+
+static struct t_mpd_worker_pool pool;
+
+static void *mpd_worker_pool_run(void *arg);
+static void mpd_worker_pool_handle(struct t_partition_state *partition_state, struct t_work_request *request);
+static struct t_work_response *mpd_worker_pool_handle_request(struct t_partition_state *partition_state,
+        struct t_work_request *request, bool *streamed);
+static void copy_mpd_settings(struct t_mpd_state *src, struct t_mpd_state *dst);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Starts the pool threads, called from the mympd_api thread
+ * @param mympd_state pointer to mympd_state struct
+ * @return true on success, else false
+ */
+bool mpd_worker_pool_start(struct t_mympd_state *mympd_state) {
+    pool.queue = mympd_queue_create("mpd_worker_pool_queue", QUEUE_TYPE_REQUEST);
+    pool.settings = malloc_assert(sizeof(struct t_mpd_state));
+    mpd_state_default(pool.settings);
+    pool.sticker_cache = &mympd_state->mpd_state->sticker_cache;
+    pool.sticker_cache_pending = NULL;
+    pool.response_cache = &mympd_state->mpd_state->response_cache;
+    pool.thread_count = 0;
+    atomic_store(&pool.generation, 0);
+    atomic_store(&pool.available, false);
+    atomic_store(&pool.stop, false);
+    pthread_mutex_init(&pool.mutex, NULL);
+    pthread_rwlock_init(&pool.sticker_lock, NULL);
+    for (int i = 0; i < MPD_WORKER_POOL_SIZE; i++) {
+        if (pthread_create(&pool.threads[i], NULL, mpd_worker_pool_run, NULL) != 0) {
+            MYMPD_LOG_ERROR("Can not create mpd_worker pool thread");
+            break;
+        }
+        pool.thread_count++;
+    }
+    MYMPD_LOG_NOTICE("Started %d mpd_worker pool threads", pool.thread_count);
+    return pool.thread_count > 0;
+}
+
+/**
+ * Stops the pool threads, called from the mympd_api thread
+ */
+void mpd_worker_pool_stop(void) {
+    atomic_store(&pool.available, false);
+    atomic_store(&pool.stop, true);
+    //wake up the pool threads
+    for (int i = 0; i < pool.thread_count; i++) {
+        mympd_queue_push(pool.queue, create_request(-1, 0, GENERAL_API_UNKNOWN, NULL), 0);
+    }
+    for (int i = 0; i < pool.thread_count; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+    pool.thread_count = 0;
+    pool.queue = mympd_queue_free(pool.queue);
+    mpd_state_free(pool.settings);
+    pool.settings = NULL;
+    if (pool.sticker_cache_pending != NULL) {
+        struct t_cache pending = { .building = false, .cache = pool.sticker_cache_pending };
+        sticker_cache_free(&pending);
+        pool.sticker_cache_pending = NULL;
+    }
+    pthread_mutex_destroy(&pool.mutex);
+    pthread_rwlock_destroy(&pool.sticker_lock);
+}
+
+/**
+ * Publishes the mpd settings and features to the pool threads.
+ * Called from the mympd_api thread after the feature detection.
+ * @param mympd_state pointer to mympd_state struct
+ */
+void mpd_worker_pool_configure(struct t_mympd_state *mympd_state) {
+    if (pool.thread_count == 0) {
+        return;
+    }
+    pthread_mutex_lock(&pool.mutex);
+    copy_mpd_settings(mympd_state->mpd_state, pool.settings);
+    pthread_mutex_unlock(&pool.mutex);
+    atomic_fetch_add(&pool.generation, 1);
+    atomic_store(&pool.available, true);
+}
+
+/**
+ * Stops handing over requests to the pool,
+ * called from the mympd_api thread if the primary connection is lost.
+ */
+void mpd_worker_pool_disable(void) {
+    atomic_store(&pool.available, false);
+}
+
+/**
+ * Hands over a request to the pool threads
+ * @param request the work request
+ * @return true if the request was queued, else false
+ */
+bool mpd_worker_pool_push(struct t_work_request *request) {
+    if (atomic_load(&pool.available) == false ||
+        is_pool_api_method(request->cmd_id) == false ||
+        request->conn_id <= 0)
+    {
+        return false;
+    }
+    MYMPD_LOG_DEBUG("Handing over \"%s\" to the mpd_worker pool", request->method);
+    return mympd_queue_push(pool.queue, request, 0);
+}
+
+/**
+ * Locks the sticker cache for writing, called from the mympd_api thread.
+ * The pool threads only read the sticker cache.
+ * @param wait true to wait for the lock, false to return immediately
+ * @return true if the lock was acquired, else false
+ */
+bool mpd_worker_pool_sticker_cache_lock(bool wait) {
+    if (pool.thread_count == 0) {
+        return true;
+    }
+    return wait == true
+        ? pthread_rwlock_wrlock(&pool.sticker_lock) == 0
+        : pthread_rwlock_trywrlock(&pool.sticker_lock) == 0;
+}
+
+/**
+ * Unlocks the sticker cache
+ */
+void mpd_worker_pool_sticker_cache_unlock(void) {
+    if (pool.thread_count == 0) {
+        return;
+    }
+    pthread_rwlock_unlock(&pool.sticker_lock);
+}
+
+/**
+ * Replaces the sticker cache, called from the mympd_api thread.
+ * The swap is deferred while a pool thread reads the sticker cache,
+ * the mympd_api thread is never blocked by a pool thread.
+ * @param sticker_cache pointer to the sticker cache of the mympd_api thread
+ * @param new_cache the new sticker cache
+ * @return true if the cache was replaced, false if the swap is deferred
+ */
+bool mpd_worker_pool_sticker_cache_replace(struct t_cache *sticker_cache, rax *new_cache) {
+    if (pool.sticker_cache_pending != NULL) {
+        //drop the older pending cache
+        struct t_cache pending = { .building = false, .cache = pool.sticker_cache_pending };
+        sticker_cache_free(&pending);
+    }
+    pool.sticker_cache_pending = new_cache;
+    return mpd_worker_pool_sticker_cache_swap(sticker_cache);
+}
+
+/**
+ * Swaps a deferred sticker cache, called from the mympd_api thread
+ * @param sticker_cache pointer to the sticker cache of the mympd_api thread
+ * @return true if the cache was replaced, else false
+ */
+bool mpd_worker_pool_sticker_cache_swap(struct t_cache *sticker_cache) {
+    if (pool.sticker_cache_pending == NULL ||
+        mpd_worker_pool_sticker_cache_lock(false) == false)
+    {
+        return false;
+    }
+    sticker_cache_free(sticker_cache);
+    sticker_cache->cache = pool.sticker_cache_pending;
+    pool.sticker_cache_pending = NULL;
+    mpd_worker_pool_sticker_cache_unlock();
+    return true;
+}
+
+/**
+ * Borrows the sticker cache of the mympd_api thread for reading,
+ * called from other threads than the mympd_api thread.
+ * The cache must be returned with mpd_worker_pool_sticker_cache_return.
+ * @return pointer to the sticker cache or NULL if it is not available
+ */
+struct t_cache *mpd_worker_pool_sticker_cache_borrow(void) {
+    if (pool.thread_count == 0) {
+        //the mympd_api thread does not lock the cache without pool threads
+        return NULL;
+    }
+    pthread_rwlock_rdlock(&pool.sticker_lock);
+    if (pool.sticker_cache->cache == NULL) {
+        pthread_rwlock_unlock(&pool.sticker_lock);
+        return NULL;
+    }
+    return pool.sticker_cache;
+}
+
+/**
+ * Returns the sticker cache borrowed with mpd_worker_pool_sticker_cache_borrow
+ */
+void mpd_worker_pool_sticker_cache_return(void) {
+    pthread_rwlock_unlock(&pool.sticker_lock);
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Main function of the pool threads
+ * @param arg not used
+ */
+static void *mpd_worker_pool_run(void *arg) {
+    (void)arg;
+    thread_logname = sds_replace(thread_logname, "mpdpool");
+    prctl(PR_SET_NAME, thread_logname, 0, 0, 0);
+    struct t_mpd_state *mpd_state = malloc_assert(sizeof(struct t_mpd_state));
+    mpd_state_default(mpd_state);
+    struct t_partition_state *partition_state = malloc_assert(sizeof(struct t_partition_state));
+    partition_state_default(partition_state, "default");
+    partition_state->mpd_state = mpd_state;
+    unsigned generation = 0;
+
+    while (atomic_load(&pool.stop) == false) {
+        struct t_work_request *request = mympd_queue_shift(pool.queue, 0, 0);
+        if (request == NULL) {
+            continue;
+        }
+        if (atomic_load(&pool.stop) == true) {
+            free_request(request);
+            break;
+        }
+        //settings have changed, reconnect with the new settings
+        unsigned current = atomic_load(&pool.generation);
+        if (current != generation) {
+            mpd_client_disconnect(partition_state);
+            pthread_mutex_lock(&pool.mutex);
+            copy_mpd_settings(pool.settings, mpd_state);
+            pthread_mutex_unlock(&pool.mutex);
+            generation = current;
+        }
+        if (partition_state->conn == NULL) {
+            if (mpd_client_connect(partition_state) == true) {
+                //set interesting tags
+                enable_mpd_tags(partition_state, &mpd_state->tags_mympd);
+            }
+            else {
+                mpd_client_disconnect(partition_state);
+            }
+        }
+        mpd_worker_pool_handle(partition_state, request);
+        if (partition_state->conn_state != MPD_CONNECTED) {
+            //reconnect on next request
+            mpd_client_disconnect(partition_state);
+        }
+    }
+    mpd_client_disconnect(partition_state);
+    mpd_state_free(mpd_state);
+    partition_state_free(partition_state);
+    FREE_SDS(thread_logname);
+    return NULL;
+}
+
+/**
+ * Handles a request and the identical queued requests in a pool thread,
+ * adds the response to the response cache and sends the responses
+ * @param partition_state pointer to the partition state of the pool thread
+ * @param request the work request
+ */
+static void mpd_worker_pool_handle(struct t_partition_state *partition_state, struct t_work_request *request) {
+    //identical requests queued at the same time are executed only once
+    struct t_list duplicates;
+    list_init(&duplicates);
+    if (is_coalescable_api_method(request->cmd_id) == true &&
+        mympd_queue_shift_duplicates(pool.queue, request, &duplicates) > 0)
+    {
+        MYMPD_LOG_DEBUG("Coalescing %ld identical \"%s\" requests", duplicates.length, request->method);
+        //the response is copied for the duplicates
+        request->stream = false;
+    }
+    //responses created before an invalidation are not cached
+    unsigned long generation = response_cache_generation(pool.response_cache);
+    bool streamed = false;
+    struct t_work_response *response = mpd_worker_pool_handle_request(partition_state, request, &streamed);
+    if (streamed == false) {
+        response_cache_add_generation(pool.response_cache, request, response->data, generation);
+    }
+    struct t_list_node *current;
+    while ((current = list_shift_first(&duplicates)) != NULL) {
+        struct t_work_request *duplicate = (struct t_work_request *)current->user_data;
+        struct t_work_response *duplicate_response = copy_response(response, duplicate);
+        if (duplicate_response == NULL) {
+            //response has an unexpected format, execute the request
+            duplicate_response = mpd_worker_pool_handle_request(partition_state, duplicate, &streamed);
+        }
+        mympd_queue_push(web_server_queue, duplicate_response, 0);
+        free_request(duplicate);
+        list_node_free(current);
+    }
+    MYMPD_LOG_DEBUG("Push response to queue for connection %lld: %s", request->conn_id, response->data);
+    mympd_queue_push(web_server_queue, response, 0);
+    free_request(request);
+}
+
+/**
+ * Handles a request in a pool thread
+ * @param partition_state pointer to the partition state of the pool thread
+ * @param request the work request
+ * @param streamed set to true if the response was sent in chunks
+ * @return the response
+ */
+static struct t_work_response *mpd_worker_pool_handle_request(struct t_partition_state *partition_state,
+        struct t_work_request *request, bool *streamed)
+{
+    long long_buf1;
+    long long_buf2;
+    sds sds_buf1 = NULL;
+    sds sds_buf2 = NULL;
+    sds error = sdsempty();
+
+    MYMPD_LOG_INFO("MPD WORKER POOL request (%lld)(%ld) %s: %s", request->conn_id, request->id, request->method, request->data);
+    struct t_work_response *response = create_response(request);
+    if (partition_state->conn == NULL) {
+        response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+            JSONRPC_FACILITY_MPD, JSONRPC_SEVERITY_ERROR, "MPD disconnected");
+    }
+    else {
+        struct t_json_index params;
+        json_index_parse(&params, request->data);
+        struct t_response_stream stream;
+        response_stream_init(&stream, request);
+
+        switch(request->cmd_id) {
+            case INTERNAL_API_ALBUMART:
+                if (json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
+                    response->data = mympd_api_albumart_getcover(partition_state, response->data, request->id, sds_buf1, &response->binary);
+                }
+                break;
+            case MYMPD_API_PLAYLIST_CONTENT_LIST: {
+                struct t_tags tagcols;
+                reset_t_tags(&tagcols);
+                if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                    json_index_get_long(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
+                    json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
+                    json_index_get_string(&params, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf2, vcb_isname, &error) == true &&
+                    json_index_get_tags(&params, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
+                {
+                    //borrow the sticker cache of the mympd_api thread
+                    pthread_rwlock_rdlock(&pool.sticker_lock);
+                    partition_state->mpd_state->sticker_cache = *pool.sticker_cache;
+                    response->data = mympd_api_playlist_content_list(partition_state, response->data, request->id, sds_buf1, long_buf1, long_buf2, sds_buf2, &tagcols, &stream);
+                    partition_state->mpd_state->sticker_cache.cache = NULL;
+                    pthread_rwlock_unlock(&pool.sticker_lock);
+                }
+                break;
+            }
+            default:
+                response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+                    JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Unknown request");
+                MYMPD_LOG_ERROR("Unknown API request: %.*s", (int)sdslen(request->data), request->data);
+        }
+        if (stream.started == true) {
+            response_stream_end(&stream, response);
+            *streamed = true;
+        }
+    }
+    FREE_SDS(sds_buf1);
+    FREE_SDS(sds_buf2);
+
+    if (sdslen(error) > 0) {
+        response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+            JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, error);
+        MYMPD_LOG_ERROR("Error processing method \"%s\"", request->method);
+    }
+    FREE_SDS(error);
+    if (sdslen(response->data) == 0) {
+        response->data = jsonrpc_respond_message_phrase(response->data, request->cmd_id, request->id,
+            JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "No response for method %{method}", 2, "method", request->method);
+        MYMPD_LOG_ERROR("No response for method \"%s\"", request->method);
+    }
+    return response;
+}
+
+/**
+ * Copies the mpd connection settings, the tags and the feature flags
+ * @param src source mpd state
+ * @param dst destination mpd state
+ */
+static void copy_mpd_settings(struct t_mpd_state *src, struct t_mpd_state *dst) {
+    dst->config = src->config;
+    dst->mpd_host = sds_replace(dst->mpd_host, src->mpd_host);
+    dst->mpd_port = src->mpd_port;
+    dst->mpd_pass = sds_replace(dst->mpd_pass, src->mpd_pass);
+    dst->mpd_binarylimit = src->mpd_binarylimit;
+    dst->mpd_timeout = src->mpd_timeout;
+    dst->mpd_keepalive = src->mpd_keepalive;
+    dst->music_directory_value = sds_replace(dst->music_directory_value, src->music_directory_value);
+    copy_tag_types(&src->tags_mympd, &dst->tags_mympd);
+    dst->tag_albumartist = src->tag_albumartist;
+    dst->feat_advqueue = src->feat_advqueue;
+    dst->feat_albumart = src->feat_albumart;
+    dst->feat_binarylimit = src->feat_binarylimit;
+    dst->feat_library = src->feat_library;
+    dst->feat_playlists = src->feat_playlists;
+    dst->feat_readpicture = src->feat_readpicture;
+    dst->feat_stickers = src->feat_stickers;
+    dst->feat_tags = src->feat_tags;
+    dst->feat_whence = src->feat_whence;
+}
@@ -0,0 +1,27 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_MPD_WORKER_POOL_H
+#define MYMPD_MPD_WORKER_POOL_H
+
+#include "../lib/api.h"
+#include "../lib/mympd_state.h"
+
+#include <stdbool.h>
+
+bool mpd_worker_pool_start(struct t_mympd_state *mympd_state);
+void mpd_worker_pool_stop(void);
+void mpd_worker_pool_configure(struct t_mympd_state *mympd_state);
+void mpd_worker_pool_disable(void);
+bool mpd_worker_pool_push(struct t_work_request *request);
+bool mpd_worker_pool_sticker_cache_lock(bool wait);
+void mpd_worker_pool_sticker_cache_unlock(void);
+bool mpd_worker_pool_sticker_cache_replace(struct t_cache *sticker_cache, rax *new_cache);
+bool mpd_worker_pool_sticker_cache_swap(struct t_cache *sticker_cache);
+struct t_cache *mpd_worker_pool_sticker_cache_borrow(void);
+void mpd_worker_pool_sticker_cache_return(void);
+
+#endif
@@ -11,6 +11,7 @@
 #include "../lib/jsonrpc.h"
 #include "../lib/log.h"
 #include "../lib/mem.h"
+#include "../lib/playlist_diff.h"
 #include "../lib/rax_extras.h"
 #include "../lib/sds_extras.h"
 #include "../lib/smartpls.h"
@@ -19,6 +20,8 @@
 #include "../mpd_client/errorhandler.h"
 #include "../mpd_client/search.h"
 #include "../mpd_client/playlists.h"
+#include "../mpd_client/tags.h"
+#include "pool.h"
 
 #include <dirent.h>
 #include <errno.h>
@@ -31,15 +34,29 @@
 /**
  * Private definitions
  */
+static void list_free_cb_smartpls_rule(struct t_list_node *current);
+static bool mpd_worker_smartpls_refresh(struct t_mpd_worker_state *mpd_worker_state,
+        struct t_list *rules, time_t db_mtime);
+static void mpd_worker_smartpls_eval_stickers(struct t_list *rules);
+static bool mpd_worker_smartpls_eval_songs(struct t_mpd_worker_state *mpd_worker_state, struct t_list *rules);
+static bool mpd_worker_smartpls_content(struct t_mpd_worker_state *mpd_worker_state,
+        struct t_smartpls_rule *rule, bool *update);
 static bool mpd_worker_smartpls_per_tag(struct t_mpd_worker_state *mpd_worker_state);
-static bool mpd_worker_smartpls_delete(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist);
-static bool mpd_worker_smartpls_update_search(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, const char *expression);
-static bool mpd_worker_smartpls_update_sticker_ge(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, const char *sticker, int maxentries, int minvalue);
-static bool mpd_worker_smartpls_update_newest(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, int timerange);
+static bool mpd_worker_smartpls_exists(struct t_mpd_worker_state *mpd_worker_state,
+        const char *playlist, bool *exists);
+static bool mpd_worker_smartpls_content_search(struct t_mpd_worker_state *mpd_worker_state,
+        const char *expression, enum mpd_tag_type sort_tag, struct t_list *content);
+static bool mpd_worker_smartpls_content_sticker_ge(struct t_mpd_worker_state *mpd_worker_state,
+        const char *sticker, int maxentries, int minvalue, struct t_list *content);
+static bool mpd_worker_smartpls_content_newest(struct t_mpd_worker_state *mpd_worker_state,
+        int timerange, enum mpd_tag_type sort_tag, struct t_list *content);
+static bool mpd_worker_smartpls_sort_values(struct t_mpd_worker_state *mpd_worker_state,
+        enum mpd_tag_type sort_tag, struct t_list *content);
+static bool mpd_worker_smartpls_sort(struct t_list *content, const char *sort, enum mpd_tag_type sort_tag);
+static bool mpd_worker_smartpls_write(struct t_mpd_worker_state *mpd_worker_state,
+        const char *playlist, struct t_list *content);
+static bool mpd_worker_smartpls_send_changes(struct t_mpd_worker_state *mpd_worker_state,
+        const char *playlist, struct t_list *deletes, struct t_list *adds, long length);
 
 /**
  * Public functions
@@ -72,6 +89,8 @@ bool mpd_worker_smartpls_update_all(struct t_mpd_worker_state *mpd_worker_state,
         FREE_SDS(dirname);
         return false;
     }
+    struct t_list rules;
+    list_init(&rules);
     struct dirent *next_file;
     while ((next_file = readdir(dir)) != NULL) {
         if (next_file->d_type != DT_REG) {
@@ -81,7 +100,10 @@ bool mpd_worker_smartpls_update_all(struct t_mpd_worker_state *mpd_worker_state,
         time_t smartpls_mtime = smartpls_get_mtime(mpd_worker_state->mpd_state->config->workdir, next_file->d_name);
         MYMPD_LOG_DEBUG("Playlist %s: playlist mtime %lld, smartpls mtime %lld", next_file->d_name, (long long)playlist_mtime, (long long)smartpls_mtime);
         if (force == true || db_mtime > playlist_mtime || smartpls_mtime > playlist_mtime) {
-            mpd_worker_smartpls_update(mpd_worker_state, next_file->d_name);
+            struct t_smartpls_rule *rule = smartpls_rule_read(mpd_worker_state->mpd_state->config->workdir, next_file->d_name);
+            if (rule != NULL) {
+                list_push(&rules, next_file->d_name, 0, NULL, rule);
+            }
         }
         else {
             MYMPD_LOG_INFO("Update of smart playlist %s skipped, already up to date", next_file->d_name);
@@ -89,11 +111,16 @@ bool mpd_worker_smartpls_update_all(struct t_mpd_worker_state *mpd_worker_state,
     }
     closedir (dir);
     FREE_SDS(dirname);
-    return true;
+    //refresh all smart playlists together
+    bool rc = mpd_worker_smartpls_refresh(mpd_worker_state, &rules, db_mtime);
+    list_clear_user_data(&rules, list_free_cb_smartpls_rule);
+    return rc;
 }
 
 /**
- * Updates a smart playlists
+ * Updates a smart playlists.
+ * The new content is calculated first and compared with the current playlist,
+ * only the changed entries are written to mpd.
  * @param mpd_worker_state pointer to the t_mpd_worker_state struct
  * @param playlist smart playlist to update
  * @return true on success, else false
@@ -103,93 +130,272 @@ bool mpd_worker_smartpls_update(struct t_mpd_worker_state *mpd_worker_state, con
         MYMPD_LOG_WARN("Playlists are disabled");
         return true;
     }
-
-    sds smartpltype = NULL;
-    bool rc = true;
-    sds sds_buf1 = NULL;
-    int int_buf1;
-    int int_buf2;
-
-    sds filename = sdscatfmt(sdsempty(), "%S/smartpls/%s", mpd_worker_state->mpd_state->config->workdir, playlist);
-    FILE *fp = fopen(filename, OPEN_FLAGS_READ);
-    if (fp == NULL) {
-        MYMPD_LOG_ERROR("Cant open smart playlist file \"%s\"", playlist);
-        FREE_SDS(filename);
+    struct t_smartpls_rule *rule = smartpls_rule_read(mpd_worker_state->mpd_state->config->workdir, playlist);
+    if (rule == NULL) {
         return false;
     }
-    sds content = sdsempty();
-    sds_getfile(&content, fp, SMARTPLS_SIZE_MAX, true);
-    (void) fclose(fp);
+    time_t db_mtime = rule->type == SMARTPLS_TYPE_NEWEST
+        ? mpd_client_get_db_mtime(mpd_worker_state->partition_state)
+        : 0;
+    struct t_list rules;
+    list_init(&rules);
+    list_push(&rules, playlist, 0, NULL, rule);
+    bool rc = mpd_worker_smartpls_refresh(mpd_worker_state, &rules, db_mtime);
+    list_clear_user_data(&rules, list_free_cb_smartpls_rule);
+    return rc;
+}
 
-    if (json_get_string(content, "$.type", 1, 200, &smartpltype, vcb_isalnum, NULL) != true) {
-        MYMPD_LOG_ERROR("Cant read smart playlist type from \"%s\"", filename);
-        FREE_SDS(filename);
-        return false;
+/**
+ * Private functions
+ */
+
+/**
+ * Frees the smart playlist rule of a list node
+ * @param current list node
+ */
+static void list_free_cb_smartpls_rule(struct t_list_node *current) {
+    smartpls_rule_free((struct t_smartpls_rule *)current->user_data);
+}
+
+/**
+ * Calculates the content of smart playlists and writes the changes to mpd.
+ * Sticker rules are evaluated against the sticker cache of the mympd_api thread.
+ * Newest and search rules are evaluated together in one listing of all songs,
+ * if there are at least two of them, all other rules query mpd.
+ * @param mpd_worker_state pointer to the t_mpd_worker_state struct
+ * @param rules list of smart playlist rules to update
+ * @param db_mtime last database update time
+ * @return true on success, else false
+ */
+static bool mpd_worker_smartpls_refresh(struct t_mpd_worker_state *mpd_worker_state,
+        struct t_list *rules, time_t db_mtime)
+{
+    struct t_mpd_state *mpd_state = mpd_worker_state->partition_state->mpd_state;
+    bool eval_stickers = false;
+    struct t_list_node *current;
+    for (current = rules->head; current != NULL; current = current->next) {
+        struct t_smartpls_rule *rule = (struct t_smartpls_rule *)current->user_data;
+        if (smartpls_rule_set_local(rule, &mpd_state->tags_mympd) == false) {
+            continue;
+        }
+        if (rule->type == SMARTPLS_TYPE_STICKER) {
+            if (mpd_state->feat_stickers == false) {
+                rule->local = false;
+                continue;
+            }
+            eval_stickers = true;
+        }
+        else if (rule->type == SMARTPLS_TYPE_NEWEST) {
+            if (db_mtime == 0) {
+                //database update time is unknown
+                rule->local = false;
+                continue;
+            }
+            rule->since = db_mtime - rule->timerange;
+        }
     }
-    if (strcmp(smartpltype, "sticker") == 0 &&
-        mpd_worker_state->mpd_state->feat_stickers == true)
-    {
-        if (json_get_string(content, "$.sticker", 1, 200, &sds_buf1, vcb_isalnum, NULL) == true &&
-            json_get_int(content, "$.maxentries", 0, MPD_PLAYLIST_LENGTH_MAX, &int_buf1, NULL) == true &&
-            json_get_int(content, "$.minvalue", 0, 100, &int_buf2, NULL) == true)
+    if (eval_stickers == true) {
+        mpd_worker_smartpls_eval_stickers(rules);
+    }
+    //the listing of all songs is only worth it, if it is shared by several rules
+    long eval_songs = 0;
+    for (current = rules->head; current != NULL; current = current->next) {
+        struct t_smartpls_rule *rule = (struct t_smartpls_rule *)current->user_data;
+        if (rule->local == true &&
+            rule->type != SMARTPLS_TYPE_STICKER)
         {
-            rc = mpd_worker_smartpls_update_sticker_ge(mpd_worker_state, playlist, sds_buf1, int_buf1, int_buf2);
-            if (rc == false) {
-                MYMPD_LOG_ERROR("Update of smart playlist \"%s\" (sticker) failed.", playlist);
-            }
+            eval_songs++;
         }
-        else {
-            MYMPD_LOG_ERROR("Can't parse smart playlist file \"%s\" (sticker)", filename);
-            rc = false;
+    }
+    if (eval_songs < 2 ||
+        mpd_worker_smartpls_eval_songs(mpd_worker_state, rules) == false)
+    {
+        //evaluation by mpd
+        for (current = rules->head; current != NULL; current = current->next) {
+            struct t_smartpls_rule *rule = (struct t_smartpls_rule *)current->user_data;
+            if (rule->type != SMARTPLS_TYPE_STICKER) {
+                list_clear(&rule->content);
+                rule->local = false;
+            }
         }
     }
-    else if (strcmp(smartpltype, "newest") == 0) {
-        if (json_get_int(content, "$.timerange", 0, JSONRPC_INT_MAX, &int_buf1, NULL) == true) {
-            rc = mpd_worker_smartpls_update_newest(mpd_worker_state, playlist, int_buf1);
-            if (rc == false) {
-                MYMPD_LOG_ERROR("Update of smart playlist \"%s\" failed (newest)", playlist);
+
+    bool rc = true;
+    for (current = rules->head; current != NULL; current = current->next) {
+        struct t_smartpls_rule *rule = (struct t_smartpls_rule *)current->user_data;
+        bool update = true;
+        bool rc_rule = true;
+        if (rule->local == true) {
+            MYMPD_LOG_DEBUG("Smart playlist \"%s\" evaluated locally", rule->name);
+            if (rule->type == SMARTPLS_TYPE_STICKER) {
+                rc_rule = mpd_worker_smartpls_sort_values(mpd_worker_state, rule->sort_tag, &rule->content);
             }
         }
         else {
-            MYMPD_LOG_ERROR("Can't parse smart playlist file \"%s\" (newest)", filename);
+            rc_rule = mpd_worker_smartpls_content(mpd_worker_state, rule, &update);
+        }
+        if (rc_rule == true &&
+            update == true)
+        {
+            //an unknown sort is an error, the playlist is written unsorted
+            bool rc_sort = mpd_worker_smartpls_sort(&rule->content, rule->sort, rule->sort_tag);
+            rc_rule = mpd_worker_smartpls_write(mpd_worker_state, rule->name, &rule->content) && rc_sort;
+        }
+        if (rc_rule == false) {
             rc = false;
         }
     }
-    else if (strcmp(smartpltype, "search") == 0) {
-        if (json_get_string(content, "$.expression", 1, 200, &sds_buf1, vcb_isname, NULL) == true) {
-            rc = mpd_worker_smartpls_update_search(mpd_worker_state, playlist, sds_buf1);
-            if (rc == false) {
-                MYMPD_LOG_ERROR("Update of smart playlist \"%s\" (search) failed", playlist);
+    return rc;
+}
+
+/**
+ * Evaluates the local sticker rules against the sticker cache of the mympd_api thread.
+ * Sticker rules are evaluated by mpd if the sticker cache is not available.
+ * @param rules list of smart playlist rules
+ */
+static void mpd_worker_smartpls_eval_stickers(struct t_list *rules) {
+    struct t_list_node *current;
+    struct t_cache *sticker_cache = mpd_worker_pool_sticker_cache_borrow();
+    if (sticker_cache == NULL) {
+        MYMPD_LOG_DEBUG("Sticker cache is not available");
+        for (current = rules->head; current != NULL; current = current->next) {
+            struct t_smartpls_rule *rule = (struct t_smartpls_rule *)current->user_data;
+            if (rule->type == SMARTPLS_TYPE_STICKER) {
+                rule->local = false;
             }
         }
-        else {
-            MYMPD_LOG_ERROR("Can't parse smart playlist file \"%s\" (search)", filename);
-            rc = false;
+        return;
+    }
+    raxIterator iter;
+    raxStart(&iter, sticker_cache->cache);
+    raxSeek(&iter, "^", NULL, 0);
+    sds uri = sdsempty();
+    while (raxNext(&iter)) {
+        uri = sds_replacelen(uri, (char *)iter.key, iter.key_len);
+        for (current = rules->head; current != NULL; current = current->next) {
+            struct t_smartpls_rule *rule = (struct t_smartpls_rule *)current->user_data;
+            if (rule->local == true &&
+                rule->type == SMARTPLS_TYPE_STICKER)
+            {
+                smartpls_rule_eval_sticker(rule, uri, (struct t_sticker *)iter.data);
+            }
         }
     }
-    if (rc == true) {
-        FREE_SDS(sds_buf1);
-        if (json_get_string(content, "$.sort", 0, 100, &sds_buf1, vcb_ismpdsort, NULL) == true) {
-            if (sdslen(sds_buf1) > 0) {
-                if (strcmp(sds_buf1, "shuffle") == 0) {
-                    rc = mpd_client_playlist_shuffle(mpd_worker_state->partition_state, playlist);
-                }
-                else {
-                    rc = mpd_client_playlist_sort(mpd_worker_state->partition_state, playlist, sds_buf1);
+    FREE_SDS(uri);
+    raxStop(&iter);
+    mpd_worker_pool_sticker_cache_return();
+    for (current = rules->head; current != NULL; current = current->next) {
+        struct t_smartpls_rule *rule = (struct t_smartpls_rule *)current->user_data;
+        if (rule->local == true &&
+            rule->type == SMARTPLS_TYPE_STICKER)
+        {
+            smartpls_rule_eval_sticker_finish(rule);
+        }
+    }
+}
+
+/**
+ * Evaluates the local newest and search rules in one listing of all songs
+ * @param mpd_worker_state pointer to the t_mpd_worker_state struct
+ * @param rules list of smart playlist rules
+ * @return true on success, else false
+ */
+static bool mpd_worker_smartpls_eval_songs(struct t_mpd_worker_state *mpd_worker_state, struct t_list *rules) {
+    struct t_partition_state *partition_state = mpd_worker_state->partition_state;
+    unsigned start = 0;
+    unsigned end = start + MPD_RESULTS_MAX;
+    unsigned i = 0;
+    do {
+        bool rc = mpd_search_db_songs(partition_state->conn, false);
+        if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_search_db_songs") == false) {
+            mpd_search_cancel(partition_state->conn);
+            return false;
+        }
+        rc = mpd_search_add_uri_constraint(partition_state->conn, MPD_OPERATOR_DEFAULT, "");
+        if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_search_add_uri_constraint") == false) {
+            mpd_search_cancel(partition_state->conn);
+            return false;
+        }
+        rc = mpd_search_add_window(partition_state->conn, start, end);
+        if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_search_add_window") == false) {
+            mpd_search_cancel(partition_state->conn);
+            return false;
+        }
+        rc = mpd_search_commit(partition_state->conn);
+        if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_search_commit") == false) {
+            return false;
+        }
+        struct mpd_song *song;
+        while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
+            for (struct t_list_node *current = rules->head; current != NULL; current = current->next) {
+                struct t_smartpls_rule *rule = (struct t_smartpls_rule *)current->user_data;
+                if (rule->local == true) {
+                    smartpls_rule_eval_song(rule, song, &partition_state->mpd_state->tags_mympd);
                 }
             }
+            mpd_song_free(song);
+            i++;
         }
-    }
-    FREE_SDS(smartpltype);
-    FREE_SDS(sds_buf1);
-    FREE_SDS(content);
-    FREE_SDS(filename);
-    return rc;
+        mpd_response_finish(partition_state->conn);
+        if (mympd_check_error_and_recover(partition_state) == false) {
+            return false;
+        }
+        start = end;
+        end = end + MPD_RESULTS_MAX;
+    } while (i >= start);
+    return true;
 }
 
 /**
- * Private functions
+ * Gets the songs of a smart playlist from mpd
+ * @param mpd_worker_state pointer to the t_mpd_worker_state struct
+ * @param rule smart playlist rule, the songs are appended to its content
+ * @param update set to false if the playlist should not be updated
+ * @return true on success, else false
  */
+static bool mpd_worker_smartpls_content(struct t_mpd_worker_state *mpd_worker_state,
+        struct t_smartpls_rule *rule, bool *update)
+{
+    //request only the tag to sort by
+    struct t_tags sort_tags = {
+        .len = 0,
+        .tags[0] = rule->sort_tag
+    };
+    if (sort_tags.tags[0] != MPD_TAG_UNKNOWN) {
+        sort_tags.len = 1;
+    }
+    enable_mpd_tags(mpd_worker_state->partition_state, &sort_tags);
+
+    bool rc = true;
+    *update = true;
+    if (rule->type == SMARTPLS_TYPE_STICKER &&
+        mpd_worker_state->mpd_state->feat_stickers == true)
+    {
+        rc = mpd_worker_smartpls_content_sticker_ge(mpd_worker_state, rule->sticker, rule->maxentries, rule->minvalue, &rule->content) &&
+            mpd_worker_smartpls_sort_values(mpd_worker_state, rule->sort_tag, &rule->content);
+        if (rc == false) {
+            MYMPD_LOG_ERROR("Update of smart playlist \"%s\" (sticker) failed.", rule->name);
+        }
+    }
+    else if (rule->type == SMARTPLS_TYPE_NEWEST) {
+        rc = mpd_worker_smartpls_content_newest(mpd_worker_state, rule->timerange, rule->sort_tag, &rule->content);
+        if (rc == false) {
+            MYMPD_LOG_ERROR("Update of smart playlist \"%s\" failed (newest)", rule->name);
+        }
+    }
+    else if (rule->type == SMARTPLS_TYPE_SEARCH) {
+        rc = mpd_worker_smartpls_content_search(mpd_worker_state, rule->expression, rule->sort_tag, &rule->content);
+        if (rc == false) {
+            MYMPD_LOG_ERROR("Update of smart playlist \"%s\" (search) failed", rule->name);
+        }
+    }
+    else {
+        //unsupported type or disabled feature, keep the playlist untouched
+        *update = false;
+    }
+    enable_mpd_tags(mpd_worker_state->partition_state, &mpd_worker_state->mpd_state->tags_mympd);
+    return rc;
+}
 
 /**
  * Generates smart playlists for tag values, e.g. one smart playlist for each genre
@@ -253,16 +459,17 @@ static bool mpd_worker_smartpls_per_tag(struct t_mpd_worker_state *mpd_worker_st
 }
 
 /**
- * Deletes playlists if it exists
+ * Checks if a playlist exists
  * @param mpd_worker_state pointer to the t_mpd_worker_state struct
- * @param playlist playlist to delete
+ * @param playlist playlist to check
+ * @param exists pointer to bool to set
  * @return true on success, else false
  */
-static bool mpd_worker_smartpls_delete(struct t_mpd_worker_state *mpd_worker_state, const char *playlist) {
+static bool mpd_worker_smartpls_exists(struct t_mpd_worker_state *mpd_worker_state,
+        const char *playlist, bool *exists)
+{
     struct mpd_playlist *pl;
-    bool exists = false;
-
-    //first check if playlist exists
+    *exists = false;
     bool rc = mpd_send_list_playlists(mpd_worker_state->partition_state->conn);
     if (mympd_check_rc_error_and_recover(mpd_worker_state->partition_state, rc, "mpd_send_list_playlists") == false) {
         return false;
@@ -270,50 +477,63 @@ static bool mpd_worker_smartpls_delete(struct t_mpd_worker_state *mpd_worker_sta
     while ((pl = mpd_recv_playlist(mpd_worker_state->partition_state->conn)) != NULL) {
         const char *plpath = mpd_playlist_get_path(pl);
         if (strcmp(playlist, plpath) == 0) {
-            exists = true;
+            *exists = true;
         }
         mpd_playlist_free(pl);
-        if (exists == true) {
+        if (*exists == true) {
             break;
         }
     }
     mpd_response_finish(mpd_worker_state->partition_state->conn);
-    if (mympd_check_error_and_recover(mpd_worker_state->partition_state) == false) {
-        return false;
-    }
-
-    //delete playlist if exists
-    if (exists == true) {
-        rc = mpd_run_rm(mpd_worker_state->partition_state->conn, playlist);
-        return mympd_check_rc_error_and_recover(mpd_worker_state->partition_state, rc, "mpd_run_rm");
-    }
-    return true;
+    return mympd_check_error_and_recover(mpd_worker_state->partition_state);
 }
 
 /**
- * Updates a search based smart playlist
+ * Gets the songs for a search based smart playlist
  * @param mpd_worker_state pointer to the t_mpd_worker_state struct
- * @param playlist playlist to delete
  * @param expression mpd search expression
+ * @param sort_tag tag to sort by or MPD_TAG_UNKNOWN
+ * @param content list to append the songs, key: uri, value_p: value of the sort tag
  * @return true on success, else false
  */
-static bool mpd_worker_smartpls_update_search(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, const char *expression)
+static bool mpd_worker_smartpls_content_search(struct t_mpd_worker_state *mpd_worker_state,
+        const char *expression, enum mpd_tag_type sort_tag, struct t_list *content)
 {
-    mpd_worker_smartpls_delete(mpd_worker_state, playlist);
-    bool rc = mpd_client_search_add_to_plist(mpd_worker_state->partition_state,
-        expression, playlist, UINT_MAX, NULL);
-    if (rc == true) {
-        MYMPD_LOG_INFO("Updated smart playlist \"%s\"", playlist);
+    struct t_partition_state *partition_state = mpd_worker_state->partition_state;
+    bool rc = mpd_search_db_songs(partition_state->conn, false);
+    if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_search_db_songs") == false) {
+        mpd_search_cancel(partition_state->conn);
+        return false;
     }
-    else {
-        MYMPD_LOG_ERROR("Updating smart playlist \"%s\" failed", playlist);
+    rc = mpd_search_add_expression(partition_state->conn, expression);
+    if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_search_add_expression") == false) {
+        mpd_search_cancel(partition_state->conn);
+        return false;
     }
-    return rc;
+    rc = mpd_search_commit(partition_state->conn);
+    if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_search_commit") == false) {
+        return false;
+    }
+    sds value = sdsempty();
+    struct mpd_song *song;
+    while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
+        if (sort_tag != MPD_TAG_UNKNOWN) {
+            sdsclear(value);
+            value = mpd_client_get_tag_value_string(song, sort_tag, value);
+            list_push(content, mpd_song_get_uri(song), 0, value, NULL);
+        }
+        else {
+            list_push(content, mpd_song_get_uri(song), 0, NULL, NULL);
+        }
+        mpd_song_free(song);
+    }
+    FREE_SDS(value);
+    mpd_response_finish(partition_state->conn);
+    return mympd_check_error_and_recover(partition_state);
 }
 
 /**
- * Simple helper struct for mpd_worker_smartpls_update_sticker_ge
+ * Simple helper struct for mpd_worker_smartpls_content_sticker_ge
  */
 struct t_sticker_value {
     sds uri;    //!< song uri
@@ -331,16 +551,16 @@ static void free_t_sticker_value(void *data) {
 }
 
 /**
- * Updates a sticker based smart playlist (numeric stickers only)
+ * Gets the songs for a sticker based smart playlist (numeric stickers only)
  * @param mpd_worker_state pointer to the t_mpd_worker_state struct
- * @param playlist playlist to delete
  * @param sticker sticker evaluate
  * @param maxentries maximum entries
  * @param minvalue minimum sticker value
+ * @param content list to append the songs, key: uri
  * @return true on success, else false
  */
-static bool mpd_worker_smartpls_update_sticker_ge(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, const char *sticker, int maxentries, int minvalue)
+static bool mpd_worker_smartpls_content_sticker_ge(struct t_mpd_worker_state *mpd_worker_state,
+        const char *sticker, int maxentries, int minvalue, struct t_list *content)
 {
     bool rc = mpd_send_sticker_find(mpd_worker_state->partition_state->conn, "song", "", sticker);
     if (mympd_check_rc_error_and_recover(mpd_worker_state->partition_state, rc, "mpd_send_sticker_find") == false) {
@@ -391,53 +611,39 @@ static bool mpd_worker_smartpls_update_sticker_ge(struct t_mpd_worker_state *mpd
         return false;
     }
 
-    mpd_worker_smartpls_delete(mpd_worker_state, playlist);
-
     //set mininum sticker value - autodetects value_min if minvalue is zero
     const int value_min = minvalue > 0 ? minvalue :
         value_max > 2 ? value_max / 2 : value_max;
 
     int i = 0;
-    if (mpd_command_list_begin(mpd_worker_state->partition_state->conn, false)) {
-        raxIterator iter;
-        raxStart(&iter, add_list);
-        raxSeek(&iter, "^", NULL, 0);
-        while (raxNext(&iter)) {
-            struct t_sticker_value *data = (struct t_sticker_value *)iter.data;
-            if (data->value >= value_min &&
-                i < maxentries)
-            {
-                rc = mpd_send_playlist_add(mpd_worker_state->partition_state->conn, playlist, data->uri);
-                if (rc == false) {
-                    MYMPD_LOG_ERROR("Error adding command to command list mpd_send_playlist_add");
-                    break;
-                }
-                i++;
-            }
-        }
-        if (mpd_command_list_end(mpd_worker_state->partition_state->conn)) {
-            mpd_response_finish(mpd_worker_state->partition_state->conn);
-        }
-        if (mympd_check_error_and_recover(mpd_worker_state->partition_state) == false) {
-            rc = false;
+    raxIterator iter;
+    raxStart(&iter, add_list);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        struct t_sticker_value *data = (struct t_sticker_value *)iter.data;
+        if (data->value >= value_min &&
+            i < maxentries)
+        {
+            list_push(content, data->uri, 0, NULL, NULL);
+            i++;
         }
-        raxStop(&iter);
     }
+    raxStop(&iter);
     rax_free_data(add_list, free_t_sticker_value);
-    MYMPD_LOG_INFO("Updated smart playlist \"%s\" with %d songs, minimum value: %d",
-        playlist, i, value_min);
-    return rc;
+    MYMPD_LOG_DEBUG("Sticker \"%s\": %d songs, minimum value: %d", sticker, i, value_min);
+    return true;
 }
 
 /**
- * Updates a newest song smart playlist
+ * Gets the songs for a newest song smart playlist
  * @param mpd_worker_state pointer to the t_mpd_worker_state struct
- * @param playlist playlist to delete
  * @param timerange timerange in seconds since now
+ * @param sort_tag tag to sort by or MPD_TAG_UNKNOWN
+ * @param content list to append the songs, key: uri, value_p: value of the sort tag
  * @return true on success, else false
  */
-static bool mpd_worker_smartpls_update_newest(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, int timerange)
+static bool mpd_worker_smartpls_content_newest(struct t_mpd_worker_state *mpd_worker_state,
+        int timerange, enum mpd_tag_type sort_tag, struct t_list *content)
 {
     unsigned long value_max = 0;
     struct mpd_stats *stats = mpd_run_stats(mpd_worker_state->partition_state->conn);
@@ -456,18 +662,271 @@ static bool mpd_worker_smartpls_update_newest(struct t_mpd_worker_state *mpd_wor
     }
     value_max = value_max - (unsigned long)timerange;
 
-    mpd_worker_smartpls_delete(mpd_worker_state, playlist);
-
     sds expression = sdscatfmt(sdsempty(), "(modified-since '%U')", value_max);
-    bool rc = mpd_client_search_add_to_plist(mpd_worker_state->partition_state, expression,
-        playlist, UINT_MAX, NULL);
+    bool rc = mpd_worker_smartpls_content_search(mpd_worker_state, expression, sort_tag, content);
     FREE_SDS(expression);
-    
+    return rc;
+}
+
+/**
+ * Gets the values of the sort tag for songs without metadata
+ * @param mpd_worker_state pointer to the t_mpd_worker_state struct
+ * @param sort_tag tag to sort by or MPD_TAG_UNKNOWN
+ * @param content list of songs, value_p is set to the value of the sort tag
+ * @return true on success, else false
+ */
+static bool mpd_worker_smartpls_sort_values(struct t_mpd_worker_state *mpd_worker_state,
+        enum mpd_tag_type sort_tag, struct t_list *content)
+{
+    if (sort_tag == MPD_TAG_UNKNOWN) {
+        return true;
+    }
+    struct t_partition_state *partition_state = mpd_worker_state->partition_state;
+    sds value = sdsempty();
+    struct t_list_node *current = content->head;
+    while (current != NULL) {
+        //uses command list to get MPD_COMMANDS_MAX songs at once
+        struct t_list_node *batch = current;
+        if (mpd_command_list_begin(partition_state->conn, false) == false) {
+            mympd_check_error_and_recover(partition_state);
+            FREE_SDS(value);
+            return false;
+        }
+        long j = 0;
+        while (current != NULL &&
+            j < MPD_COMMANDS_MAX)
+        {
+            if (mpd_send_list_meta(partition_state->conn, current->key) == false) {
+                MYMPD_LOG_ERROR("Error adding command to command list mpd_send_list_meta");
+                break;
+            }
+            current = current->next;
+            j++;
+        }
+        if (mpd_command_list_end(partition_state->conn)) {
+            struct mpd_song *song;
+            while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
+                //songs are returned in the requested order
+                while (batch != current &&
+                    strcmp(batch->key, mpd_song_get_uri(song)) != 0)
+                {
+                    batch = batch->next;
+                }
+                if (batch != current) {
+                    sdsclear(value);
+                    value = mpd_client_get_tag_value_string(song, sort_tag, value);
+                    batch->value_p = sds_replace(batch->value_p, value);
+                    batch = batch->next;
+                }
+                mpd_song_free(song);
+            }
+            mpd_response_finish(partition_state->conn);
+        }
+        if (mympd_check_error_and_recover(partition_state) == false) {
+            FREE_SDS(value);
+            return false;
+        }
+    }
+    FREE_SDS(value);
+    return true;
+}
+
+/**
+ * Sorts the songs of a smart playlist, uses the same order as mpd_client_playlist_sort
+ * @param content list of songs, key: uri, value_p: value of the sort tag
+ * @param sort "shuffle", "filename", a tag name or an empty string to keep the order
+ * @param sort_tag parsed tag of sort or MPD_TAG_UNKNOWN
+ * @return true on success, false if the playlist can not be sorted by sort
+ */
+static bool mpd_worker_smartpls_sort(struct t_list *content, const char *sort, enum mpd_tag_type sort_tag) {
+    if (sort[0] == '\0') {
+        return true;
+    }
+    if (strcmp(sort, "shuffle") == 0) {
+        list_shuffle(content);
+        return true;
+    }
+    bool by_tag = sort_tag != MPD_TAG_UNKNOWN;
+    if (by_tag == false &&
+        strcmp(sort, "filename") != 0)
+    {
+        MYMPD_LOG_ERROR("Can not sort smart playlist by \"%s\", keeping the order", sort);
+        return false;
+    }
+    rax *plist = raxNew();
+    sds key = sdsempty();
+    struct t_list_node *current;
+    while ((current = list_shift_first(content)) != NULL) {
+        const char *tag_value = NULL;
+        if (by_tag == true) {
+            tag_value = current->value_p != NULL ? current->value_p : "";
+        }
+        key = mpd_client_playlist_sort_add(plist, key, tag_value, current->key);
+        list_node_free(current);
+    }
+    FREE_SDS(key);
+    raxIterator iter;
+    raxStart(&iter, plist);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        list_push(content, iter.data, 0, NULL, NULL);
+    }
+    raxStop(&iter);
+    rax_free_sds_data(plist);
+    return true;
+}
+
+/**
+ * Writes the changes between the current playlist and the new content to mpd
+ * @param mpd_worker_state pointer to the t_mpd_worker_state struct
+ * @param playlist playlist to update
+ * @param content new content of the playlist, key: uri
+ * @return true on success, else false
+ */
+static bool mpd_worker_smartpls_write(struct t_mpd_worker_state *mpd_worker_state,
+        const char *playlist, struct t_list *content)
+{
+    struct t_partition_state *partition_state = mpd_worker_state->partition_state;
+    bool exists;
+    if (mpd_worker_smartpls_exists(mpd_worker_state, playlist, &exists) == false) {
+        return false;
+    }
+    struct t_list current;
+    list_init(&current);
+    if (exists == true) {
+        bool rc = mpd_send_list_playlist(partition_state->conn, playlist);
+        if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_send_list_playlist") == false) {
+            return false;
+        }
+        struct mpd_song *song;
+        while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
+            list_push(&current, mpd_song_get_uri(song), 0, NULL, NULL);
+            mpd_song_free(song);
+        }
+        mpd_response_finish(partition_state->conn);
+        if (mympd_check_error_and_recover(partition_state) == false) {
+            list_clear(&current);
+            return false;
+        }
+    }
+    if (content->length == 0) {
+        list_clear(&current);
+        if (exists == true) {
+            MYMPD_LOG_INFO("Smart playlist \"%s\" is empty, removing it", playlist);
+            bool rc = mpd_run_rm(partition_state->conn, playlist);
+            return mympd_check_rc_error_and_recover(partition_state, rc, "mpd_run_rm");
+        }
+        return true;
+    }
+
+    struct t_list deletes;
+    struct t_list adds;
+    list_init(&deletes);
+    list_init(&adds);
+    long ops = playlist_diff(&current, content, &deletes, &adds);
+    long kept = current.length - deletes.length;
+    list_clear(&current);
+    if (ops == 0) {
+        MYMPD_LOG_INFO("Smart playlist \"%s\" is unchanged", playlist);
+        return true;
+    }
+    //adding songs at a position requires mpd 0.23.3, the same version as deleting ranges
+    if (mpd_worker_state->mpd_state->feat_playlist_rm_range == false &&
+        adds.head != NULL &&
+        adds.head->value_i < kept)
+    {
+        MYMPD_LOG_DEBUG("Rewriting smart playlist \"%s\"", playlist);
+        list_clear(&deletes);
+        list_clear(&adds);
+        bool rc = mpd_run_rm(partition_state->conn, playlist);
+        if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_run_rm") == false) {
+            return false;
+        }
+        long i = 0;
+        struct t_list_node *node = content->head;
+        while (node != NULL) {
+            list_push(&adds, node->key, i, NULL, NULL);
+            i++;
+            node = node->next;
+        }
+        kept = 0;
+    }
+    MYMPD_LOG_INFO("Updating smart playlist \"%s\": removing %ld and adding %ld songs", playlist, deletes.length, adds.length);
+    bool rc = mpd_worker_smartpls_send_changes(mpd_worker_state, playlist, &deletes, &adds, kept);
     if (rc == true) {
         MYMPD_LOG_INFO("Updated smart playlist \"%s\"", playlist);
     }
     else {
         MYMPD_LOG_ERROR("Updating smart playlist \"%s\" failed", playlist);
     }
-    return true;
+    list_clear(&deletes);
+    list_clear(&adds);
+    return rc;
+}
+
+/**
+ * Sends the delete and add commands in command lists of MPD_COMMANDS_MAX commands.
+ * Consecutive positions are deleted as range if supported.
+ * @param mpd_worker_state pointer to the t_mpd_worker_state struct
+ * @param playlist playlist to update
+ * @param deletes positions to delete in descending order
+ * @param adds songs to add in ascending position order
+ * @param length length of the playlist after the deletes
+ * @return true on success, else false
+ */
+static bool mpd_worker_smartpls_send_changes(struct t_mpd_worker_state *mpd_worker_state,
+        const char *playlist, struct t_list *deletes, struct t_list *adds, long length)
+{
+    struct t_partition_state *partition_state = mpd_worker_state->partition_state;
+    bool rm_range = mpd_worker_state->mpd_state->feat_playlist_rm_range;
+    struct t_list_node *del = deletes->head;
+    struct t_list_node *add = adds->head;
+    bool rc = true;
+    while (rc == true &&
+        (del != NULL || add != NULL))
+    {
+        if (mpd_command_list_begin(partition_state->conn, false) == false) {
+            mympd_check_error_and_recover(partition_state);
+            return false;
+        }
+        long j = 0;
+        while (j < MPD_COMMANDS_MAX &&
+            (del != NULL || add != NULL))
+        {
+            if (del != NULL) {
+                unsigned end = (unsigned)del->value_i + 1;
+                unsigned start = (unsigned)del->value_i;
+                while (rm_range == true &&
+                    del->next != NULL &&
+                    del->next->value_i == start - 1)
+                {
+                    start--;
+                    del = del->next;
+                }
+                rc = start + 1 == end
+                    ? mpd_send_playlist_delete(partition_state->conn, playlist, start)
+                    : mpd_send_playlist_delete_range(partition_state->conn, playlist, start, end);
+                del = del->next;
+            }
+            else {
+                rc = add->value_i >= length
+                    ? mpd_send_playlist_add(partition_state->conn, playlist, add->key)
+                    : mpd_send_playlist_add_to(partition_state->conn, playlist, add->key, (unsigned)add->value_i);
+                length++;
+                add = add->next;
+            }
+            if (rc == false) {
+                MYMPD_LOG_ERROR("Error adding command to command list");
+                break;
+            }
+            j++;
+        }
+        if (mpd_command_list_end(partition_state->conn)) {
+            mpd_response_finish(partition_state->conn);
+        }
+        if (mympd_check_error_and_recover(partition_state) == false) {
+            return false;
+        }
+    }
+    return rc;
 }
@@ -19,6 +19,8 @@
 void *mpd_worker_state_free(struct t_mpd_worker_state *mpd_worker_state) {
     FREE_SDS(mpd_worker_state->smartpls_sort);
     FREE_SDS(mpd_worker_state->smartpls_prefix);
+    FREE_SDS(mpd_worker_state->coverimage_names);
+    FREE_SDS(mpd_worker_state->thumbnail_names);
     //mpd state
     mpd_state_free(mpd_worker_state->mpd_state);
     partition_state_free(mpd_worker_state->partition_state);
@@ -18,6 +18,8 @@ struct t_mpd_worker_state {
     sds smartpls_sort;                            //!< smart playlists sort tag
     sds smartpls_prefix;                          //!< prefix for smart playlist names
     struct t_tags smartpls_generate_tag_types;    //!< generate smart playlists for each value for this tag
+    sds coverimage_names;                         //!< comma separated string of coverimage names
+    sds thumbnail_names;                          //!< comma separated string of coverimage thumbnail names
     struct t_partition_state *partition_state;    //!< pointer to the partition state to work (default partion for worker threads)
     struct t_mpd_state *mpd_state;  //!< pointer to mpd shared state
     struct t_work_request *request;               //!< work request from msg queue
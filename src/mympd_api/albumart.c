@@ -79,6 +79,7 @@ sds mympd_api_albumart_getcover(struct t_partition_state *partition_state, sds b
         MYMPD_LOG_DEBUG("Albumart found by mpd for uri \"%s\" (%lu bytes)", uri, (unsigned long)sdslen(*binary));
         const char *mime_type = get_mime_type_by_magic_stream(*binary);
         buffer = jsonrpc_respond_start(buffer, INTERNAL_API_ALBUMART, request_id);
+        buffer = tojson_char(buffer, "uri", uri, true);
         buffer = tojson_char(buffer, "mime_type", mime_type, false);
         buffer = jsonrpc_end(buffer);
         if (partition_state->mpd_state->config->covercache_keep_days > 0) {
@@ -90,7 +91,8 @@ sds mympd_api_albumart_getcover(struct t_partition_state *partition_state, sds b
     }
     else {
         MYMPD_LOG_INFO("No albumart found by mpd for uri \"%s\"", uri);
-        buffer = jsonrpc_respond_message(buffer, INTERNAL_API_ALBUMART, request_id, JSONRPC_FACILITY_MPD, JSONRPC_SEVERITY_WARN, "No albumart found by mpd");
+        buffer = jsonrpc_respond_message_phrase(buffer, INTERNAL_API_ALBUMART, request_id,
+            JSONRPC_FACILITY_MPD, JSONRPC_SEVERITY_WARN, "No albumart found by mpd", 2, "uri", uri);
     }
     return buffer;
 }
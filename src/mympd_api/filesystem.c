@@ -54,10 +54,11 @@ static bool search_dir_entry(rax *rt, sds key, sds entity_name, struct mpd_entit
  * @param limit max entries to list
  * @param searchstr string to search
  * @param tagcols columns to print
+ * @param stream response stream or NULL
  * @return pointer to buffer
  */
 sds mympd_api_browse_filesystem(struct t_partition_state *partition_state, sds buffer, long request_id,
-        sds path, long offset, long limit, sds searchstr, const struct t_tags *tagcols)
+        sds path, long offset, long limit, sds searchstr, const struct t_tags *tagcols, struct t_response_stream *stream)
 {
     enum mympd_cmd_ids cmd_id = MYMPD_API_DATABASE_FILESYSTEM_LIST;
     bool rc = mpd_send_list_meta(partition_state->conn, path);
@@ -190,6 +191,7 @@ sds mympd_api_browse_filesystem(struct t_partition_state *partition_state, sds b
         FREE_SDS(entry_data->name);
         FREE_PTR(iter.data);
         entity_count++;
+        buffer = response_stream_flush(stream, buffer);
     }
     raxStop(&iter);
     buffer = sdscatlen(buffer, "],", 2);
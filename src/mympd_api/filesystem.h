@@ -8,8 +8,9 @@
 #define MYMPD_API_FILESYSTEM_H
 
 #include "../lib/mympd_state.h"
+#include "../lib/response_stream.h"
 
 sds mympd_api_browse_filesystem(struct t_partition_state *partition_state, sds buffer,
         long request_id, sds path, long offset, long limit,
-        sds searchstr, const struct t_tags *tagcols);
+        sds searchstr, const struct t_tags *tagcols, struct t_response_stream *stream);
 #endif
@@ -7,7 +7,7 @@
 #include "compile_time.h"
 #include "last_played.h"
 
-#include "../lib/filehandler.h"
+#include "../lib/last_played_store.h"
 #include "../lib/jsonrpc.h"
 #include "../lib/log.h"
 #include "../lib/sds_extras.h"
@@ -18,90 +18,21 @@
 #include "../mpd_client/tags.h"
 #include "sticker.h"
 
-#include <errno.h>
-#include <inttypes.h>
-#include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 
 /**
  * Private definitions
  */
 
-static sds _get_last_played_obj(struct t_partition_state *partition_state, sds buffer, long entity_count,
-        long long last_played, const char *uri, sds searchstr, const struct t_tags *tagcols);
+static sds print_last_played_obj(struct t_partition_state *partition_state, sds buffer, long entity_count,
+        long long last_played, const char *uri, const struct mpd_song *song, const struct t_tags *tagcols);
 
 /**
  * Public functions
  */
 
 /**
- * Saves the last played list from memory to disc and empties the list in memory
- * @param last_played pointer to last played list in memory
- * @param last_played_count maximum number to last played songs to keep
- * @param workdir working directory
- * @return true on success, else false
- */
-bool mympd_api_last_played_file_save(struct t_list *last_played, long last_played_count, sds workdir) {
-    MYMPD_LOG_INFO("Saving last_played list to disc");
-    sds tmp_file = sdscatfmt(sdsempty(), "%S/state/last_played.XXXXXX", workdir);
-    FILE *fp = open_tmp_file(tmp_file);
-    if (fp == NULL) {
-        FREE_SDS(tmp_file);
-        return false;
-    }
-
-    int i = 0;
-    struct t_list_node *current;
-    bool write_rc = true;
-    while ((current = list_shift_first(last_played)) != NULL) {
-        if (fprintf(fp, "%lld::%s\n", current->value_i, current->key) < 0) {
-            MYMPD_LOG_ERROR("Could not write last played songs to disc");
-            write_rc = false;
-            list_node_free(current);
-            break;
-        }
-        i++;
-        list_node_free(current);
-    }
-    //append current last_played file to tmp file
-    sds filepath = sdscatfmt(sdsempty(), "%S/state/last_played", workdir);
-    if (write_rc == true) {
-        errno = 0;
-        FILE *fi = fopen(filepath, OPEN_FLAGS_READ);
-        if (fi != NULL) {
-            sds line = sdsempty();
-            while (sds_getline_n(&line, fi, LINE_LENGTH_MAX) == 0 &&
-                i < last_played_count)
-            {
-                if (fputs(line, fp) == EOF) {
-                    MYMPD_LOG_ERROR("Could not write last played songs to disc");
-                    write_rc = false;
-                    break;
-                }
-                i++;
-            }
-            (void) fclose(fi);
-            FREE_SDS(line);
-        }
-        else {
-            //ignore error
-            MYMPD_LOG_DEBUG("Can not open file \"%s\"", filepath);
-            if (errno != ENOENT) {
-                MYMPD_LOG_ERRNO(errno);
-            }
-        }
-    }
-
-    bool rc = rename_tmp_file(fp, tmp_file, filepath, write_rc);
-    FREE_SDS(tmp_file);
-    FREE_SDS(filepath);
-    return rc;
-}
-
-/**
- * Adds a song from with queue id to the last played list in memory
+ * Appends a song from with queue id to the last played list
  * @param partition_state pointer to partition state
  * @param song_id the song id to add
  * @return true on success, else false
@@ -121,22 +52,18 @@ bool mympd_api_last_played_add_song(struct t_partition_state *partition_state, i
         mpd_song_free(song);
         return true;
     }
-    list_insert(&partition_state->mpd_state->last_played, uri, (long long)time(NULL), NULL, NULL);
-    mpd_song_free(song);
-    //write last_played list to disc
-    if (partition_state->mpd_state->last_played.length > 9 ||
-        partition_state->mpd_state->last_played.length > partition_state->mpd_state->last_played_count)
-    {
-        mympd_api_last_played_file_save(&partition_state->mpd_state->last_played,
-            partition_state->mpd_state->last_played_count, partition_state->mpd_state->config->workdir);
-    }
+    struct t_last_played_store *store = &partition_state->mpd_state->last_played;
+    last_played_store_append(store, uri, time(NULL), partition_state->mpd_state->last_played_count);
+    //the song is printed on the first page of the list
+    last_played_store_song_put(store, song);
     //notify clients
     send_jsonrpc_event(JSONRPC_EVENT_UPDATE_LAST_PLAYED);
     return true;
 }
 
 /**
- * Prints a jsonrpc response with the last played songs (memory and disc)
+ * Prints a jsonrpc response with the last played songs.
+ * Without a search string only the entries of the requested page are read.
  * @param partition_state pointer to partition state
  * @param buffer alreay allocated sds string to append the response
  * @param request_id jsonrpc request id
@@ -150,77 +77,54 @@ sds mympd_api_last_played_list(struct t_partition_state *partition_state, sds bu
         long request_id, long offset, long limit, sds searchstr, const struct t_tags *tagcols)
 {
     enum mympd_cmd_ids cmd_id = MYMPD_API_LAST_PLAYED_LIST;
+    struct t_last_played_store *store = &partition_state->mpd_state->last_played;
     long entity_count = 0;
     long entities_returned = 0;
+    long real_limit = offset + limit;
+    long long last_played;
+    sds uri = sdsempty();
 
     buffer = jsonrpc_respond_start(buffer, cmd_id, request_id);
     buffer = sdscat(buffer, "\"data\":[");
-    sds obj = sdsempty();
-
-    long real_limit = offset + limit;
 
-    if (partition_state->mpd_state->last_played.length > 0) {
-        struct t_list_node *current = partition_state->mpd_state->last_played.head;
-        while (current != NULL) {
-            obj = _get_last_played_obj(partition_state, obj, entity_count, current->value_i, current->key, searchstr, tagcols);
-            if (sdslen(obj) > 0) {
-                entity_count++;
-                if (entity_count > offset &&
-                    entity_count <= real_limit)
-                {
-                    if (entities_returned++) {
-                        buffer = sdscatlen(buffer, ",", 1);
-                    }
-                    buffer = sdscatsds(buffer, obj);
-                    sdsclear(obj);
-                }
+    long length = last_played_store_count(store, partition_state->mpd_state->last_played_count);
+    if (sdslen(searchstr) == 0) {
+        //random access to the requested page
+        entity_count = length;
+        for (long i = offset; i < real_limit && i < length; i++) {
+            if (last_played_store_get(store, i, &last_played, &uri) == false) {
+                continue;
             }
-            current = current->next;
-        }
-    }
-
-    sds line = sdsempty();
-    sdsclear(obj);
-    char *data = NULL;
-    sds lp_file = sdscatfmt(sdsempty(), "%S/state/last_played", partition_state->mpd_state->config->workdir);
-    errno = 0;
-    FILE *fp = fopen(lp_file, OPEN_FLAGS_READ);
-    if (fp != NULL) {
-        while (sds_getline(&line, fp, LINE_LENGTH_MAX) == 0) {
-            int value = (int)strtoimax(line, &data, 10);
-            if (strlen(data) > 2) {
-                data = data + 2;
-                obj = _get_last_played_obj(partition_state, obj, entity_count, value, data, searchstr, tagcols);
-                if (sdslen(obj) > 0) {
-                    entity_count++;
-                    if (entity_count > offset &&
-                        entity_count <= real_limit)
-                    {
-                        if (entities_returned++) {
-                            buffer = sdscatlen(buffer, ",", 1);
-                        }
-                        buffer = sdscatsds(buffer, obj);
-                        sdsclear(obj);
-                    }
-                }
-            }
-            else {
-                MYMPD_LOG_ERROR("Reading last_played line failed");
-                MYMPD_LOG_DEBUG("Errorneous line: %s", line);
+            const struct mpd_song *song = mympd_api_last_played_song(partition_state, uri);
+            if (entities_returned++) {
+                buffer = sdscatlen(buffer, ",", 1);
             }
+            buffer = print_last_played_obj(partition_state, buffer, i, last_played, uri, song, tagcols);
         }
-        (void) fclose(fp);
-        FREE_SDS(line);
     }
     else {
-        //ignore error
-        MYMPD_LOG_DEBUG("Can not open file \"%s\"", lp_file);
-        if (errno != ENOENT) {
-            MYMPD_LOG_ERRNO(errno);
+        for (long i = 0; i < length; i++) {
+            if (last_played_store_get(store, i, &last_played, &uri) == false) {
+                continue;
+            }
+            const struct mpd_song *song = mympd_api_last_played_song(partition_state, uri);
+            if (song == NULL ||
+                search_mpd_song(song, searchstr, tagcols) == false)
+            {
+                continue;
+            }
+            if (entity_count >= offset &&
+                entity_count < real_limit)
+            {
+                if (entities_returned++) {
+                    buffer = sdscatlen(buffer, ",", 1);
+                }
+                buffer = print_last_played_obj(partition_state, buffer, entity_count, last_played, uri, song, tagcols);
+            }
+            entity_count++;
         }
     }
-    FREE_SDS(lp_file);
-    FREE_SDS(obj);
+    FREE_SDS(uri);
     buffer = sdscatlen(buffer, "],", 2);
     buffer = tojson_long(buffer, "totalEntities", entity_count, true);
     buffer = tojson_long(buffer, "offset", offset, true);
@@ -230,49 +134,71 @@ sds mympd_api_last_played_list(struct t_partition_state *partition_state, sds bu
     return buffer;
 }
 
+/**
+ * Gets the song metadata from the cache of the last played store or from mpd.
+ * Uris that are not known by mpd are cached as missing.
+ * @param partition_state pointer to partition state
+ * @param uri uri of the song
+ * @return pointer to the cached song or NULL if the song was not found
+ */
+const struct mpd_song *mympd_api_last_played_song(struct t_partition_state *partition_state, const char *uri) {
+    struct t_last_played_store *store = &partition_state->mpd_state->last_played;
+    const struct mpd_song *cached = NULL;
+    if (last_played_store_song_get(store, uri, &cached) == true) {
+        return cached;
+    }
+    bool rc = mpd_send_list_meta(partition_state->conn, uri);
+    if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_send_list_meta") == false) {
+        return NULL;
+    }
+    struct mpd_song *song = mpd_recv_song(partition_state->conn);
+    mpd_response_finish(partition_state->conn);
+    enum mpd_error error = mpd_connection_get_error(partition_state->conn);
+    bool missing = song == NULL &&
+        (error == MPD_ERROR_SUCCESS ||
+         (error == MPD_ERROR_SERVER &&
+          mpd_connection_get_server_error(partition_state->conn) == MPD_SERVER_ERROR_NO_EXIST));
+    mympd_check_error_and_recover(partition_state);
+    if (song == NULL) {
+        if (missing == true) {
+            //do not ask mpd again until the next database update
+            last_played_store_song_missing(store, uri);
+        }
+        return NULL;
+    }
+    last_played_store_song_put(store, song);
+    return song;
+}
+
 /**
  * Private functions
  */
 
 /**
- * Gets the song and searches for searchstr and prints it as json object
+ * Prints a last played entry as json object
  * @param partition_state pointer to partition state
  * @param buffer alreay allocated buffer to append the result
  * @param entity_count position in the list
  * @param last_played songs last played time as unix timestamp
  * @param uri uri of the song
- * @param searchstr string to search
+ * @param song pointer to the song, NULL prints empty tags
  * @param tagcols columns to print
  * @return pointer to buffer
  */
-static sds _get_last_played_obj(struct t_partition_state *partition_state, sds buffer, long entity_count,
-        long long last_played, const char *uri, sds searchstr, const struct t_tags *tagcols)
+static sds print_last_played_obj(struct t_partition_state *partition_state, sds buffer, long entity_count,
+        long long last_played, const char *uri, const struct mpd_song *song, const struct t_tags *tagcols)
 {
-    bool rc = mpd_send_list_meta(partition_state->conn, uri);
-    if (mympd_check_rc_error_and_recover(partition_state, rc, "mpd_send_list_meta") == false) {
-        return buffer;
-    }
-
     buffer = sdscatlen(buffer, "{", 1);
     buffer = tojson_long(buffer, "Pos", entity_count, true);
     buffer = tojson_llong(buffer, "LastPlayed", last_played, true);
-    struct mpd_song *song;
-    if ((song = mpd_recv_song(partition_state->conn)) != NULL) {
-        if ((rc = search_mpd_song(song, searchstr, tagcols)) == true) {
-            buffer = get_song_tags(buffer, partition_state, tagcols, song);
-            buffer = sdscatlen(buffer, ",", 1);
-            buffer = mympd_api_sticker_list(buffer, &partition_state->mpd_state->sticker_cache, mpd_song_get_uri(song));
-        }
-        mpd_song_free(song);
+    if (song != NULL) {
+        buffer = get_song_tags(buffer, partition_state, tagcols, song);
     }
     else {
-        rc = false;
+        buffer = get_empty_song_tags(buffer, partition_state, tagcols, uri);
     }
-    mpd_response_finish(partition_state->conn);
-    mympd_check_error_and_recover(partition_state);
+    buffer = sdscatlen(buffer, ",", 1);
+    buffer = mympd_api_sticker_list(buffer, &partition_state->mpd_state->sticker_cache, uri);
     buffer = sdscatlen(buffer, "}", 1);
-    if (rc == false) {
-        sdsclear(buffer);
-    }
     return buffer;
 }
@@ -10,7 +10,7 @@
 #include "../lib/mympd_state.h"
 
 bool mympd_api_last_played_add_song(struct t_partition_state *partition_state, int song_id);
-bool mympd_api_last_played_file_save(struct t_list *last_played, long last_played_count, sds workdir);
+const struct mpd_song *mympd_api_last_played_song(struct t_partition_state *partition_state, const char *uri);
 sds mympd_api_last_played_list(struct t_partition_state *partition_state, sds buffer,
         long request_id, long offset, long limit, sds searchstr, const struct t_tags *tagcols);
 #endif
@@ -10,11 +10,16 @@
 #include "../lib/api.h"
 #include "../lib/log.h"
 #include "../lib/mem.h"
+#include "../lib/last_played_store.h"
+#include "../lib/play_stats.h"
 #include "../lib/sds_extras.h"
+#include "../lib/sticker_journal.h"
 #include "../mpd_client/autoconf.h"
 #include "../mpd_client/connection.h"
 #include "../mpd_client/errorhandler.h"
 #include "../mpd_client/idle.h"
+#include "../mpd_client/partitions.h"
+#include "../mpd_worker/pool.h"
 #include "home.h"
 #include "last_played.h"
 #include "settings.h"
@@ -53,6 +58,14 @@ void *mympd_api_loop(void *arg_config) {
     mympd_api_timer_file_read(&mympd_state->timer_list, mympd_state->config->workdir);
     //myMPD trigger
     mympd_api_trigger_file_read(&mympd_state->trigger_list, mympd_state->config->workdir);
+    //last played history
+    last_played_store_open(&mympd_state->mpd_state->last_played, mympd_state->config->workdir,
+        mympd_state->mpd_state->last_played_count);
+    //listening statistics
+    play_stats_open(&mympd_state->mpd_state->play_stats, mympd_state->config->workdir, time(NULL));
+    //replay sticker updates that were not written to mpd
+    sticker_journal_open(&mympd_state->mpd_state->sticker_journal, &mympd_state->mpd_state->sticker_queue,
+        &mympd_state->mpd_state->sticker_writes, mympd_state->config->workdir);
     //set timers
     if (mympd_state->config->covercache_keep_days > 0) {
         MYMPD_LOG_DEBUG("Adding timer for \"crop covercache\" to execute periodic each day");
@@ -61,6 +74,8 @@ void *mympd_api_loop(void *arg_config) {
     }
     //start trigger
     mympd_api_trigger_execute(&mympd_state->trigger_list, TRIGGER_MYMPD_START);
+    //start the mpd_worker pool
+    mpd_worker_pool_start(mympd_state);
     //thread loop
     while (s_signal_received == 0) {
         mpd_client_idle(mympd_state);
@@ -68,7 +83,10 @@ void *mympd_api_loop(void *arg_config) {
     }
     //stop trigger
     mympd_api_trigger_execute(&mympd_state->trigger_list, TRIGGER_MYMPD_STOP);
+    //stop the mpd_worker pool
+    mpd_worker_pool_stop();
     //disconnect from mpd
+    mpd_client_partitions_clear(mympd_state);
     mpd_client_disconnect(mympd_state->partition_state);
     //save states
     mympd_state_save(mympd_state);
@@ -11,22 +11,26 @@
 #include "../lib/api.h"
 #include "../lib/covercache.h"
 #include "../lib/jsonrpc.h"
+#include "../lib/list.h"
 #include "../lib/log.h"
 #include "../lib/lua_mympd_state.h"
 #include "../lib/mem.h"
+#include "../lib/response_cache.h"
+#include "../lib/response_stream.h"
 #include "../lib/sds_extras.h"
 #include "../lib/smartpls.h"
-#include "../lib/sticker_cache.h"
 #include "../lib/utility.h"
 #include "../lib/validate.h"
 #include "../mpd_client/connection.h"
 #include "../mpd_client/errorhandler.h"
 #include "../mpd_client/features.h"
 #include "../mpd_client/jukebox.h"
+#include "../mpd_client/partitions.h"
 #include "../mpd_client/playlists.h"
 #include "../mpd_client/search.h"
 #include "../mpd_client/tags.h"
 #include "../mpd_worker/mpd_worker.h"
+#include "../mpd_worker/pool.h"
 #include "albumart.h"
 #include "browse.h"
 #include "filesystem.h"
@@ -37,6 +41,7 @@
 #include "outputs.h"
 #include "partitions.h"
 #include "pictures.h"
+#include "play_stats.h"
 #include "playlists.h"
 #include "queue.h"
 #include "scripts.h"
@@ -57,6 +62,9 @@
 /**
  * Private definitions
  */
+static struct t_work_response *handle_batch_request(struct t_mympd_state *mympd_state, struct t_work_request *request);
+static struct t_work_response *handle_request(struct t_mympd_state *mympd_state, struct t_work_request *request);
+static void push_response(struct t_work_request *request, struct t_work_response *response);
 static bool check_start_play(struct t_partition_state *partition_state, bool play, sds *buffer,
         enum mympd_cmd_ids cmd_id, long request_id);
 
@@ -70,6 +78,121 @@ static bool check_start_play(struct t_partition_state *partition_state, bool pla
  * @param request pointer to the jsonrpc request struct
  */
 void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request *request) {
+    //read heavy requests are handed over to the mpd_worker pool on a response cache miss
+    if (is_pool_api_method(request->cmd_id) == true) {
+        struct t_work_response *response = create_response(request);
+        if (response_cache_get(&mympd_state->mpd_state->response_cache, request, &response->data) == true) {
+            push_response(request, response);
+            return;
+        }
+        free_response(response);
+        if (mpd_worker_pool_push(request) == true) {
+            return;
+        }
+    }
+    //identical requests queued at the same time are executed only once
+    struct t_list duplicates;
+    list_init(&duplicates);
+    if (is_coalescable_api_method(request->cmd_id) == true &&
+        mympd_queue_shift_duplicates(mympd_api_queue, request, &duplicates) > 0)
+    {
+        MYMPD_LOG_DEBUG("Coalescing %ld identical \"%s\" requests", duplicates.length, request->method);
+        //the response is copied for the duplicates
+        request->stream = false;
+    }
+    struct t_work_response *response = request->cmd_id == INTERNAL_API_BATCH
+        ? handle_batch_request(mympd_state, request)
+        : handle_request(mympd_state, request);
+    if (response == NULL) {
+        //request is handled by a mpd_worker thread,
+        //coalescable methods are always answered synchronously
+        return;
+    }
+    struct t_list_node *current;
+    while ((current = list_shift_first(&duplicates)) != NULL) {
+        struct t_work_request *duplicate = (struct t_work_request *)current->user_data;
+        struct t_work_response *duplicate_response = copy_response(response, duplicate);
+        if (duplicate_response == NULL) {
+            //response has an unexpected format, execute the request
+            duplicate_response = handle_request(mympd_state, duplicate);
+        }
+        push_response(duplicate, duplicate_response);
+        list_node_free(current);
+    }
+    push_response(request, response);
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Sends the response to the origin of the request and frees the request
+ * @param request the request
+ * @param response the response to send
+ */
+static void push_response(struct t_work_request *request, struct t_work_response *response) {
+    if (request->conn_id == -2) {
+        MYMPD_LOG_DEBUG("Push response to mympd_script_queue for thread %ld: %s", request->id, response->data);
+        mympd_queue_push(mympd_script_queue, response, request->id);
+    }
+    else if (request->conn_id > -1) {
+        MYMPD_LOG_DEBUG("Push response to web_server_queue for connection %lld: %s", request->conn_id, response->data);
+        mympd_queue_push(web_server_queue, response, 0);
+    }
+    else {
+        free_response(response);
+    }
+    free_request(request);
+}
+
+/**
+ * Handles a jsonrpc batch request.
+ * The requests are executed in order and the responses are
+ * collected in one jsonrpc batch response.
+ * @param mympd_state pointer to mympd state struct
+ * @param request pointer to the jsonrpc batch request struct
+ * @return the jsonrpc batch response
+ */
+static struct t_work_response *handle_batch_request(struct t_mympd_state *mympd_state, struct t_work_request *request) {
+    struct t_work_response *response = create_response(request);
+    struct t_list *requests = (struct t_list *)request->extra;
+    MYMPD_LOG_INFO("MYMPD API batch request (%lld) with %ld requests", request->conn_id, requests->length);
+    response->data = sdscatlen(response->data, "[", 1);
+    struct t_list_node *current;
+    while ((current = list_shift_first(requests)) != NULL) {
+        struct t_work_request *batch_request = (struct t_work_request *)current->user_data;
+        struct t_work_response *batch_response;
+        if (mympd_state->partition_state->conn_state != MPD_CONNECTED &&
+            is_mympd_only_api_method(batch_request->cmd_id) == false)
+        {
+            batch_response = create_response(batch_request);
+            batch_response->data = jsonrpc_respond_message(batch_response->data, batch_request->cmd_id, batch_request->id,
+                JSONRPC_FACILITY_MPD, JSONRPC_SEVERITY_ERROR, "MPD disconnected");
+        }
+        else {
+            //batch requests are never handled asynchronously
+            batch_response = handle_request(mympd_state, batch_request);
+        }
+        if (sdslen(response->data) > 1) {
+            response->data = sdscatlen(response->data, ",", 1);
+        }
+        response->data = sdscatsds(response->data, batch_response->data);
+        free_response(batch_response);
+        free_request(batch_request);
+        list_node_free(current);
+    }
+    response->data = sdscatlen(response->data, "]", 1);
+    return response;
+}
+
+/**
+ * Handles a single jsonrpc request
+ * @param mympd_state pointer to mympd state struct
+ * @param request pointer to the jsonrpc request struct
+ * @return the jsonrpc response or NULL if the request is handled by a mpd_worker thread
+ */
+static struct t_work_response *handle_request(struct t_mympd_state *mympd_state, struct t_work_request *request) {
     unsigned uint_buf1;
     unsigned uint_buf2;
     long long_buf1;
@@ -105,9 +228,23 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
     //create response struct
     struct t_work_response *response = create_response(request);
 
+    //serve read only methods from the response cache
+    if (response_cache_get(&mympd_state->mpd_state->response_cache, request, &response->data) == true) {
+        FREE_SDS(error);
+        return response;
+    }
+
+    //index the params object once for all parameter lookups
+    struct t_json_index params;
+    json_index_parse(&params, request->data);
+
+    //large listings are sent in chunks
+    struct t_response_stream stream;
+    response_stream_init(&stream, request);
+
     switch(request->cmd_id) {
         case MYMPD_API_LOGLEVEL:
-            if (json_get_int(request->data, "$.params.loglevel", 0, 7, &int_buf1, &error) == true) {
+            if (json_index_get_int(&params, "$.params.loglevel", 0, 7, &int_buf1, &error) == true) {
                 MYMPD_LOG_INFO("Setting loglevel to %d", int_buf1);
                 loglevel = int_buf1;
                 response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_GENERAL);
@@ -116,6 +253,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_SMARTPLS_UPDATE_ALL:
         case MYMPD_API_SMARTPLS_UPDATE:
         case INTERNAL_API_CACHES_CREATE:
+        case MYMPD_API_COVERCACHE_PREWARM:
             if (worker_threads > 5) {
                 response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
                     JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Too many worker threads are already running");
@@ -134,12 +272,28 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
                 mympd_state->mpd_state->album_cache.building = mympd_state->mpd_state->feat_tags;
                 mympd_state->mpd_state->sticker_cache.building = mympd_state->mpd_state->feat_stickers;
             }
+            else if (request->cmd_id == MYMPD_API_COVERCACHE_PREWARM) {
+                if (config->covercache_keep_days == 0) {
+                    response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+                        JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Covercache is disabled");
+                    break;
+                }
+                if (mympd_state->mpd_state->album_cache.cache == NULL) {
+                    response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+                        JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Album cache is not available");
+                    break;
+                }
+                //the worker thread can not access the album cache
+                struct t_list *uris = list_new();
+                album_cache_get_uris(&mympd_state->mpd_state->album_cache, uris);
+                request->extra = uris;
+            }
             async = true;
             free_response(response);
             mpd_worker_start(mympd_state, request);
             break;
         case MYMPD_API_PICTURE_LIST:
-            if (json_get_string(request->data, "$.params.type", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
+            if (json_index_get_string(&params, "$.params.type", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
                 response->data = mympd_api_settings_picture_list(mympd_state->config->workdir, response->data, request->id, sds_buf1);
             }
             break;
@@ -151,15 +305,15 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             struct t_list options;
             list_init(&options);
-            if (json_get_bool(request->data, "$.params.replace", &bool_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.oldpos", 0, LIST_HOME_ICONS_MAX, &long_buf1, &error) == true &&
-                json_get_string_max(request->data, "$.params.name", &sds_buf1, vcb_isname, &error) == true &&
-                json_get_string_max(request->data, "$.params.ligature", &sds_buf2, vcb_isalnum, &error) == true &&
-                json_get_string(request->data, "$.params.bgcolor", 1, 7, &sds_buf3, vcb_ishexcolor, &error) == true &&
-                json_get_string(request->data, "$.params.color", 1, 7, &sds_buf4, vcb_ishexcolor, &error) == true &&
-                json_get_string(request->data, "$.params.image", 0, FILEPATH_LEN_MAX, &sds_buf5, vcb_isuri, &error) == true &&
-                json_get_string_max(request->data, "$.params.cmd", &sds_buf6, vcb_isalnum, &error) == true &&
-                json_get_array_string(request->data, "$.params.options", &options, vcb_isname, 10, &error) == true)
+            if (json_index_get_bool(&params, "$.params.replace", &bool_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.oldpos", 0, LIST_HOME_ICONS_MAX, &long_buf1, &error) == true &&
+                json_index_get_string_max(&params, "$.params.name", &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_string_max(&params, "$.params.ligature", &sds_buf2, vcb_isalnum, &error) == true &&
+                json_index_get_string(&params, "$.params.bgcolor", 1, 7, &sds_buf3, vcb_ishexcolor, &error) == true &&
+                json_index_get_string(&params, "$.params.color", 1, 7, &sds_buf4, vcb_ishexcolor, &error) == true &&
+                json_index_get_string(&params, "$.params.image", 0, FILEPATH_LEN_MAX, &sds_buf5, vcb_isuri, &error) == true &&
+                json_index_get_string_max(&params, "$.params.cmd", &sds_buf6, vcb_isalnum, &error) == true &&
+                json_index_get_array_string(&params, "$.params.options", &options, vcb_isname, 10, &error) == true)
             {
                 rc = mympd_api_home_icon_save(&mympd_state->home_list, bool_buf1, long_buf1, sds_buf1, sds_buf2, sds_buf3, sds_buf4, sds_buf5, sds_buf6, &options);
                 if (rc == true) {
@@ -174,8 +328,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             break;
         }
         case MYMPD_API_HOME_ICON_MOVE:
-            if (json_get_long(request->data, "$.params.from", 0, LIST_HOME_ICONS_MAX, &long_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.to", 0, LIST_HOME_ICONS_MAX, &long_buf2, &error) == true)
+            if (json_index_get_long(&params, "$.params.from", 0, LIST_HOME_ICONS_MAX, &long_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.to", 0, LIST_HOME_ICONS_MAX, &long_buf2, &error) == true)
             {
                 rc = mympd_api_home_icon_move(&mympd_state->home_list, long_buf1, long_buf2);
                 if (rc == true) {
@@ -188,7 +342,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_HOME_ICON_RM:
-            if (json_get_long(request->data, "$.params.pos", 0, LIST_HOME_ICONS_MAX, &long_buf1, &error) == true) {
+            if (json_index_get_long(&params, "$.params.pos", 0, LIST_HOME_ICONS_MAX, &long_buf1, &error) == true) {
                 rc = mympd_api_home_icon_delete(&mympd_state->home_list, long_buf1);
                 if (rc == true) {
                     response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_HOME);
@@ -200,7 +354,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_HOME_ICON_GET:
-            if (json_get_long(request->data, "$.params.pos", 0, LIST_HOME_ICONS_MAX, &long_buf1, &error) == true) {
+            if (json_index_get_long(&params, "$.params.pos", 0, LIST_HOME_ICONS_MAX, &long_buf1, &error) == true) {
                 response->data = mympd_api_home_icon_get(&mympd_state->home_list, response->data, request->id, long_buf1);
             }
             break;
@@ -211,11 +365,11 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_SCRIPT_SAVE: {
             struct t_list arguments;
             list_init(&arguments);
-            if (json_get_string(request->data, "$.params.script", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_string(request->data, "$.params.oldscript", 0, FILENAME_LEN_MAX, &sds_buf2, vcb_isfilename, &error) == true &&
-                json_get_int(request->data, "$.params.order", 0, LIST_TIMER_MAX, &int_buf1, &error) == true &&
-                json_get_string(request->data, "$.params.content", 0, CONTENT_LEN_MAX, &sds_buf3, vcb_istext, &error) == true &&
-                json_get_array_string(request->data, "$.params.arguments", &arguments, vcb_isalnum, 10, &error) == true)
+            if (json_index_get_string(&params, "$.params.script", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_string(&params, "$.params.oldscript", 0, FILENAME_LEN_MAX, &sds_buf2, vcb_isfilename, &error) == true &&
+                json_index_get_int(&params, "$.params.order", 0, LIST_TIMER_MAX, &int_buf1, &error) == true &&
+                json_index_get_string(&params, "$.params.content", 0, CONTENT_LEN_MAX, &sds_buf3, vcb_istext, &error) == true &&
+                json_index_get_array_string(&params, "$.params.arguments", &arguments, vcb_isalnum, 10, &error) == true)
             {
                 rc = mympd_api_script_save(config->workdir, sds_buf1, sds_buf2, int_buf1, sds_buf3, &arguments);
                 if (rc == true) {
@@ -230,7 +384,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             break;
         }
         case MYMPD_API_SCRIPT_RM:
-            if (json_get_string(request->data, "$.params.script", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
+            if (json_index_get_string(&params, "$.params.script", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
                 rc = mympd_api_script_delete(config->workdir, sds_buf1);
                 if (rc == true) {
                     response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_SCRIPT);
@@ -242,12 +396,12 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_SCRIPT_GET:
-            if (json_get_string(request->data, "$.params.script", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
+            if (json_index_get_string(&params, "$.params.script", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
                 response->data = mympd_api_script_get(config->workdir, response->data, request->id, sds_buf1);
             }
             break;
         case MYMPD_API_SCRIPT_LIST: {
-            if (json_get_bool(request->data, "$.params.all", &bool_buf1, &error) == true) {
+            if (json_index_get_bool(&params, "$.params.all", &bool_buf1, &error) == true) {
                 response->data = mympd_api_script_list(config->workdir, response->data, request->id, bool_buf1);
             }
             break;
@@ -255,8 +409,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_SCRIPT_EXECUTE: {
             //malloc list - it is used in another thread
             struct t_list *arguments = list_new();
-            if (json_get_string(request->data, "$.params.script", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_object_string(request->data, "$.params.arguments", arguments, vcb_isname, 10, &error) == true)
+            if (json_index_get_string(&params, "$.params.script", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_object_string(&params, "$.params.arguments", arguments, vcb_isname, 10, &error) == true)
             {
                 rc = mympd_api_script_start(config->workdir, sds_buf1, config->lualibs, arguments, true);
                 if (rc == true) {
@@ -277,8 +431,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case INTERNAL_API_SCRIPT_POST_EXECUTE: {
             //malloc list - it is used in another thread
             struct t_list *arguments = list_new();
-            if (json_get_string(request->data, "$.params.script", 1, CONTENT_LEN_MAX, &sds_buf1, vcb_istext, &error) == true &&
-                json_get_object_string(request->data, "$.params.arguments", arguments, vcb_isname, 10, &error) == true)
+            if (json_index_get_string(&params, "$.params.script", 1, CONTENT_LEN_MAX, &sds_buf1, vcb_istext, &error) == true &&
+                json_index_get_object_string(&params, "$.params.arguments", arguments, vcb_isname, 10, &error) == true)
             {
                 rc = mympd_api_script_start(config->workdir, sds_buf1, config->lualibs, arguments, false);
                 if (rc == true) {
@@ -299,7 +453,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         }
         #endif
         case MYMPD_API_COLS_SAVE: {
-            if (json_get_string(request->data, "$.params.table", 1, NAME_LEN_MAX, &sds_buf1, vcb_isalnum, &error) == true) {
+            if (json_index_get_string(&params, "$.params.table", 1, NAME_LEN_MAX, &sds_buf1, vcb_isalnum, &error) == true) {
                 rc = false;
                 sds cols = sdsempty();
                 cols = json_get_cols_as_string(request->data, cols, &rc);
@@ -322,7 +476,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             break;
         }
         case MYMPD_API_SETTINGS_SET: {
-            if (json_iterate_object(request->data, "$.params", mympd_api_settings_set, mympd_state, NULL, 1000, &error) == true) {
+            if (json_index_iterate_object(&params, "$.params", mympd_api_settings_set, mympd_state, NULL, 1000, &error) == true) {
                 if (mympd_state->partition_state->conn_state == MPD_CONNECTED) {
                     //feature detection
                     mpd_client_mpd_features(mympd_state);
@@ -342,7 +496,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
                     JSONRPC_FACILITY_MPD, JSONRPC_SEVERITY_ERROR, "Can't set playback options: MPD not connected");
                 break;
             }
-            if (json_iterate_object(request->data, "$.params", mympd_api_settings_mpd_options_set, mympd_state, NULL, 100, &error) == true) {
+            if (json_index_iterate_object(&params, "$.params", mympd_api_settings_mpd_options_set, mympd_state, NULL, 100, &error) == true) {
                 if (mympd_state->partition_state->jukebox_mode != JUKEBOX_OFF) {
                     //start jukebox
                     jukebox_run(mympd_state->partition_state);
@@ -362,7 +516,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_CONNECTION_SAVE: {
             sds old_mpd_settings = sdscatfmt(sdsempty(), "%S%i%S", mympd_state->mpd_state->mpd_host, mympd_state->mpd_state->mpd_port, mympd_state->mpd_state->mpd_pass);
 
-            if (json_iterate_object(request->data, "$.params", mympd_api_settings_connection_save, mympd_state, NULL, 100, &error) == true) {
+            if (json_index_iterate_object(&params, "$.params", mympd_api_settings_connection_save, mympd_state, NULL, 100, &error) == true) {
                 sds new_mpd_settings = sdscatfmt(sdsempty(), "%S%i%S", mympd_state->mpd_state->mpd_host, mympd_state->mpd_state->mpd_port, mympd_state->mpd_state->mpd_pass);
                 if (strcmp(old_mpd_settings, new_mpd_settings) != 0) {
                     //reconnect to new mpd
@@ -384,7 +538,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             break;
         }
         case MYMPD_API_COVERCACHE_CROP:
-            int_buf1 = covercache_clear(config->cachedir, mympd_state->config->covercache_keep_days);
+            int_buf1 = covercache_clear(mympd_state->config->covercache_keep_days);
             if (int_buf1 >= 0) {
                 response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
                     JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_INFO, "Successfully croped covercache");
@@ -395,7 +549,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_COVERCACHE_CLEAR:
-            int_buf1 = covercache_clear(config->cachedir, 0);
+            int_buf1 = covercache_clear(0);
             if (int_buf1 >= 0) {
                 response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
                     JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_INFO, "Successfully cleared covercache");
@@ -414,8 +568,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             struct t_timer_definition *timer_def = malloc_assert(sizeof(struct t_timer_definition));
             timer_def = mympd_api_timer_parse(timer_def, request->data, &error);
             if (timer_def != NULL &&
-                json_get_int(request->data, "$.params.interval", -1, TIMER_INTERVAL_MAX, &int_buf2, &error) == true &&
-                json_get_int(request->data, "$.params.timerid", 0, USER_TIMER_ID_MAX, &int_buf1, &error) == true)
+                json_index_get_int(&params, "$.params.interval", -1, TIMER_INTERVAL_MAX, &int_buf2, &error) == true &&
+                json_index_get_int(&params, "$.params.timerid", 0, USER_TIMER_ID_MAX, &int_buf1, &error) == true)
             {
                 if (int_buf1 == 0) {
                     mympd_state->timer_list.last_id++;
@@ -455,24 +609,24 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             response->data = mympd_api_timer_list(&mympd_state->timer_list, response->data, request->id);
             break;
         case MYMPD_API_TIMER_GET:
-            if (json_get_int(request->data, "$.params.timerid", USER_TIMER_ID_MIN, USER_TIMER_ID_MAX, &int_buf1, &error) == true) {
+            if (json_index_get_int(&params, "$.params.timerid", USER_TIMER_ID_MIN, USER_TIMER_ID_MAX, &int_buf1, &error) == true) {
                 response->data = mympd_api_timer_get(&mympd_state->timer_list, response->data, request->id, int_buf1);
             }
             break;
         case MYMPD_API_TIMER_RM:
-            if (json_get_int(request->data, "$.params.timerid", USER_TIMER_ID_MIN, USER_TIMER_ID_MAX, &int_buf1, &error) == true) {
+            if (json_index_get_int(&params, "$.params.timerid", USER_TIMER_ID_MIN, USER_TIMER_ID_MAX, &int_buf1, &error) == true) {
                 mympd_api_timer_remove(&mympd_state->timer_list, int_buf1);
                 response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_TIMER);
             }
             break;
         case MYMPD_API_TIMER_TOGGLE:
-            if (json_get_int(request->data, "$.params.timerid", USER_TIMER_ID_MIN, USER_TIMER_ID_MAX, &int_buf1, &error) == true) {
+            if (json_index_get_int(&params, "$.params.timerid", USER_TIMER_ID_MIN, USER_TIMER_ID_MAX, &int_buf1, &error) == true) {
                 mympd_api_timer_toggle(&mympd_state->timer_list, int_buf1);
                 response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_TIMER);
             }
             break;
         case MYMPD_API_LYRICS_GET:
-            if (json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
+            if (json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
                 response->data = mympd_api_lyrics_get(&mympd_state->lyrics, mympd_state->mpd_state->music_directory_value, response->data, request->id, sds_buf1);
             }
             break;
@@ -481,7 +635,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_GENERAL);
             break;
         case MYMPD_API_JUKEBOX_RM:
-            if (json_get_long(request->data, "$.params.pos", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true) {
+            if (json_index_get_long(&params, "$.params.pos", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true) {
                 rc = jukebox_rm_entry(&mympd_state->partition_state->jukebox_queue, long_buf1);
                 if (rc == true) {
                     response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_JUKEBOX);
@@ -499,10 +653,10 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_JUKEBOX_LIST: {
             struct t_tags tagcols;
             reset_t_tags(&tagcols);
-            if (json_get_long(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
-                json_get_string(request->data, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_tags(request->data, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
+            if (json_index_get_long(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
+                json_index_get_string(&params, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_tags(&params, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
             {
                 response->data = jukebox_list(mympd_state->partition_state, response->data, request->cmd_id, request->id,
                     long_buf1, long_buf2, sds_buf1, &tagcols);
@@ -513,7 +667,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             response->data = mympd_api_trigger_list(&mympd_state->trigger_list, response->data, request->id);
             break;
         case MYMPD_API_TRIGGER_GET:
-            if (json_get_long(request->data, "$.params.id", 0, LIST_TRIGGER_MAX, &long_buf1, &error) == true) {
+            if (json_index_get_long(&params, "$.params.id", 0, LIST_TRIGGER_MAX, &long_buf1, &error) == true) {
                 response->data = mympd_api_trigger_get(&mympd_state->trigger_list, response->data, request->id, long_buf1);
             }
             break;
@@ -526,11 +680,11 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             //malloc list - it is used in trigger list
             struct t_list *arguments = list_new();
 
-            if (json_get_string(request->data, "$.params.name", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_string(request->data, "$.params.script", 0, FILENAME_LEN_MAX, &sds_buf2, vcb_isfilename, &error) == true &&
-                json_get_int(request->data, "$.params.id", -1, LIST_TRIGGER_MAX, &int_buf1, &error) == true &&
-                json_get_int_max(request->data, "$.params.event", &int_buf2, &error) == true &&
-                json_get_object_string(request->data, "$.params.arguments", arguments, vcb_isname, 10, &error) == true)
+            if (json_index_get_string(&params, "$.params.name", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_string(&params, "$.params.script", 0, FILENAME_LEN_MAX, &sds_buf2, vcb_isfilename, &error) == true &&
+                json_index_get_int(&params, "$.params.id", -1, LIST_TRIGGER_MAX, &int_buf1, &error) == true &&
+                json_index_get_int_max(&params, "$.params.event", &int_buf2, &error) == true &&
+                json_index_get_object_string(&params, "$.params.arguments", arguments, vcb_isname, 10, &error) == true)
             {
                 rc = list_push(&mympd_state->trigger_list, sds_buf1, int_buf2, sds_buf2, arguments);
                 if (rc == true) {
@@ -549,7 +703,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             break;
         }
         case MYMPD_API_TRIGGER_RM:
-            if (json_get_long(request->data, "$.params.id", 0, LIST_TRIGGER_MAX, &long_buf1, &error) == true) {
+            if (json_index_get_long(&params, "$.params.id", 0, LIST_TRIGGER_MAX, &long_buf1, &error) == true) {
                 rc = mympd_api_trigger_delete(&mympd_state->trigger_list, long_buf1);
                 if (rc == true) {
                     response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_TRIGGER);
@@ -578,8 +732,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_PLAYER_OUTPUT_ATTRIBUTS_SET: {
             struct t_list attributes;
             list_init(&attributes);
-            if (json_get_uint(request->data, "$.params.outputId", 0, MPD_OUTPUT_ID_MAX, &uint_buf1, &error) == true &&
-                json_get_object_string(request->data, "$.params.attributes", &attributes, vcb_isalnum, 10, &error) == true)
+            if (json_index_get_uint(&params, "$.params.outputId", 0, MPD_OUTPUT_ID_MAX, &uint_buf1, &error) == true &&
+                json_index_get_object_string(&params, "$.params.attributes", &attributes, vcb_isalnum, 10, &error) == true)
             {
                 struct t_list_node *current = attributes.head;
                 while (current != NULL) {
@@ -596,10 +750,14 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         }
         case INTERNAL_API_STICKERCACHE_CREATED:
             if (request->extra != NULL) {
-                sticker_cache_free(&mympd_state->mpd_state->sticker_cache);
-                mympd_state->mpd_state->sticker_cache.cache = (rax *) request->extra;
+                //the swap is deferred while a mpd_worker pool thread reads the sticker cache
+                if (mpd_worker_pool_sticker_cache_replace(&mympd_state->mpd_state->sticker_cache, (rax *) request->extra) == true) {
+                    MYMPD_LOG_INFO("Sticker cache was replaced");
+                }
+                else {
+                    MYMPD_LOG_INFO("Sticker cache is in use, replacing it later");
+                }
                 response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_STICKER);
-                MYMPD_LOG_INFO("Sticker cache was replaced");
             }
             else {
                 MYMPD_LOG_ERROR("Sticker cache is NULL");
@@ -631,8 +789,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             mympd_state->mpd_state->album_cache.building = false;
             break;
         case MYMPD_API_MESSAGE_SEND:
-            if (json_get_string(request->data, "$.params.channel", 1, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_string(request->data, "$.params.message", 1, CONTENT_LEN_MAX, &sds_buf2, vcb_isname, &error) == true)
+            if (json_index_get_string(&params, "$.params.channel", 1, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_string(&params, "$.params.message", 1, CONTENT_LEN_MAX, &sds_buf2, vcb_isname, &error) == true)
             {
                 bool_buf1 = mpd_run_send_message(mympd_state->partition_state->conn, sds_buf1, sds_buf2);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, bool_buf1, "mpd_run_send_message", &result);
@@ -645,10 +803,11 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
                 MYMPD_LOG_ERROR("MPD stickers are disabled");
                 break;
             }
-            if (json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true &&
-                json_get_int(request->data, "$.params.like", 0, 2, &int_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true &&
+                json_index_get_int(&params, "$.params.like", 0, 2, &int_buf1, &error) == true)
             {
-                rc = sticker_set_like(&mympd_state->mpd_state->sticker_queue, sds_buf1, int_buf1);
+                rc = sticker_set_like(&mympd_state->mpd_state->sticker_queue,
+                    &mympd_state->mpd_state->sticker_journal, sds_buf1, int_buf1);
                 if (rc == true) {
                     response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_STICKER);
                 }
@@ -680,7 +839,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
                     JSONRPC_FACILITY_DATABASE, JSONRPC_SEVERITY_INFO, "Database update already started");
                 break;
             }
-            if (json_get_string(request->data, "$.params.uri", 0, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
+            if (json_index_get_string(&params, "$.params.uri", 0, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
                 if (sdslen(sds_buf1) == 0) {
                     //path should be NULL to scan root directory
                     FREE_SDS(sds_buf1);
@@ -707,27 +866,27 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             rc = false;
             if (request->cmd_id == MYMPD_API_SMARTPLS_STICKER_SAVE) {
-                if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                    json_get_string(request->data, "$.params.sticker", 1, NAME_LEN_MAX, &sds_buf2, vcb_isalnum, &error) == true &&
-                    json_get_int(request->data, "$.params.maxentries", 0, MPD_PLAYLIST_LENGTH_MAX, &int_buf1, &error) == true &&
-                    json_get_int(request->data, "$.params.minvalue", 0, 100, &int_buf2, &error) == true &&
-                    json_get_string(request->data, "$.params.sort", 0, 100, &sds_buf3, vcb_ismpdsort, &error) == true)
+                if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                    json_index_get_string(&params, "$.params.sticker", 1, NAME_LEN_MAX, &sds_buf2, vcb_isalnum, &error) == true &&
+                    json_index_get_int(&params, "$.params.maxentries", 0, MPD_PLAYLIST_LENGTH_MAX, &int_buf1, &error) == true &&
+                    json_index_get_int(&params, "$.params.minvalue", 0, 100, &int_buf2, &error) == true &&
+                    json_index_get_string(&params, "$.params.sort", 0, 100, &sds_buf3, vcb_ismpdsort, &error) == true)
                 {
                     rc = smartpls_save_sticker(config->workdir, sds_buf1, sds_buf2, int_buf1, int_buf2, sds_buf3);
                 }
             }
             else if (request->cmd_id == MYMPD_API_SMARTPLS_NEWEST_SAVE) {
-                if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                    json_get_int(request->data, "$.params.timerange", 0, JSONRPC_INT_MAX, &int_buf1, &error) == true &&
-                    json_get_string(request->data, "$.params.sort", 0, 100, &sds_buf2, vcb_ismpdsort, &error) == true)
+                if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                    json_index_get_int(&params, "$.params.timerange", 0, JSONRPC_INT_MAX, &int_buf1, &error) == true &&
+                    json_index_get_string(&params, "$.params.sort", 0, 100, &sds_buf2, vcb_ismpdsort, &error) == true)
                 {
                     rc = smartpls_save_newest(config->workdir, sds_buf1, int_buf1, sds_buf2);
                 }
             }
             else if (request->cmd_id == MYMPD_API_SMARTPLS_SEARCH_SAVE) {
-                if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                    json_get_string(request->data, "$.params.expression", 1, EXPRESSION_LEN_MAX, &sds_buf2, vcb_isname, &error) == true &&
-                    json_get_string(request->data, "$.params.sort", 0, 100, &sds_buf3, vcb_ismpdsort, &error) == true)
+                if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                    json_index_get_string(&params, "$.params.expression", 1, EXPRESSION_LEN_MAX, &sds_buf2, vcb_isname, &error) == true &&
+                    json_index_get_string(&params, "$.params.sort", 0, 100, &sds_buf3, vcb_ismpdsort, &error) == true)
                 {
                     rc = smartpls_save_search(config->workdir, sds_buf1, sds_buf2, sds_buf3);
                 }
@@ -739,7 +898,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_SMARTPLS_GET:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
                 response->data = mympd_api_smartpls_get(config->workdir, response->data, request->id, sds_buf1);
             }
             break;
@@ -778,14 +937,14 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             response->data = mympd_api_queue_crop(mympd_state->partition_state, response->data, request->cmd_id, request->id, true);
             break;
         case MYMPD_API_QUEUE_RM_SONG:
-            if (json_get_uint_max(request->data, "$.params.songId", &uint_buf1, &error) == true) {
+            if (json_index_get_uint_max(&params, "$.params.songId", &uint_buf1, &error) == true) {
                 rc = mpd_run_delete_id(mympd_state->partition_state->conn, uint_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_delete_id", &result);
             }
             break;
         case MYMPD_API_QUEUE_RM_RANGE:
-            if (json_get_uint(request->data, "$.params.start", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
-                json_get_int(request->data, "$.params.end", -1, MPD_PLAYLIST_LENGTH_MAX, &int_buf1, &error) == true)
+            if (json_index_get_uint(&params, "$.params.start", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
+                json_index_get_int(&params, "$.params.end", -1, MPD_PLAYLIST_LENGTH_MAX, &int_buf1, &error) == true)
             {
                 //map -1 to UINT_MAX for open ended range
                 uint_buf2 = int_buf1 < 0 ? UINT_MAX : (unsigned)int_buf1;
@@ -794,8 +953,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_QUEUE_MOVE_SONG:
-            if (json_get_uint(request->data, "$.params.from", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
-                json_get_uint(request->data, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf2, &error) == true)
+            if (json_index_get_uint(&params, "$.params.from", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
+                json_index_get_uint(&params, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf2, &error) == true)
             {
                 if (uint_buf1 < uint_buf2) {
                     uint_buf2--;
@@ -805,8 +964,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_QUEUE_PRIO_SET:
-            if (json_get_uint_max(request->data, "$.params.songId", &uint_buf1, &error) == true &&
-                json_get_uint(request->data, "$.params.priority", 0, MPD_QUEUE_PRIO_MAX, &uint_buf2, &error) == true)
+            if (json_index_get_uint_max(&params, "$.params.songId", &uint_buf1, &error) == true &&
+                json_index_get_uint(&params, "$.params.priority", 0, MPD_QUEUE_PRIO_MAX, &uint_buf2, &error) == true)
             {
                 rc = mympd_api_queue_prio_set(mympd_state->partition_state, uint_buf1, uint_buf2);
                 if (rc == true) {
@@ -819,7 +978,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_QUEUE_PRIO_SET_HIGHEST:
-            if (json_get_uint_max(request->data, "$.params.songId", &uint_buf1, &error) == true) {
+            if (json_index_get_uint_max(&params, "$.params.songId", &uint_buf1, &error) == true) {
                 rc = mympd_api_queue_prio_set_highest(mympd_state->partition_state, uint_buf1);
                 if (rc == true) {
                     response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_QUEUE);
@@ -831,13 +990,13 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_PLAYER_PLAY_SONG:
-            if (json_get_uint_max(request->data, "$.params.songId", &uint_buf1, &error) == true) {
+            if (json_index_get_uint_max(&params, "$.params.songId", &uint_buf1, &error) == true) {
                 rc = mpd_run_play_id(mympd_state->partition_state->conn, uint_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_play_id", &result);
             }
             break;
         case MYMPD_API_PLAYER_OUTPUT_LIST:
-            if (json_get_string(request->data, "$.params.partition", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true) {
+            if (json_index_get_string(&params, "$.params.partition", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true) {
                 if (sdslen(sds_buf1) == 0) {
                     sds_buf1 = sds_replace(sds_buf1, mympd_state->partition_state->name);
                 }
@@ -845,8 +1004,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_PLAYER_OUTPUT_TOGGLE:
-            if (json_get_uint(request->data, "$.params.outputId", 0, MPD_OUTPUT_ID_MAX, &uint_buf1, &error) == true &&
-                json_get_uint(request->data, "$.params.state", 0, 1, &uint_buf2, &error) == true)
+            if (json_index_get_uint(&params, "$.params.outputId", 0, MPD_OUTPUT_ID_MAX, &uint_buf1, &error) == true &&
+                json_index_get_uint(&params, "$.params.state", 0, 1, &uint_buf2, &error) == true)
             {
                 if (uint_buf2 == 1) {
                     rc = mpd_run_enable_output(mympd_state->partition_state->conn, uint_buf1);
@@ -859,7 +1018,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_PLAYER_VOLUME_SET:
-            if (json_get_uint(request->data, "$.params.volume", 0, 100, &uint_buf1, &error) == true) {
+            if (json_index_get_uint(&params, "$.params.volume", 0, 100, &uint_buf1, &error) == true) {
                 if (uint_buf1 > mympd_state->volume_max || uint_buf1 < mympd_state->volume_min) {
                     response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
                         JSONRPC_FACILITY_PLAYER, JSONRPC_SEVERITY_ERROR, "Invalid volume level");
@@ -874,8 +1033,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             response->data = mympd_api_status_volume_get(mympd_state->partition_state, response->data, request->id);
             break;
         case MYMPD_API_PLAYER_SEEK_CURRENT:
-            if (json_get_int_max(request->data, "$.params.seek", &int_buf1, &error) == true &&
-                json_get_bool(request->data, "$.params.relative", &bool_buf1, &error) == true)
+            if (json_index_get_int_max(&params, "$.params.seek", &int_buf1, &error) == true &&
+                json_index_get_bool(&params, "$.params.relative", &bool_buf1, &error) == true)
             {
                 rc = mpd_run_seek_current(mympd_state->partition_state->conn, (float)int_buf1, bool_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_seek_current", &result);
@@ -884,37 +1043,51 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_QUEUE_LIST: {
             struct t_tags tagcols;
             reset_t_tags(&tagcols);
-            if (json_get_long(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
-                json_get_tags(request->data, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
+            if (json_index_get_long(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
+                json_index_get_tags(&params, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
             {
-                response->data = mympd_api_queue_list(mympd_state->partition_state, response->data, request->id, long_buf1, long_buf2, &tagcols);
+                response->data = mympd_api_queue_list(mympd_state->partition_state, response->data, request->id, long_buf1, long_buf2, &tagcols, &stream);
             }
             break;
         }
         case MYMPD_API_LAST_PLAYED_LIST: {
             struct t_tags tagcols;
             reset_t_tags(&tagcols);
-            if (json_get_long(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
-                json_get_string(request->data, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_tags(request->data, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
+            if (json_index_get_long(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
+                json_index_get_string(&params, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_tags(&params, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
             {
                 response->data = mympd_api_last_played_list(mympd_state->partition_state, response->data, request->id, long_buf1, long_buf2, sds_buf1, &tagcols);
             }
             break;
         }
+        case MYMPD_API_PLAY_STATS_TOP_LIST:
+            if (json_index_get_string(&params, "$.params.type", 1, NAME_LEN_MAX, &sds_buf1, vcb_isalnum, &error) == true &&
+                json_index_get_int(&params, "$.params.days", 1, PLAY_STATS_DAYS_MAX, &int_buf1, &error) == true &&
+                json_index_get_string(&params, "$.params.sort", 1, NAME_LEN_MAX, &sds_buf2, vcb_isalnum, &error) == true &&
+                json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf1, &error) == true)
+            {
+                response->data = mympd_api_play_stats_top_list(mympd_state->mpd_state, response->data, request->id, sds_buf1, int_buf1, sds_buf2, long_buf1);
+            }
+            break;
+        case MYMPD_API_PLAY_STATS_DAYS_LIST:
+            if (json_index_get_int(&params, "$.params.days", 1, PLAY_STATS_DAYS_MAX, &int_buf1, &error) == true) {
+                response->data = mympd_api_play_stats_days_list(mympd_state->mpd_state, response->data, request->id, int_buf1);
+            }
+            break;
         case MYMPD_API_PLAYER_CURRENT_SONG: {
             response->data = mympd_api_status_current_song(mympd_state->partition_state, response->data, request->id);
             break;
         }
         case MYMPD_API_SONG_DETAILS:
-            if (json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
+            if (json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
                 response->data = mympd_api_song_details(mympd_state->partition_state, response->data, request->id, sds_buf1);
             }
             break;
         case MYMPD_API_SONG_COMMENTS:
-            if (json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
+            if (json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
                 response->data = mympd_api_song_comments(mympd_state->partition_state, response->data, request->id, sds_buf1);
             }
             break;
@@ -924,26 +1097,26 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
                     JSONRPC_FACILITY_DATABASE, JSONRPC_SEVERITY_ERROR, "Fingerprint command not supported");
                 break;
             }
-            if (json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
+            if (json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
                 response->data = mympd_api_song_fingerprint(mympd_state->partition_state, response->data, request->id, sds_buf1);
             }
             break;
         case MYMPD_API_PLAYLIST_RENAME:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_string(request->data, "$.params.newName", 1, FILENAME_LEN_MAX, &sds_buf2, vcb_isfilename, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_string(&params, "$.params.newName", 1, FILENAME_LEN_MAX, &sds_buf2, vcb_isfilename, &error) == true)
             {
                 response->data = mympd_api_playlist_rename(mympd_state->partition_state, response->data, request->id, sds_buf1, sds_buf2);
             }
             break;
         case MYMPD_API_PLAYLIST_RM:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_bool(request->data, "$.params.smartplsOnly", &bool_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_bool(&params, "$.params.smartplsOnly", &bool_buf1, &error) == true)
             {
                 response->data = mympd_api_playlist_delete(mympd_state->partition_state, response->data, request->id, sds_buf1, bool_buf1);
             }
             break;
         case MYMPD_API_PLAYLIST_RM_ALL:
-            if (json_get_string(request->data, "$.params.type", 1, NAME_LEN_MAX, &sds_buf1, vcb_isalnum, &error) == true) {
+            if (json_index_get_string(&params, "$.params.type", 1, NAME_LEN_MAX, &sds_buf1, vcb_isalnum, &error) == true) {
                 enum plist_delete_criterias criteria = parse_plist_delete_criteria(sds_buf1);
                 if (criteria > -1) {
                     response->data = mympd_api_playlist_delete_all(mympd_state->partition_state, response->data, request->id, criteria);
@@ -955,10 +1128,10 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_PLAYLIST_LIST:
-            if (json_get_long(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
-                json_get_string(request->data, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_uint(request->data, "$.params.type", 0, 2, &uint_buf1, &error) == true)
+            if (json_index_get_long(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
+                json_index_get_string(&params, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_uint(&params, "$.params.type", 0, 2, &uint_buf1, &error) == true)
             {
                 response->data = mympd_api_playlist_list(mympd_state->partition_state, response->data, request->cmd_id, long_buf1, long_buf2, sds_buf1, uint_buf1);
             }
@@ -966,19 +1139,19 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_PLAYLIST_CONTENT_LIST: {
             struct t_tags tagcols;
             reset_t_tags(&tagcols);
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_long(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
-                json_get_string(request->data, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf2, vcb_isname, &error) == true &&
-                json_get_tags(request->data, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_long(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
+                json_index_get_string(&params, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf2, vcb_isname, &error) == true &&
+                json_index_get_tags(&params, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
             {
-                response->data = mympd_api_playlist_content_list(mympd_state->partition_state, response->data, request->id, sds_buf1, long_buf1, long_buf2, sds_buf2, &tagcols);
+                response->data = mympd_api_playlist_content_list(mympd_state->partition_state, response->data, request->id, sds_buf1, long_buf1, long_buf2, sds_buf2, &tagcols, &stream);
             }
             break;
         }
         case MYMPD_API_PLAYLIST_CONTENT_APPEND_URI:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isuri, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isuri, &error) == true)
             {
                 rc = mpd_run_playlist_add(mympd_state->partition_state->conn, sds_buf1, sds_buf2);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_playlist_add", &result);
@@ -994,9 +1167,9 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
                     JSONRPC_FACILITY_PLAYLIST, JSONRPC_SEVERITY_ERROR, "Method not supported");
                 break;
             }
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isuri, &error) == true &&
-                json_get_uint(request->data, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isuri, &error) == true &&
+                json_index_get_uint(&params, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true)
             {
                 rc = mpd_run_playlist_add_to(mympd_state->partition_state->conn, sds_buf1, sds_buf2, uint_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_playlist_add_to", &result);
@@ -1007,8 +1180,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_PLAYLIST_CONTENT_REPLACE_URI:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isuri, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isuri, &error) == true)
             {
                 rc = mpd_run_playlist_clear(mympd_state->partition_state->conn, sds_buf1);
                 if (rc == false) {
@@ -1029,9 +1202,9 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
                     JSONRPC_FACILITY_PLAYLIST, JSONRPC_SEVERITY_ERROR, "Method not supported");
                 break;
             }
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_string(request->data, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf2, vcb_isname, &error) == true &&
-                json_get_uint(request->data, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_string(&params, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf2, vcb_isname, &error) == true &&
+                json_index_get_uint(&params, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true)
             {
                 result = mpd_client_search_add_to_plist(mympd_state->partition_state, sds_buf2, sds_buf1, uint_buf1, &response->data);
                 if (result == true) {
@@ -1042,8 +1215,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             break;
         case MYMPD_API_PLAYLIST_CONTENT_REPLACE_SEARCH:
         case MYMPD_API_PLAYLIST_CONTENT_APPEND_SEARCH:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_string(request->data, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf2, vcb_isname, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_string(&params, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf2, vcb_isname, &error) == true)
             {
                 if (request->cmd_id == MYMPD_API_PLAYLIST_CONTENT_REPLACE_SEARCH) {
                     rc = mpd_run_playlist_clear(mympd_state->partition_state->conn, sds_buf1);
@@ -1060,7 +1233,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_PLAYLIST_CONTENT_CLEAR:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
                 rc = mpd_run_playlist_clear(mympd_state->partition_state->conn, sds_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_playlist_clear", &result);
                 if (result == true) {
@@ -1070,9 +1243,9 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_PLAYLIST_CONTENT_MOVE_SONG:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_uint(request->data, "$.params.from", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
-                json_get_uint(request->data, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf2, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_uint(&params, "$.params.from", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
+                json_index_get_uint(&params, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf2, &error) == true)
             {
                 if (uint_buf1 < uint_buf2) {
                     uint_buf2--;
@@ -1082,8 +1255,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_PLAYLIST_CONTENT_RM_SONG:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_uint(request->data, "$.params.pos", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_uint(&params, "$.params.pos", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true)
             {
                 rc = mpd_run_playlist_delete(mympd_state->partition_state->conn, sds_buf1, uint_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_playlist_delete", &result);
@@ -1095,9 +1268,9 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
                     JSONRPC_FACILITY_PLAYLIST, JSONRPC_SEVERITY_ERROR, "Method not supported");
                 break;
             }
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_uint(request->data, "$.params.start", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
-                json_get_int(request->data, "$.params.end", -1, MPD_PLAYLIST_LENGTH_MAX, &int_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_uint(&params, "$.params.start", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
+                json_index_get_int(&params, "$.params.end", -1, MPD_PLAYLIST_LENGTH_MAX, &int_buf1, &error) == true)
             {
                 //map -1 to UINT_MAX for open ended range
                 uint_buf2 = int_buf1 < 0 ? UINT_MAX : (unsigned)int_buf1;
@@ -1106,7 +1279,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_PLAYLIST_CONTENT_SHUFFLE:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
                 rc = mpd_client_playlist_shuffle(mympd_state->partition_state, sds_buf1);
                 if (rc == true) {
                     response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
@@ -1119,8 +1292,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_PLAYLIST_CONTENT_SORT:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_string(request->data, "$.params.tag", 1, NAME_LEN_MAX, &sds_buf2, vcb_ismpdtag, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_string(&params, "$.params.tag", 1, NAME_LEN_MAX, &sds_buf2, vcb_ismpdtag, &error) == true)
             {
                 rc = mpd_client_playlist_sort(mympd_state->partition_state, sds_buf1, sds_buf2);
                 if (rc == true) {
@@ -1136,18 +1309,18 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_DATABASE_FILESYSTEM_LIST: {
             struct t_tags tagcols;
             reset_t_tags(&tagcols);
-            if (json_get_long(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
-                json_get_string(request->data, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_string(request->data, "$.params.path", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isfilepath, &error) == true &&
-                json_get_string(request->data, "$.params.type", 1, 5, &sds_buf3, vcb_isalnum, &error) == true &&
-                json_get_tags(request->data, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
+            if (json_index_get_long(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
+                json_index_get_string(&params, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_string(&params, "$.params.path", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isfilepath, &error) == true &&
+                json_index_get_string(&params, "$.params.type", 1, 5, &sds_buf3, vcb_isalnum, &error) == true &&
+                json_index_get_tags(&params, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
             {
                 if (strcmp(sds_buf3, "plist") == 0) {
-                    response->data = mympd_api_playlist_content_list(mympd_state->partition_state, response->data, request->id, sds_buf2, long_buf1, long_buf2, sds_buf1, &tagcols);
+                    response->data = mympd_api_playlist_content_list(mympd_state->partition_state, response->data, request->id, sds_buf2, long_buf1, long_buf2, sds_buf1, &tagcols, &stream);
                 }
                 else {
-                    response->data = mympd_api_browse_filesystem(mympd_state->partition_state, response->data, request->id, sds_buf2, long_buf1, long_buf2, sds_buf1, &tagcols);
+                    response->data = mympd_api_browse_filesystem(mympd_state->partition_state, response->data, request->id, sds_buf2, long_buf1, long_buf2, sds_buf1, &tagcols, &stream);
                 }
             }
             break;
@@ -1158,10 +1331,10 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
                     JSONRPC_FACILITY_QUEUE, JSONRPC_SEVERITY_ERROR, "Method not supported");
                 break;
             }
-            if (json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
-                json_get_uint(request->data, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
-                json_get_uint(request->data, "$.params.whence", 0, 2, &uint_buf2, &error) == true &&
-                json_get_bool(request->data, "$.params.play", &bool_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
+                json_index_get_uint(&params, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
+                json_index_get_uint(&params, "$.params.whence", 0, 2, &uint_buf2, &error) == true &&
+                json_index_get_bool(&params, "$.params.play", &bool_buf1, &error) == true)
             {
                 rc = mpd_run_add_whence(mympd_state->partition_state->conn, sds_buf1, uint_buf1, uint_buf2);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_add_whence", &result);
@@ -1174,8 +1347,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_QUEUE_REPLACE_URI:
-            if (json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
-                json_get_bool(request->data, "$.params.play", &bool_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
+                json_index_get_bool(&params, "$.params.play", &bool_buf1, &error) == true)
             {
                 rc = mympd_api_queue_replace_with_song(mympd_state->partition_state, sds_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mympd_api_queue_replace_with_song", &result);
@@ -1188,8 +1361,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_QUEUE_APPEND_URI:
-            if (json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
-                json_get_bool(request->data, "$.params.play", &bool_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
+                json_index_get_bool(&params, "$.params.play", &bool_buf1, &error) == true)
             {
                 rc = mpd_run_add(mympd_state->partition_state->conn, sds_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_add", &result);
@@ -1202,8 +1375,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_QUEUE_APPEND_PLAYLIST:
-            if (json_get_string(request->data, "$.params.plist", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
-                json_get_bool(request->data, "$.params.play", &bool_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
+                json_index_get_bool(&params, "$.params.play", &bool_buf1, &error) == true)
             {
                 sds_buf1 = resolv_mympd_uri(sds_buf1, mympd_state->mpd_state->mpd_host, config->http_host, config->http_port);
                 rc = mpd_run_load(mympd_state->partition_state->conn, sds_buf1);
@@ -1222,10 +1395,10 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
                     JSONRPC_FACILITY_QUEUE, JSONRPC_SEVERITY_ERROR, "Method not supported");
                 break;
             }
-            if (json_get_string(request->data, "$.params.plist", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
-                json_get_uint(request->data, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
-                json_get_uint(request->data, "$.params.whence", 0, 2, &uint_buf2, &error) == true &&
-                json_get_bool(request->data, "$.params.play", &bool_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
+                json_index_get_uint(&params, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
+                json_index_get_uint(&params, "$.params.whence", 0, 2, &uint_buf2, &error) == true &&
+                json_index_get_bool(&params, "$.params.play", &bool_buf1, &error) == true)
             {
                 sds_buf1 = resolv_mympd_uri(sds_buf1, mympd_state->mpd_state->mpd_host, config->http_host, config->http_port);
                 rc = mpd_run_load_range_to(mympd_state->partition_state->conn, sds_buf1, 0, UINT_MAX, uint_buf1, uint_buf2);
@@ -1239,8 +1412,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_QUEUE_REPLACE_PLAYLIST:
-            if (json_get_string(request->data, "$.params.plist", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
-                json_get_bool(request->data, "$.params.play", &bool_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
+                json_index_get_bool(&params, "$.params.play", &bool_buf1, &error) == true)
             {
                 sds_buf1 = resolv_mympd_uri(sds_buf1, mympd_state->mpd_state->mpd_host, config->http_host, config->http_port);
                 rc = mympd_api_queue_replace_with_playlist(mympd_state->partition_state, sds_buf1);
@@ -1259,10 +1432,10 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
                     JSONRPC_FACILITY_QUEUE, JSONRPC_SEVERITY_ERROR, "Method not supported");
                 break;
             }
-            if (json_get_string(request->data, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_uint(request->data, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
-                json_get_uint(request->data, "$.params.whence", 0, 2, &uint_buf2, &error) == true &&
-                json_get_bool(request->data, "$.params.play", &bool_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_uint(&params, "$.params.to", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
+                json_index_get_uint(&params, "$.params.whence", 0, 2, &uint_buf2, &error) == true &&
+                json_index_get_bool(&params, "$.params.play", &bool_buf1, &error) == true)
             {
                 result = mpd_client_search_add_to_queue(mympd_state->partition_state, sds_buf1, uint_buf1, uint_buf2, &response->data);
                 if (result == true &&
@@ -1275,8 +1448,8 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             break;
         case MYMPD_API_QUEUE_REPLACE_SEARCH:
         case MYMPD_API_QUEUE_APPEND_SEARCH:
-            if (json_get_string(request->data, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_bool(request->data, "$.params.play", &bool_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_bool(&params, "$.params.play", &bool_buf1, &error) == true)
             {
                 if (request->cmd_id == MYMPD_API_QUEUE_REPLACE_SEARCH) {
                     rc = mpd_run_clear(mympd_state->partition_state->conn);
@@ -1295,9 +1468,9 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_QUEUE_ADD_RANDOM:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_uint(request->data, "$.params.mode", 0, 2, &uint_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.quantity", 0, 1000, &long_buf1, &error) == true)
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_uint(&params, "$.params.mode", 0, 2, &uint_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.quantity", 0, 1000, &long_buf1, &error) == true)
             {
                 rc = jukebox_add_to_queue(mympd_state->partition_state, long_buf1, uint_buf1, sds_buf1, true);
                 if (rc == true) {
@@ -1311,7 +1484,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_QUEUE_SAVE:
-            if (json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
+            if (json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
                 rc = mpd_run_save(mympd_state->partition_state->conn, sds_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_save", &result);
             }
@@ -1319,11 +1492,11 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_QUEUE_SEARCH: {
             struct t_tags tagcols;
             reset_t_tags(&tagcols);
-            if (json_get_long(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
-                json_get_string(request->data, "$.params.filter", 1, NAME_LEN_MAX, &sds_buf1, vcb_ismpdtag_or_any, &error) == true &&
-                json_get_string(request->data, "$.params.searchstr", 1, NAME_LEN_MAX, &sds_buf2, vcb_isname, &error) == true &&
-                json_get_tags(request->data, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
+            if (json_index_get_long(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
+                json_index_get_string(&params, "$.params.filter", 1, NAME_LEN_MAX, &sds_buf1, vcb_ismpdtag_or_any, &error) == true &&
+                json_index_get_string(&params, "$.params.searchstr", 1, NAME_LEN_MAX, &sds_buf2, vcb_isname, &error) == true &&
+                json_index_get_tags(&params, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
             {
                 response->data = mympd_api_queue_search(mympd_state->partition_state, response->data, request->id,
                     sds_buf1, long_buf1, long_buf2, sds_buf2, &tagcols);
@@ -1333,12 +1506,12 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_QUEUE_SEARCH_ADV: {
             struct t_tags tagcols;
             reset_t_tags(&tagcols);
-            if (json_get_string(request->data, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_string(request->data, "$.params.sort", 0, NAME_LEN_MAX, &sds_buf2, vcb_ismpdsort, &error) == true &&
-                json_get_bool(request->data, "$.params.sortdesc", &bool_buf1, &error) == true &&
-                json_get_uint(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
-                json_get_uint(request->data, "$.params.limit", 0, MPD_RESULTS_MAX, &uint_buf2, &error) == true &&
-                json_get_tags(request->data, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
+            if (json_index_get_string(&params, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_string(&params, "$.params.sort", 0, NAME_LEN_MAX, &sds_buf2, vcb_ismpdsort, &error) == true &&
+                json_index_get_bool(&params, "$.params.sortdesc", &bool_buf1, &error) == true &&
+                json_index_get_uint(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
+                json_index_get_uint(&params, "$.params.limit", 0, MPD_RESULTS_MAX, &uint_buf2, &error) == true &&
+                json_index_get_tags(&params, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
             {
                 response->data = mympd_api_queue_search_adv(mympd_state->partition_state, response->data, request->id,
                     sds_buf1, sds_buf2, bool_buf1, uint_buf1, uint_buf2, &tagcols);
@@ -1348,12 +1521,12 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
         case MYMPD_API_DATABASE_SEARCH: {
             struct t_tags tagcols;
             reset_t_tags(&tagcols);
-            if (json_get_string(request->data, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_string(request->data, "$.params.sort", 0, NAME_LEN_MAX, &sds_buf2, vcb_ismpdsort, &error) == true &&
-                json_get_bool(request->data, "$.params.sortdesc", &bool_buf1, &error) == true &&
-                json_get_uint(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
-                json_get_uint(request->data, "$.params.limit", 0, MPD_RESULTS_MAX, &uint_buf2, &error) == true &&
-                json_get_tags(request->data, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
+            if (json_index_get_string(&params, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_string(&params, "$.params.sort", 0, NAME_LEN_MAX, &sds_buf2, vcb_ismpdsort, &error) == true &&
+                json_index_get_bool(&params, "$.params.sortdesc", &bool_buf1, &error) == true &&
+                json_index_get_uint(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &uint_buf1, &error) == true &&
+                json_index_get_uint(&params, "$.params.limit", 0, MPD_RESULTS_MAX, &uint_buf2, &error) == true &&
+                json_index_get_tags(&params, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
             {
                 response->data = mpd_client_search_response(mympd_state->partition_state, response->data, request->id,
                     sds_buf1, sds_buf2, bool_buf1, uint_buf1, uint_buf2, &tagcols, &mympd_state->mpd_state->sticker_cache, &result);
@@ -1368,27 +1541,27 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             response->data = mympd_api_stats_get(mympd_state->partition_state, response->data, request->id);
             break;
         case INTERNAL_API_ALBUMART:
-            if (json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
+            if (json_index_get_string(&params, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
                 response->data = mympd_api_albumart_getcover(mympd_state->partition_state, response->data, request->id, sds_buf1, &response->binary);
             }
             break;
         case MYMPD_API_DATABASE_ALBUMS_GET:
-            if (json_get_long(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
-                json_get_string(request->data, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_string(request->data, "$.params.sort", 1, NAME_LEN_MAX, &sds_buf2, vcb_ismpdsort, &error) == true &&
-                json_get_bool(request->data, "$.params.sortdesc", &bool_buf1, &error) == true)
+            if (json_index_get_long(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
+                json_index_get_string(&params, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_string(&params, "$.params.sort", 1, NAME_LEN_MAX, &sds_buf2, vcb_ismpdsort, &error) == true &&
+                json_index_get_bool(&params, "$.params.sortdesc", &bool_buf1, &error) == true)
             {
                 response->data = mympd_api_browse_album_list(mympd_state->partition_state, response->data, request->id,
                     sds_buf1, sds_buf2, bool_buf1, long_buf1, long_buf2);
             }
             break;
         case MYMPD_API_DATABASE_TAG_LIST:
-            if (json_get_long(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
-                json_get_string(request->data, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_string(request->data, "$.params.tag", 1, NAME_LEN_MAX, &sds_buf2, vcb_ismpdtag_or_any, &error) == true &&
-                json_get_bool(request->data, "$.params.sortdesc", &bool_buf1, &error) == true)
+            if (json_index_get_long(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
+                json_index_get_string(&params, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_string(&params, "$.params.tag", 1, NAME_LEN_MAX, &sds_buf2, vcb_ismpdtag_or_any, &error) == true &&
+                json_index_get_bool(&params, "$.params.sortdesc", &bool_buf1, &error) == true)
             {
                 response->data = mympd_api_browse_tag_list(mympd_state->partition_state, response->data, request->id,
                     sds_buf1, sds_buf2, long_buf1, long_buf2, bool_buf1);
@@ -1399,9 +1572,9 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             reset_t_tags(&tagcols);
             struct t_list albumartists;
             list_init(&albumartists);
-            if (json_get_string(request->data, "$.params.album", 1, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_array_string(request->data, "$.params.albumartist", &albumartists, vcb_isname, 10, &error) == true &&
-                json_get_tags(request->data, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
+            if (json_index_get_string(&params, "$.params.album", 1, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_array_string(&params, "$.params.albumartist", &albumartists, vcb_isname, 10, &error) == true &&
+                json_index_get_tags(&params, "$.params.cols", &tagcols, COLS_MAX, &error) == true)
             {
                 response->data = mympd_api_browse_album_songs(mympd_state->partition_state, response->data, request->id, sds_buf1, &albumartists, &tagcols);
             }
@@ -1409,9 +1582,9 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             break;
         }
         case INTERNAL_API_TIMER_STARTPLAY:
-            if (json_get_uint(request->data, "$.params.volume", 0, 100, &uint_buf1, &error) == true &&
-                json_get_string(request->data, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
-                json_get_uint(request->data, "$.params.jukeboxMode", 0, 2, &uint_buf2, &error) == true)
+            if (json_index_get_uint(&params, "$.params.volume", 0, 100, &uint_buf1, &error) == true &&
+                json_index_get_string(&params, "$.params.plist", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true &&
+                json_index_get_uint(&params, "$.params.jukeboxMode", 0, 2, &uint_buf2, &error) == true)
             {
                 rc = mympd_api_timer_startplay(mympd_state->partition_state, uint_buf1, sds_buf1, uint_buf2);
                 if (rc == true) {
@@ -1430,30 +1603,45 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             response->data = mympd_api_partition_list(mympd_state->partition_state, response->data, request->id);
             break;
         case MYMPD_API_PARTITION_NEW:
-            if (json_get_string(request->data, "$.params.name", 1, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true) {
+            if (json_index_get_string(&params, "$.params.name", 1, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true) {
                 rc = mpd_run_newpartition(mympd_state->partition_state->conn, sds_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_newpartition", &result);
             }
             break;
         case MYMPD_API_PARTITION_SWITCH:
-            if (json_get_string(request->data, "$.params.name", 1, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true) {
+            if (json_index_get_string(&params, "$.params.name", 1, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true) {
+                //the partition has already an own connection
+                if (mpd_client_partitions_switch(mympd_state, sds_buf1) == true) {
+                    response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_MPD);
+                    break;
+                }
                 rc = mpd_run_switch_partition(mympd_state->partition_state->conn, sds_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_switch_partition", &result);
                 if (result == true) {
                     mympd_state->partition_state->name = sds_replace(mympd_state->partition_state->name, sds_buf1);
+                    //the settings and the jukebox queue belong to the partition
+                    mympd_api_settings_partition_read(mympd_state->config->workdir, mympd_state->partition_state);
+                    jukebox_clear(&mympd_state->partition_state->jukebox_queue);
+                    mpd_client_partitions_populate(mympd_state);
                 }
             }
             break;
         case MYMPD_API_PARTITION_RM:
-            if (json_get_string(request->data, "$.params.name", 1, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true) {
+            if (json_index_get_string(&params, "$.params.name", 1, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true) {
+                //mpd can not delete partitions with connected clients
+                mpd_client_partitions_remove(mympd_state, sds_buf1);
                 rc = mpd_run_delete_partition(mympd_state->partition_state->conn, sds_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_delete_partition", &result);
+                if (result == false) {
+                    //reconnect the partition
+                    mpd_client_partitions_populate(mympd_state);
+                }
             }
             break;
         case MYMPD_API_PARTITION_OUTPUT_MOVE: {
             struct t_list outputs;
             list_init(&outputs); 
-            if (json_get_array_string(request->data, "$.params.outputs", &outputs, vcb_isname, 10, &error) == true) {
+            if (json_index_get_array_string(&params, "$.params.outputs", &outputs, vcb_isname, 10, &error) == true) {
                 struct t_list_node *current;
                 while ((current = list_shift_first(&outputs)) != NULL) {
                     rc = mpd_run_move_output(mympd_state->partition_state->conn, current->key);
@@ -1474,44 +1662,44 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             response->data = mympd_api_mounts_neighbor_list(mympd_state->partition_state, response->data, request->id);
             break;
         case MYMPD_API_MOUNT_MOUNT:
-            if (json_get_string(request->data, "$.params.mountUrl", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
-                json_get_string(request->data, "$.params.mountPoint", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isfilepath, &error) == true)
+            if (json_index_get_string(&params, "$.params.mountUrl", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isuri, &error) == true &&
+                json_index_get_string(&params, "$.params.mountPoint", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isfilepath, &error) == true)
             {
                 rc = mpd_run_mount(mympd_state->partition_state->conn, sds_buf2, sds_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_mount", &result);
             }
             break;
         case MYMPD_API_MOUNT_UNMOUNT:
-            if (json_get_string(request->data, "$.params.mountPoint", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
+            if (json_index_get_string(&params, "$.params.mountPoint", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &error) == true) {
                 rc = mpd_run_unmount(mympd_state->partition_state->conn, sds_buf1);
                 response->data = mympd_respond_with_error_or_ok(mympd_state->partition_state, response->data, request->cmd_id, request->id, rc, "mpd_run_unmount", &result);
             }
             break;
         case MYMPD_API_WEBRADIO_FAVORITE_LIST:
-            if (json_get_long(request->data, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
-                json_get_long(request->data, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
-                json_get_string(request->data, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true)
+            if (json_index_get_long(&params, "$.params.offset", 0, MPD_PLAYLIST_LENGTH_MAX, &long_buf1, &error) == true &&
+                json_index_get_long(&params, "$.params.limit", MPD_RESULTS_MIN, MPD_RESULTS_MAX, &long_buf2, &error) == true &&
+                json_index_get_string(&params, "$.params.searchstr", 0, NAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true)
             {
                 response->data = mympd_api_webradio_list(config->workdir, response->data, request->cmd_id, sds_buf1, long_buf1, long_buf2);
             }
             break;
         case MYMPD_API_WEBRADIO_FAVORITE_GET:
-            if (json_get_string(request->data, "$.params.filename", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
+            if (json_index_get_string(&params, "$.params.filename", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
                 response->data = mympd_api_webradio_get(config->workdir, response->data, request->cmd_id, sds_buf1);
             }
             break;
         case MYMPD_API_WEBRADIO_FAVORITE_SAVE:
-            if (json_get_string(request->data, "$.params.name", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
-                json_get_string(request->data, "$.params.streamUri", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isuri, &error) == true &&
-                json_get_string(request->data, "$.params.streamUriOld", 0, FILEPATH_LEN_MAX, &sds_buf3, vcb_isuri, &error) == true &&
-                json_get_string(request->data, "$.params.genre", 0, FILENAME_LEN_MAX, &sds_buf4, vcb_isname, &error) == true &&
-                json_get_string(request->data, "$.params.image", 0, FILEPATH_LEN_MAX, &sds_buf5, vcb_isuri, &error) == true &&
-                json_get_string(request->data, "$.params.homepage", 0, FILEPATH_LEN_MAX, &sds_buf6, vcb_isuri, &error) == true &&
-                json_get_string(request->data, "$.params.country", 0, FILEPATH_LEN_MAX, &sds_buf7, vcb_isname, &error) == true &&
-                json_get_string(request->data, "$.params.language", 0, FILEPATH_LEN_MAX, &sds_buf8, vcb_isname, &error) == true &&
-                json_get_string(request->data, "$.params.codec", 0, FILEPATH_LEN_MAX, &sds_buf9, vcb_isalnum, &error) == true &&
-                json_get_int(request->data, "$.params.bitrate", 0, 2048, &int_buf1, &error) == true &&
-                json_get_string(request->data, "$.params.description", 0, CONTENT_LEN_MAX, &sds_buf0, vcb_isname, &error) == true
+            if (json_index_get_string(&params, "$.params.name", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isname, &error) == true &&
+                json_index_get_string(&params, "$.params.streamUri", 1, FILEPATH_LEN_MAX, &sds_buf2, vcb_isuri, &error) == true &&
+                json_index_get_string(&params, "$.params.streamUriOld", 0, FILEPATH_LEN_MAX, &sds_buf3, vcb_isuri, &error) == true &&
+                json_index_get_string(&params, "$.params.genre", 0, FILENAME_LEN_MAX, &sds_buf4, vcb_isname, &error) == true &&
+                json_index_get_string(&params, "$.params.image", 0, FILEPATH_LEN_MAX, &sds_buf5, vcb_isuri, &error) == true &&
+                json_index_get_string(&params, "$.params.homepage", 0, FILEPATH_LEN_MAX, &sds_buf6, vcb_isuri, &error) == true &&
+                json_index_get_string(&params, "$.params.country", 0, FILEPATH_LEN_MAX, &sds_buf7, vcb_isname, &error) == true &&
+                json_index_get_string(&params, "$.params.language", 0, FILEPATH_LEN_MAX, &sds_buf8, vcb_isname, &error) == true &&
+                json_index_get_string(&params, "$.params.codec", 0, FILEPATH_LEN_MAX, &sds_buf9, vcb_isalnum, &error) == true &&
+                json_index_get_int(&params, "$.params.bitrate", 0, 2048, &int_buf1, &error) == true &&
+                json_index_get_string(&params, "$.params.description", 0, CONTENT_LEN_MAX, &sds_buf0, vcb_isname, &error) == true
             ) {
                 rc = mympd_api_webradio_save(config->workdir, sds_buf1, sds_buf2, sds_buf3, sds_buf4, sds_buf5, sds_buf6, sds_buf7,
                     sds_buf8, sds_buf9, int_buf1, sds_buf0);
@@ -1526,7 +1714,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             }
             break;
         case MYMPD_API_WEBRADIO_FAVORITE_RM:
-            if (json_get_string(request->data, "$.params.filename", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
+            if (json_index_get_string(&params, "$.params.filename", 1, FILENAME_LEN_MAX, &sds_buf1, vcb_isfilename, &error) == true) {
                 rc = mympd_api_webradio_delete(config->workdir, sds_buf1);
                 if (rc == true) {
                     response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_DATABASE);
@@ -1561,7 +1749,7 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
 
     if (async == true) {
         FREE_SDS(error);
-        return;
+        return NULL;
     }
 
     if (sdslen(error) > 0) {
@@ -1575,24 +1763,17 @@ void mympd_api_handler(struct t_mympd_state *mympd_state, struct t_work_request
             JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "No response for method %{method}", 2, "method", request->method);
         MYMPD_LOG_ERROR("No response for method \"%s\"", request->method);
     }
-    if (request->conn_id == -2) {
-        MYMPD_LOG_DEBUG("Push response to mympd_script_queue for thread %ld: %s", request->id, response->data);
-        mympd_queue_push(mympd_script_queue, response, request->id);
-    }
-    else if (request->conn_id > -1) {
-        MYMPD_LOG_DEBUG("Push response to web_server_queue for connection %lld: %s", request->conn_id, response->data);
-        mympd_queue_push(web_server_queue, response, 0);
+    if (stream.started == true) {
+        //the response was sent in chunks, only the last chunk is left
+        response_stream_end(&stream, response);
     }
     else {
-        free_response(response);
+        response_cache_add(&mympd_state->mpd_state->response_cache, request, response->data);
     }
-    free_request(request);
+    response_cache_invalidate_by_method(&mympd_state->mpd_state->response_cache, request->cmd_id);
+    return response;
 }
 
-/**
- * Private functions
- */
-
 /**
  * Tries to play the last inserted song and checks for success
  * @param partition_state pointer to partition state
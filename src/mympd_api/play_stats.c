@@ -0,0 +1,318 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "play_stats.h"
+
+#include "../lib/jsonrpc.h"
+#include "../lib/log.h"
+#include "../lib/mem.h"
+#include "../lib/play_stats.h"
+#include "../lib/sds_extras.h"
+#include "../lib/utility.h"
+#include "last_played.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Private definitions
+ */
+
+/**
+ * Sort orders for the top list
+ */
+enum top_sort {
+    TOP_SORT_UNKNOWN = -1,
+    TOP_SORT_PLAYS = 0,
+    TOP_SORT_SKIPS,
+    TOP_SORT_SKIP_RATE
+};
+
+/**
+ * Entry of the top list
+ */
+struct t_top_entry {
+    sds key;                               //!< dimension key
+    struct t_play_stats_counter counter;   //!< merged counter
+    double skip_rate;                      //!< skips / (plays + skips)
+};
+
+static int cmp_plays(const void *a, const void *b);
+static int cmp_skips(const void *a, const void *b);
+static int cmp_skip_rate(const void *a, const void *b);
+static double calc_skip_rate(const struct t_play_stats_counter *counter);
+static sds print_key(sds buffer, enum play_stats_dims dim, sds key);
+static const char *tag_value(const struct mpd_song *song, enum mpd_tag_type tag);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Adds a play or skip event to the listening statistics
+ * @param partition_state pointer to partition state
+ * @param uri song uri
+ * @param event_time time of the event
+ * @param skipped true if the song was skipped
+ */
+void mympd_api_play_stats_add(struct t_partition_state *partition_state, const char *uri, time_t event_time, bool skipped) {
+    if (is_streamuri(uri) == true) {
+        return;
+    }
+    const struct mpd_song *song = mympd_api_last_played_song(partition_state, uri);
+    struct t_play_event event = {
+        .time = event_time,
+        .skipped = skipped,
+        .uri = uri,
+        .title = tag_value(song, MPD_TAG_TITLE),
+        .artist = tag_value(song, MPD_TAG_ARTIST),
+        .album = tag_value(song, MPD_TAG_ALBUM),
+        .albumartist = tag_value(song, partition_state->mpd_state->tag_albumartist),
+        .genre = tag_value(song, MPD_TAG_GENRE)
+    };
+    play_stats_add(&partition_state->mpd_state->play_stats, &event);
+}
+
+/**
+ * Prints the most played or skipped entries of a dimension
+ * @param mpd_state pointer to the shared mpd state
+ * @param buffer already allocated sds string to append the response
+ * @param request_id jsonrpc request id
+ * @param type dimension: Artist, Album, Song or Genre
+ * @param days number of days including today
+ * @param sort sort order: plays, skips or skipRate
+ * @param limit max number of entries to return
+ * @return pointer to buffer
+ */
+sds mympd_api_play_stats_top_list(struct t_mpd_state *mpd_state, sds buffer, long request_id,
+        sds type, int days, sds sort, long limit)
+{
+    enum mympd_cmd_ids cmd_id = MYMPD_API_PLAY_STATS_TOP_LIST;
+    enum play_stats_dims dim = play_stats_dim_parse(type);
+    if (dim == PLAY_STATS_DIM_UNKNOWN) {
+        return jsonrpc_respond_message(buffer, cmd_id, request_id,
+            JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Invalid statistics type");
+    }
+    enum top_sort sort_order = strcmp(sort, "plays") == 0 ? TOP_SORT_PLAYS :
+        strcmp(sort, "skips") == 0 ? TOP_SORT_SKIPS :
+        strcmp(sort, "skipRate") == 0 ? TOP_SORT_SKIP_RATE :
+        TOP_SORT_UNKNOWN;
+    if (sort_order == TOP_SORT_UNKNOWN) {
+        return jsonrpc_respond_message(buffer, cmd_id, request_id,
+            JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Invalid sort order");
+    }
+    struct t_play_stats_counter total;
+    rax *merged = play_stats_merge(&mpd_state->play_stats, dim, days, time(NULL), &total);
+    long entity_count = (long)raxSize(merged);
+    struct t_top_entry *entries = NULL;
+    if (entity_count > 0) {
+        entries = malloc_assert((size_t)entity_count * sizeof(struct t_top_entry));
+        long i = 0;
+        raxIterator iter;
+        raxStart(&iter, merged);
+        raxSeek(&iter, "^", NULL, 0);
+        while (raxNext(&iter)) {
+            struct t_play_stats_counter *counter = (struct t_play_stats_counter *)iter.data;
+            entries[i].key = sdsnewlen(iter.key, iter.key_len);
+            entries[i].counter = *counter;
+            entries[i].skip_rate = calc_skip_rate(counter);
+            i++;
+        }
+        raxStop(&iter);
+        switch(sort_order) {
+            case TOP_SORT_SKIPS:
+                qsort(entries, (size_t)entity_count, sizeof(struct t_top_entry), cmp_skips);
+                break;
+            case TOP_SORT_SKIP_RATE:
+                qsort(entries, (size_t)entity_count, sizeof(struct t_top_entry), cmp_skip_rate);
+                break;
+            default:
+                qsort(entries, (size_t)entity_count, sizeof(struct t_top_entry), cmp_plays);
+        }
+    }
+    play_stats_merge_free(merged);
+
+    buffer = jsonrpc_respond_start(buffer, cmd_id, request_id);
+    buffer = sdscat(buffer, "\"data\":[");
+    long entities_returned = 0;
+    for (long i = 0; i < entity_count; i++) {
+        if (i < limit) {
+            if (entities_returned++) {
+                buffer = sdscatlen(buffer, ",", 1);
+            }
+            buffer = sdscatlen(buffer, "{", 1);
+            buffer = print_key(buffer, dim, entries[i].key);
+            buffer = tojson_long(buffer, "plays", entries[i].counter.plays, true);
+            buffer = tojson_long(buffer, "skips", entries[i].counter.skips, true);
+            buffer = tojson_double(buffer, "skipRate", entries[i].skip_rate, false);
+            buffer = sdscatlen(buffer, "}", 1);
+        }
+        FREE_SDS(entries[i].key);
+    }
+    FREE_PTR(entries);
+    buffer = sdscatlen(buffer, "],", 2);
+    buffer = tojson_sds(buffer, "type", type, true);
+    buffer = tojson_int(buffer, "days", days, true);
+    buffer = tojson_long(buffer, "totalPlays", total.plays, true);
+    buffer = tojson_long(buffer, "totalSkips", total.skips, true);
+    buffer = tojson_long(buffer, "totalEntities", entity_count, true);
+    buffer = tojson_long(buffer, "returnedEntities", entities_returned, false);
+    buffer = jsonrpc_end(buffer);
+    return buffer;
+}
+
+/**
+ * Prints the plays and skips per day, newest first.
+ * Days without events are omitted.
+ * @param mpd_state pointer to the shared mpd state
+ * @param buffer already allocated sds string to append the response
+ * @param request_id jsonrpc request id
+ * @param days number of days including today
+ * @return pointer to buffer
+ */
+sds mympd_api_play_stats_days_list(struct t_mpd_state *mpd_state, sds buffer, long request_id, int days) {
+    enum mympd_cmd_ids cmd_id = MYMPD_API_PLAY_STATS_DAYS_LIST;
+    //start of the oldest day to print
+    time_t oldest = play_stats_day(time(NULL));
+    for (int i = 1; i < days; i++) {
+        oldest = play_stats_day(oldest - 1);
+    }
+
+    buffer = jsonrpc_respond_start(buffer, cmd_id, request_id);
+    buffer = sdscat(buffer, "\"data\":[");
+    long entities_returned = 0;
+    struct t_list_node *current = mpd_state->play_stats.buckets.head;
+    while (current != NULL) {
+        struct t_play_stats_bucket *bucket = (struct t_play_stats_bucket *)current->user_data;
+        if (bucket->day < oldest) {
+            break;
+        }
+        if (entities_returned++) {
+            buffer = sdscatlen(buffer, ",", 1);
+        }
+        buffer = sdscatlen(buffer, "{", 1);
+        buffer = tojson_llong(buffer, "day", (long long)bucket->day, true);
+        buffer = tojson_long(buffer, "plays", bucket->total.plays, true);
+        buffer = tojson_long(buffer, "skips", bucket->total.skips, false);
+        buffer = sdscatlen(buffer, "}", 1);
+        current = current->next;
+    }
+    buffer = sdscatlen(buffer, "],", 2);
+    buffer = tojson_int(buffer, "days", days, true);
+    buffer = tojson_long(buffer, "returnedEntities", entities_returned, false);
+    buffer = jsonrpc_end(buffer);
+    return buffer;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * qsort callback to sort the top list by plays, descending
+ * @param a first entry
+ * @param b second entry
+ * @return compare result
+ */
+static int cmp_plays(const void *a, const void *b) {
+    const struct t_top_entry *e1 = (const struct t_top_entry *)a;
+    const struct t_top_entry *e2 = (const struct t_top_entry *)b;
+    if (e1->counter.plays != e2->counter.plays) {
+        return e1->counter.plays < e2->counter.plays ? 1 : -1;
+    }
+    return strcmp(e1->key, e2->key);
+}
+
+/**
+ * qsort callback to sort the top list by skips, descending
+ * @param a first entry
+ * @param b second entry
+ * @return compare result
+ */
+static int cmp_skips(const void *a, const void *b) {
+    const struct t_top_entry *e1 = (const struct t_top_entry *)a;
+    const struct t_top_entry *e2 = (const struct t_top_entry *)b;
+    if (e1->counter.skips != e2->counter.skips) {
+        return e1->counter.skips < e2->counter.skips ? 1 : -1;
+    }
+    return strcmp(e1->key, e2->key);
+}
+
+/**
+ * qsort callback to sort the top list by skip rate, descending
+ * @param a first entry
+ * @param b second entry
+ * @return compare result
+ */
+static int cmp_skip_rate(const void *a, const void *b) {
+    const struct t_top_entry *e1 = (const struct t_top_entry *)a;
+    const struct t_top_entry *e2 = (const struct t_top_entry *)b;
+    if (e1->skip_rate != e2->skip_rate) {
+        return e1->skip_rate < e2->skip_rate ? 1 : -1;
+    }
+    return cmp_skips(a, b);
+}
+
+/**
+ * Calculates the skip rate
+ * @param counter play and skip counter
+ * @return skips / (plays + skips)
+ */
+static double calc_skip_rate(const struct t_play_stats_counter *counter) {
+    long events = counter->plays + counter->skips;
+    return events > 0
+        ? (double)counter->skips / (double)events
+        : 0;
+}
+
+/**
+ * Prints the key of a dimension as json key/value pairs
+ * @param buffer already allocated sds string to append
+ * @param dim dimension
+ * @param key the key, optionally with a second value after a null byte
+ * @return pointer to buffer
+ */
+static sds print_key(sds buffer, enum play_stats_dims dim, sds key) {
+    size_t len = strlen(key);
+    const char *value2 = len < sdslen(key)
+        ? key + len + 1
+        : "";
+    switch(dim) {
+        case PLAY_STATS_DIM_ARTIST:
+            buffer = tojson_char_len(buffer, "Artist", key, len, true);
+            break;
+        case PLAY_STATS_DIM_ALBUM:
+            buffer = tojson_char_len(buffer, "Album", key, len, true);
+            buffer = tojson_char(buffer, "AlbumArtist", value2, true);
+            break;
+        case PLAY_STATS_DIM_SONG:
+            buffer = tojson_char_len(buffer, "uri", key, len, true);
+            buffer = tojson_char(buffer, "Title", value2, true);
+            break;
+        case PLAY_STATS_DIM_GENRE:
+            buffer = tojson_char_len(buffer, "Genre", key, len, true);
+            break;
+        default:
+            break;
+    }
+    return buffer;
+}
+
+/**
+ * Gets the first value of a tag
+ * @param song pointer to the song, can be NULL
+ * @param tag mpd tag type
+ * @return the tag value or NULL
+ */
+static const char *tag_value(const struct mpd_song *song, enum mpd_tag_type tag) {
+    if (song == NULL ||
+        tag == MPD_TAG_UNKNOWN)
+    {
+        return NULL;
+    }
+    return mpd_song_get_tag(song, tag, 0);
+}
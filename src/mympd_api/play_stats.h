@@ -0,0 +1,16 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_API_PLAY_STATS_H
+#define MYMPD_API_PLAY_STATS_H
+
+#include "../lib/mympd_state.h"
+
+void mympd_api_play_stats_add(struct t_partition_state *partition_state, const char *uri, time_t event_time, bool skipped);
+sds mympd_api_play_stats_top_list(struct t_mpd_state *mpd_state, sds buffer, long request_id,
+        sds type, int days, sds sort, long limit);
+sds mympd_api_play_stats_days_list(struct t_mpd_state *mpd_state, sds buffer, long request_id, int days);
+#endif
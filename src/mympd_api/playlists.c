@@ -189,10 +189,11 @@ sds mympd_api_playlist_list(struct t_partition_state *partition_state, sds buffe
  * @param limit maximum number of entries to print
  * @param searchstr string to search in the playlist name
  * @param tagcols columns to print
+ * @param stream response stream or NULL
  * @return pointer to buffer
  */
 sds mympd_api_playlist_content_list(struct t_partition_state *partition_state, sds buffer, long request_id,
-        sds plist, long offset, long limit, sds searchstr, const struct t_tags *tagcols)
+        sds plist, long offset, long limit, sds searchstr, const struct t_tags *tagcols, struct t_response_stream *stream)
 {
     enum mympd_cmd_ids cmd_id = MYMPD_API_PLAYLIST_CONTENT_LIST;
     bool rc = mpd_send_list_playlist_meta(partition_state->conn, plist);
@@ -240,6 +241,7 @@ sds mympd_api_playlist_content_list(struct t_partition_state *partition_state, s
                     }
                 }
                 buffer = sdscatlen(buffer, "}", 1);
+                buffer = response_stream_flush(stream, buffer);
             }
             else {
                 entity_count--;
@@ -8,6 +8,7 @@
 #define MYMPD_API_PLAYLISTS_H
 
 #include "../lib/mympd_state.h"
+#include "../lib/response_stream.h"
 #include "../mpd_client/playlists.h"
 
 enum plist_delete_criterias {
@@ -23,7 +24,7 @@ sds mympd_api_playlist_list(struct t_partition_state *partition_state, sds buffe
         long offset, long limit, sds searchstr, enum playlist_types type);
 sds mympd_api_playlist_content_list(struct t_partition_state *partition_state, sds buffer,
         long request_id, sds plist, long offset, long limit, sds searchstr,
-        const struct t_tags *tagcols);
+        const struct t_tags *tagcols, struct t_response_stream *stream);
 sds mympd_api_playlist_delete(struct t_partition_state *partition_state, sds buffer,
         long request_id, const char *playlist, bool smartpls_only);
 sds mympd_api_playlist_rename(struct t_partition_state *partition_state, sds buffer,
@@ -7,11 +7,15 @@
 #include "compile_time.h"
 #include "queue.h"
 
+#include "../../dist/utf8/utf8.h"
 #include "../lib/jsonrpc.h"
 #include "../lib/log.h"
+#include "../lib/mem.h"
 #include "../lib/sds_extras.h"
 #include "../lib/utility.h"
 #include "../mpd_client/errorhandler.h"
+#include "../mpd_client/queue_mirror.h"
+#include "../mpd_client/search_local.h"
 #include "../mpd_client/tags.h"
 #include "status.h"
 #include "sticker.h"
@@ -22,7 +26,34 @@
 /**
  * Private definitions
  */
+/**
+ * Sort modes for the local queue search
+ */
+enum queue_sort_types {
+    QUEUE_SORT_NONE,
+    QUEUE_SORT_TAG,
+    QUEUE_SORT_LAST_MODIFIED,
+    QUEUE_SORT_PRIORITY
+};
+
+/**
+ * Entry of the sorted local queue search result
+ */
+struct t_queue_sort_entry {
+    struct mpd_song *song;  //!< pointer to the song in the queue mirror
+    const char *key;        //!< string sort key
+    long long num;          //!< numeric sort key
+    bool desc;              //!< sort descending, equal keys are kept in queue order
+};
+
 sds _print_queue_entry(struct t_partition_state *partition_state, sds buffer, const struct t_tags *tagcols, struct mpd_song *song);
+static bool queue_search_adv_local(struct t_partition_state *partition_state, sds *buffer, long request_id,
+        sds expression, sds sort, bool sortdesc, unsigned offset, unsigned limit,
+        const struct t_tags *tagcols);
+static int queue_sort_entry_cmp_key(const void *a, const void *b);
+static sds queue_status(struct t_partition_state *partition_state, sds buffer, bool delta);
+static sds queue_delta_print(struct t_partition_state *partition_state, sds buffer);
+static int queue_sort_entry_cmp_num(const void *a, const void *b);
 
 /**
  * Public functions
@@ -161,24 +192,19 @@ bool mympd_api_queue_replace_with_playlist(struct t_partition_state *partition_s
  * @return pointer to buffer
  */
 sds mympd_api_queue_status(struct t_partition_state *partition_state, sds buffer) {
-    struct mpd_status *status = mpd_run_status(partition_state->conn);
-    if (status == NULL) {
-        mympd_check_error_and_recover(partition_state);
-        return buffer;
-    }
-
-    partition_state->queue_version = mpd_status_get_queue_version(status);
-    partition_state->queue_length = (long long)mpd_status_get_queue_length(status);
-    partition_state->crossfade = (time_t)mpd_status_get_crossfade(status);
-    partition_state->play_state = mpd_status_get_state(status);
+    return queue_status(partition_state, buffer, false);
+}
 
-    if (buffer != NULL) {
-        buffer = jsonrpc_notify_start(buffer, JSONRPC_EVENT_UPDATE_QUEUE);
-        buffer = mympd_api_status_print(partition_state, buffer, status);
-        buffer = jsonrpc_end(buffer);
-    }
-    mpd_status_free(status);
-    return buffer;
+/**
+ * Gets the queue status and appends the changes since the last mirrored queue version.
+ * The delta is added only if the queue mirror is already populated
+ * and the number of changed songs is small enough.
+ * @param partition_state pointer to partition state
+ * @param buffer already allocated sds string to append the jsonrpc notification
+ * @return pointer to buffer
+ */
+sds mympd_api_queue_status_delta(struct t_partition_state *partition_state, sds buffer) {
+    return queue_status(partition_state, buffer, true);
 }
 
 /**
@@ -254,58 +280,47 @@ sds mympd_api_queue_crop(struct t_partition_state *partition_state, sds buffer,
  * @param offset offset for the list
  * @param limit maximum entries to print
  * @param tagcols columns to print
+ * @param stream response stream or NULL
  * @return pointer to buffer
  */
 sds mympd_api_queue_list(struct t_partition_state *partition_state, sds buffer, long request_id,
-                         long offset, long limit, const struct t_tags *tagcols)
+                         long offset, long limit, const struct t_tags *tagcols, struct t_response_stream *stream)
 {
     enum mympd_cmd_ids cmd_id = MYMPD_API_QUEUE_LIST;
-    struct mpd_status *status = mpd_run_status(partition_state->conn);
-    if (status == NULL) {
-        mympd_check_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id);
-        return buffer;
+    if (queue_mirror_sync(partition_state, NULL) == false) {
+        return jsonrpc_respond_message(buffer, cmd_id, request_id,
+            JSONRPC_FACILITY_QUEUE, JSONRPC_SEVERITY_ERROR, "Error reading the queue");
     }
+    const struct t_queue_mirror *mirror = &partition_state->queue_mirror;
 
-    partition_state->queue_version = mpd_status_get_queue_version(status);
-    partition_state->queue_length = (long long)mpd_status_get_queue_length(status);
-    mpd_status_free(status);
-
-    if (offset >= partition_state->queue_length) {
+    if (offset >= mirror->length) {
         offset = 0;
     }
 
-    long real_limit = offset + limit;
-
-    bool rc = mpd_send_list_queue_range_meta(partition_state->conn, (unsigned)offset, (unsigned)real_limit);
-    if (mympd_check_rc_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id, rc, "mpd_send_list_queue_range_meta") == false) {
-        return buffer;
-    }
+    unsigned real_limit = limit > mirror->length - offset
+        ? mirror->length
+        : (unsigned)(offset + limit);
 
     buffer = jsonrpc_respond_start(buffer, cmd_id, request_id);
     buffer = sdscat(buffer, "\"data\":[");
     unsigned total_time = 0;
-    long entity_count = 0;
     long entities_returned = 0;
-    struct mpd_song *song;
-    while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
+    for (unsigned i = (unsigned)offset; i < real_limit; i++) {
         if (entities_returned++) {
             buffer = sdscatlen(buffer, ",", 1);
         }
-        buffer = _print_queue_entry(partition_state, buffer, tagcols, song);
-        total_time += mpd_song_get_duration(song);
-        mpd_song_free(song);
-        entity_count++;
+        buffer = _print_queue_entry(partition_state, buffer, tagcols, mirror->songs[i]);
+        total_time += mpd_song_get_duration(mirror->songs[i]);
+        buffer = response_stream_flush(stream, buffer);
     }
 
     buffer = sdscatlen(buffer, "],", 2);
     buffer = tojson_uint(buffer, "totalTime", total_time, true);
-    buffer = tojson_llong(buffer, "totalEntities", partition_state->queue_length, true);
+    buffer = tojson_uint(buffer, "totalEntities", mirror->length, true);
+    buffer = tojson_uint(buffer, "queueVersion", mirror->version, true);
     buffer = tojson_long(buffer, "offset", offset, true);
     buffer = tojson_long(buffer, "returnedEntities", entities_returned, false);
     buffer = jsonrpc_end(buffer);
-
-    mpd_response_finish(partition_state->conn);
-    mympd_check_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id);
     return buffer;
 }
 
@@ -325,40 +340,33 @@ sds mympd_api_queue_search(struct t_partition_state *partition_state, sds buffer
                             const char *tag, long offset, long limit, const char *searchstr, const struct t_tags *tagcols)
 {
     enum mympd_cmd_ids cmd_id = MYMPD_API_QUEUE_SEARCH;
-    bool rc = mpd_search_queue_songs(partition_state->conn, false);
-    if (mympd_check_rc_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id, rc, "mpd_search_queue_songs") == false) {
-        mpd_search_cancel(partition_state->conn);
-        return buffer;
-    }
+    if (queue_mirror_sync(partition_state, NULL) == false) {
+        return jsonrpc_respond_message(buffer, cmd_id, request_id,
+            JSONRPC_FACILITY_QUEUE, JSONRPC_SEVERITY_ERROR, "Error reading the queue");
+    }
+    const struct t_queue_mirror *mirror = &partition_state->queue_mirror;
+    //search in the selected tag or in all tags like the mpd playlistsearch command
+    struct t_tags one_tag;
+    const struct t_tags *search_tags = &partition_state->mpd_state->tags_mympd;
     enum mpd_tag_type tag_type = mpd_tag_name_parse(tag);
     if (tag_type != MPD_TAG_UNKNOWN) {
-        rc = mpd_search_add_tag_constraint(partition_state->conn, MPD_OPERATOR_DEFAULT, tag_type, searchstr);
-        if (mympd_check_rc_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id, rc, "mpd_search_add_tag_constraint") == false) {
-            mpd_search_cancel(partition_state->conn);
-            return buffer;
-        }
-    }
-    else {
-        rc = mpd_search_add_any_tag_constraint(partition_state->conn, MPD_OPERATOR_DEFAULT, searchstr);
-        if (mympd_check_rc_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id, rc, "mpd_search_add_any_tag_constraint") == false) {
-            mpd_search_cancel(partition_state->conn);
-            return buffer;
-        }
-    }
-
-    rc = mpd_search_commit(partition_state->conn);
-    if (mympd_check_rc_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id, rc, "mpd_search_commit") == false) {
-        return buffer;
+        one_tag.len = 1;
+        one_tag.tags[0] = tag_type;
+        search_tags = &one_tag;
     }
+    sds search = sdsnew(searchstr);
 
     buffer = jsonrpc_respond_start(buffer, cmd_id, request_id);
     buffer = sdscat(buffer, "\"data\":[");
-    struct mpd_song *song;
     unsigned total_time = 0;
     long entity_count = 0;
     long entities_returned = 0;
     long real_limit = offset + limit;
-    while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
+    for (unsigned i = 0; i < mirror->length; i++) {
+        struct mpd_song *song = mirror->songs[i];
+        if (search_mpd_song(song, search, search_tags) == false) {
+            continue;
+        }
         if (entity_count >= offset && entity_count < real_limit) {
             if (entities_returned++) {
                 buffer= sdscatlen(buffer, ",", 1);
@@ -366,9 +374,9 @@ sds mympd_api_queue_search(struct t_partition_state *partition_state, sds buffer
             buffer = _print_queue_entry(partition_state, buffer, tagcols, song);
             total_time += mpd_song_get_duration(song);
         }
-        mpd_song_free(song);
         entity_count++;
     }
+    FREE_SDS(search);
 
     buffer = sdscatlen(buffer, "],", 2);
     buffer = tojson_uint(buffer, "totalTime", total_time, true);
@@ -376,12 +384,6 @@ sds mympd_api_queue_search(struct t_partition_state *partition_state, sds buffer
     buffer = tojson_long(buffer, "offset", offset, true);
     buffer = tojson_long(buffer, "returnedEntities", entities_returned, false);
     buffer = jsonrpc_end(buffer);
-
-    mpd_response_finish(partition_state->conn);
-    if (mympd_check_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id) == false) {
-        return buffer;
-    }
-
     return buffer;
 }
 
@@ -403,6 +405,12 @@ sds mympd_api_queue_search_adv(struct t_partition_state *partition_state, sds bu
         const struct t_tags *tagcols)
 {
     enum mympd_cmd_ids cmd_id = MYMPD_API_QUEUE_SEARCH_ADV;
+    //evaluate the expression on the queue mirror if possible
+    if (queue_search_adv_local(partition_state, &buffer, request_id, expression, sort, sortdesc,
+            offset, limit, tagcols) == true)
+    {
+        return buffer;
+    }
     bool rc = mpd_search_queue_songs(partition_state->conn, false);
     if (mympd_check_rc_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id, rc, "mpd_search_queue_songs") == false) {
         mpd_search_cancel(partition_state->conn);
@@ -496,6 +504,243 @@ sds mympd_api_queue_search_adv(struct t_partition_state *partition_state, sds bu
 
 //private functions
 
+/**
+ * Prints the queue status and updates internal state
+ * @param partition_state pointer to partition state
+ * @param buffer already allocated sds string to append the response or NULL
+ * @param delta true to append the queue changes
+ * @return pointer to buffer
+ */
+static sds queue_status(struct t_partition_state *partition_state, sds buffer, bool delta) {
+    struct mpd_status *status = mpd_run_status(partition_state->conn);
+    if (status == NULL) {
+        mympd_check_error_and_recover(partition_state);
+        return buffer;
+    }
+
+    partition_state->queue_version = mpd_status_get_queue_version(status);
+    partition_state->queue_length = (long long)mpd_status_get_queue_length(status);
+    partition_state->crossfade = (time_t)mpd_status_get_crossfade(status);
+    partition_state->play_state = mpd_status_get_state(status);
+
+    if (buffer != NULL) {
+        buffer = jsonrpc_notify_start(buffer, JSONRPC_EVENT_UPDATE_QUEUE);
+        buffer = mympd_api_status_print(partition_state, buffer, status);
+        if (delta == true) {
+            buffer = queue_delta_print(partition_state, buffer);
+        }
+        buffer = jsonrpc_end(buffer);
+    }
+    mpd_status_free(status);
+    return buffer;
+}
+
+/**
+ * Syncs the queue mirror and prints the changed songs as delta object
+ * @param partition_state pointer to partition state
+ * @param buffer already allocated sds string to append the delta
+ * @return pointer to buffer
+ */
+static sds queue_delta_print(struct t_partition_state *partition_state, sds buffer) {
+    const struct t_queue_mirror *mirror = &partition_state->queue_mirror;
+    if (mirror->valid == false) {
+        //the mirror is populated by the first queue listing
+        return buffer;
+    }
+    unsigned from_version = mirror->version;
+    struct t_list changes;
+    list_init(&changes);
+    if (queue_mirror_sync(partition_state, &changes) == true &&
+        mirror->version != from_version &&
+        changes.length <= QUEUE_DELTA_SONGS_MAX)
+    {
+        buffer = sdscat(buffer, ",\"delta\":{");
+        buffer = tojson_uint(buffer, "fromVersion", from_version, true);
+        buffer = tojson_uint(buffer, "toVersion", mirror->version, true);
+        buffer = tojson_uint(buffer, "length", mirror->length, true);
+        buffer = tojson_ullong(buffer, "totalTime", mirror->total_time, true);
+        buffer = sdscat(buffer, "\"songs\":[");
+        long entities_returned = 0;
+        struct t_list_node *current = changes.head;
+        while (current != NULL) {
+            if (current->value_i < mirror->length) {
+                if (entities_returned++) {
+                    buffer = sdscatlen(buffer, ",", 1);
+                }
+                buffer = _print_queue_entry(partition_state, buffer, &partition_state->mpd_state->tags_mympd,
+                    mirror->songs[current->value_i]);
+            }
+            current = current->next;
+        }
+        buffer = sdscatlen(buffer, "]}", 2);
+    }
+    list_clear(&changes);
+    return buffer;
+}
+
+/**
+ * Searches the queue mirror with a mpd filter expression
+ * @param partition_state pointer to partition state
+ * @param buffer pointer to an already allocated sds string to append the response
+ * @param request_id jsonrpc id
+ * @param expression mpd filter expression
+ * @param sort tag to sort
+ * @param sortdesc false = ascending, true = descending sort
+ * @param offset offset for the list
+ * @param limit maximum entries to print
+ * @param tagcols columns to print
+ * @return true if the response was created, false if the search must be run by mpd
+ */
+static bool queue_search_adv_local(struct t_partition_state *partition_state, sds *buffer, long request_id,
+        sds expression, sds sort, bool sortdesc, unsigned offset, unsigned limit,
+        const struct t_tags *tagcols)
+{
+    struct t_list *expr_list = NULL;
+    if (sdslen(expression) > 0) {
+        expr_list = parse_search_expression_to_list(expression);
+        if (search_expression_is_local(expr_list, expression) == false) {
+            MYMPD_LOG_DEBUG("Expression \"%s\" is not supported by the local search", expression);
+            free_search_expression_list(expr_list);
+            return false;
+        }
+    }
+    enum queue_sort_types sort_type = QUEUE_SORT_NONE;
+    enum mpd_tag_type sort_tag = mpd_tag_name_parse(sort);
+    if (sort_tag != MPD_TAG_UNKNOWN) {
+        sort_tag = get_sort_tag(sort_tag, &partition_state->mpd_state->tags_mpd);
+        sort_type = QUEUE_SORT_TAG;
+    }
+    else if (strcmp(sort, "LastModified") == 0) {
+        sort_type = QUEUE_SORT_LAST_MODIFIED;
+    }
+    else if (strcmp(sort, "Priority") == 0) {
+        sort_type = QUEUE_SORT_PRIORITY;
+    }
+    else if (sdslen(sort) > 0) {
+        MYMPD_LOG_WARN("Unknown sort tag: %s", sort);
+    }
+    if (queue_mirror_sync(partition_state, NULL) == false) {
+        if (expr_list != NULL) {
+            free_search_expression_list(expr_list);
+        }
+        return false;
+    }
+    const struct t_queue_mirror *mirror = &partition_state->queue_mirror;
+
+    //collect the matching songs
+    struct t_queue_sort_entry *entries = malloc_assert((mirror->length + 1) * sizeof(struct t_queue_sort_entry));
+    unsigned entity_count = 0;
+    for (unsigned i = 0; i < mirror->length; i++) {
+        struct mpd_song *song = mirror->songs[i];
+        if (expr_list != NULL &&
+            search_song_expression(song, expr_list, &partition_state->mpd_state->tags_mympd) == false)
+        {
+            continue;
+        }
+        struct t_queue_sort_entry *entry = &entries[entity_count++];
+        entry->song = song;
+        entry->key = NULL;
+        entry->num = 0;
+        entry->desc = sortdesc;
+        switch(sort_type) {
+            case QUEUE_SORT_TAG:
+                entry->key = mpd_song_get_tag(song, sort_tag, 0);
+                if (entry->key == NULL) {
+                    entry->key = "";
+                }
+                break;
+            case QUEUE_SORT_LAST_MODIFIED:
+                entry->num = (long long)mpd_song_get_last_modified(song);
+                break;
+            case QUEUE_SORT_PRIORITY:
+                entry->num = (long long)mpd_song_get_prio(song);
+                break;
+            case QUEUE_SORT_NONE:
+                break;
+        }
+    }
+    if (expr_list != NULL) {
+        free_search_expression_list(expr_list);
+    }
+    //sort the result, equal keys are ordered by queue position
+    if (sort_type == QUEUE_SORT_TAG) {
+        qsort(entries, entity_count, sizeof(struct t_queue_sort_entry), queue_sort_entry_cmp_key);
+    }
+    else if (sort_type != QUEUE_SORT_NONE) {
+        qsort(entries, entity_count, sizeof(struct t_queue_sort_entry), queue_sort_entry_cmp_num);
+    }
+
+    //print the window
+    unsigned real_limit = entity_count;
+    if (offset >= entity_count) {
+        real_limit = offset;
+    }
+    else if (limit > 0 &&
+             limit < entity_count - offset)
+    {
+        real_limit = offset + limit;
+    }
+    *buffer = jsonrpc_respond_start(*buffer, MYMPD_API_QUEUE_SEARCH_ADV, request_id);
+    *buffer = sdscat(*buffer, "\"data\":[");
+    unsigned total_time = 0;
+    long entities_returned = 0;
+    for (unsigned i = offset; i < real_limit; i++) {
+        if (entities_returned++) {
+            *buffer = sdscatlen(*buffer, ",", 1);
+        }
+        *buffer = _print_queue_entry(partition_state, *buffer, tagcols, entries[i].song);
+        total_time += mpd_song_get_duration(entries[i].song);
+    }
+    FREE_PTR(entries);
+
+    *buffer = sdscatlen(*buffer, "],", 2);
+    *buffer = tojson_uint(*buffer, "totalTime", total_time, true);
+    *buffer = tojson_uint(*buffer, "totalEntities", entity_count, true);
+    *buffer = tojson_uint(*buffer, "queueVersion", mirror->version, true);
+    *buffer = tojson_uint(*buffer, "offset", offset, true);
+    *buffer = tojson_long(*buffer, "returnedEntities", entities_returned, false);
+    *buffer = jsonrpc_end(*buffer);
+    return true;
+}
+
+/**
+ * Compares the string keys of two queue sort entries for qsort
+ * @param a pointer to first entry
+ * @param b pointer to second entry
+ * @return less than, equal to, or greater than zero
+ */
+static int queue_sort_entry_cmp_key(const void *a, const void *b) {
+    const struct t_queue_sort_entry *entry_a = (const struct t_queue_sort_entry *)a;
+    const struct t_queue_sort_entry *entry_b = (const struct t_queue_sort_entry *)b;
+    int rc = utf8casecmp(entry_a->key, entry_b->key);
+    if (rc != 0) {
+        return entry_a->desc == true ? -rc : rc;
+    }
+    if (entry_a->song == entry_b->song) {
+        return 0;
+    }
+    return mpd_song_get_pos(entry_a->song) < mpd_song_get_pos(entry_b->song) ? -1 : 1;
+}
+
+/**
+ * Compares the numeric keys of two queue sort entries for qsort
+ * @param a pointer to first entry
+ * @param b pointer to second entry
+ * @return -1, 0 or 1
+ */
+static int queue_sort_entry_cmp_num(const void *a, const void *b) {
+    const struct t_queue_sort_entry *entry_a = (const struct t_queue_sort_entry *)a;
+    const struct t_queue_sort_entry *entry_b = (const struct t_queue_sort_entry *)b;
+    if (entry_a->num != entry_b->num) {
+        int rc = entry_a->num < entry_b->num ? -1 : 1;
+        return entry_a->desc == true ? -rc : rc;
+    }
+    if (entry_a->song == entry_b->song) {
+        return 0;
+    }
+    return mpd_song_get_pos(entry_a->song) < mpd_song_get_pos(entry_b->song) ? -1 : 1;
+}
+
 /**
  * Prints a queue entry as an json object string
  * @param partition_state pointer to partition state
@@ -9,11 +9,13 @@
 
 #include "../lib/api.h"
 #include "../lib/mympd_state.h"
+#include "../lib/response_stream.h"
 
 bool mympd_api_queue_play_newly_inserted(struct t_partition_state *partition_state);
 sds mympd_api_queue_status(struct t_partition_state *partition_state, sds buffer);
+sds mympd_api_queue_status_delta(struct t_partition_state *partition_state, sds buffer);
 sds mympd_api_queue_list(struct t_partition_state *partition_state, sds buffer, long request_id,
-        long offset, long limit, const struct t_tags *tagcols);
+        long offset, long limit, const struct t_tags *tagcols, struct t_response_stream *stream);
 sds mympd_api_queue_crop(struct t_partition_state *partition_state, sds buffer, enum mympd_cmd_ids cmd_id,
         long request_id, bool or_clear);
 sds mympd_api_queue_search(struct t_partition_state *partition_state, sds buffer, long request_id,
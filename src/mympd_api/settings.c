@@ -9,6 +9,7 @@
 
 #include "../../dist/mjson/mjson.h"
 #include "../lib/api.h"
+#include "../lib/filehandler.h"
 #include "../lib/jsonrpc.h"
 #include "../lib/log.h"
 #include "../lib/sds_extras.h"
@@ -35,6 +36,7 @@
 
 static sds print_tags_array(sds buffer, const char *tagsname, struct t_tags tags);
 static sds set_invalid_value(sds buffer, sds key, sds value);
+static sds get_partition_state_dir(sds workdir, sds partition, bool create);
 
 /**
  * Saves connection specific settings
@@ -572,9 +574,14 @@ bool mympd_api_settings_mpd_options_set(sds key, sds value, int vtype, validate_
         jukebox_clear(&mympd_state->partition_state->jukebox_queue);
     }
     if (write_state_file == true) {
-        sds state_filename = camel_to_snake(key);
-        rc = state_file_write(mympd_state->config->workdir, "state", state_filename, value);
-        FREE_SDS(state_filename);
+        //autoPlay and the jukebox settings are saved for the partition
+        sds dir = get_partition_state_dir(mympd_state->config->workdir, mympd_state->partition_state->name, false);
+        if (dir != NULL) {
+            sds state_filename = camel_to_snake(key);
+            rc = state_file_write(mympd_state->config->workdir, dir, state_filename, value);
+            FREE_SDS(state_filename);
+            FREE_SDS(dir);
+        }
     }
     return rc;
 }
@@ -601,12 +608,7 @@ void mympd_api_settings_statefiles_read(struct t_mympd_state *mympd_state) {
     mympd_state->smartpls_interval = state_file_rw_int(mympd_state->config->workdir, "state", "smartpls_interval", (int)mympd_state->smartpls_interval, TIMER_INTERVAL_MIN, TIMER_INTERVAL_MAX, false);
     mympd_state->smartpls_generate_tag_list = state_file_rw_string_sds(mympd_state->config->workdir, "state", "smartpls_generate_tag_list", mympd_state->smartpls_generate_tag_list, vcb_istaglist, false);
     mympd_state->mpd_state->last_played_count = state_file_rw_long(mympd_state->config->workdir, "state", "last_played_count", mympd_state->mpd_state->last_played_count, 0, MPD_PLAYLIST_LENGTH_MAX, false);
-    mympd_state->partition_state->auto_play = state_file_rw_bool(mympd_state->config->workdir, "state", "auto_play", mympd_state->partition_state->auto_play, false);
-    mympd_state->partition_state->jukebox_mode = state_file_rw_uint(mympd_state->config->workdir, "state", "jukebox_mode", mympd_state->partition_state->jukebox_mode, 0, 2, false);
-    mympd_state->partition_state->jukebox_playlist = state_file_rw_string_sds(mympd_state->config->workdir, "state", "jukebox_playlist", mympd_state->partition_state->jukebox_playlist, vcb_isfilename, false);
-    mympd_state->partition_state->jukebox_queue_length = state_file_rw_long(mympd_state->config->workdir, "state", "jukebox_queue_length", mympd_state->partition_state->jukebox_queue_length, 0, JUKEBOX_QUEUE_MAX, false);
-    mympd_state->partition_state->jukebox_last_played = state_file_rw_long(mympd_state->config->workdir, "state", "jukebox_last_played", mympd_state->partition_state->jukebox_last_played, 0, JUKEBOX_LAST_PLAYED_MAX, false);
-    mympd_state->partition_state->jukebox_unique_tag.tags[0] = state_file_rw_int(mympd_state->config->workdir, "state", "jukebox_unique_tag", mympd_state->partition_state->jukebox_unique_tag.tags[0], 0, 64, false);
+    mympd_api_settings_partition_read(mympd_state->config->workdir, mympd_state->partition_state);
     mympd_state->cols_queue_current = state_file_rw_string_sds(mympd_state->config->workdir, "state", "cols_queue_current", mympd_state->cols_queue_current, vcb_isname, false);
     mympd_state->cols_search = state_file_rw_string_sds(mympd_state->config->workdir, "state", "cols_search", mympd_state->cols_search, vcb_isname, false);
     mympd_state->cols_browse_database_detail = state_file_rw_string_sds(mympd_state->config->workdir, "state", "cols_browse_database_detail", mympd_state->cols_browse_database_detail, vcb_isname, false);
@@ -638,6 +640,34 @@ void mympd_api_settings_statefiles_read(struct t_mympd_state *mympd_state) {
     strip_slash(mympd_state->playlist_directory);
 }
 
+/**
+ * Reads the partition specific settings from the state files.
+ * The settings of the default partition are saved in the state directory,
+ * the settings of other partitions in the directory state/partitions/<name>.
+ * Missing settings are reset to the defaults.
+ * @param workdir working directory
+ * @param partition_state pointer to the partition state
+ */
+void mympd_api_settings_partition_read(sds workdir, struct t_partition_state *partition_state) {
+    partition_state->auto_play = MYMPD_AUTO_PLAY;
+    partition_state->jukebox_mode = JUKEBOX_OFF;
+    partition_state->jukebox_playlist = sds_replace(partition_state->jukebox_playlist, MYMPD_JUKEBOX_PLAYLIST);
+    partition_state->jukebox_queue_length = MYMPD_JUKEBOX_QUEUE_LENGTH;
+    partition_state->jukebox_last_played = MYMPD_JUKEBOX_LAST_PLAYED;
+    partition_state->jukebox_unique_tag.tags[0] = MYMPD_JUKEBOX_UNIQUE_TAG;
+    sds dir = get_partition_state_dir(workdir, partition_state->name, true);
+    if (dir == NULL) {
+        return;
+    }
+    partition_state->auto_play = state_file_rw_bool(workdir, dir, "auto_play", partition_state->auto_play, false);
+    partition_state->jukebox_mode = state_file_rw_uint(workdir, dir, "jukebox_mode", partition_state->jukebox_mode, 0, 2, false);
+    partition_state->jukebox_playlist = state_file_rw_string_sds(workdir, dir, "jukebox_playlist", partition_state->jukebox_playlist, vcb_isfilename, false);
+    partition_state->jukebox_queue_length = state_file_rw_long(workdir, dir, "jukebox_queue_length", partition_state->jukebox_queue_length, 0, JUKEBOX_QUEUE_MAX, false);
+    partition_state->jukebox_last_played = state_file_rw_long(workdir, dir, "jukebox_last_played", partition_state->jukebox_last_played, 0, JUKEBOX_LAST_PLAYED_MAX, false);
+    partition_state->jukebox_unique_tag.tags[0] = state_file_rw_int(workdir, dir, "jukebox_unique_tag", partition_state->jukebox_unique_tag.tags[0], 0, 64, false);
+    FREE_SDS(dir);
+}
+
 /**
  * Prints all settings
  * @param mympd_state pointer to the t_mympd_state struct
@@ -817,3 +847,36 @@ static sds set_invalid_value(sds buffer, sds key, sds value) {
     MYMPD_LOG_WARN("%s", buffer);
     return buffer;
 }
+
+/**
+ * Returns the state directory for the partition specific settings
+ * @param workdir working directory
+ * @param partition partition name
+ * @param create true to create the directory
+ * @return newly allocated sds string with the directory relative to workdir,
+ *         NULL if the partition name is not usable as directory name
+ */
+static sds get_partition_state_dir(sds workdir, sds partition, bool create) {
+    if (strcmp(partition, "default") == 0) {
+        return sdsnew("state");
+    }
+    if (vcb_isfilename(partition) == false) {
+        MYMPD_LOG_WARN("Settings for partition \"%s\" are not saved", partition);
+        return NULL;
+    }
+    sds dir = sdscatfmt(sdsempty(), "state/partitions/%S", partition);
+    if (create == true) {
+        sds dirpath = sdscatfmt(sdsempty(), "%S/state/partitions", workdir);
+        int rc = testdir("Partitions state dir", dirpath, true);
+        if (rc != DIR_CREATE_FAILED) {
+            dirpath = sdscatfmt(dirpath, "/%S", partition);
+            rc = testdir("Partition state dir", dirpath, true);
+        }
+        FREE_SDS(dirpath);
+        if (rc == DIR_CREATE_FAILED) {
+            FREE_SDS(dir);
+            return NULL;
+        }
+    }
+    return dir;
+}
@@ -12,6 +12,7 @@
 #include "../lib/validate.h"
 
 void mympd_api_settings_statefiles_read(struct t_mympd_state *mympd_state);
+void mympd_api_settings_partition_read(sds workdir, struct t_partition_state *partition_state);
 sds mympd_api_settings_get(struct t_mympd_state *mympd_state, sds buffer, long request_id);
 bool mympd_api_settings_cols_save(struct t_mympd_state *mympd_state, sds table, sds cols);
 bool mympd_api_settings_set(sds key, sds value, int vtype, validate_callback vcb, void *userdata, sds *error);
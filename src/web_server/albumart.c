@@ -8,7 +8,9 @@
 #include "albumart.h"
 
 #include "../lib/api.h"
+#include "../lib/coverextract.h"
 #include "../lib/covercache.h"
+#include "../lib/filehandler.h"
 #include "../lib/jsonrpc.h"
 #include "../lib/log.h"
 #include "../lib/m3u.h"
@@ -16,53 +18,89 @@
 #include "../lib/sds_extras.h"
 #include "../lib/utility.h"
 #include "../lib/validate.h"
+#include "albumart_cache.h"
+#include "thumbnail_worker.h"
 
-#include <assert.h>
 #include <libgen.h>
 
-//optional includes
-#ifdef ENABLE_LIBID3TAG
-    #include <id3tag.h>
-#endif
-
-#ifdef ENABLE_FLAC
-    #include <FLAC/metadata.h>
-#endif
-
 /**
  * Privat definitions
  */
-static bool handle_coverextract(struct mg_connection *nc, sds cachedir, const char *uri, const char *media_file, bool covercache, int offset);
-static bool handle_coverextract_id3(sds cachedir, const char *uri, const char *media_file, sds *binary, bool covercache, int offset);
-static bool handle_coverextract_flac(sds cachedir, const char *uri, const char *media_file, sds *binary, bool is_ogg, bool covercache, int offset);
+static bool handle_coverextract(struct mg_connection *nc, struct mg_http_message *hm, struct t_mg_user_data *mg_user_data,
+        sds cache_key, const char *uri, const char *media_file, bool covercache, int offset, bool create_thumbnail);
+static void serve_albumart_file(struct mg_connection *nc, struct mg_http_message *hm, struct t_mg_user_data *mg_user_data,
+        sds cache_key, sds filepath, const char *uri, int offset, bool create_thumbnail);
+static void serve_albumart_binary(struct mg_connection *nc, struct mg_http_message *hm, struct t_mg_user_data *mg_user_data,
+        sds cache_key, const char *mime_type, sds binary);
+static void serve_albumart_thumbnail(struct mg_connection *nc, struct mg_http_message *hm, struct t_mg_user_data *mg_user_data,
+        sds cache_key, const char *uri, int offset, const char *mime_type, sds binary, sds filepath);
+static bool thumbnails_enabled(struct t_mg_user_data *mg_user_data);
 
 /**
  * Public functions
  */
 
 /**
- * Sends the albumart response from mpd to the client
+ * Sends the albumart response from mpd to the client and adds it to the albumart cache
  * @param nc mongoose connection
  * @param data jsonrpc response
  * @param binary the image
  */
 void webserver_send_albumart(struct mg_connection *nc, sds data, sds binary) {
+    struct t_mg_user_data *mg_user_data = (struct t_mg_user_data *) nc->mgr->userdata;
     size_t len = sdslen(binary);
     sds mime_type = NULL;
+    sds uri = NULL;
     if (len > 0 &&
         json_get_string(data, "$.result.mime_type", 1, 200, &mime_type, vcb_isname, NULL) == true &&
         strncmp(mime_type, "image/", 6) == 0)
     {
-        MYMPD_LOG_DEBUG("Serving albumart from memory (%s - %lu bytes) (%lu)", mime_type, (unsigned long)len, nc->id);
-        sds headers = sdscatfmt(sdsempty(), "Content-Type: %S\r\n", mime_type);
-        headers = sdscat(headers, EXTRA_HEADERS_CACHE);
-        webserver_send_data(nc, binary, len, headers);
-        FREE_SDS(headers);
+        if (json_get_string(data, "$.result.uri", 1, FILEPATH_LEN_MAX, &uri, vcb_isfilepath, NULL) == true) {
+            //label[3] is set by request_handler_albumart
+            bool thumbnail = nc->label[3] == 'T' ? true : false;
+            sds cache_key = albumart_cache_key(sdsempty(), uri, 0, thumbnail);
+            if (thumbnail == true &&
+                thumbnails_enabled(mg_user_data) == true)
+            {
+                serve_albumart_thumbnail(nc, NULL, mg_user_data, cache_key, uri, 0, mime_type, binary, NULL);
+            }
+            else {
+                serve_albumart_binary(nc, NULL, mg_user_data, cache_key, mime_type, binary);
+            }
+            FREE_SDS(cache_key);
+        }
+        else {
+            serve_albumart_binary(nc, NULL, mg_user_data, NULL, mime_type, binary);
+        }
     }
     else {
+        if (json_get_string(data, "$.error.data.uri", 1, FILEPATH_LEN_MAX, &uri, vcb_isfilepath, NULL) == true) {
+            //remember that mpd has no albumart for this uri
+            sds cache_key = albumart_cache_key(sdsempty(), uri, 0, (nc->label[3] == 'T' ? true : false));
+            albumart_cache_negative_add(&mg_user_data->albumart_cache, cache_key);
+            FREE_SDS(cache_key);
+        }
         webserver_serve_na_image(nc);
     }
     FREE_SDS(mime_type);
+    FREE_SDS(uri);
+}
+
+/**
+ * Adds the result of the thumbnail worker to the albumart cache
+ * @param mg_user_data pointer to mongoose configuration
+ * @param cache_key key for the albumart cache
+ * @param thumbnail the thumbnail or an empty string if no thumbnail was created
+ */
+void webserver_albumart_thumbnail_done(struct t_mg_user_data *mg_user_data, sds cache_key, sds thumbnail) {
+    thumbnail_worker_done(cache_key);
+    if (sdslen(thumbnail) == 0) {
+        //serve the original image from now on
+        albumart_cache_no_thumbnail_add(&mg_user_data->albumart_cache, cache_key);
+        return;
+    }
+    MYMPD_LOG_DEBUG("Thumbnail for \"%s\" created", cache_key);
+    albumart_cache_put(&mg_user_data->albumart_cache, cache_key, "image/jpeg", thumbnail, sdslen(thumbnail));
 }
 
 /**
@@ -127,7 +165,7 @@ bool request_handler_albumart(struct mg_connection *nc, struct mg_http_message *
 
         sds coverfile = sdscatfmt(sdsempty(), "%S/pics/thumbs/%S", config->workdir, uri_decoded);
         MYMPD_LOG_DEBUG("Check for stream cover \"%s\"", coverfile);
-        coverfile = webserver_find_image_file(coverfile);
+        coverfile = find_image_file(coverfile);
 
         if (sdslen(coverfile) == 0) {
             //no coverfile found, next try to find a webradio m3u
@@ -171,23 +209,47 @@ bool request_handler_albumart(struct mg_connection *nc, struct mg_http_message *
         return true;
     }
 
+    //check in-memory albumart cache
+    sds cache_key = albumart_cache_key(sdsempty(), uri_decoded, offset, (size == ALBUMART_THUMBNAIL ? true : false));
+    struct t_albumart_cache_entry *entry = albumart_cache_get(&mg_user_data->albumart_cache, cache_key);
+    if (entry != NULL) {
+        albumart_cache_send(nc, hm, &mg_user_data->albumart_cache, entry);
+        FREE_SDS(uri_decoded);
+        FREE_SDS(cache_key);
+        return true;
+    }
+    //check negative cache
+    if (albumart_cache_negative_get(&mg_user_data->albumart_cache, cache_key) == true) {
+        MYMPD_LOG_DEBUG("No coverimage for \"%s\" (negative cache)", uri_decoded);
+        webserver_serve_na_image(nc);
+        FREE_SDS(uri_decoded);
+        FREE_SDS(cache_key);
+        return true;
+    }
+
+    bool create_thumbnail = size == ALBUMART_THUMBNAIL &&
+        thumbnails_enabled(mg_user_data) == true ? true : false;
+
     //check covercache
     if (mg_user_data->config->covercache_keep_days > 0) {
-        sds filename = sds_hash(uri_decoded);
-        sds covercachefile = sdscatfmt(sdsempty(), "%S/covercache/%S-%i", config->cachedir, filename, offset);
-        FREE_SDS(filename);
-        covercachefile = webserver_find_image_file(covercachefile);
+        sds covercachefile = sdsempty();
+        if (create_thumbnail == true) {
+            //generated thumbnail
+            covercachefile = covercache_get_file(config->cachedir, uri_decoded, offset, config->thumbnail_size, covercachefile);
+            if (sdslen(covercachefile) > 0) {
+                serve_albumart_file(nc, hm, mg_user_data, cache_key, covercachefile, uri_decoded, offset, false);
+                FREE_SDS(uri_decoded);
+                FREE_SDS(covercachefile);
+                FREE_SDS(cache_key);
+                return true;
+            }
+        }
+        covercachefile = covercache_get_file(config->cachedir, uri_decoded, offset, 0, covercachefile);
         if (sdslen(covercachefile) > 0) {
-            const char *mime_type = get_mime_type_by_ext(covercachefile);
-            MYMPD_LOG_DEBUG("Serving file %s (%s)", covercachefile, mime_type);
-            static struct mg_http_serve_opts s_http_server_opts;
-            s_http_server_opts.root_dir = mg_user_data->browse_directory;
-            s_http_server_opts.extra_headers = EXTRA_HEADERS_CACHE;
-            s_http_server_opts.mime_types = EXTRA_MIME_TYPES;
-            mg_http_serve_file(nc, hm, covercachefile, &s_http_server_opts);
-            webserver_handle_connection_close(nc);
+            serve_albumart_file(nc, hm, mg_user_data, cache_key, covercachefile, uri_decoded, offset, create_thumbnail);
             FREE_SDS(uri_decoded);
             FREE_SDS(covercachefile);
+            FREE_SDS(cache_key);
             return true;
         }
         MYMPD_LOG_DEBUG("No covercache file found");
@@ -218,23 +280,28 @@ bool request_handler_albumart(struct mg_connection *nc, struct mg_http_message *
                     coverfile = sdscatfmt(coverfile, "%S/%S/%S", mg_user_data->music_directory, path, mg_user_data->thumbnail_names[j]);
                     if (strchr(mg_user_data->thumbnail_names[j], '.') == NULL) {
                         //basename, try extensions
-                        coverfile = webserver_find_image_file(coverfile);
+                        coverfile = webserver_find_image_file_cached(&mg_user_data->dir_cache, coverfile);
                     }
-                    if (sdslen(coverfile) > 0 && access(coverfile, F_OK ) == 0) { /* Flawfinder: ignore */
+                    if (sdslen(coverfile) > 0 &&
+                        dir_cache_file_exists(&mg_user_data->dir_cache, coverfile) == true)
+                    {
                         found = true;
                         break;
                     }
                     sdsclear(coverfile);
                 }
             }
+            bool is_thumbnail = found;
             if (found == false) {
                 for (int j = 0; j < mg_user_data->coverimage_names_len; j++) {
                     coverfile = sdscatfmt(coverfile, "%S/%S/%S", mg_user_data->music_directory, path, mg_user_data->coverimage_names[j]);
                     if (strchr(mg_user_data->coverimage_names[j], '.') == NULL) {
                         //basename, try extensions
-                        coverfile = webserver_find_image_file(coverfile);
+                        coverfile = webserver_find_image_file_cached(&mg_user_data->dir_cache, coverfile);
                     }
-                    if (sdslen(coverfile) > 0 && access(coverfile, F_OK ) == 0) { /* Flawfinder: ignore */
+                    if (sdslen(coverfile) > 0 &&
+                        dir_cache_file_exists(&mg_user_data->dir_cache, coverfile) == true)
+                    {
                         found = true;
                         break;
                     }
@@ -242,18 +309,13 @@ bool request_handler_albumart(struct mg_connection *nc, struct mg_http_message *
                 }
             }
             if (found == true) {
-                const char *mime_type = get_mime_type_by_ext(coverfile);
-                MYMPD_LOG_DEBUG("Serving file %s (%s)", coverfile, mime_type);
-                static struct mg_http_serve_opts s_http_server_opts;
-                s_http_server_opts.root_dir = mg_user_data->browse_directory;
-                s_http_server_opts.extra_headers = EXTRA_HEADERS_CACHE;
-                s_http_server_opts.mime_types = EXTRA_MIME_TYPES;
-                mg_http_serve_file(nc, hm, coverfile, &s_http_server_opts);
-                webserver_handle_connection_close(nc);
+                serve_albumart_file(nc, hm, mg_user_data, cache_key, coverfile, uri_decoded, offset,
+                    (create_thumbnail == true && is_thumbnail == false ? true : false));
                 FREE_SDS(uri_decoded);
                 FREE_SDS(coverfile);
                 FREE_SDS(mediafile);
                 FREE_SDS(path);
+                FREE_SDS(cache_key);
                 return true;
             }
 
@@ -262,13 +324,14 @@ bool request_handler_albumart(struct mg_connection *nc, struct mg_http_message *
             FREE_SDS(path);
         }
 
-        if (access(mediafile, F_OK) == 0) { /* Flawfinder: ignore */
+        if (dir_cache_file_exists(&mg_user_data->dir_cache, mediafile) == true) {
             //try to extract albumart from media file
             bool covercache = mg_user_data->config->covercache_keep_days > 0 ? true : false;
-            bool rc = handle_coverextract(nc, config->cachedir, uri_decoded, mediafile, covercache, offset);
+            bool rc = handle_coverextract(nc, hm, mg_user_data, cache_key, uri_decoded, mediafile, covercache, offset, create_thumbnail);
             if (rc == true) {
                 FREE_SDS(uri_decoded);
                 FREE_SDS(mediafile);
+                FREE_SDS(cache_key);
                 return true;
             }
         }
@@ -284,12 +347,17 @@ bool request_handler_albumart(struct mg_connection *nc, struct mg_http_message *
         request->data = tojson_sds(request->data, "uri", uri_decoded, false);
         request->data = jsonrpc_end(request->data);
         mympd_queue_push(mympd_api_queue, request, 0);
+        //remember the albumart size for the albumart cache
+        nc->label[3] = size == ALBUMART_THUMBNAIL ? 'T' : 'F';
         FREE_SDS(uri_decoded);
+        FREE_SDS(cache_key);
         return false;
     }
 
     MYMPD_LOG_INFO("No coverimage found for \"%s\"", uri_decoded);
+    albumart_cache_negative_add(&mg_user_data->albumart_cache, cache_key);
     FREE_SDS(uri_decoded);
+    FREE_SDS(cache_key);
     webserver_serve_na_image(nc);
     return true;
 }
@@ -299,187 +367,162 @@ bool request_handler_albumart(struct mg_connection *nc, struct mg_http_message *
  */
 
 /**
- * Extracts albumart from media files
+ * Serves an image file and adds it to the albumart cache
  * @param nc mongoose connection
- * @param cachedir covercache directory
+ * @param hm http message
+ * @param mg_user_data pointer to mongoose configuration
+ * @param cache_key key for the albumart cache
+ * @param filepath image file to serve
  * @param uri song uri
- * @param media_file full path to the song
- * @param covercache true = covercache is enabled
- * @param offset number of embedded image to extract
- * @return true on success, else false
+ * @param offset number of the coverimage
+ * @param create_thumbnail true = serve a thumbnail of the image
  */
-static bool handle_coverextract(struct mg_connection *nc, sds cachedir,
-        const char *uri, const char *media_file, bool covercache, int offset)
+static void serve_albumart_file(struct mg_connection *nc, struct mg_http_message *hm, struct t_mg_user_data *mg_user_data,
+        sds cache_key, sds filepath, const char *uri, int offset, bool create_thumbnail)
 {
-    bool rc = false;
-    const char *mime_type_media_file = get_mime_type_by_ext(media_file);
-    MYMPD_LOG_DEBUG("Handle coverextract for uri \"%s\"", uri);
-    MYMPD_LOG_DEBUG("Mimetype of %s is %s", media_file, mime_type_media_file);
-    sds binary = sdsempty();
-    if (strcmp(mime_type_media_file, "audio/mpeg") == 0) {
-        rc = handle_coverextract_id3(cachedir, uri, media_file, &binary, covercache, offset);
+    const char *mime_type = get_mime_type_by_ext(filepath);
+    if (create_thumbnail == true) {
+        serve_albumart_thumbnail(nc, hm, mg_user_data, cache_key, uri, offset, mime_type, NULL, filepath);
+        return;
     }
-    else if (strcmp(mime_type_media_file, "audio/ogg") == 0) {
-        rc = handle_coverextract_flac(cachedir, uri, media_file, &binary, true, covercache, offset);
+    struct t_albumart_cache_entry *entry = albumart_cache_put_file(&mg_user_data->albumart_cache, cache_key, filepath, mime_type);
+    if (entry != NULL) {
+        albumart_cache_send(nc, hm, &mg_user_data->albumart_cache, entry);
+        return;
     }
-    else if (strcmp(mime_type_media_file, "audio/flac") == 0) {
-        rc = handle_coverextract_flac(cachedir, uri, media_file, &binary, false, covercache, offset);
-    }
-    if (rc == true) {
-        const char *mime_type = get_mime_type_by_magic_stream(binary);
-        MYMPD_LOG_DEBUG("Serving coverimage for \"%s\" (%s)", media_file, mime_type);
-        sds headers = sdscatfmt(sdsempty(), "Content-Type: %s\r\n", mime_type);
-        headers = sdscat(headers, EXTRA_HEADERS_CACHE);
-        webserver_send_data(nc, binary,  sdslen(binary), headers);
-        FREE_SDS(headers);
+    MYMPD_LOG_DEBUG("Serving file %s (%s)", filepath, mime_type);
+    static struct mg_http_serve_opts s_http_server_opts;
+    s_http_server_opts.root_dir = mg_user_data->browse_directory;
+    s_http_server_opts.extra_headers = EXTRA_HEADERS_CACHE;
+    s_http_server_opts.mime_types = EXTRA_MIME_TYPES;
+    mg_http_serve_file(nc, hm, filepath, &s_http_server_opts);
+    webserver_handle_connection_close(nc);
+}
+
+/**
+ * Serves an image from memory and adds it to the albumart cache
+ * @param nc mongoose connection
+ * @param hm http message or NULL
+ * @param mg_user_data pointer to mongoose configuration
+ * @param cache_key key for the albumart cache or NULL to skip the cache
+ * @param mime_type mime type of the image
+ * @param binary the image
+ */
+static void serve_albumart_binary(struct mg_connection *nc, struct mg_http_message *hm, struct t_mg_user_data *mg_user_data,
+        sds cache_key, const char *mime_type, sds binary)
+{
+    size_t len = sdslen(binary);
+    if (cache_key != NULL) {
+        struct t_albumart_cache_entry *entry = albumart_cache_put(&mg_user_data->albumart_cache, cache_key,
+            mime_type, binary, len);
+        if (entry != NULL) {
+            albumart_cache_send(nc, hm, &mg_user_data->albumart_cache, entry);
+            return;
+        }
     }
-    FREE_SDS(binary);
-    return rc;
+    //validators are sent also if the image is not cached
+    albumart_cache_send_uncached(nc, hm, &mg_user_data->albumart_cache, mime_type, binary, len);
 }
 
 /**
- * Extracts albumart from id3v2 taged files
- * @param cachedir covercache directory
+ * Serves the thumbnail of an image. The thumbnail is created by the thumbnail worker,
+ * the original image is served until the thumbnail is in the albumart cache or covercache.
+ * @param nc mongoose connection
+ * @param hm http message or NULL
+ * @param mg_user_data pointer to mongoose configuration
+ * @param cache_key key for the albumart cache
  * @param uri song uri
- * @param media_file full path to the song
- * @param binary pointer to already allocates sds string to hold the image
- * @param covercache true = covercache is enabled
- * @param offset number of embedded image to extract
- * @return true on success, else false
+ * @param offset number of the coverimage
+ * @param mime_type mime type of the original image
+ * @param binary the original image or NULL
+ * @param filepath the original image file, used if binary is NULL
  */
-static bool handle_coverextract_id3(sds cachedir, const char *uri, const char *media_file,
-        sds *binary, bool covercache, int offset)
+static void serve_albumart_thumbnail(struct mg_connection *nc, struct mg_http_message *hm, struct t_mg_user_data *mg_user_data,
+        sds cache_key, const char *uri, int offset, const char *mime_type, sds binary, sds filepath)
 {
-    bool rc = false;
-    #ifdef ENABLE_LIBID3TAG
-    MYMPD_LOG_DEBUG("Exctracting coverimage from %s", media_file);
-    struct id3_file *file_struct = id3_file_open(media_file, ID3_FILE_MODE_READONLY);
-    if (file_struct == NULL) {
-        MYMPD_LOG_ERROR("Can't parse id3_file: %s", media_file);
-        return false;
-    }
-    struct id3_tag *tags = id3_file_tag(file_struct);
-    if (tags == NULL) {
-        MYMPD_LOG_ERROR("Can't read id3 tags from file: %s", media_file);
-        return false;
-    }
-    struct id3_frame *frame = id3_tag_findframe(tags, "APIC", (unsigned)offset);
-    if (frame != NULL) {
-        id3_length_t length = 0;
-        const id3_byte_t *pic = id3_field_getbinarydata(id3_frame_field(frame, 4), &length);
-        if (length > 0) {
-            *binary = sdscatlen(*binary, pic, length);
-            const char *mime_type = get_mime_type_by_magic_stream(*binary);
-            if (mime_type != NULL) {
-                if (covercache == true) {
-                    covercache_write_file(cachedir, uri, mime_type, *binary, offset);
-                }
-                else {
-                    MYMPD_LOG_DEBUG("Covercache is disabled");
-                }
-                MYMPD_LOG_DEBUG("Coverimage successfully extracted (%lu bytes)", (unsigned long)sdslen(*binary));
-                rc = true;
-            }
-            else {
-                MYMPD_LOG_WARN("Could not determine mimetype, discarding image");
-                sdsclear(*binary);
-            }
+    struct t_config *config = mg_user_data->config;
+    if (albumart_cache_no_thumbnail_get(&mg_user_data->albumart_cache, cache_key) == true ||
+        (config->covercache_keep_days > 0 &&
+         covercache_thumbnail_skipped(config->cachedir, uri, offset, config->thumbnail_size) == true))
+    {
+        //image is already small enough or could not be decoded
+        if (binary != NULL) {
+            serve_albumart_binary(nc, hm, mg_user_data, cache_key, mime_type, binary);
         }
         else {
-            MYMPD_LOG_WARN("Embedded picture size is zero");
+            serve_albumart_file(nc, hm, mg_user_data, cache_key, filepath, uri, offset, false);
         }
+        return;
     }
-    else {
-        MYMPD_LOG_DEBUG("No embedded picture detected");
+    thumbnail_worker_push(cache_key, uri, offset, binary, filepath);
+    //the original image is not cached, the client revalidates it
+    if (binary != NULL) {
+        albumart_cache_send_placeholder(nc, hm, &mg_user_data->albumart_cache, mime_type, binary, sdslen(binary));
+        return;
     }
-    id3_file_close(file_struct);
+    MYMPD_LOG_DEBUG("Serving file %s (%s) until the thumbnail is created", filepath, mime_type);
+    static struct mg_http_serve_opts s_http_server_opts;
+    s_http_server_opts.root_dir = mg_user_data->browse_directory;
+    s_http_server_opts.extra_headers = EXTRA_HEADERS_NO_CACHE;
+    s_http_server_opts.mime_types = EXTRA_MIME_TYPES;
+    mg_http_serve_file(nc, hm, filepath, &s_http_server_opts);
+    webserver_handle_connection_close(nc);
+}
+
+/**
+ * Checks if thumbnails should be created,
+ * the albumart cache or the covercache must be enabled to keep them
+ * @param mg_user_data pointer to mongoose configuration
+ * @return true if thumbnail creation is enabled, else false
+ */
+static bool thumbnails_enabled(struct t_mg_user_data *mg_user_data) {
+    #ifdef ENABLE_THUMBNAILS
+        return mg_user_data->config->thumbnail_size > 0 &&
+            (mg_user_data->albumart_cache.size_max > 0 || mg_user_data->config->covercache_keep_days > 0) ? true : false;
     #else
-    (void) cachedir;
-    (void) uri;
-    (void) media_file;
-    (void) binary;
-    (void) covercache;
-    (void) offset;
+        (void) mg_user_data;
+        return false;
     #endif
-    return rc;
 }
 
 /**
- * Extracts albumart from vorbis tagged files
- * @param cachedir covercache directory
+ * Extracts albumart from media files
+ * @param nc mongoose connection
+ * @param hm http message
+ * @param mg_user_data pointer to mongoose configuration
+ * @param cache_key key for the albumart cache
  * @param uri song uri
  * @param media_file full path to the song
- * @param binary pointer to already allocates sds string to hold the image
- * @param is_ogg true if it is a ogg file, false if it is a flac file
  * @param covercache true = covercache is enabled
  * @param offset number of embedded image to extract
+ * @param create_thumbnail true = serve a thumbnail of the image
  * @return true on success, else false
  */
-static bool handle_coverextract_flac(sds cachedir, const char *uri, const char *media_file,
-        sds *binary, bool is_ogg, bool covercache, int offset)
+static bool handle_coverextract(struct mg_connection *nc, struct mg_http_message *hm, struct t_mg_user_data *mg_user_data,
+        sds cache_key, const char *uri, const char *media_file, bool covercache, int offset, bool create_thumbnail)
 {
-    bool rc = false;
-    #ifdef ENABLE_FLAC
-    MYMPD_LOG_DEBUG("Exctracting coverimage from %s", media_file);
-    FLAC__StreamMetadata *metadata = NULL;
-
-    FLAC__Metadata_Chain *chain = FLAC__metadata_chain_new();
-
-    if(! (is_ogg? FLAC__metadata_chain_read_ogg(chain, media_file) : FLAC__metadata_chain_read(chain, media_file)) ) {
-        MYMPD_LOG_DEBUG("%s: ERROR: reading metadata", media_file);
-        FLAC__metadata_chain_delete(chain);
-        return false;
-    }
-
-    FLAC__Metadata_Iterator *iterator = FLAC__metadata_iterator_new();
-    FLAC__metadata_iterator_init(iterator, chain);
-    assert(iterator);
-    int i = 0;
-    do {
-        FLAC__StreamMetadata *block = FLAC__metadata_iterator_get_block(iterator);
-        if (block->type == FLAC__METADATA_TYPE_PICTURE) {
-            if (i == offset) {
-                metadata = block;
-                break;
-            }
-            i++;
+    MYMPD_LOG_DEBUG("Handle coverextract for uri \"%s\"", uri);
+    sds binary = sdsempty();
+    bool rc = coverextract(media_file, &binary, offset);
+    if (rc == true) {
+        if (covercache == true) {
+            const char *mime_type = get_mime_type_by_magic_stream(binary);
+            covercache_write_file(mg_user_data->config->cachedir, uri, mime_type, binary, offset);
+        }
+        else {
+            MYMPD_LOG_DEBUG("Covercache is disabled");
         }
-    } while (FLAC__metadata_iterator_next(iterator) && metadata == NULL);
-
-    if (metadata == NULL) {
-        MYMPD_LOG_DEBUG("No embedded picture detected");
     }
-    else if (metadata->data.picture.data_length > 0) {
-        *binary = sdscatlen(*binary, metadata->data.picture.data, metadata->data.picture.data_length);
-        const char *mime_type = get_mime_type_by_magic_stream(*binary);
-        if (mime_type != NULL) {
-            if (covercache == true) {
-                covercache_write_file(cachedir, uri, mime_type, *binary, offset);
-            }
-            else {
-                MYMPD_LOG_DEBUG("Covercache is disabled");
-            }
-            MYMPD_LOG_DEBUG("Coverimage successfully extracted (%lu bytes)", (unsigned long)sdslen(*binary));
-            rc = true;
+    if (rc == true) {
+        const char *mime_type = get_mime_type_by_magic_stream(binary);
+        MYMPD_LOG_DEBUG("Serving coverimage for \"%s\" (%s)", media_file, mime_type);
+        if (create_thumbnail == true) {
+            serve_albumart_thumbnail(nc, hm, mg_user_data, cache_key, uri, offset, mime_type, binary, NULL);
         }
         else {
-            MYMPD_LOG_WARN("Could not determine mimetype, discarding image");
-            sdsclear(*binary);
+            serve_albumart_binary(nc, hm, mg_user_data, cache_key, mime_type, binary);
         }
     }
-    else {
-        MYMPD_LOG_WARN("Embedded picture size is zero");
-    }
-    FLAC__metadata_iterator_delete(iterator);
-    FLAC__metadata_chain_delete(chain);
-    #else
-    (void) cachedir;
-    (void) uri;
-    (void) media_file;
-    (void) binary;
-    (void) is_ogg;
-    (void) covercache;
-    (void) offset;
-    #endif
+    FREE_SDS(binary);
     return rc;
 }
@@ -21,6 +21,7 @@ enum albumart_sizes {
 };
 
 void webserver_send_albumart(struct mg_connection *nc, sds data, sds binary);
+void webserver_albumart_thumbnail_done(struct t_mg_user_data *mg_user_data, sds cache_key, sds thumbnail);
 bool request_handler_albumart(struct mg_connection *nc, struct mg_http_message *hm,
     struct t_mg_user_data *mg_user_data, long long conn_id, enum albumart_sizes size);
 #endif
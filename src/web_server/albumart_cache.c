@@ -0,0 +1,495 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "albumart_cache.h"
+
+#include "../lib/filehandler.h"
+#include "../lib/jsonrpc.h"
+#include "../lib/log.h"
+#include "../lib/mem.h"
+#include "../lib/sds_extras.h"
+#include "utility.h"
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/**
+ * This unit implements a size bounded in-memory LRU cache for albumart.
+ * It is used only from the webserver thread and needs therefore no locking.
+ */
+
+/**
+ * Private definitions
+ */
+static void entry_unlink(struct t_albumart_cache *cache, struct t_albumart_cache_entry *entry);
+static void entry_link_head(struct t_albumart_cache *cache, struct t_albumart_cache_entry *entry);
+static void entry_remove(struct t_albumart_cache *cache, struct t_albumart_cache_entry *entry);
+static void entry_free(struct t_albumart_cache_entry *entry);
+static sds etag_from_content(sds buffer, const char *binary, size_t len);
+static bool etag_matches(struct mg_http_message *hm, sds etag);
+static void send_with_etag(struct mg_connection *nc, struct mg_http_message *hm, struct t_albumart_cache *cache,
+        const char *mime_type, const char *binary, size_t len, sds etag, const char *cache_control);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes the albumart cache
+ * @param cache pointer to already allocated cache struct
+ * @param size_max size budget in bytes, 0 disables the cache
+ */
+void albumart_cache_init(struct t_albumart_cache *cache, size_t size_max) {
+    cache->index = raxNew();
+    cache->head = NULL;
+    cache->tail = NULL;
+    cache->negative = raxNew();
+    cache->no_thumbnail = raxNew();
+    cache->size = 0;
+    cache->size_max = size_max;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->not_modified = 0;
+    cache->evictions = 0;
+    cache->negative_hits = 0;
+}
+
+/**
+ * Removes all entries from the albumart cache, the negative cache
+ * and the no thumbnail markers, statistics are preserved
+ * @param cache pointer to the cache
+ */
+void albumart_cache_clear(struct t_albumart_cache *cache) {
+    if (cache->negative->numele > 0) {
+        raxFree(cache->negative);
+        cache->negative = raxNew();
+    }
+    if (cache->no_thumbnail->numele > 0) {
+        raxFree(cache->no_thumbnail);
+        cache->no_thumbnail = raxNew();
+    }
+    if (cache->head == NULL) {
+        return;
+    }
+    MYMPD_LOG_DEBUG("Clearing albumart cache (%lu bytes)", (unsigned long)cache->size);
+    struct t_albumart_cache_entry *current = cache->head;
+    while (current != NULL) {
+        struct t_albumart_cache_entry *next = current->next;
+        entry_free(current);
+        current = next;
+    }
+    raxFree(cache->index);
+    cache->index = raxNew();
+    cache->head = NULL;
+    cache->tail = NULL;
+    cache->size = 0;
+}
+
+/**
+ * Frees all entries and the index of the albumart cache
+ * @param cache pointer to the cache
+ */
+void albumart_cache_free(struct t_albumart_cache *cache) {
+    albumart_cache_clear(cache);
+    raxFree(cache->index);
+    cache->index = NULL;
+    raxFree(cache->negative);
+    cache->negative = NULL;
+    raxFree(cache->no_thumbnail);
+    cache->no_thumbnail = NULL;
+}
+
+/**
+ * Creates the cache key for an albumart request
+ * @param key already allocated sds string to append the key
+ * @param uri song uri
+ * @param offset number of the embedded image
+ * @param thumbnail true for thumbnail requests
+ * @return pointer to key
+ */
+sds albumart_cache_key(sds key, const char *uri, int offset, bool thumbnail) {
+    sds hash = sds_hash(uri);
+    key = sdscatfmt(key, "%S-%i-%s", hash, offset, (thumbnail == true ? "t" : "f"));
+    FREE_SDS(hash);
+    return key;
+}
+
+/**
+ * Looks up an entry and marks it as most recently used
+ * @param cache pointer to the cache
+ * @param key cache key
+ * @return the entry or NULL if not found
+ */
+struct t_albumart_cache_entry *albumart_cache_get(struct t_albumart_cache *cache, sds key) {
+    if (cache->size_max == 0) {
+        return NULL;
+    }
+    void *data = raxFind(cache->index, (unsigned char *)key, sdslen(key));
+    if (data == raxNotFound) {
+        cache->misses++;
+        return NULL;
+    }
+    cache->hits++;
+    struct t_albumart_cache_entry *entry = (struct t_albumart_cache_entry *)data;
+    if (entry != cache->head) {
+        entry_unlink(cache, entry);
+        entry_link_head(cache, entry);
+    }
+    return entry;
+}
+
+/**
+ * Adds an image to the cache, least recently used entries are evicted
+ * until the image fits in the size budget
+ * @param cache pointer to the cache
+ * @param key cache key
+ * @param mime_type mime type of the image
+ * @param binary the image
+ * @param len length of the image
+ * @return the new entry or NULL if the image was not cached
+ */
+struct t_albumart_cache_entry *albumart_cache_put(struct t_albumart_cache *cache, sds key,
+        const char *mime_type, const char *binary, size_t len)
+{
+    if (cache->size_max == 0 ||
+        len == 0 ||
+        len > cache->size_max)
+    {
+        return NULL;
+    }
+    //replace an existing entry
+    void *data = raxFind(cache->index, (unsigned char *)key, sdslen(key));
+    if (data != raxNotFound) {
+        entry_remove(cache, (struct t_albumart_cache_entry *)data);
+    }
+    //evict least recently used entries
+    while (cache->tail != NULL &&
+        cache->size + len > cache->size_max)
+    {
+        MYMPD_LOG_DEBUG("Evicting \"%s\" from albumart cache", cache->tail->key);
+        entry_remove(cache, cache->tail);
+        cache->evictions++;
+    }
+    struct t_albumart_cache_entry *entry = malloc_assert(sizeof(struct t_albumart_cache_entry));
+    entry->key = sdsdup(key);
+    entry->mime_type = sdsnew(mime_type);
+    entry->binary = sdsnewlen(binary, len);
+    entry->etag = etag_from_content(sdsempty(), binary, len);
+    raxInsert(cache->index, (unsigned char *)entry->key, sdslen(entry->key), entry, NULL);
+    entry_link_head(cache, entry);
+    cache->size += len;
+    MYMPD_LOG_DEBUG("Added \"%s\" to albumart cache (%lu bytes), cache size: %lu bytes",
+        key, (unsigned long)len, (unsigned long)cache->size);
+    return entry;
+}
+
+/**
+ * Reads an image file and adds it to the cache
+ * @param cache pointer to the cache
+ * @param key cache key
+ * @param filepath image file to read
+ * @param mime_type mime type of the image
+ * @return the new entry or NULL if the image was not cached
+ */
+struct t_albumart_cache_entry *albumart_cache_put_file(struct t_albumart_cache *cache, sds key,
+        const char *filepath, const char *mime_type)
+{
+    if (cache->size_max == 0) {
+        return NULL;
+    }
+    struct stat status;
+    if (stat(filepath, &status) != 0 ||
+        status.st_size <= 0 ||
+        (size_t)status.st_size > cache->size_max ||
+        status.st_size > MPD_BINARY_SIZE_MAX)
+    {
+        return NULL;
+    }
+    sds binary = sdsempty();
+    struct t_albumart_cache_entry *entry = NULL;
+    if (read_data_from_file(&binary, filepath, MPD_BINARY_SIZE_MAX) == true) {
+        entry = albumart_cache_put(cache, key, mime_type, binary, sdslen(binary));
+    }
+    FREE_SDS(binary);
+    return entry;
+}
+
+/**
+ * Checks the negative cache
+ * @param cache pointer to the cache
+ * @param key cache key
+ * @return true if it is known that there is no albumart for key, else false
+ */
+bool albumart_cache_negative_get(struct t_albumart_cache *cache, sds key) {
+    void *data = raxFind(cache->negative, (unsigned char *)key, sdslen(key));
+    if (data == raxNotFound) {
+        return false;
+    }
+    if ((time_t)(uintptr_t)data < time(NULL)) {
+        //expired, lookup errors could be transient
+        raxRemove(cache->negative, (unsigned char *)key, sdslen(key), NULL);
+        return false;
+    }
+    cache->negative_hits++;
+    return true;
+}
+
+/**
+ * Remembers that there is no albumart for key,
+ * the entry expires after ALBUMART_NEGATIVE_CACHE_TTL seconds
+ * @param cache pointer to the cache
+ * @param key cache key
+ */
+void albumart_cache_negative_add(struct t_albumart_cache *cache, sds key) {
+    if (cache->negative->numele >= ALBUMART_NEGATIVE_CACHE_MAX) {
+        MYMPD_LOG_DEBUG("Negative albumart cache is full, clearing it");
+        raxFree(cache->negative);
+        cache->negative = raxNew();
+    }
+    uintptr_t expires = (uintptr_t)(time(NULL) + ALBUMART_NEGATIVE_CACHE_TTL);
+    raxInsert(cache->negative, (unsigned char *)key, sdslen(key), (void *)expires, NULL);
+}
+
+/**
+ * Checks if no thumbnail could be created for key
+ * @param cache pointer to the cache
+ * @param key cache key of the thumbnail request
+ * @return true if the original image should be served, else false
+ */
+bool albumart_cache_no_thumbnail_get(struct t_albumart_cache *cache, sds key) {
+    return raxFind(cache->no_thumbnail, (unsigned char *)key, sdslen(key)) != raxNotFound;
+}
+
+/**
+ * Remembers that no thumbnail could be created for key,
+ * the image could not be decoded or the thumbnail was not smaller
+ * @param cache pointer to the cache
+ * @param key cache key of the thumbnail request
+ */
+void albumart_cache_no_thumbnail_add(struct t_albumart_cache *cache, sds key) {
+    if (cache->no_thumbnail->numele >= ALBUMART_NEGATIVE_CACHE_MAX) {
+        raxFree(cache->no_thumbnail);
+        cache->no_thumbnail = raxNew();
+    }
+    raxInsert(cache->no_thumbnail, (unsigned char *)key, sdslen(key), NULL, NULL);
+}
+
+/**
+ * Sends a cached image to the client, answers with 304 if the
+ * If-None-Match header matches the etag of the entry
+ * @param nc mongoose connection
+ * @param hm http message, can be NULL
+ * @param cache pointer to the cache
+ * @param entry entry to send
+ */
+void albumart_cache_send(struct mg_connection *nc, struct mg_http_message *hm,
+        struct t_albumart_cache *cache, struct t_albumart_cache_entry *entry)
+{
+    send_with_etag(nc, hm, cache, entry->mime_type, entry->binary, sdslen(entry->binary), entry->etag, EXTRA_HEADERS_CACHE);
+}
+
+/**
+ * Sends an image that is not cached to the client, the etag is
+ * calculated from the content independently of the cache size.
+ * Answers with 304 if the If-None-Match header matches.
+ * @param nc mongoose connection
+ * @param hm http message, can be NULL
+ * @param cache pointer to the cache for the statistics
+ * @param mime_type mime type of the image
+ * @param binary the image
+ * @param len length of the image
+ */
+void albumart_cache_send_uncached(struct mg_connection *nc, struct mg_http_message *hm,
+        struct t_albumart_cache *cache, const char *mime_type, const char *binary, size_t len)
+{
+    sds etag = etag_from_content(sdsempty(), binary, len);
+    send_with_etag(nc, hm, cache, mime_type, binary, len, etag, EXTRA_HEADERS_CACHE);
+    FREE_SDS(etag);
+}
+
+/**
+ * Sends an image that replaces a not yet created thumbnail,
+ * the client must revalidate it on each use.
+ * @param nc mongoose connection
+ * @param hm http message, can be NULL
+ * @param cache pointer to the cache for the statistics
+ * @param mime_type mime type of the image
+ * @param binary the image
+ * @param len length of the image
+ */
+void albumart_cache_send_placeholder(struct mg_connection *nc, struct mg_http_message *hm,
+        struct t_albumart_cache *cache, const char *mime_type, const char *binary, size_t len)
+{
+    sds etag = etag_from_content(sdsempty(), binary, len);
+    send_with_etag(nc, hm, cache, mime_type, binary, len, etag, EXTRA_HEADERS_NO_CACHE);
+    FREE_SDS(etag);
+}
+
+/**
+ * Prints the albumart cache statistics as json object
+ * @param buffer already allocated sds string to append
+ * @param cache pointer to the cache
+ * @return pointer to buffer
+ */
+sds albumart_cache_stats(sds buffer, struct t_albumart_cache *cache) {
+    buffer = sdscatlen(buffer, "{", 1);
+    buffer = tojson_ullong(buffer, "entries", cache->index != NULL ? cache->index->numele : 0, true);
+    buffer = tojson_ulong(buffer, "size", (unsigned long)cache->size, true);
+    buffer = tojson_ulong(buffer, "sizeMax", (unsigned long)cache->size_max, true);
+    buffer = tojson_ulong(buffer, "hits", cache->hits, true);
+    buffer = tojson_ulong(buffer, "misses", cache->misses, true);
+    buffer = tojson_ulong(buffer, "notModified", cache->not_modified, true);
+    buffer = tojson_ulong(buffer, "evictions", cache->evictions, true);
+    buffer = tojson_ullong(buffer, "negativeEntries", cache->negative != NULL ? cache->negative->numele : 0, true);
+    buffer = tojson_ulong(buffer, "negativeHits", cache->negative_hits, false);
+    buffer = sdscatlen(buffer, "}", 1);
+    return buffer;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Removes the entry from the lru list
+ * @param cache pointer to the cache
+ * @param entry entry to unlink
+ */
+static void entry_unlink(struct t_albumart_cache *cache, struct t_albumart_cache_entry *entry) {
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    }
+    else {
+        cache->head = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    }
+    else {
+        cache->tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+/**
+ * Inserts the entry at the head of the lru list
+ * @param cache pointer to the cache
+ * @param entry entry to insert
+ */
+static void entry_link_head(struct t_albumart_cache *cache, struct t_albumart_cache_entry *entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head != NULL) {
+        cache->head->prev = entry;
+    }
+    cache->head = entry;
+    if (cache->tail == NULL) {
+        cache->tail = entry;
+    }
+}
+
+/**
+ * Removes the entry from the cache and frees it
+ * @param cache pointer to the cache
+ * @param entry entry to remove
+ */
+static void entry_remove(struct t_albumart_cache *cache, struct t_albumart_cache_entry *entry) {
+    entry_unlink(cache, entry);
+    raxRemove(cache->index, (unsigned char *)entry->key, sdslen(entry->key), NULL);
+    cache->size -= sdslen(entry->binary);
+    entry_free(entry);
+}
+
+/**
+ * Frees a cache entry
+ * @param entry entry to free
+ */
+static void entry_free(struct t_albumart_cache_entry *entry) {
+    FREE_SDS(entry->key);
+    FREE_SDS(entry->mime_type);
+    FREE_SDS(entry->etag);
+    FREE_SDS(entry->binary);
+    FREE_PTR(entry);
+}
+
+/**
+ * Creates a strong etag from the sha1 hash of the content
+ * @param buffer already allocated sds string to append the etag
+ * @param binary content to hash
+ * @param len length of the content
+ * @return pointer to buffer
+ */
+static sds etag_from_content(sds buffer, const char *binary, size_t len) {
+    mg_sha1_ctx ctx;
+    mg_sha1_init(&ctx);
+    mg_sha1_update(&ctx, (const unsigned char *)binary, len);
+    unsigned char hash[20];
+    mg_sha1_final(hash, &ctx);
+    buffer = sdscatlen(buffer, "\"", 1);
+    for (unsigned i = 0; i < 20; i++) {
+        buffer = sdscatprintf(buffer, "%02x", hash[i]);
+    }
+    buffer = sdscatlen(buffer, "\"", 1);
+    return buffer;
+}
+
+/**
+ * Checks the If-None-Match header against the etag
+ * @param hm http message
+ * @param etag etag to match
+ * @return true if etag matches, else false
+ */
+static bool etag_matches(struct mg_http_message *hm, sds etag) {
+    struct mg_str *if_none_match = mg_http_get_header(hm, "If-None-Match");
+    if (if_none_match == NULL) {
+        return false;
+    }
+    if (if_none_match->len == 1 &&
+        if_none_match->ptr[0] == '*')
+    {
+        return true;
+    }
+    return mg_strstr(*if_none_match, mg_str_n(etag, sdslen(etag))) != NULL;
+}
+
+/**
+ * Sends an image with an etag header, answers with 304 if the
+ * If-None-Match header matches the etag
+ * @param nc mongoose connection
+ * @param hm http message, can be NULL
+ * @param cache pointer to the cache for the statistics
+ * @param mime_type mime type of the image
+ * @param binary the image
+ * @param len length of the image
+ * @param etag the etag of the image
+ * @param cache_control Cache-Control header line
+ */
+static void send_with_etag(struct mg_connection *nc, struct mg_http_message *hm, struct t_albumart_cache *cache,
+        const char *mime_type, const char *binary, size_t len, sds etag, const char *cache_control)
+{
+    if (hm != NULL &&
+        etag_matches(hm, etag) == true)
+    {
+        MYMPD_LOG_DEBUG("Albumart not modified (%lu)", nc->id);
+        cache->not_modified++;
+        mg_printf(nc, "HTTP/1.1 304 Not Modified\r\n"
+            "ETag: %s\r\n"
+            "%s"
+            "Content-Length: 0\r\n\r\n",
+            etag, cache_control);
+        webserver_handle_connection_close(nc);
+        return;
+    }
+    MYMPD_LOG_DEBUG("Serving albumart from memory (%s - %lu bytes) (%lu)",
+        mime_type, (unsigned long)len, nc->id);
+    sds headers = sdscatfmt(sdsempty(), "Content-Type: %s\r\nETag: %S\r\n", mime_type, etag);
+    headers = sdscat(headers, cache_control);
+    webserver_send_data(nc, binary, len, headers);
+    FREE_SDS(headers);
+}
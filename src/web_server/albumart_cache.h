@@ -0,0 +1,66 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_WEB_SERVER_ALBUMART_CACHE_H
+#define MYMPD_WEB_SERVER_ALBUMART_CACHE_H
+
+#include "../../dist/mongoose/mongoose.h"
+#include "../../dist/rax/rax.h"
+#include "../../dist/sds/sds.h"
+
+#include <stdbool.h>
+
+/**
+ * Entry of the in-memory albumart cache
+ */
+struct t_albumart_cache_entry {
+    sds key;                               //!< cache key: hash of uri, offset and size
+    sds mime_type;                         //!< mime type of the image
+    sds etag;                              //!< strong etag (hash of the image content)
+    sds binary;                            //!< the image itself
+    struct t_albumart_cache_entry *prev;   //!< more recently used entry
+    struct t_albumart_cache_entry *next;   //!< less recently used entry
+};
+
+/**
+ * In-memory LRU cache for albumart, owned by the webserver thread
+ */
+struct t_albumart_cache {
+    rax *index;                            //!< key -> struct t_albumart_cache_entry
+    struct t_albumart_cache_entry *head;   //!< most recently used entry
+    struct t_albumart_cache_entry *tail;   //!< least recently used entry
+    rax *negative;                         //!< keys of albumart requests without a result
+    rax *no_thumbnail;                     //!< keys of thumbnail requests served with the original image
+    size_t size;                           //!< bytes of all cached images
+    size_t size_max;                       //!< size budget in bytes, 0 disables the cache
+    unsigned long hits;                    //!< number of cache hits
+    unsigned long misses;                  //!< number of cache misses
+    unsigned long not_modified;            //!< number of 304 responses
+    unsigned long evictions;               //!< number of evicted entries
+    unsigned long negative_hits;           //!< number of requests answered by the negative cache
+};
+
+void albumart_cache_init(struct t_albumart_cache *cache, size_t size_max);
+void albumart_cache_clear(struct t_albumart_cache *cache);
+void albumart_cache_free(struct t_albumart_cache *cache);
+sds albumart_cache_key(sds key, const char *uri, int offset, bool thumbnail);
+struct t_albumart_cache_entry *albumart_cache_get(struct t_albumart_cache *cache, sds key);
+struct t_albumart_cache_entry *albumart_cache_put(struct t_albumart_cache *cache, sds key,
+        const char *mime_type, const char *binary, size_t len);
+struct t_albumart_cache_entry *albumart_cache_put_file(struct t_albumart_cache *cache, sds key,
+        const char *filepath, const char *mime_type);
+bool albumart_cache_negative_get(struct t_albumart_cache *cache, sds key);
+void albumart_cache_negative_add(struct t_albumart_cache *cache, sds key);
+bool albumart_cache_no_thumbnail_get(struct t_albumart_cache *cache, sds key);
+void albumart_cache_no_thumbnail_add(struct t_albumart_cache *cache, sds key);
+void albumart_cache_send(struct mg_connection *nc, struct mg_http_message *hm,
+        struct t_albumart_cache *cache, struct t_albumart_cache_entry *entry);
+void albumart_cache_send_uncached(struct mg_connection *nc, struct mg_http_message *hm,
+        struct t_albumart_cache *cache, const char *mime_type, const char *binary, size_t len);
+void albumart_cache_send_placeholder(struct mg_connection *nc, struct mg_http_message *hm,
+        struct t_albumart_cache *cache, const char *mime_type, const char *binary, size_t len);
+sds albumart_cache_stats(sds buffer, struct t_albumart_cache *cache);
+#endif
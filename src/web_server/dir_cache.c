@@ -0,0 +1,245 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "dir_cache.h"
+
+#include "../lib/log.h"
+#include "../lib/mem.h"
+#include "../lib/rax_extras.h"
+#include "../lib/sds_extras.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Private definitions
+ */
+
+/**
+ * Cached listing of a directory
+ */
+struct t_dir_cache_dir {
+    rax *files;    //!< filenames, NULL if the directory has too many entries
+    bool nocase;   //!< true if the directory is on a case insensitive filesystem, filenames are lowercase
+};
+
+static struct t_dir_cache_dir *dir_cache_read_dir(const char *dirpath, size_t dirpath_len);
+static bool dir_cache_is_nocase(sds path, rax *files);
+static void dir_cache_free_dir(void *data);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes the directory cache
+ * @param dir_cache pointer to already allocated struct
+ */
+void dir_cache_init(struct t_dir_cache *dir_cache) {
+    dir_cache->dirs = raxNew();
+    dir_cache->hits = 0;
+    dir_cache->misses = 0;
+}
+
+/**
+ * Removes all cached directory listings
+ * @param dir_cache pointer to the directory cache
+ */
+void dir_cache_clear(struct t_dir_cache *dir_cache) {
+    if (dir_cache->dirs->numele == 0) {
+        return;
+    }
+    MYMPD_LOG_DEBUG("Clearing directory cache (%llu directories)", (unsigned long long)dir_cache->dirs->numele);
+    rax_free_data(dir_cache->dirs, dir_cache_free_dir);
+    dir_cache->dirs = raxNew();
+}
+
+/**
+ * Frees the directory cache
+ * @param dir_cache pointer to the directory cache
+ */
+void dir_cache_free(struct t_dir_cache *dir_cache) {
+    rax_free_data(dir_cache->dirs, dir_cache_free_dir);
+    dir_cache->dirs = NULL;
+}
+
+/**
+ * Checks if a file exists, the listing of the parent directory is
+ * read on first access and cached until the next dir_cache_clear.
+ * Filenames are compared case insensitive on case insensitive filesystems.
+ * @param dir_cache pointer to the directory cache
+ * @param filepath file to check
+ * @return true if file exists, else false
+ */
+bool dir_cache_file_exists(struct t_dir_cache *dir_cache, const char *filepath) {
+    const char *filename = strrchr(filepath, '/');
+    if (filename == NULL) {
+        return access(filepath, F_OK) == 0; /* Flawfinder: ignore */
+    }
+    size_t dirpath_len = (size_t)(filename - filepath);
+    filename++;
+    struct t_dir_cache_dir *dir = raxFind(dir_cache->dirs, (unsigned char *)filepath, dirpath_len);
+    if (dir == raxNotFound) {
+        if (dir_cache->dirs->numele >= DIR_CACHE_DIRS_MAX) {
+            dir_cache_clear(dir_cache);
+        }
+        dir = dir_cache_read_dir(filepath, dirpath_len);
+        raxInsert(dir_cache->dirs, (unsigned char *)filepath, dirpath_len, dir, NULL);
+        dir_cache->misses++;
+    }
+    else {
+        dir_cache->hits++;
+    }
+    if (dir->files == NULL) {
+        //directory listing was too large to cache
+        return access(filepath, F_OK) == 0; /* Flawfinder: ignore */
+    }
+    if (dir->nocase == true) {
+        sds key = sdsnew(filename);
+        sds_utf8_tolower(key);
+        bool found = raxFind(dir->files, (unsigned char *)key, sdslen(key)) != raxNotFound;
+        FREE_SDS(key);
+        return found;
+    }
+    return raxFind(dir->files, (unsigned char *)filename, strlen(filename)) != raxNotFound;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Reads the filenames of a directory
+ * @param dirpath directory to read, must not be null terminated
+ * @param dirpath_len length of dirpath
+ * @return allocated directory listing
+ */
+static struct t_dir_cache_dir *dir_cache_read_dir(const char *dirpath, size_t dirpath_len) {
+    struct t_dir_cache_dir *dir = malloc_assert(sizeof(struct t_dir_cache_dir));
+    dir->files = raxNew();
+    dir->nocase = false;
+    sds path = sdsnewlen(dirpath, dirpath_len);
+    DIR *dir_handle = opendir(path);
+    if (dir_handle == NULL) {
+        //cache nonexistent directories as empty
+        MYMPD_LOG_DEBUG("Can not open directory \"%s\"", path);
+        FREE_SDS(path);
+        return dir;
+    }
+    struct dirent *next_file;
+    while ((next_file = readdir(dir_handle)) != NULL) {
+        if (next_file->d_name[0] == '.' &&
+            (next_file->d_name[1] == '\0' ||
+             (next_file->d_name[1] == '.' && next_file->d_name[2] == '\0')))
+        {
+            continue;
+        }
+        if (dir->files->numele >= DIR_CACHE_FILES_MAX) {
+            MYMPD_LOG_DEBUG("Directory \"%s\" has too many entries for the directory cache", path);
+            raxFree(dir->files);
+            dir->files = NULL;
+            break;
+        }
+        raxInsert(dir->files, (unsigned char *)next_file->d_name, strlen(next_file->d_name), NULL, NULL);
+    }
+    closedir(dir_handle);
+    if (dir->files != NULL &&
+        dir_cache_is_nocase(path, dir->files) == true)
+    {
+        MYMPD_LOG_DEBUG("Directory \"%s\" is case insensitive", path);
+        //rebuild the listing with lowercase filenames
+        rax *files = raxNew();
+        raxIterator iter;
+        raxStart(&iter, dir->files);
+        raxSeek(&iter, "^", NULL, 0);
+        sds key = sdsempty();
+        while (raxNext(&iter)) {
+            key = sds_replacelen(key, (char *)iter.key, iter.key_len);
+            sds_utf8_tolower(key);
+            raxInsert(files, (unsigned char *)key, sdslen(key), NULL, NULL);
+        }
+        FREE_SDS(key);
+        raxStop(&iter);
+        raxFree(dir->files);
+        dir->files = files;
+        dir->nocase = true;
+    }
+    FREE_SDS(path);
+    return dir;
+}
+
+/**
+ * Checks if a directory is on a case insensitive filesystem (e.g. vfat or cifs).
+ * A filename that changes by case folding is probed with its folded name,
+ * if all filenames are already folded, a filename is probed with uppercase ascii letters.
+ * Both probes fold to the listed filename with sds_utf8_tolower,
+ * that folds the filenames of case insensitive directories and the lookups.
+ * @param path directory path
+ * @param files filenames of the directory
+ * @return true if the directory is case insensitive, else false
+ */
+static bool dir_cache_is_nocase(sds path, rax *files) {
+    sds probe = NULL;
+    sds fallback = NULL;
+    sds folded = sdsempty();
+    raxIterator iter;
+    raxStart(&iter, files);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        folded = sds_replacelen(folded, (char *)iter.key, iter.key_len);
+        sds_utf8_tolower(folded);
+        if (memcmp(folded, iter.key, iter.key_len) != 0) {
+            probe = sdsdup(folded);
+            break;
+        }
+        if (fallback == NULL) {
+            bool has_alpha = false;
+            for (size_t i = 0; i < sdslen(folded); i++) {
+                if (islower((unsigned char)folded[i])) {
+                    folded[i] = (char)toupper((unsigned char)folded[i]);
+                    has_alpha = true;
+                }
+            }
+            if (has_alpha == true) {
+                fallback = sdsdup(folded);
+            }
+        }
+    }
+    raxStop(&iter);
+    FREE_SDS(folded);
+    if (probe == NULL) {
+        probe = fallback;
+    }
+    else {
+        FREE_SDS(fallback);
+    }
+    if (probe == NULL) {
+        return false;
+    }
+    bool nocase = false;
+    if (raxFind(files, (unsigned char *)probe, sdslen(probe)) == raxNotFound) {
+        sds filepath = sdscatfmt(sdsempty(), "%S/%S", path, probe);
+        nocase = access(filepath, F_OK) == 0; /* Flawfinder: ignore */
+        FREE_SDS(filepath);
+    }
+    FREE_SDS(probe);
+    return nocase;
+}
+
+/**
+ * Frees a cached directory listing
+ * @param data pointer to struct t_dir_cache_dir
+ */
+static void dir_cache_free_dir(void *data) {
+    struct t_dir_cache_dir *dir = (struct t_dir_cache_dir *)data;
+    if (dir->files != NULL) {
+        raxFree(dir->files);
+    }
+    FREE_PTR(dir);
+}
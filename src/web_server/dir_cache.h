@@ -0,0 +1,29 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_WEB_SERVER_DIR_CACHE_H
+#define MYMPD_WEB_SERVER_DIR_CACHE_H
+
+#include "../../dist/rax/rax.h"
+#include "../../dist/sds/sds.h"
+
+#include <stdbool.h>
+
+/**
+ * Cache of directory listings, owned by the webserver thread.
+ * It replaces the access() probing for cover files with hash lookups.
+ */
+struct t_dir_cache {
+    rax *dirs;               //!< directory path -> rax of filenames, NULL if the directory is not cacheable
+    unsigned long hits;      //!< lookups answered from cache
+    unsigned long misses;    //!< directories read from disk
+};
+
+void dir_cache_init(struct t_dir_cache *dir_cache);
+void dir_cache_clear(struct t_dir_cache *dir_cache);
+void dir_cache_free(struct t_dir_cache *dir_cache);
+bool dir_cache_file_exists(struct t_dir_cache *dir_cache, const char *filepath);
+#endif
@@ -8,6 +8,7 @@
 #include "request_handler.h"
 
 #include "../lib/api.h"
+#include "../lib/covercache.h"
 #include "../lib/jsonrpc.h"
 #include "../lib/log.h"
 #include "sessions.h"
@@ -16,9 +17,23 @@
 #include "webradiodb.h"
 
 /**
- * Request handler for api requests /api
+ * Private definitions
+ */
+
+static bool request_handler_api_batch(struct mg_connection *nc, sds body, struct mg_str *auth_header,
+        struct t_mg_user_data *mg_user_data);
+static enum mympd_cmd_ids get_api_method(sds request, int request_id_max, int *request_id);
+static bool check_api_auth(struct mg_connection *nc, enum mympd_cmd_ids cmd_id, long request_id,
+        struct mg_str *auth_header, struct t_mg_user_data *mg_user_data, sds *session);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Request handler for api requests /api and websocket api requests
  * @param nc mongoose connection
- * @param body http body (jsonrpc request)
+ * @param body http body or websocket message (jsonrpc request or jsonrpc batch request)
  * @param auth_header Authentication header (myMPD session)
  * @param mg_user_data webserver configuration
  * @param backend_nc backend connection
@@ -29,78 +44,39 @@ bool request_handler_api(struct mg_connection *nc, sds body, struct mg_str *auth
 {
     MYMPD_LOG_DEBUG("API request (%lld): %s", (long long)nc->id, body);
 
+    if (body[0] == '[') {
+        //jsonrpc batch request
+        if (validate_json_array(body) == false) {
+            return false;
+        }
+        return request_handler_api_batch(nc, body, auth_header, mg_user_data);
+    }
+
     //first check if request is valid json string
     if (validate_json(body) == false) {
         return false;
     }
 
-    sds cmd = NULL;
-    sds jsonrpc = NULL;
+    //websocket clients need the jsonrpc id to assign the responses
     int request_id = 0;
-
-    if (json_get_string_cmp(body, "$.jsonrpc", 3, 3, "2.0", &jsonrpc, NULL) == false ||
-        json_get_string_max(body, "$.method", &cmd, vcb_isalnum, NULL) == false ||
-        json_get_int(body, "$.id", 0, 0, &request_id, NULL) == false)
-    {
-        MYMPD_LOG_ERROR("Invalid jsonrpc2 request");
-        FREE_SDS(cmd);
-        FREE_SDS(jsonrpc);
-        return false;
-    }
-
-    MYMPD_LOG_INFO("API request (%lld): %s", (long long)nc->id, cmd);
-
-    enum mympd_cmd_ids cmd_id = get_cmd_id(cmd);
+    enum mympd_cmd_ids cmd_id = get_api_method(body, (nc->is_websocket == 1 ? JSONRPC_INT_MAX : 0), &request_id);
     if (cmd_id == GENERAL_API_UNKNOWN) {
-        MYMPD_LOG_ERROR("Unknown API method");
-        FREE_SDS(cmd);
-        FREE_SDS(jsonrpc);
         return false;
     }
-
-    if (is_public_api_method(cmd_id) == false) {
-        MYMPD_LOG_ERROR("API method %s is for internal use only", cmd);
-        FREE_SDS(cmd);
-        FREE_SDS(jsonrpc);
+    if (nc->is_websocket == 1 &&
+        is_webserver_api_method(cmd_id) == true)
+    {
+        MYMPD_LOG_ERROR("API method %s is not supported over the websocket", get_cmd_id_method_name(cmd_id));
         return false;
     }
 
+    MYMPD_LOG_INFO("API request (%lld): %s", (long long)nc->id, get_cmd_id_method_name(cmd_id));
+
     sds session = sdsempty();
-    #ifdef ENABLE_SSL
-    if (sdslen(mg_user_data->config->pin_hash) > 0 &&
-        is_protected_api_method(cmd_id) == true)
-    {
-        bool rc = false;
-        if (auth_header != NULL &&
-            auth_header->len == 20)
-        {
-            session = sdscatlen(session, auth_header->ptr, auth_header->len);
-            rc = webserver_session_validate(&mg_user_data->session_list, session);
-        }
-        else {
-            MYMPD_LOG_ERROR("No valid Authorization header found");
-        }
-        if (rc == false) {
-            MYMPD_LOG_ERROR("API method %s is protected", cmd);
-            sds response = jsonrpc_respond_message(sdsempty(), cmd_id, 0,
-                JSONRPC_FACILITY_SESSION, JSONRPC_SEVERITY_ERROR,
-                (cmd_id == MYMPD_API_SESSION_VALIDATE ? "Invalid session" : "Authentication required"));
-            mg_printf(nc, "HTTP/1.1 403 Forbidden\r\n"
-                "Content-Type: application/json\r\n"
-                "Content-Length: %d\r\n\r\n",
-                (int)sdslen(response));
-            mg_send(nc, response, sdslen(response));
-            FREE_SDS(cmd);
-            FREE_SDS(jsonrpc);
-            FREE_SDS(session);
-            FREE_SDS(response);
-            return true;
-        }
-        MYMPD_LOG_INFO("API request is authorized");
+    if (check_api_auth(nc, cmd_id, request_id, auth_header, mg_user_data, &session) == false) {
+        FREE_SDS(session);
+        return true;
     }
-    #else
-    (void) auth_header;
-    #endif
     switch(cmd_id) {
         case MYMPD_API_SESSION_LOGIN:
         case MYMPD_API_SESSION_LOGOUT:
@@ -120,12 +96,12 @@ bool request_handler_api(struct mg_connection *nc, sds body, struct mg_str *auth
         default: {
             //forward API request to mympd_api_handler
             struct t_work_request *request = create_request((long long)nc->id, request_id, cmd_id, body);
+            //http responses can be sent with chunked transfer encoding
+            request->stream = nc->is_websocket == 0;
             mympd_queue_push(mympd_api_queue, request, 0);
         }
     }
     FREE_SDS(session);
-    FREE_SDS(cmd);
-    FREE_SDS(jsonrpc);
     return true;
 }
 
@@ -262,8 +238,9 @@ void request_handler_proxy(struct mg_connection *nc, struct mg_http_message *hm,
 /**
  * Request handler for /api/serverinfo
  * @param nc mongoose connection
+ * @param mg_user_data webserver configuration
  */
-void request_handler_serverinfo(struct mg_connection *nc) {
+void request_handler_serverinfo(struct mg_connection *nc, struct t_mg_user_data *mg_user_data) {
     struct sockaddr_storage localip;
     socklen_t len = sizeof(localip);
     if (getsockname((int)(long)nc->fd, (struct sockaddr *)(&localip), &len) == 0) {
@@ -279,6 +256,12 @@ void request_handler_serverinfo(struct mg_connection *nc) {
             MYMPD_LOG_ERROR("Could not convert peer ip to string");
             response = tojson_char_len(response, "ip", "", 0, false);
         }
+        response = sdscat(response, ",\"albumartCache\":");
+        response = albumart_cache_stats(response, &mg_user_data->albumart_cache);
+        response = sdscat(response, ",\"covercache\":");
+        response = covercache_stats(response);
+        response = sdscat(response, ",\"compression\":");
+        response = compress_stats(response, &mg_user_data->compress);
         response = jsonrpc_end(response);
         webserver_send_data(nc, response, sdslen(response), "Content-Type: application/json\r\n");
         FREE_SDS(response);
@@ -317,3 +300,165 @@ void request_handler_ca(struct mg_connection *nc, struct mg_http_message *hm,
     }
 }
 #endif
+
+/**
+ * Private functions
+ */
+
+/**
+ * Handles a jsonrpc batch request.
+ * All requests are forwarded in one work request to the mympd_api thread,
+ * they are executed in order and the responses are returned as one array.
+ * @param nc mongoose connection
+ * @param body http body (jsonrpc batch request)
+ * @param auth_header Authentication header (myMPD session)
+ * @param mg_user_data webserver configuration
+ * @return true on success, else false
+ */
+static bool request_handler_api_batch(struct mg_connection *nc, sds body, struct mg_str *auth_header,
+        struct t_mg_user_data *mg_user_data)
+{
+    struct t_list *batch = list_new();
+    sds error = sdsempty();
+    if (json_get_array_object(body, "$", batch, JSONRPC_BATCH_MAX, &error) == false ||
+        batch->length == 0)
+    {
+        MYMPD_LOG_ERROR("Invalid jsonrpc2 batch request: %s", error);
+        list_free(batch);
+        FREE_SDS(error);
+        return false;
+    }
+    FREE_SDS(error);
+
+    MYMPD_LOG_INFO("API batch request (%lld): %ld requests", (long long)nc->id, batch->length);
+
+    struct t_work_request *request = create_request((long long)nc->id, 0, INTERNAL_API_BATCH, body);
+    struct t_list *requests = list_new();
+    request->extra = requests;
+    bool authenticated = false;
+    struct t_list_node *current = batch->head;
+    while (current != NULL) {
+        int request_id = 0;
+        enum mympd_cmd_ids cmd_id = get_api_method(current->key, JSONRPC_INT_MAX, &request_id);
+        if (cmd_id == GENERAL_API_UNKNOWN ||
+            is_batch_api_method(cmd_id) == false)
+        {
+            MYMPD_LOG_ERROR("API method %s can not be used in a batch request", get_cmd_id_method_name(cmd_id));
+            free_request(request);
+            list_free(batch);
+            return false;
+        }
+        if (authenticated == false &&
+            is_protected_api_method(cmd_id) == true)
+        {
+            //validate the session only once for the whole batch
+            sds session = sdsempty();
+            authenticated = check_api_auth(nc, cmd_id, request_id, auth_header, mg_user_data, &session);
+            FREE_SDS(session);
+            if (authenticated == false) {
+                free_request(request);
+                list_free(batch);
+                return true;
+            }
+        }
+        struct t_work_request *batch_request = create_request(-1, request_id, cmd_id, current->key);
+        list_push(requests, "", 0, NULL, batch_request);
+        current = current->next;
+    }
+    list_free(batch);
+    mympd_queue_push(mympd_api_queue, request, 0);
+    return true;
+}
+
+/**
+ * Validates the jsonrpc envelope of an api request
+ * @param request jsonrpc request
+ * @param request_id_max maximum value for the jsonrpc id
+ * @param request_id pointer to int to set the jsonrpc id
+ * @return the myMPD API method or GENERAL_API_UNKNOWN on error
+ */
+static enum mympd_cmd_ids get_api_method(sds request, int request_id_max, int *request_id) {
+    sds cmd = NULL;
+    sds jsonrpc = NULL;
+    if (json_get_string_cmp(request, "$.jsonrpc", 3, 3, "2.0", &jsonrpc, NULL) == false ||
+        json_get_string_max(request, "$.method", &cmd, vcb_isalnum, NULL) == false ||
+        json_get_int(request, "$.id", 0, request_id_max, request_id, NULL) == false)
+    {
+        MYMPD_LOG_ERROR("Invalid jsonrpc2 request");
+        FREE_SDS(cmd);
+        FREE_SDS(jsonrpc);
+        return GENERAL_API_UNKNOWN;
+    }
+    FREE_SDS(jsonrpc);
+
+    enum mympd_cmd_ids cmd_id = get_cmd_id(cmd);
+    if (cmd_id == GENERAL_API_UNKNOWN) {
+        MYMPD_LOG_ERROR("Unknown API method");
+    }
+    else if (is_public_api_method(cmd_id) == false) {
+        MYMPD_LOG_ERROR("API method %s is for internal use only", cmd);
+        cmd_id = GENERAL_API_UNKNOWN;
+    }
+    FREE_SDS(cmd);
+    return cmd_id;
+}
+
+/**
+ * Checks the authentication for protected api methods,
+ * sends a 403 response or websocket message if authentication fails
+ * @param nc mongoose connection
+ * @param cmd_id myMPD API method
+ * @param request_id jsonrpc id of the request, echoed in the error response
+ * @param auth_header Authentication header (myMPD session)
+ * @param mg_user_data webserver configuration
+ * @param session pointer to already allocated sds string to set the session
+ * @return true if request is authorized, else false
+ */
+static bool check_api_auth(struct mg_connection *nc, enum mympd_cmd_ids cmd_id, long request_id,
+        struct mg_str *auth_header, struct t_mg_user_data *mg_user_data, sds *session)
+{
+    #ifdef ENABLE_SSL
+    if (sdslen(mg_user_data->config->pin_hash) > 0 &&
+        is_protected_api_method(cmd_id) == true)
+    {
+        bool rc = false;
+        if (auth_header != NULL &&
+            auth_header->len == 20)
+        {
+            *session = sdscatlen(*session, auth_header->ptr, auth_header->len);
+            rc = webserver_session_validate(&mg_user_data->session_list, *session);
+        }
+        else {
+            MYMPD_LOG_ERROR("No valid Authorization header found");
+        }
+        if (rc == false) {
+            MYMPD_LOG_ERROR("API method %s is protected", get_cmd_id_method_name(cmd_id));
+            sds response = jsonrpc_respond_message(sdsempty(), cmd_id, request_id,
+                JSONRPC_FACILITY_SESSION, JSONRPC_SEVERITY_ERROR,
+                (cmd_id == MYMPD_API_SESSION_VALIDATE ? "Invalid session" : "Authentication required"));
+            if (nc->is_websocket == 1) {
+                mg_ws_send(nc, response, sdslen(response), WEBSOCKET_OP_TEXT);
+            }
+            else {
+                mg_printf(nc, "HTTP/1.1 403 Forbidden\r\n"
+                    "Content-Type: application/json\r\n"
+                    EXTRA_HEADER_VARY_ENCODING
+                    "Content-Length: %d\r\n\r\n",
+                    (int)sdslen(response));
+                mg_send(nc, response, sdslen(response));
+            }
+            FREE_SDS(response);
+            return false;
+        }
+        MYMPD_LOG_INFO("API request is authorized");
+    }
+    #else
+    (void) nc;
+    (void) cmd_id;
+    (void) request_id;
+    (void) auth_header;
+    (void) mg_user_data;
+    (void) session;
+    #endif
+    return true;
+}
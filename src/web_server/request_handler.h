@@ -18,7 +18,7 @@ void request_handler_browse(struct mg_connection *nc, struct mg_http_message *hm
         struct t_mg_user_data *mg_user_data);
 void request_handler_proxy(struct mg_connection *nc, struct mg_http_message *hm,
         struct mg_connection *backend_nc);
-void request_handler_serverinfo(struct mg_connection *nc);
+void request_handler_serverinfo(struct mg_connection *nc, struct t_mg_user_data *mg_user_data);
 
 #ifdef ENABLE_SSL
 void request_handler_ca(struct mg_connection *nc, struct mg_http_message *hm,
@@ -10,6 +10,7 @@
 #include "../lib/log.h"
 #include "../lib/mimetype.h"
 #include "../lib/sds_extras.h"
+#include "../lib/utility.h"
 #include "../lib/validate.h"
 
 /**
@@ -45,7 +46,7 @@ bool request_handler_tagart(struct mg_connection *nc, struct mg_http_message *hm
     //create absolute file
     sds mediafile = sdscatfmt(sdsempty(), "%S/pics/%S", config->workdir, uri_decoded);
     MYMPD_LOG_DEBUG("Absolut media_file: %s", mediafile);
-    mediafile = webserver_find_image_file(mediafile);
+    mediafile = find_image_file(mediafile);
     if (sdslen(mediafile) > 0) {
         const char *mime_type = get_mime_type_by_ext(mediafile);
         MYMPD_LOG_DEBUG("Serving file %s (%s)", mediafile, mime_type);
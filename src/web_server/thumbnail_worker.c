@@ -0,0 +1,272 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "thumbnail_worker.h"
+
+#include "../../dist/rax/rax.h"
+#include "../lib/api.h"
+#include "../lib/covercache.h"
+#include "../lib/filehandler.h"
+#include "../lib/log.h"
+#include "../lib/mem.h"
+#include "../lib/msg_queue.h"
+#include "../lib/sds_extras.h"
+#include "../lib/thumbnail.h"
+
+#include <pthread.h>
+#include <sys/prctl.h>
+
+/**
+ * The thumbnail worker decodes, scales and encodes the coverimages outside
+ * of the mongoose event loop. The result is sent back to the webserver thread
+ * as internal message with the cmd_id INTERNAL_API_ALBUMART.
+ */
+
+/**
+ * Privat definitions
+ */
+
+/**
+ * A queued thumbnail job
+ */
+struct t_thumbnail_job {
+    sds cache_key;                  //!< albumart cache key of the thumbnail request
+    sds uri;                        //!< song uri
+    int offset;                     //!< number of the coverimage
+    sds binary;                     //!< the original image or NULL to read filepath
+    sds filepath;                   //!< image file to read or NULL
+    struct t_thumbnail_job *next;   //!< next job
+};
+
+/**
+ * State of the thumbnail worker
+ */
+struct t_thumbnail_worker {
+    pthread_t thread;               //!< the worker thread
+    bool running;                   //!< true if the thread was started
+    bool stop;                      //!< true to stop the thread
+    pthread_mutex_t mutex;          //!< protects the job list and stop
+    pthread_cond_t wakeup;          //!< signals new jobs and stop
+    struct t_thumbnail_job *head;   //!< first job
+    struct t_thumbnail_job *tail;   //!< last job
+    long length;                    //!< number of queued jobs
+    rax *pending;                   //!< cache keys of unfinished jobs, accessed only by the webserver thread
+    struct t_config *config;        //!< pointer to myMPD config
+};
+
+static struct t_thumbnail_worker worker;
+
+static void *thumbnail_worker_run(void *arg);
+static void thumbnail_worker_create(struct t_thumbnail_job *job);
+static void job_free(struct t_thumbnail_job *job);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Starts the thumbnail worker thread, called from the webserver init
+ * @param config pointer to myMPD config
+ * @return true on success, else false
+ */
+bool thumbnail_worker_start(struct t_config *config) {
+    worker.config = config;
+    worker.stop = false;
+    worker.head = NULL;
+    worker.tail = NULL;
+    worker.length = 0;
+    worker.pending = raxNew();
+    pthread_mutex_init(&worker.mutex, NULL);
+    pthread_cond_init(&worker.wakeup, NULL);
+    if (pthread_create(&worker.thread, NULL, thumbnail_worker_run, NULL) != 0) {
+        MYMPD_LOG_ERROR("Can not create thumbnail worker thread");
+        worker.running = false;
+        return false;
+    }
+    worker.running = true;
+    return true;
+}
+
+/**
+ * Stops the thumbnail worker thread and discards the queued jobs,
+ * called from the webserver thread before it exits
+ */
+void thumbnail_worker_stop(void) {
+    if (worker.pending == NULL) {
+        //not started
+        return;
+    }
+    if (worker.running == true) {
+        pthread_mutex_lock(&worker.mutex);
+        worker.stop = true;
+        pthread_cond_signal(&worker.wakeup);
+        pthread_mutex_unlock(&worker.mutex);
+        pthread_join(worker.thread, NULL);
+        worker.running = false;
+    }
+    while (worker.head != NULL) {
+        struct t_thumbnail_job *job = worker.head;
+        worker.head = job->next;
+        job_free(job);
+    }
+    worker.tail = NULL;
+    worker.length = 0;
+    raxFree(worker.pending);
+    worker.pending = NULL;
+    pthread_mutex_destroy(&worker.mutex);
+    pthread_cond_destroy(&worker.wakeup);
+}
+
+/**
+ * Queues a thumbnail job, called from the webserver thread.
+ * Only one job per cache key is queued.
+ * @param cache_key albumart cache key of the thumbnail request
+ * @param uri song uri
+ * @param offset number of the coverimage
+ * @param binary the original image (copied) or NULL
+ * @param filepath image file to read (copied) or NULL
+ * @return true if a job for the cache key is queued, else false
+ */
+bool thumbnail_worker_push(sds cache_key, const char *uri, int offset, sds binary, sds filepath) {
+    if (worker.running == false) {
+        return false;
+    }
+    if (raxFind(worker.pending, (unsigned char *)cache_key, sdslen(cache_key)) != raxNotFound) {
+        return true;
+    }
+    pthread_mutex_lock(&worker.mutex);
+    if (worker.length >= THUMBNAIL_QUEUE_MAX) {
+        pthread_mutex_unlock(&worker.mutex);
+        MYMPD_LOG_DEBUG("Thumbnail queue is full, skipping \"%s\"", uri);
+        return false;
+    }
+    struct t_thumbnail_job *job = malloc_assert(sizeof(struct t_thumbnail_job));
+    job->cache_key = sdsdup(cache_key);
+    job->uri = sdsnew(uri);
+    job->offset = offset;
+    job->binary = binary != NULL ? sdsdup(binary) : NULL;
+    job->filepath = filepath != NULL ? sdsdup(filepath) : NULL;
+    job->next = NULL;
+    if (worker.tail == NULL) {
+        worker.head = job;
+    }
+    else {
+        worker.tail->next = job;
+    }
+    worker.tail = job;
+    worker.length++;
+    pthread_cond_signal(&worker.wakeup);
+    pthread_mutex_unlock(&worker.mutex);
+    raxInsert(worker.pending, (unsigned char *)cache_key, sdslen(cache_key), NULL, NULL);
+    return true;
+}
+
+/**
+ * Marks the job for the cache key as finished,
+ * called from the webserver thread on receiving the result
+ * @param cache_key albumart cache key of the thumbnail request
+ */
+void thumbnail_worker_done(sds cache_key) {
+    if (worker.pending != NULL) {
+        raxRemove(worker.pending, (unsigned char *)cache_key, sdslen(cache_key), NULL);
+    }
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Main function of the thumbnail worker thread
+ * @param arg not used
+ * @return NULL
+ */
+static void *thumbnail_worker_run(void *arg) {
+    (void)arg;
+    thread_logname = sds_replace(thread_logname, "thumbnails");
+    prctl(PR_SET_NAME, thread_logname, 0, 0, 0);
+    while (true) {
+        pthread_mutex_lock(&worker.mutex);
+        while (worker.head == NULL &&
+            worker.stop == false)
+        {
+            pthread_cond_wait(&worker.wakeup, &worker.mutex);
+        }
+        if (worker.stop == true) {
+            pthread_mutex_unlock(&worker.mutex);
+            break;
+        }
+        struct t_thumbnail_job *job = worker.head;
+        worker.head = job->next;
+        if (worker.head == NULL) {
+            worker.tail = NULL;
+        }
+        worker.length--;
+        pthread_mutex_unlock(&worker.mutex);
+        thumbnail_worker_create(job);
+        job_free(job);
+    }
+    FREE_SDS(thread_logname);
+    return NULL;
+}
+
+/**
+ * Creates the thumbnail, saves it in the covercache and sends it to the webserver.
+ * An empty result is sent, if the image could not be decoded or the thumbnail is not smaller.
+ * @param job the job
+ */
+static void thumbnail_worker_create(struct t_thumbnail_job *job) {
+    struct t_config *config = worker.config;
+    bool covercache = config->covercache_keep_days > 0 ? true : false;
+    sds thumbnail = sdsempty();
+    bool done = false;
+    if (covercache == true) {
+        //a previous job could have finished it already
+        sds thumbfile = covercache_get_file(config->cachedir, job->uri, job->offset, config->thumbnail_size, sdsempty());
+        if (sdslen(thumbfile) > 0) {
+            done = read_data_from_file(&thumbnail, thumbfile, MPD_BINARY_SIZE_MAX);
+        }
+        else {
+            done = covercache_thumbnail_skipped(config->cachedir, job->uri, job->offset, config->thumbnail_size);
+        }
+        FREE_SDS(thumbfile);
+    }
+    if (done == false) {
+        if (job->binary == NULL) {
+            job->binary = sdsempty();
+            if (read_data_from_file(&job->binary, job->filepath, MPD_BINARY_SIZE_MAX) == false) {
+                sdsclear(job->binary);
+            }
+        }
+        if (thumbnail_create(job->binary, sdslen(job->binary), config->thumbnail_size, config->thumbnail_quality, &thumbnail) == false) {
+            //remember that the original image should be served
+            sdsclear(thumbnail);
+        }
+        if (covercache == true &&
+            sdslen(job->binary) > 0)
+        {
+            covercache_write_thumbnail(config->cachedir, job->uri, thumbnail, job->offset, config->thumbnail_size);
+        }
+    }
+    struct t_work_response *response = create_response_new(-1, 0, INTERNAL_API_ALBUMART);
+    response->data = sds_replace(response->data, job->cache_key);
+    FREE_SDS(response->binary);
+    response->binary = thumbnail;
+    mympd_queue_push(web_server_queue, response, 0);
+}
+
+/**
+ * Frees a thumbnail job
+ * @param job the job to free
+ */
+static void job_free(struct t_thumbnail_job *job) {
+    FREE_SDS(job->cache_key);
+    FREE_SDS(job->uri);
+    FREE_SDS(job->binary);
+    FREE_SDS(job->filepath);
+    FREE_PTR(job);
+}
@@ -0,0 +1,19 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_WEB_SERVER_THUMBNAIL_WORKER_H
+#define MYMPD_WEB_SERVER_THUMBNAIL_WORKER_H
+
+#include "../../dist/sds/sds.h"
+#include "../lib/config_def.h"
+
+#include <stdbool.h>
+
+bool thumbnail_worker_start(struct t_config *config);
+void thumbnail_worker_stop(void);
+bool thumbnail_worker_push(sds cache_key, const char *uri, int offset, sds binary, sds filepath);
+void thumbnail_worker_done(sds cache_key);
+#endif
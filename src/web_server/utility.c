@@ -11,6 +11,7 @@
 #include "../lib/mem.h"
 #include "../lib/mimetype.h"
 #include "../lib/sds_extras.h"
+#include "../lib/utility.h"
 
 #ifdef EMBEDDED_ASSETS
 //embedded files for release build
@@ -33,6 +34,9 @@ void *mg_user_data_free(struct t_mg_user_data *mg_user_data) {
     sdsfreesplitres(mg_user_data->thumbnail_names, mg_user_data->thumbnail_names_len);
     FREE_SDS(mg_user_data->stream_uri);
     list_clear(&mg_user_data->session_list);
+    albumart_cache_free(&mg_user_data->albumart_cache);
+    dir_cache_free(&mg_user_data->dir_cache);
+    compress_free(&mg_user_data->compress);
     FREE_PTR(mg_user_data);
     return NULL;
 }
@@ -61,25 +65,19 @@ struct mg_str mg_str_strip_parent(struct mg_str *path, int count) {
 }
 
 /**
- * Image file extensions to detect
- */
-static const char *image_file_extensions[] = {
-    "webp", "jpg", "jpeg", "png", "svg", "avif",
-    "WEBP", "JPG", "JPEG", "PNG", "SVG", "AVIF",
-    NULL};
-
-/**
- * Finds the first image with basefilename by trying out extentions
+ * Finds the first image with basefilename by trying out extentions,
+ * uses the directory cache instead of probing the filesystem
+ * @param dir_cache pointer to the directory cache
  * @param basefilename basefilename to append extensions
  * @return pointer to basefilename
  */
-sds webserver_find_image_file(sds basefilename) {
-    MYMPD_LOG_DEBUG("Searching image file for basename \"%s\"", basefilename);
+sds webserver_find_image_file_cached(struct t_dir_cache *dir_cache, sds basefilename) {
+    MYMPD_LOG_DEBUG("Searching image file for basename \"%s\" in directory cache", basefilename);
     const char **p = image_file_extensions;
     sds testfilename = sdsempty();
     while (*p != NULL) {
         testfilename = sdscatfmt(testfilename, "%S.%s", basefilename, *p);
-        if (access(testfilename, F_OK) == 0) { /* Flawfinder: ignore */
+        if (dir_cache_file_exists(dir_cache, testfilename) == true) {
             break;
         }
         sdsclear(testfilename);
@@ -140,6 +138,38 @@ void webserver_send_data(struct mg_connection *nc, const char *data, size_t len,
     webserver_handle_connection_close(nc);
 }
 
+/**
+ * Sends data gzip compressed, if the client accepts it and the data is large enough.
+ * The Vary header is always sent, uncompressed responses are cacheable only for the same encoding.
+ * @param nc mongoose connection
+ * @param data data to send
+ * @param len length of the data to send
+ * @param headers extra headers to add
+ */
+void webserver_send_data_compressed(struct mg_connection *nc, const char *data, size_t len, const char *headers) {
+    //label[4] is set if the client accepts gzip encoding
+    if (nc->label[4] == 'Z' &&
+        len >= HTTP_COMPRESS_MIN_SIZE)
+    {
+        struct t_mg_user_data *mg_user_data = (struct t_mg_user_data *) nc->mgr->userdata;
+        sds compressed = sdsempty();
+        if (compress_gzip(&mg_user_data->compress, data, len, &compressed) == true) {
+            MYMPD_LOG_DEBUG("Sending %lu bytes (compressed from %lu bytes) to %lu", (unsigned long)sdslen(compressed), (unsigned long)len, nc->id);
+            sds extra_headers = sdscatfmt(sdsempty(), "%s"EXTRA_HEADER_CONTENT_ENCODING EXTRA_HEADER_VARY_ENCODING, headers);
+            webserver_send_header_ok(nc, sdslen(compressed), extra_headers);
+            mg_send(nc, compressed, sdslen(compressed));
+            webserver_handle_connection_close(nc);
+            FREE_SDS(extra_headers);
+            FREE_SDS(compressed);
+            return;
+        }
+        FREE_SDS(compressed);
+    }
+    sds extra_headers = sdscatfmt(sdsempty(), "%s"EXTRA_HEADER_VARY_ENCODING, headers);
+    webserver_send_data(nc, data, len, extra_headers);
+    FREE_SDS(extra_headers);
+}
+
 /**
  * Sends a 301 moved permamently header
  * @param nc mongoose connection
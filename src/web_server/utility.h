@@ -9,8 +9,11 @@
 
 #include "../../dist/mongoose/mongoose.h"
 #include "../../dist/sds/sds.h"
+#include "../lib/compress.h"
 #include "../lib/config_def.h"
 #include "../lib/list.h"
+#include "albumart_cache.h"
+#include "dir_cache.h"
 
 #include <stdbool.h>
 
@@ -31,12 +34,15 @@ struct t_mg_user_data {
     int connection_count;        //!< number of http connections
     sds stream_uri;              //!< uri for the mpd stream reverse proxy
     struct t_list session_list;  //!< list of myMPD sessions (pin protection mode)
+    struct t_albumart_cache albumart_cache;  //!< in-memory albumart cache
+    struct t_dir_cache dir_cache;            //!< directory listing cache for cover file discovery
+    struct t_compress compress;              //!< gzip context for api responses
 };
 
 #ifdef EMBEDDED_ASSETS
 bool webserver_serve_embedded_files(struct mg_connection *nc, sds uri);
 #endif
-sds webserver_find_image_file(sds basefilename);
+sds webserver_find_image_file_cached(struct t_dir_cache *dir_cache, sds basefilename);
 void webserver_send_error(struct mg_connection *nc, int code, const char *msg);
 void webserver_serve_na_image(struct mg_connection *nc);
 void webserver_serve_stream_image(struct mg_connection *nc);
@@ -44,6 +50,7 @@ void webserver_send_header_ok(struct mg_connection *nc, size_t len, const char *
 void webserver_send_header_redirect(struct mg_connection *nc, const char *location);
 void webserver_send_header_found(struct mg_connection *nc, const char *location);
 void webserver_send_data(struct mg_connection *nc, const char *data, size_t len, const char *headers);
+void webserver_send_data_compressed(struct mg_connection *nc, const char *data, size_t len, const char *headers);
 void webserver_handle_connection_close(struct mg_connection *nc);
 struct mg_str mg_str_strip_parent(struct mg_str *path, int count);
 void *mg_user_data_free(struct t_mg_user_data *mg_user_data);
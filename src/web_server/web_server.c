@@ -13,6 +13,7 @@
 #include "../lib/log.h"
 #include "../lib/mem.h"
 #include "../lib/pin.h"
+#include "../lib/response_stream.h"
 #include "../lib/sds_extras.h"
 #include "../lib/utility.h"
 #include "../lib/validate.h"
@@ -20,7 +21,9 @@
 #include "proxy.h"
 #include "request_handler.h"
 #include "tagart.h"
+#include "thumbnail_worker.h"
 
+#include <string.h>
 #include <sys/prctl.h>
 
 /**
@@ -35,6 +38,15 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *fn
 static void send_ws_notify(struct mg_mgr *mgr, struct t_work_response *response);
 static void send_api_response(struct mg_mgr *mgr, struct t_work_response *response);
 static bool check_acl(struct mg_connection *nc, sds acl);
+static size_t stream_unsent_get(struct mg_connection *nc);
+static void stream_unsent_set(struct mg_connection *nc, size_t len);
+static void stream_unsent_release(struct mg_connection *nc, size_t written);
+static struct t_compress_stream *stream_deflate_get(struct mg_connection *nc);
+static void stream_deflate_set(struct mg_connection *nc, struct t_compress_stream *deflate_stream);
+static size_t stream_write_chunk(struct mg_connection *nc, struct t_compress *compress, sds data, bool finish);
+
+#define LABEL_STREAM_UNSENT 8 //offset of the unsent chunk bytes in nc->label
+#define LABEL_STREAM_DEFLATE 16 //offset of the deflate stream of a chunked response in nc->label
 
 /**
  * Public functions
@@ -64,6 +76,14 @@ bool web_server_init(struct mg_mgr *mgr, struct t_config *config, struct t_mg_us
     mg_user_data->connection_count = 0;
     mg_user_data->stream_uri = sdsnew("http://localhost:8000");
     list_init(&mg_user_data->session_list);
+    albumart_cache_init(&mg_user_data->albumart_cache, (size_t)config->albumart_cache_size * 1024 * 1024);
+    dir_cache_init(&mg_user_data->dir_cache);
+    compress_init(&mg_user_data->compress, HTTP_COMPRESS_LEVEL);
+    #ifdef ENABLE_THUMBNAILS
+    if (config->thumbnail_size > 0) {
+        thumbnail_worker_start(config);
+    }
+    #endif
 
     //init monogoose mgr
     mg_mgr_init(mgr);
@@ -147,6 +167,8 @@ void *web_server_loop(void *arg_mgr) {
 
     sds last_notify = sdsempty();
     time_t last_time = 0;
+    sds update_database_event = jsonrpc_event(sdsempty(), JSONRPC_EVENT_UPDATE_DATABASE);
+    sds update_covercache_event = jsonrpc_event(sdsempty(), JSONRPC_EVENT_UPDATE_COVERCACHE);
     while (s_signal_received == 0) {
         struct t_work_response *response = mympd_queue_shift(web_server_queue, 50, 0);
         if (response != NULL) {
@@ -157,6 +179,15 @@ void *web_server_loop(void *arg_mgr) {
             }
             else if (response->conn_id == 0) {
                 MYMPD_LOG_DEBUG("Got websocket notify");
+                if (strcmp(response->data, update_database_event) == 0) {
+                    //covers could have changed
+                    albumart_cache_clear(&mg_user_data->albumart_cache);
+                    dir_cache_clear(&mg_user_data->dir_cache);
+                }
+                else if (strcmp(response->data, update_covercache_event) == 0) {
+                    //forget the negative lookups
+                    albumart_cache_clear(&mg_user_data->albumart_cache);
+                }
                 //websocket notify from mpd idle
                 time_t now = time(NULL);
                 if (strcmp(response->data, last_notify) != 0 ||
@@ -180,8 +211,11 @@ void *web_server_loop(void *arg_mgr) {
         //webserver polling
         mg_mgr_poll(mgr, 50);
     }
+    thumbnail_worker_stop();
     FREE_SDS(thread_logname);
     FREE_SDS(last_notify);
+    FREE_SDS(update_database_event);
+    FREE_SDS(update_covercache_event);
     return NULL;
 }
 
@@ -190,15 +224,21 @@ void *web_server_loop(void *arg_mgr) {
  */
 
 /**
- * Sets the mg_user_data values from set_mg_user_data_request.
- * Message is sent by the feature detection function in the mympd_api thread.
- * @param response 
+ * Handles internal messages.
+ * INTERNAL_API_ALBUMART is sent by the thumbnail worker with a created thumbnail,
+ * the other messages set the mg_user_data values from set_mg_user_data_request.
+ * This message is sent by the feature detection function in the mympd_api thread.
+ * @param response the internal message
  * @param mg_user_data t_mg_user_data to configure
  * @return true on success, else false
  */
 static bool parse_internal_message(struct t_work_response *response, struct t_mg_user_data *mg_user_data) {
     bool rc = false;
-    if (response->extra != NULL) {
+    if (response->cmd_id == INTERNAL_API_ALBUMART) {
+        webserver_albumart_thumbnail_done(mg_user_data, response->data, response->binary);
+        rc = true;
+    }
+    else if (response->extra != NULL) {
         struct set_mg_user_data_request *new_mg_user_data = (struct set_mg_user_data_request *)response->extra;
         struct t_config *config = mg_user_data->config;
 
@@ -238,6 +278,10 @@ static bool parse_internal_message(struct t_work_response *response, struct t_mg
 
         mg_user_data->feat_albumart = new_mg_user_data->feat_albumart;
 
+        //cached albumart lookups depend on the settings above
+        albumart_cache_clear(&mg_user_data->albumart_cache);
+        dir_cache_clear(&mg_user_data->dir_cache);
+
         sdsclear(mg_user_data->stream_uri);
         if (new_mg_user_data->mpd_stream_port != 0) {
             mg_user_data->stream_uri = sdscatfmt(mg_user_data->stream_uri, "http://%s:%u",
@@ -290,20 +334,74 @@ static void send_ws_notify(struct mg_mgr *mgr, struct t_work_response *response)
  * @param response jsonrpc response
  */
 static void send_api_response(struct mg_mgr *mgr, struct t_work_response *response) {
+    struct t_mg_user_data *mg_user_data = (struct t_mg_user_data *) mgr->userdata;
     struct mg_connection *nc = mgr->conns;
+    bool chunk_queued = false;
     while (nc != NULL) {
-        if ((int)nc->is_websocket == 0 && nc->id == (long unsigned)response->conn_id) {
-            if (response->cmd_id == INTERNAL_API_ALBUMART) {
+        if (nc->id == (long unsigned)response->conn_id) {
+            if ((int)nc->is_websocket == 1) {
+                MYMPD_LOG_DEBUG("Sending websocket response to conn_id %lu (length: %lu): %s", nc->id, (unsigned long)sdslen(response->data), response->data);
+                mg_ws_send(nc, response->data, sdslen(response->data), WEBSOCKET_OP_TEXT);
+            }
+            else if (response->cmd_id == INTERNAL_API_ALBUMART) {
                 webserver_send_albumart(nc, response->data, response->binary);
             }
+            else if (response->cmd_id == INTERNAL_API_STREAM_CHUNK) {
+                //label[5] is set after the header for chunked transfer encoding was sent
+                if (nc->label[5] != 'S') {
+                    //label[4] is set if the client accepts gzip encoding
+                    struct t_compress_stream *deflate_stream = nc->label[4] == 'Z'
+                        ? compress_stream_new(HTTP_COMPRESS_LEVEL)
+                        : NULL;
+                    stream_deflate_set(nc, deflate_stream);
+                    mg_printf(nc, "HTTP/1.1 200 OK\r\n"
+                        "Content-Type: application/json\r\n"
+                        "%s"
+                        EXTRA_HEADER_VARY_ENCODING
+                        "Transfer-Encoding: chunked\r\n\r\n",
+                        (deflate_stream != NULL ? EXTRA_HEADER_CONTENT_ENCODING : ""));
+                    nc->label[5] = 'S';
+                }
+                MYMPD_LOG_DEBUG("Sending chunk to conn_id %lu (length: %lu)", nc->id, (unsigned long)sdslen(response->data));
+                size_t written = stream_write_chunk(nc, &mg_user_data->compress, response->data, false);
+                //the chunk is accounted until it is written to the socket
+                stream_unsent_set(nc, stream_unsent_get(nc) + written);
+                if (written < sdslen(response->data)) {
+                    //release the bytes saved by compression
+                    response_stream_chunk_sent(response->conn_id, sdslen(response->data) - written);
+                }
+                chunk_queued = true;
+            }
+            else if (response->cmd_id == INTERNAL_API_STREAM_ABORT) {
+                MYMPD_LOG_ERROR("Aborting chunked response for conn_id %lu", nc->id);
+                compress_stream_free(stream_deflate_get(nc));
+                stream_deflate_set(nc, NULL);
+                nc->is_draining = 1;
+            }
+            else if (nc->label[5] == 'S') {
+                //last chunk of a chunked response
+                MYMPD_LOG_DEBUG("Sending last chunk to conn_id %lu (length: %lu)", nc->id, (unsigned long)sdslen(response->data));
+                stream_write_chunk(nc, &mg_user_data->compress, response->data, true);
+                mg_http_write_chunk(nc, "", 0);
+                compress_stream_free(stream_deflate_get(nc));
+                stream_deflate_set(nc, NULL);
+                nc->label[5] = '-';
+                webserver_handle_connection_close(nc);
+            }
             else {
                 MYMPD_LOG_DEBUG("Sending response to conn_id %lu (length: %lu): %s", nc->id, (unsigned long)sdslen(response->data), response->data);
-                webserver_send_data(nc, response->data, sdslen(response->data), "Content-Type: application/json\r\n");
+                webserver_send_data_compressed(nc, response->data, sdslen(response->data), "Content-Type: application/json\r\n");
             }
             break;
         }
         nc = nc->next;
     }
+    if (response->cmd_id == INTERNAL_API_STREAM_CHUNK &&
+        chunk_queued == false)
+    {
+        //chunks for closed connections are discarded
+        response_stream_chunk_sent(response->conn_id, sdslen(response->data));
+    }
     free_response(response);
 }
 
@@ -339,12 +437,101 @@ static bool check_acl(struct mg_connection *nc, sds acl) {
     return false;
 }
 
+/**
+ * Gets the size of the chunks of a chunked response that are not written to the socket
+ * @param nc mongoose connection
+ * @return size in bytes
+ */
+static size_t stream_unsent_get(struct mg_connection *nc) {
+    size_t len;
+    memcpy(&len, nc->label + LABEL_STREAM_UNSENT, sizeof(len));
+    return len;
+}
+
+/**
+ * Sets the size of the chunks of a chunked response that are not written to the socket
+ * @param nc mongoose connection
+ * @param len size in bytes
+ */
+static void stream_unsent_set(struct mg_connection *nc, size_t len) {
+    memcpy(nc->label + LABEL_STREAM_UNSENT, &len, sizeof(len));
+}
+
+/**
+ * Releases the chunk bytes written to the socket for the producer
+ * @param nc mongoose connection
+ * @param written bytes written to the socket
+ */
+static void stream_unsent_release(struct mg_connection *nc, size_t written) {
+    size_t unsent = stream_unsent_get(nc);
+    if (unsent == 0) {
+        return;
+    }
+    size_t released = written < unsent ? written : unsent;
+    stream_unsent_set(nc, unsent - released);
+    response_stream_chunk_sent((long long)nc->id, released);
+}
+
+/**
+ * Gets the deflate stream of a chunked response
+ * @param nc mongoose connection
+ * @return the deflate stream or NULL if the response is not compressed
+ */
+static struct t_compress_stream *stream_deflate_get(struct mg_connection *nc) {
+    struct t_compress_stream *deflate_stream;
+    memcpy(&deflate_stream, nc->label + LABEL_STREAM_DEFLATE, sizeof(deflate_stream));
+    return deflate_stream;
+}
+
+/**
+ * Sets the deflate stream of a chunked response
+ * @param nc mongoose connection
+ * @param deflate_stream the deflate stream or NULL
+ */
+static void stream_deflate_set(struct mg_connection *nc, struct t_compress_stream *deflate_stream) {
+    memcpy(nc->label + LABEL_STREAM_DEFLATE, &deflate_stream, sizeof(deflate_stream));
+}
+
+/**
+ * Writes a chunk of a chunked response, compressed if the connection has a deflate stream
+ * @param nc mongoose connection
+ * @param compress compression context for the statistics
+ * @param data chunk data
+ * @param finish true for the last chunk
+ * @return number of bytes written to the send buffer
+ */
+static size_t stream_write_chunk(struct mg_connection *nc, struct t_compress *compress, sds data, bool finish) {
+    struct t_compress_stream *deflate_stream = stream_deflate_get(nc);
+    if (deflate_stream == NULL) {
+        mg_http_write_chunk(nc, data, sdslen(data));
+        return sdslen(data);
+    }
+    sds compressed = sdsempty();
+    if (compress_stream_chunk(compress, deflate_stream, data, sdslen(data), finish, &compressed) == false) {
+        MYMPD_LOG_ERROR("Aborting chunked response for conn_id %lu", nc->id);
+        nc->is_draining = 1;
+        FREE_SDS(compressed);
+        return 0;
+    }
+    size_t len = sdslen(compressed);
+    if (len > 0) {
+        mg_http_write_chunk(nc, compressed, len);
+    }
+    FREE_SDS(compressed);
+    return len;
+}
+
 /**
  * Central webserver event handler
  * nc->label usage
  * 0 - connection type: F = frontend connection, B = backend connection
  * 1 - http method: G = GET, H = HEAD, P = POST
  * 2 - connection header: C = close, K = keepalive
+ * 3 - albumart size for pending mpd albumart requests: T = thumbnail, F = full
+ * 4 - accepted content encoding: Z = gzip
+ * 5 - chunked response: S = chunked transfer encoding started
+ * 8 - size_t, bytes of the chunked response not written to the socket
+ * 16 - pointer, deflate stream of the chunked response
  *
  * @param nc mongoose connection
  * @param ev connection event
@@ -391,6 +578,18 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *fn
             nc->label[0] = 'F';
             nc->label[1] = '-';
             nc->label[2] = '-';
+            nc->label[3] = '-';
+            nc->label[4] = '-';
+            nc->label[5] = '-';
+            stream_unsent_set(nc, 0);
+            stream_deflate_set(nc, NULL);
+            break;
+        }
+        case MG_EV_WRITE: {
+            if (nc->label[0] == 'F') {
+                long *written = (long *)ev_data;
+                stream_unsent_release(nc, (size_t)*written);
+            }
             break;
         }
         case MG_EV_WS_MSG: {
@@ -403,6 +602,30 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *fn
                     nc->is_closing = 1;
                 }
             }
+            else if (wm->data.len > 0 &&
+                (wm->data.ptr[0] == '{' || wm->data.ptr[0] == '['))
+            {
+                //api request, the response is routed back by the connection id
+                bool rc = false;
+                int request_id = 0;
+                if (wm->data.len <= BODY_SIZE_MAX) {
+                    sds body = sdsnewlen(wm->data.ptr, wm->data.len);
+                    //browsers can not set custom headers for websocket connections
+                    rc = request_handler_api(nc, body, NULL, mg_user_data, backend_nc);
+                    if (rc == false) {
+                        //echo the id to remove the pending request from the client
+                        json_get_int(body, "$.id", 0, JSONRPC_INT_MAX, &request_id, NULL);
+                    }
+                    FREE_SDS(body);
+                }
+                if (rc == false) {
+                    MYMPD_LOG_ERROR("Invalid websocket API request");
+                    sds response = jsonrpc_respond_message(sdsempty(), GENERAL_API_UNKNOWN, request_id,
+                        JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Invalid API request");
+                    mg_ws_send(nc, response, sdslen(response), WEBSOCKET_OP_TEXT);
+                    FREE_SDS(response);
+                }
+            }
             break;
         }
         case MG_EV_HTTP_MSG: {
@@ -450,6 +673,12 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *fn
                     nc->label[2] = 'K';
                 }
             }
+            //check if gzip encoding is accepted
+            struct mg_str *accept_encoding_hdr = mg_http_get_header(hm, "Accept-Encoding");
+            nc->label[4] = accept_encoding_hdr != NULL &&
+                mg_strstr(*accept_encoding_hdr, mg_str("gzip")) != NULL
+                    ? 'Z'
+                    : '-';
             //handle uris
             if (mg_http_match_uri(hm, "/api/")) {
                 //api request
@@ -460,12 +689,16 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *fn
                  */
                 struct mg_str *auth_header = mg_http_get_header(hm, "X-myMPD-Session");
                 bool rc = request_handler_api(nc, body, auth_header, mg_user_data, backend_nc);
+                int request_id = 0;
+                if (rc == false) {
+                    json_get_int(body, "$.id", 0, JSONRPC_INT_MAX, &request_id, NULL);
+                }
                 FREE_SDS(body);
                 if (rc == false) {
                     MYMPD_LOG_ERROR("Invalid API request");
-                    sds response = jsonrpc_respond_message(sdsempty(), GENERAL_API_UNKNOWN, 0,
+                    sds response = jsonrpc_respond_message(sdsempty(), GENERAL_API_UNKNOWN, request_id,
                         JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Invalid API request");
-                    webserver_send_data(nc, response, sdslen(response), "Content-Type: application/json\r\n");
+                    webserver_send_data(nc, response, sdslen(response), "Content-Type: application/json\r\n"EXTRA_HEADER_VARY_ENCODING);
                     FREE_SDS(response);
                 }
             }
@@ -501,7 +734,7 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *fn
                 request_handler_proxy(nc, hm, backend_nc);
             }
             else if (mg_http_match_uri(hm, "/api/serverinfo")) {
-                request_handler_serverinfo(nc);
+                request_handler_serverinfo(nc, mg_user_data);
             }
             else if (mg_http_match_uri(hm, "/api/script")) {
                 //check acl
@@ -557,6 +790,17 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *fn
         case MG_EV_CLOSE: {
             MYMPD_LOG_INFO("HTTP connection %lu closed", nc->id);
             mg_user_data->connection_count--;
+            //unsent chunks are discarded
+            if (nc->label[0] == 'F') {
+                stream_unsent_release(nc, stream_unsent_get(nc));
+                compress_stream_free(stream_deflate_get(nc));
+                stream_deflate_set(nc, NULL);
+            }
+            //the responses of queued read only requests can not be delivered anymore
+            int canceled = mympd_queue_cancel(mympd_api_queue, (long long)nc->id);
+            if (canceled > 0) {
+                MYMPD_LOG_INFO("Canceled %d requests for connection %lu", canceled, nc->id);
+            }
             if (backend_nc != NULL) {
                 MYMPD_LOG_INFO("Closing backend connection \"%lu\"", backend_nc->id);
                 //remove pointer to frontend connection
@@ -14,6 +14,7 @@
 #include <unistd.h>
 
 _Thread_local sds thread_logname;
+sig_atomic_t s_signal_received;
 
 //message queues
 struct t_mympd_queue *web_server_queue;
@@ -33,6 +34,7 @@ int main(int argc, const char *const argv[]) {
     mkdir("/tmp/mympd-test", 0770);
     mkdir("/tmp/mympd-test/state", 0770);
     mkdir("/tmp/mympd-test/webradios", 0770);
+    mkdir("/tmp/mympd-test/smartpls", 0770);
 
     //utest main
     int rc = utest_main(argc, argv);
@@ -41,6 +43,7 @@ int main(int argc, const char *const argv[]) {
     FREE_SDS(thread_logname);
     rmdir("/tmp/mympd-test/ssl");
     rmdir("/tmp/mympd-test/state");
+    rmdir("/tmp/mympd-test/smartpls");
     rmdir("/tmp/mympd-test");
     sdsfree(workdir);
     return rc;
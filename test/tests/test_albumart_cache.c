@@ -0,0 +1,102 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/sds_extras.h"
+#include "../../src/web_server/albumart_cache.h"
+
+#include <stdint.h>
+
+UTEST(albumart_cache, test_albumart_cache_key) {
+    sds key = albumart_cache_key(sdsempty(), "test/song.mp3", 0, false);
+    sds hash = sds_hash("test/song.mp3");
+    sds expected = sdscatfmt(sdsempty(), "%S-0-f", hash);
+    ASSERT_STREQ(expected, key);
+    sdsclear(key);
+    key = albumart_cache_key(key, "test/song.mp3", 1, true);
+    sdsclear(expected);
+    expected = sdscatfmt(expected, "%S-1-t", hash);
+    ASSERT_STREQ(expected, key);
+    sdsfree(key);
+    sdsfree(hash);
+    sdsfree(expected);
+}
+
+UTEST(albumart_cache, test_albumart_cache_lru) {
+    struct t_albumart_cache cache;
+    albumart_cache_init(&cache, 10);
+    sds key1 = sdsnew("key1");
+    sds key2 = sdsnew("key2");
+    sds key3 = sdsnew("key3");
+
+    struct t_albumart_cache_entry *entry = albumart_cache_put(&cache, key1, "image/png", "abcd", 4);
+    ASSERT_TRUE(entry != NULL);
+    ASSERT_EQ(42U, sdslen(entry->etag));
+    entry = albumart_cache_put(&cache, key2, "image/png", "efgh", 4);
+    ASSERT_TRUE(entry != NULL);
+    ASSERT_EQ(8U, cache.size);
+
+    //key1 is now the most recently used entry
+    entry = albumart_cache_get(&cache, key1);
+    ASSERT_TRUE(entry != NULL);
+    ASSERT_STREQ("abcd", entry->binary);
+
+    //evicts key2
+    entry = albumart_cache_put(&cache, key3, "image/jpeg", "ijkl", 4);
+    ASSERT_TRUE(entry != NULL);
+    ASSERT_EQ(8U, cache.size);
+    ASSERT_EQ(1U, cache.evictions);
+    ASSERT_TRUE(albumart_cache_get(&cache, key2) == NULL);
+    ASSERT_TRUE(albumart_cache_get(&cache, key1) != NULL);
+    ASSERT_EQ(2U, cache.hits);
+    ASSERT_EQ(1U, cache.misses);
+
+    //too large
+    entry = albumart_cache_put(&cache, key2, "image/png", "0123456789a", 11);
+    ASSERT_TRUE(entry == NULL);
+
+    albumart_cache_clear(&cache);
+    ASSERT_EQ(0U, cache.size);
+    ASSERT_TRUE(albumart_cache_get(&cache, key1) == NULL);
+
+    albumart_cache_free(&cache);
+    sdsfree(key1);
+    sdsfree(key2);
+    sdsfree(key3);
+}
+
+UTEST(albumart_cache, test_albumart_cache_negative) {
+    struct t_albumart_cache cache;
+    albumart_cache_init(&cache, 10);
+    sds key = sdsnew("key1");
+    ASSERT_FALSE(albumart_cache_negative_get(&cache, key));
+    albumart_cache_negative_add(&cache, key);
+    ASSERT_TRUE(albumart_cache_negative_get(&cache, key));
+    ASSERT_EQ(1U, cache.negative_hits);
+    albumart_cache_clear(&cache);
+    ASSERT_FALSE(albumart_cache_negative_get(&cache, key));
+    //expired entry
+    raxInsert(cache.negative, (unsigned char *)key, sdslen(key), (void *)(uintptr_t)1, NULL);
+    ASSERT_FALSE(albumart_cache_negative_get(&cache, key));
+    ASSERT_EQ(0U, cache.negative->numele);
+    albumart_cache_free(&cache);
+    sdsfree(key);
+}
+
+UTEST(albumart_cache, test_albumart_cache_no_thumbnail) {
+    struct t_albumart_cache cache;
+    albumart_cache_init(&cache, 10);
+    sds key = sdsnew("key1");
+    ASSERT_FALSE(albumart_cache_no_thumbnail_get(&cache, key));
+    albumart_cache_no_thumbnail_add(&cache, key);
+    ASSERT_TRUE(albumart_cache_no_thumbnail_get(&cache, key));
+    albumart_cache_clear(&cache);
+    ASSERT_FALSE(albumart_cache_no_thumbnail_get(&cache, key));
+    albumart_cache_free(&cache);
+    sdsfree(key);
+}
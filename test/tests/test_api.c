@@ -8,6 +8,10 @@
 
 #include "../../dist/utest/utest.h"
 #include "../../src/lib/api.h"
+#include "../../src/lib/list.h"
+
+#include <string.h>
+#include <time.h>
 
 UTEST(api, test_get_cmd_id) {
     enum mympd_cmd_ids cmd_id = get_cmd_id("MYMPD_API_COLS_SAVE");
@@ -15,6 +19,67 @@ UTEST(api, test_get_cmd_id) {
     ASSERT_TRUE(rc);
 }
 
+UTEST(api, test_get_cmd_id_all) {
+    for (unsigned i = 0; i < TOTAL_API_COUNT; i++) {
+        const char *name = get_cmd_id_method_name(i);
+        ASSERT_EQ(i, (unsigned)get_cmd_id(name));
+    }
+    ASSERT_EQ((unsigned)GENERAL_API_UNKNOWN, (unsigned)get_cmd_id(""));
+    ASSERT_EQ((unsigned)GENERAL_API_UNKNOWN, (unsigned)get_cmd_id("MYMPD_API_COLS_SAV"));
+    ASSERT_EQ((unsigned)GENERAL_API_UNKNOWN, (unsigned)get_cmd_id("MYMPD_API_COLS_SAVE_"));
+}
+
+#define BENCH_ROUNDS 2000
+
+static enum mympd_cmd_ids get_cmd_id_linear(const char *cmd) {
+    for (unsigned i = 0; i < TOTAL_API_COUNT; i++) {
+        if (strcmp(cmd, get_cmd_id_method_name(i)) == 0) {
+            return i;
+        }
+    }
+    return GENERAL_API_UNKNOWN;
+}
+
+static long long bench_usec(struct timespec *tic, struct timespec *toc) {
+    return ((long long)toc->tv_sec * 1000000 + toc->tv_nsec / 1000) -
+        ((long long)tic->tv_sec * 1000000 + tic->tv_nsec / 1000);
+}
+
+UTEST(api, test_get_cmd_id_benchmark) {
+    struct timespec tic;
+    struct timespec toc;
+    unsigned long sum_hash = 0;
+    unsigned long sum_linear = 0;
+    clock_gettime(CLOCK_MONOTONIC, &tic);
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (unsigned i = 0; i < TOTAL_API_COUNT; i++) {
+            sum_hash += get_cmd_id(get_cmd_id_method_name(i));
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &toc);
+    long long usec_hash = bench_usec(&tic, &toc);
+    clock_gettime(CLOCK_MONOTONIC, &tic);
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (unsigned i = 0; i < TOTAL_API_COUNT; i++) {
+            sum_linear += get_cmd_id_linear(get_cmd_id_method_name(i));
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &toc);
+    long long usec_linear = bench_usec(&tic, &toc);
+    printf("%d lookups: perfect hash %lld us, linear search %lld us\n",
+        BENCH_ROUNDS * TOTAL_API_COUNT, usec_hash, usec_linear);
+    ASSERT_EQ(sum_linear, sum_hash);
+}
+
+UTEST(api, test_get_api_method_flags) {
+    unsigned flags = get_api_method_flags(MYMPD_API_SESSION_LOGOUT);
+    ASSERT_EQ((unsigned)(API_FLAG_PUBLIC | API_FLAG_PROTECTED | API_FLAG_WEBSERVER), flags);
+    flags = get_api_method_flags(MYMPD_API_PLAYER_STATE);
+    ASSERT_EQ((unsigned)(API_FLAG_PUBLIC | API_FLAG_BATCH | API_FLAG_COALESCABLE), flags);
+    ASSERT_EQ(0U, get_api_method_flags(INTERNAL_API_STATE_SAVE));
+    ASSERT_EQ(0U, get_api_method_flags(TOTAL_API_COUNT));
+}
+
 UTEST(api, test_get_cmd_id_method_name) {
     const char *name = get_cmd_id_method_name(MYMPD_API_COLS_SAVE);
     ASSERT_STREQ(name, "MYMPD_API_COLS_SAVE");
@@ -44,6 +109,26 @@ UTEST(api, test_is_mympd_only_api_method) {
     ASSERT_FALSE(rc);
 }
 
+UTEST(api, test_is_batch_api_method) {
+    bool rc = is_batch_api_method(MYMPD_API_PLAYER_STATE);
+    ASSERT_TRUE(rc);
+
+    rc = is_batch_api_method(MYMPD_API_SESSION_LOGIN);
+    ASSERT_FALSE(rc);
+
+    rc = is_batch_api_method(MYMPD_API_SMARTPLS_UPDATE_ALL);
+    ASSERT_FALSE(rc);
+
+    rc = is_batch_api_method(INTERNAL_API_BATCH);
+    ASSERT_FALSE(rc);
+}
+
+UTEST(api, test_is_pool_api_method) {
+    ASSERT_TRUE(is_pool_api_method(INTERNAL_API_ALBUMART));
+    ASSERT_TRUE(is_pool_api_method(MYMPD_API_PLAYLIST_CONTENT_LIST));
+    ASSERT_FALSE(is_pool_api_method(MYMPD_API_PLAYER_STATE));
+}
+
 UTEST(api, test_request_result) {
     struct t_work_request *request = create_request(1, 1, MYMPD_API_SETTINGS_SET, "test");
     bool rc = request == NULL ? false : true;
@@ -58,3 +143,14 @@ UTEST(api, test_request_result) {
     free_request(request);
     free_response(response);
 }
+
+UTEST(api, test_batch_request) {
+    struct t_work_request *request = create_request(1, 0, INTERNAL_API_BATCH, "[]");
+    struct t_list *requests = list_new();
+    request->extra = requests;
+    list_push(requests, "", 0, NULL, create_request(-1, 1, MYMPD_API_PLAYER_STATE, "{}"));
+    list_push(requests, "", 0, NULL, create_request(-1, 2, MYMPD_API_QUEUE_LIST, "{}"));
+    ASSERT_EQ(2, requests->length);
+    //frees the contained requests
+    free_request(request);
+}
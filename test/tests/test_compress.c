@@ -0,0 +1,122 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/compress.h"
+#include "../../src/lib/jsonrpc.h"
+#include "../../src/lib/sds_extras.h"
+
+#include <string.h>
+#include <zlib.h>
+
+//builds a response like MYMPD_API_DATABASE_ALBUMS_GET
+static sds create_album_list(int count) {
+    sds buffer = jsonrpc_respond_start(sdsempty(), MYMPD_API_DATABASE_ALBUMS_GET, 0);
+    buffer = sdscat(buffer, "\"data\":[");
+    for (int i = 0; i < count; i++) {
+        if (i > 0) {
+            buffer = sdscatlen(buffer, ",", 1);
+        }
+        buffer = sdscat(buffer, "{\"Type\": \"album\",");
+        buffer = sdscatfmt(buffer, "\"Album\":\"Album title %i\",", i);
+        buffer = sdscatfmt(buffer, "\"AlbumArtist\":[\"Artist %i\"],", i % 50);
+        buffer = sdscatfmt(buffer, "\"Genre\":[\"Genre %i\"],", i % 10);
+        buffer = tojson_uint(buffer, "Discs", 1, true);
+        buffer = tojson_uint(buffer, "SongCount", (unsigned)(10 + i % 7), true);
+        buffer = tojson_uint(buffer, "Duration", (unsigned)(2400 + i * 13 % 600), true);
+        buffer = tojson_llong(buffer, "LastModified", 1660000000 + i, true);
+        buffer = sdscatfmt(buffer, "\"FirstSongUri\":\"Artist %i/Album title %i/01 - Track.flac\"}", i % 50, i);
+    }
+    buffer = sdscat(buffer, "],");
+    buffer = tojson_long(buffer, "totalEntities", count, true);
+    buffer = tojson_long(buffer, "returnedEntities", count, false);
+    buffer = jsonrpc_end(buffer);
+    return buffer;
+}
+
+UTEST(compress, test_compress_gzip) {
+    struct t_compress compress;
+    compress_init(&compress, HTTP_COMPRESS_LEVEL);
+    sds out = sdsempty();
+    char *inflated = NULL;
+    //reuse the context
+    for (int count = 100; count <= 1000; count *= 10) {
+        sds data = create_album_list(count);
+        ASSERT_TRUE(compress_gzip(&compress, data, sdslen(data), &out));
+        ASSERT_LT(sdslen(out), sdslen(data));
+        //gzip magic
+        ASSERT_EQ(0x1f, (unsigned char)out[0]);
+        ASSERT_EQ(0x8b, (unsigned char)out[1]);
+
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        ASSERT_EQ(Z_OK, inflateInit2(&stream, 15 + 16));
+        inflated = realloc(inflated, sdslen(data));
+        stream.next_in = (Bytef *)out;
+        stream.avail_in = (uInt)sdslen(out);
+        stream.next_out = (Bytef *)inflated;
+        stream.avail_out = (uInt)sdslen(data);
+        ASSERT_EQ(Z_STREAM_END, inflate(&stream, Z_FINISH));
+        ASSERT_EQ(sdslen(data), stream.total_out);
+        ASSERT_EQ(0, memcmp(data, inflated, sdslen(data)));
+        inflateEnd(&stream);
+        printf("Album list with %d entries: %lu bytes compressed to %lu bytes\n", count, (unsigned long)sdslen(data), (unsigned long)sdslen(out));
+        sdsfree(data);
+    }
+    ASSERT_EQ(2U, compress.count);
+    printf("Compression ratio: %.2f, cpu time: %llu us\n", (double)compress.bytes_in / (double)compress.bytes_out, compress.cpu_usec);
+
+    //incompressible data is rejected
+    ASSERT_FALSE(compress_gzip(&compress, "abc", 3, &out));
+    ASSERT_EQ(2U, compress.count);
+
+    free(inflated);
+    sdsfree(out);
+    compress_free(&compress);
+}
+
+UTEST(compress, test_compress_stream) {
+    struct t_compress compress;
+    compress_init(&compress, HTTP_COMPRESS_LEVEL);
+    struct t_compress_stream *deflate_stream = compress_stream_new(HTTP_COMPRESS_LEVEL);
+    ASSERT_TRUE(deflate_stream != NULL);
+    sds data = create_album_list(1000);
+    size_t chunk_size = sdslen(data) / 3;
+    sds out = sdsempty();
+    sds compressed = sdsempty();
+    //compress the response in chunks like a streamed response
+    for (size_t pos = 0; pos < sdslen(data); pos += chunk_size) {
+        size_t len = pos + chunk_size < sdslen(data) ? chunk_size : sdslen(data) - pos;
+        ASSERT_TRUE(compress_stream_chunk(&compress, deflate_stream, data + pos, len, false, &out));
+        compressed = sdscatsds(compressed, out);
+    }
+    ASSERT_TRUE(compress_stream_chunk(&compress, deflate_stream, "", 0, true, &out));
+    compressed = sdscatsds(compressed, out);
+    compress_stream_free(deflate_stream);
+    ASSERT_EQ(1U, compress.count);
+    ASSERT_LT(sdslen(compressed), sdslen(data));
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    ASSERT_EQ(Z_OK, inflateInit2(&stream, 15 + 16));
+    char *inflated = malloc(sdslen(data));
+    stream.next_in = (Bytef *)compressed;
+    stream.avail_in = (uInt)sdslen(compressed);
+    stream.next_out = (Bytef *)inflated;
+    stream.avail_out = (uInt)sdslen(data);
+    ASSERT_EQ(Z_STREAM_END, inflate(&stream, Z_FINISH));
+    ASSERT_EQ(sdslen(data), stream.total_out);
+    ASSERT_EQ(0, memcmp(data, inflated, sdslen(data)));
+    inflateEnd(&stream);
+
+    free(inflated);
+    sdsfree(data);
+    sdsfree(out);
+    sdsfree(compressed);
+    compress_free(&compress);
+}
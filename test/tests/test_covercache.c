@@ -0,0 +1,138 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/covercache.h"
+#include "../../src/lib/filehandler.h"
+#include "../../src/lib/sds_extras.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+UTEST(covercache, test_covercache_lru) {
+    sds cachedir = sdsnew("/tmp/mympd-test/covercache_lru");
+    mkdir(cachedir, 0770);
+    mkdir("/tmp/mympd-test/covercache_lru/covercache", 0770);
+    sds binary = sdsnew("0123456789");
+    sds filepath = sdsempty();
+
+    //budget for two files
+    ASSERT_TRUE(covercache_init(cachedir, 25));
+    ASSERT_TRUE(covercache_write_file(cachedir, "album1/song.mp3", "image/jpeg", binary, 0));
+    ASSERT_TRUE(covercache_write_file(cachedir, "album2/song.mp3", "image/png", binary, 0));
+    filepath = covercache_get_file(cachedir, "album1/song.mp3", 0, 0, filepath);
+    sds hash = sds_hash("album1/song.mp3");
+    sds expected = sdscatprintf(sdsempty(), "%s/covercache/%.2s/%s-0.jpg", cachedir, hash, hash);
+    ASSERT_STREQ(expected, filepath);
+    //album2 is now the least recently used entry
+    ASSERT_TRUE(covercache_write_thumbnail(cachedir, "album1/song.mp3", binary, 0, 100));
+    filepath = covercache_get_file(cachedir, "album2/song.mp3", 0, 0, filepath);
+    ASSERT_STREQ("", filepath);
+    filepath = covercache_get_file(cachedir, "album1/song.mp3", 0, 100, filepath);
+    ASSERT_GT(sdslen(filepath), 0U);
+    ASSERT_EQ(0, access(filepath, F_OK));
+    //thumbnails of other sizes are not found
+    filepath = covercache_get_file(cachedir, "album1/song.mp3", 0, 200, filepath);
+    ASSERT_STREQ("", filepath);
+
+    //index is saved on free and restored on init
+    covercache_free();
+    ASSERT_TRUE(covercache_init(cachedir, 25));
+    filepath = covercache_get_file(cachedir, "album1/song.mp3", 0, 0, filepath);
+    ASSERT_STREQ(expected, filepath);
+    ASSERT_EQ(2, covercache_clear(0));
+    ASSERT_NE(0, access(expected, F_OK));
+    covercache_free();
+
+    sdsfree(hash);
+    sdsfree(expected);
+    sdsfree(binary);
+    sdsfree(filepath);
+    sdsfree(cachedir);
+}
+
+UTEST(covercache, test_covercache_migrate) {
+    sds cachedir = sdsnew("/tmp/mympd-test/covercache_migrate");
+    mkdir(cachedir, 0770);
+    mkdir("/tmp/mympd-test/covercache_migrate/covercache", 0770);
+    //file in the old flat directory layout
+    sds hash = sds_hash("album1/song.mp3");
+    sds oldfile = sdscatfmt(sdsempty(), "%S/covercache/%S-0.png", cachedir, hash);
+    write_data_to_file(oldfile, "0123456789", 10);
+
+    ASSERT_TRUE(covercache_init(cachedir, 0));
+    ASSERT_NE(0, access(oldfile, F_OK));
+    sds filepath = covercache_get_file(cachedir, "album1/song.mp3", 0, 0, sdsempty());
+    ASSERT_EQ(0, access(filepath, F_OK));
+    ASSERT_EQ(1, covercache_clear(0));
+    covercache_free();
+
+    sds index_file = sdscatfmt(sdsempty(), "%S/covercache/index", cachedir);
+    unlink(index_file);
+    sdsfree(index_file);
+    sdsfree(hash);
+    sdsfree(oldfile);
+    sdsfree(filepath);
+    sdsfree(cachedir);
+}
+
+UTEST(covercache, test_covercache_thumbnail_skipped) {
+    sds cachedir = sdsnew("/tmp/mympd-test/covercache_skipped");
+    mkdir(cachedir, 0770);
+    mkdir("/tmp/mympd-test/covercache_skipped/covercache", 0770);
+    sds empty = sdsempty();
+
+    ASSERT_TRUE(covercache_init(cachedir, 0));
+    ASSERT_FALSE(covercache_thumbnail_skipped(cachedir, "album1/song.mp3", 0, 100));
+    ASSERT_TRUE(covercache_write_thumbnail(cachedir, "album1/song.mp3", empty, 0, 100));
+    ASSERT_TRUE(covercache_thumbnail_skipped(cachedir, "album1/song.mp3", 0, 100));
+    ASSERT_FALSE(covercache_thumbnail_skipped(cachedir, "album1/song.mp3", 0, 200));
+    sds filepath = covercache_get_file(cachedir, "album1/song.mp3", 0, 100, sdsempty());
+    ASSERT_STREQ("", filepath);
+    ASSERT_EQ(1, covercache_clear(0));
+    covercache_free();
+
+    sds index_file = sdscatfmt(sdsempty(), "%S/covercache/index", cachedir);
+    unlink(index_file);
+    sdsfree(index_file);
+    sdsfree(filepath);
+    sdsfree(empty);
+    sdsfree(cachedir);
+}
+
+UTEST(covercache, test_covercache_journal) {
+    sds cachedir = sdsnew("/tmp/mympd-test/covercache_journal");
+    mkdir(cachedir, 0770);
+    mkdir("/tmp/mympd-test/covercache_journal/covercache", 0770);
+    sds binary = sdsnew("0123456789");
+    sds index_file = sdscatfmt(sdsempty(), "%S/covercache/index", cachedir);
+    sds journal_file = sdscatfmt(sdsempty(), "%S/covercache/index.journal", cachedir);
+
+    //the index is saved on init, changes are appended to the journal
+    ASSERT_TRUE(covercache_init(cachedir, 0));
+    ASSERT_EQ(0, access(index_file, F_OK));
+    ASSERT_TRUE(covercache_write_file(cachedir, "album1/song.mp3", "image/jpeg", binary, 0));
+    sds journal = sdsempty();
+    ASSERT_TRUE(read_data_from_file(&journal, journal_file, 1000));
+    sds hash = sds_hash("album1/song.mp3");
+    sds expected = sdscatfmt(sdsempty(), "+ %S-0.jpg 10 ", hash);
+    ASSERT_EQ(0, strncmp(journal, expected, sdslen(expected)));
+    ASSERT_EQ(1, covercache_clear(0));
+    covercache_free();
+    ASSERT_NE(0, access(journal_file, F_OK));
+
+    unlink(index_file);
+    sdsfree(hash);
+    sdsfree(expected);
+    sdsfree(journal);
+    sdsfree(journal_file);
+    sdsfree(index_file);
+    sdsfree(binary);
+    sdsfree(cachedir);
+}
@@ -0,0 +1,79 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/filehandler.h"
+#include "../../src/lib/sds_extras.h"
+#include "../../src/web_server/dir_cache.h"
+#include "../../src/web_server/utility.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+UTEST(dir_cache, test_dir_cache_file_exists) {
+    mkdir("/tmp/mympd-test/dir_cache", 0770);
+    sds file = sdsnew("/tmp/mympd-test/dir_cache/cover.jpg");
+    write_data_to_file(file, "test", 4);
+
+    struct t_dir_cache dir_cache;
+    dir_cache_init(&dir_cache);
+    ASSERT_TRUE(dir_cache_file_exists(&dir_cache, "/tmp/mympd-test/dir_cache/cover.jpg"));
+    ASSERT_FALSE(dir_cache_file_exists(&dir_cache, "/tmp/mympd-test/dir_cache/folder.jpg"));
+    ASSERT_FALSE(dir_cache_file_exists(&dir_cache, "/tmp/mympd-test/nonexistent/cover.jpg"));
+    ASSERT_EQ(2U, dir_cache.misses);
+    ASSERT_EQ(1U, dir_cache.hits);
+
+    sds basename = sdsnew("/tmp/mympd-test/dir_cache/cover");
+    basename = webserver_find_image_file_cached(&dir_cache, basename);
+    ASSERT_STREQ("/tmp/mympd-test/dir_cache/cover.jpg", basename);
+
+    //files created after the listing was read are not visible until the cache is cleared
+    sds file2 = sdsnew("/tmp/mympd-test/dir_cache/folder.jpg");
+    write_data_to_file(file2, "test", 4);
+    ASSERT_FALSE(dir_cache_file_exists(&dir_cache, "/tmp/mympd-test/dir_cache/folder.jpg"));
+    dir_cache_clear(&dir_cache);
+    ASSERT_TRUE(dir_cache_file_exists(&dir_cache, "/tmp/mympd-test/dir_cache/folder.jpg"));
+
+    dir_cache_free(&dir_cache);
+    unlink(file);
+    unlink(file2);
+    rmdir("/tmp/mympd-test/dir_cache");
+    sdsfree(file);
+    sdsfree(file2);
+    sdsfree(basename);
+}
+
+UTEST(dir_cache, test_dir_cache_case) {
+    mkdir("/tmp/mympd-test/dir_cache_case", 0770);
+    sds file = sdsnew("/tmp/mympd-test/dir_cache_case/Cover.JPG");
+    write_data_to_file(file, "test", 4);
+    struct t_dir_cache dir_cache;
+    dir_cache_init(&dir_cache);
+    //the probe for a case insensitive filesystem fails on case sensitive filesystems
+    ASSERT_TRUE(dir_cache_file_exists(&dir_cache, "/tmp/mympd-test/dir_cache_case/Cover.JPG"));
+    ASSERT_FALSE(dir_cache_file_exists(&dir_cache, "/tmp/mympd-test/dir_cache_case/cover.jpg"));
+    dir_cache_free(&dir_cache);
+    unlink(file);
+    rmdir("/tmp/mympd-test/dir_cache_case");
+    sdsfree(file);
+}
+
+UTEST(dir_cache, test_dir_cache_case_utf8) {
+    mkdir("/tmp/mympd-test/dir_cache_case_utf8", 0770);
+    //the probe folds non-ascii filenames like the lookup
+    sds file = sdsnew("/tmp/mympd-test/dir_cache_case_utf8/\xc3\x84rger.jpg");
+    write_data_to_file(file, "test", 4);
+    struct t_dir_cache dir_cache;
+    dir_cache_init(&dir_cache);
+    ASSERT_TRUE(dir_cache_file_exists(&dir_cache, "/tmp/mympd-test/dir_cache_case_utf8/\xc3\x84rger.jpg"));
+    ASSERT_FALSE(dir_cache_file_exists(&dir_cache, "/tmp/mympd-test/dir_cache_case_utf8/\xc3\xa4rger.jpg"));
+    dir_cache_free(&dir_cache);
+    unlink(file);
+    rmdir("/tmp/mympd-test/dir_cache_case_utf8");
+    sdsfree(file);
+}
@@ -200,6 +200,27 @@ UTEST(jsonrpc, test_json_get_object_string) {
     list_clear(&l);
 }
 
+UTEST(jsonrpc, test_json_get_array_object) {
+    struct t_list l;
+    list_init(&l);
+    sds data = sdsnew("[{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"MYMPD_API_PLAYER_STATE\",\"params\":{}}, {\"id\":2,\"params\":{\"a\":[1,2]}}]");
+    //valid
+    ASSERT_TRUE(json_get_array_object(data, "$", &l, 10, NULL));
+    ASSERT_EQ(2, l.length);
+    ASSERT_STREQ("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"MYMPD_API_PLAYER_STATE\",\"params\":{}}", l.head->key);
+    ASSERT_STREQ("{\"id\":2,\"params\":{\"a\":[1,2]}}", l.tail->key);
+    list_clear(&l);
+    //invalid - too many array elements
+    ASSERT_FALSE(json_get_array_object(data, "$", &l, 1, NULL));
+    list_clear(&l);
+    //invalid - no objects
+    sdsclear(data);
+    data = sdscat(data, "[{\"id\":1}, \"string\"]");
+    ASSERT_FALSE(json_get_array_object(data, "$", &l, 10, NULL));
+    list_clear(&l);
+    FREE_SDS(data);
+}
+
 UTEST(jsonrpc, test_json_get_tags) {
     struct t_tags tagcols;
     reset_t_tags(&tagcols);
@@ -214,6 +235,46 @@ UTEST(jsonrpc, test_json_get_tags) {
     FREE_SDS(data);
 }
 
+UTEST(jsonrpc, test_json_index) {
+    struct t_json_index index;
+    sds data = sdsnew("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"MYMPD_API_QUEUE_LIST\","
+        "\"params\":{\"offset\":10,\"play\":true,\"plist\":\"test\\\"list\",\"cols\":[\"Title\",\"Artist\"],"
+        "\"sub\":{\"offset\":20}}}");
+    ASSERT_TRUE(json_index_parse(&index, data));
+    ASSERT_EQ(5, index.count);
+    long offset;
+    ASSERT_TRUE(json_index_get_long(&index, "$.params.offset", 0, 100, &offset, NULL));
+    ASSERT_EQ(10, offset);
+    //nested paths are searched by mjson
+    ASSERT_TRUE(json_index_get_long(&index, "$.params.sub.offset", 0, 100, &offset, NULL));
+    ASSERT_EQ(20, offset);
+    ASSERT_FALSE(json_index_get_long(&index, "$.params.offset", 0, 5, &offset, NULL));
+    bool play;
+    ASSERT_TRUE(json_index_get_bool(&index, "$.params.play", &play, NULL));
+    ASSERT_TRUE(play);
+    sds plist = NULL;
+    ASSERT_TRUE(json_index_get_string(&index, "$.params.plist", 1, 20, &plist, vcb_isname, NULL));
+    ASSERT_STREQ("test\"list", plist);
+    FREE_SDS(plist);
+    ASSERT_FALSE(json_index_get_string(&index, "$.params.plis", 1, 20, &plist, vcb_isname, NULL));
+    ASSERT_FALSE(json_index_get_string(&index, "$.params.offset", 1, 20, &plist, vcb_isname, NULL));
+    struct t_list l;
+    list_init(&l);
+    ASSERT_TRUE(json_index_get_array_string(&index, "$.params.cols", &l, vcb_isalnum, 10, NULL));
+    ASSERT_EQ(2, l.length);
+    list_clear(&l);
+    //paths outside params are searched by mjson
+    ASSERT_TRUE(json_index_get_long(&index, "$.id", 0, 100, &offset, NULL));
+    ASSERT_EQ(1, offset);
+    FREE_SDS(data);
+
+    //missing params object
+    data = sdsnew("{\"jsonrpc\":\"2.0\",\"id\":1}");
+    ASSERT_FALSE(json_index_parse(&index, data));
+    ASSERT_FALSE(json_index_get_long(&index, "$.params.offset", 0, 100, &offset, NULL));
+    FREE_SDS(data);
+}
+
 UTEST(jsonrpc, test_list_to_json_array) {
     struct t_list l;
     list_init(&l);
@@ -0,0 +1,123 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "../utility.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/last_played_store.h"
+#include "../../src/lib/sds_extras.h"
+
+#include <unistd.h>
+
+static void write_file(const char *filepath, const char *data) {
+    FILE *fp = fopen(filepath, "w");
+    fputs(data, fp);
+    fclose(fp);
+}
+
+UTEST(last_played_store, test_last_played_store_append) {
+    sds filepath = sdscatfmt(sdsempty(), "%S/state/last_played.log", workdir);
+    unlink(filepath);
+    struct t_last_played_store store;
+    last_played_store_init(&store);
+    ASSERT_TRUE(last_played_store_open(&store, workdir, 3));
+    ASSERT_EQ(0, store.length);
+
+    ASSERT_TRUE(last_played_store_append(&store, "a.mp3", 1, 3));
+    ASSERT_TRUE(last_played_store_append(&store, "b.mp3", 2, 3));
+    ASSERT_TRUE(last_played_store_append(&store, "dir::c.mp3", 3, 3));
+    ASSERT_EQ(3, store.length);
+
+    long long played;
+    sds uri = sdsempty();
+    ASSERT_TRUE(last_played_store_get(&store, 0, &played, &uri));
+    ASSERT_EQ(3, played);
+    ASSERT_STREQ("dir::c.mp3", uri);
+    ASSERT_TRUE(last_played_store_get(&store, 2, &played, &uri));
+    ASSERT_EQ(1, played);
+    ASSERT_STREQ("a.mp3", uri);
+    ASSERT_FALSE(last_played_store_get(&store, 3, &played, &uri));
+
+    //the log is compacted after reaching twice the max entries
+    for (int i = 4; i <= 7; i++) {
+        ASSERT_TRUE(last_played_store_append(&store, "d.mp3", i, 3));
+    }
+    ASSERT_EQ(3, store.length);
+    ASSERT_TRUE(last_played_store_get(&store, 0, &played, &uri));
+    ASSERT_EQ(7, played);
+    ASSERT_TRUE(last_played_store_get(&store, 2, &played, &uri));
+    ASSERT_EQ(5, played);
+    ASSERT_TRUE(last_played_store_append(&store, "e.mp3", 8, 3));
+    //not compacted yet, but only the max entries are valid
+    ASSERT_EQ(4, store.length);
+    ASSERT_EQ(3, last_played_store_count(&store, 3));
+    last_played_store_close(&store);
+
+    //reopen, an incomplete last line is removed
+    FILE *fp = fopen(filepath, "a");
+    fputs("9::f.m", fp);
+    fclose(fp);
+    last_played_store_init(&store);
+    ASSERT_TRUE(last_played_store_open(&store, workdir, 10));
+    ASSERT_EQ(4, store.length);
+    ASSERT_TRUE(last_played_store_get(&store, 0, &played, &uri));
+    ASSERT_EQ(8, played);
+    ASSERT_STREQ("e.mp3", uri);
+    ASSERT_TRUE(last_played_store_append(&store, "g.mp3", 10, 10));
+    ASSERT_TRUE(last_played_store_get(&store, 0, &played, &uri));
+    ASSERT_STREQ("g.mp3", uri);
+    ASSERT_TRUE(last_played_store_get(&store, 1, &played, &uri));
+    ASSERT_STREQ("e.mp3", uri);
+    last_played_store_close(&store);
+
+    unlink(filepath);
+    sdsfree(uri);
+    sdsfree(filepath);
+}
+
+UTEST(last_played_store, test_last_played_store_import) {
+    sds filepath = sdscatfmt(sdsempty(), "%S/state/last_played.log", workdir);
+    sds old_file = sdscatfmt(sdsempty(), "%S/state/last_played", workdir);
+    unlink(filepath);
+    //old format is sorted newest first
+    write_file(old_file, "30::c.mp3\n20::b.mp3\n10::a.mp3\n");
+    struct t_last_played_store store;
+    last_played_store_init(&store);
+    ASSERT_TRUE(last_played_store_open(&store, workdir, 2));
+    ASSERT_NE(0, access(old_file, F_OK));
+    ASSERT_EQ(2, store.length);
+
+    long long played;
+    sds uri = sdsempty();
+    ASSERT_TRUE(last_played_store_get(&store, 0, &played, &uri));
+    ASSERT_EQ(30, played);
+    ASSERT_STREQ("c.mp3", uri);
+    ASSERT_TRUE(last_played_store_get(&store, 1, &played, &uri));
+    ASSERT_EQ(20, played);
+    ASSERT_STREQ("b.mp3", uri);
+    last_played_store_close(&store);
+
+    unlink(filepath);
+    sdsfree(uri);
+    sdsfree(filepath);
+    sdsfree(old_file);
+}
+
+UTEST(last_played_store, test_last_played_store_song_missing) {
+    struct t_last_played_store store;
+    last_played_store_init(&store);
+    const struct mpd_song *song = NULL;
+    ASSERT_FALSE(last_played_store_song_get(&store, "a.mp3", &song));
+    last_played_store_song_missing(&store, "a.mp3");
+    song = (const struct mpd_song *)&store;
+    ASSERT_TRUE(last_played_store_song_get(&store, "a.mp3", &song));
+    ASSERT_TRUE(song == NULL);
+    //missing songs are looked up again after a database update
+    last_played_store_songs_clear(&store);
+    ASSERT_FALSE(last_played_store_song_get(&store, "a.mp3", &song));
+    last_played_store_close(&store);
+}
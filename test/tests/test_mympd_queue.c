@@ -8,11 +8,14 @@
 
 #include "../../dist/utest/utest.h"
 #include "../../src/lib/api.h"
+#include "../../src/lib/list.h"
 #include "../../src/lib/msg_queue.h"
 #include "../../src/lib/sds_extras.h"
 
+#include <pthread.h>
+
 UTEST(mympd_queue, push_shift) {
-    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_RESPONSE);
     sds test_data_in0 = sdsnew("test0");
     sds test_data_in1 = sdsnew("test0");
     sds test_data_in2 = sdsnew("test0");
@@ -44,7 +47,7 @@ UTEST(mympd_queue, push_shift) {
 }
 
 UTEST(mympd_queue, push_shift_id) {
-    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_RESPONSE);
     sds test_data_in0 = sdsnew("test0");
     sds test_data_in1 = sdsnew("test0");
     sds test_data_in2 = sdsnew("test0");
@@ -77,6 +80,14 @@ UTEST(mympd_queue, push_shift_id) {
     sdsfree(test_data_in2);
 }
 
+/**
+ * Pushed messages are moved from the ring buffer to the list by the consumer,
+ * cancel does this for request queues
+ */
+static void drain_ring(struct t_mympd_queue *queue) {
+    mympd_queue_cancel(queue, 0);
+}
+
 UTEST(mympd_queue, expire) {
     struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
     for (int i = 0; i < 50; i++) {
@@ -85,6 +96,7 @@ UTEST(mympd_queue, expire) {
         mympd_queue_push(test_queue, request, 10);
     }
     ASSERT_EQ(50, test_queue->length);
+    drain_ring(test_queue);
 
     //manually overwrite timestamp for first entry
     struct t_mympd_msg *current = test_queue->head;
@@ -118,3 +130,272 @@ UTEST(mympd_queue, expire) {
 
     mympd_queue_free(test_queue);
 }
+
+UTEST(mympd_queue, shift_duplicates) {
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
+    struct t_work_request *request = create_request(1, 1, MYMPD_API_QUEUE_LIST,
+        "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"MYMPD_API_QUEUE_LIST\",\"params\":{\"offset\":0,\"limit\":100}}");
+    mympd_queue_push(test_queue, create_request(2, 5, MYMPD_API_QUEUE_LIST,
+        "{\"jsonrpc\":\"2.0\",\"id\":5,\"method\":\"MYMPD_API_QUEUE_LIST\",\"params\":{\"offset\":0,\"limit\":100}}"), 0);
+    mympd_queue_push(test_queue, create_request(3, 6, MYMPD_API_QUEUE_LIST,
+        "{\"jsonrpc\":\"2.0\",\"id\":6,\"method\":\"MYMPD_API_QUEUE_LIST\",\"params\":{\"offset\":100,\"limit\":100}}"), 0);
+    mympd_queue_push(test_queue, create_request(4, 7, MYMPD_API_PLAYER_STATE,
+        "{\"jsonrpc\":\"2.0\",\"id\":7,\"method\":\"MYMPD_API_PLAYER_STATE\",\"params\":{}}"), 0);
+    mympd_queue_push(test_queue, create_request(5, 8, MYMPD_API_QUEUE_LIST,
+        "{\"jsonrpc\":\"2.0\",\"id\":8,\"method\":\"MYMPD_API_QUEUE_LIST\",\"params\":{\"offset\":0,\"limit\":100}}"), 0);
+
+    struct t_list duplicates;
+    list_init(&duplicates);
+    int shifted = mympd_queue_shift_duplicates(test_queue, request, &duplicates);
+    ASSERT_EQ(2, shifted);
+    ASSERT_EQ(2, duplicates.length);
+    ASSERT_EQ(2, test_queue->length);
+    struct t_work_request *duplicate = (struct t_work_request *)duplicates.head->user_data;
+    ASSERT_EQ(2, duplicate->conn_id);
+    duplicate = (struct t_work_request *)duplicates.tail->user_data;
+    ASSERT_EQ(5, duplicate->conn_id);
+
+    //tail must point to the remaining last entry
+    struct t_work_request *remaining = (struct t_work_request *)test_queue->tail->data;
+    ASSERT_EQ(4, remaining->conn_id);
+    mympd_queue_push(test_queue, create_request(6, 9, MYMPD_API_QUEUE_LIST,
+        "{\"jsonrpc\":\"2.0\",\"id\":9,\"method\":\"MYMPD_API_QUEUE_LIST\",\"params\":{\"offset\":0,\"limit\":100}}"), 0);
+    ASSERT_EQ(3, test_queue->length);
+
+    struct t_list_node *current;
+    while ((current = list_shift_first(&duplicates)) != NULL) {
+        free_request((struct t_work_request *)current->user_data);
+        list_node_free(current);
+    }
+    free_request(request);
+    mympd_queue_free(test_queue);
+}
+
+UTEST(mympd_queue, shift_duplicates_barrier) {
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
+    struct t_work_request *request = create_request(1, 1, MYMPD_API_QUEUE_LIST,
+        "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"MYMPD_API_QUEUE_LIST\",\"params\":{\"offset\":0,\"limit\":100}}");
+    mympd_queue_push(test_queue, create_request(2, 5, MYMPD_API_QUEUE_LIST,
+        "{\"jsonrpc\":\"2.0\",\"id\":5,\"method\":\"MYMPD_API_QUEUE_LIST\",\"params\":{\"offset\":0,\"limit\":100}}"), 0);
+    mympd_queue_push(test_queue, create_request(2, 6, MYMPD_API_QUEUE_CLEAR,
+        "{\"jsonrpc\":\"2.0\",\"id\":6,\"method\":\"MYMPD_API_QUEUE_CLEAR\",\"params\":{}}"), 0);
+    mympd_queue_push(test_queue, create_request(4, 7, MYMPD_API_QUEUE_LIST,
+        "{\"jsonrpc\":\"2.0\",\"id\":7,\"method\":\"MYMPD_API_QUEUE_LIST\",\"params\":{\"offset\":0,\"limit\":100}}"), 0);
+
+    //the request after the mutating request must not be merged
+    struct t_list duplicates;
+    list_init(&duplicates);
+    int shifted = mympd_queue_shift_duplicates(test_queue, request, &duplicates);
+    ASSERT_EQ(1, shifted);
+    ASSERT_EQ(2, test_queue->length);
+    struct t_work_request *duplicate = (struct t_work_request *)duplicates.head->user_data;
+    ASSERT_EQ(2, duplicate->conn_id);
+    struct t_work_request *remaining = (struct t_work_request *)test_queue->tail->data;
+    ASSERT_EQ(4, remaining->conn_id);
+
+    struct t_list_node *current;
+    while ((current = list_shift_first(&duplicates)) != NULL) {
+        free_request((struct t_work_request *)current->user_data);
+        list_node_free(current);
+    }
+    free_request(request);
+    mympd_queue_free(test_queue);
+}
+
+UTEST(mympd_queue, priority) {
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
+    mympd_queue_push(test_queue, create_request(1, 1, MYMPD_API_QUEUE_APPEND_SEARCH, NULL), 0);
+    mympd_queue_push(test_queue, create_request(2, 2, MYMPD_API_QUEUE_LIST, NULL), 0);
+    mympd_queue_push(test_queue, create_request(3, 3, MYMPD_API_PLAYER_PAUSE, NULL), 0);
+    //same connection as the bulk request, must not be reordered
+    mympd_queue_push(test_queue, create_request(1, 4, MYMPD_API_PLAYER_PLAY, NULL), 0);
+    mympd_queue_push(test_queue, create_request(4, 5, MYMPD_API_PLAYER_VOLUME_SET, NULL), 0);
+    ASSERT_EQ(5, test_queue->length);
+
+    //read requests and player controls of other connections are moved ahead,
+    //player controls are not reordered against each other
+    long expected[] = {2, 3, 1, 4, 5};
+    for (int i = 0; i < 5; i++) {
+        struct t_work_request *request = mympd_queue_shift(test_queue, 50, 0);
+        ASSERT_TRUE(request != NULL);
+        ASSERT_EQ(expected[i], request->id);
+        free_request(request);
+    }
+    ASSERT_EQ(0, test_queue->length);
+    ASSERT_TRUE(test_queue->head == NULL);
+    ASSERT_TRUE(test_queue->tail == NULL);
+    mympd_queue_free(test_queue);
+}
+
+UTEST(mympd_queue, priority_changes) {
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
+    mympd_queue_push(test_queue, create_request(1, 1, MYMPD_API_QUEUE_APPEND_SEARCH, NULL), 0);
+    mympd_queue_push(test_queue, create_request(2, 2, MYMPD_API_QUEUE_CLEAR, NULL), 0);
+    //must not be moved ahead of the queue clear
+    mympd_queue_push(test_queue, create_request(3, 3, MYMPD_API_PLAYER_PLAY, NULL), 0);
+
+    long expected[] = {1, 2, 3};
+    for (int i = 0; i < 3; i++) {
+        struct t_work_request *request = mympd_queue_shift(test_queue, 50, 0);
+        ASSERT_TRUE(request != NULL);
+        ASSERT_EQ(expected[i], request->id);
+        free_request(request);
+    }
+    mympd_queue_free(test_queue);
+}
+
+UTEST(mympd_queue, priority_aging) {
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
+    mympd_queue_push(test_queue, create_request(1, 1, MYMPD_API_QUEUE_APPEND_SEARCH, NULL), 0);
+    //the long running job waits already too long
+    drain_ring(test_queue);
+    ASSERT_TRUE(test_queue->head != NULL);
+    test_queue->head->enqueued -= MYMPD_QUEUE_AGING_MS + 1;
+    mympd_queue_push(test_queue, create_request(2, 2, MYMPD_API_QUEUE_LIST, NULL), 0);
+    mympd_queue_push(test_queue, create_request(3, 3, MYMPD_API_QUEUE_REPLACE_SEARCH, NULL), 0);
+    mympd_queue_push(test_queue, create_request(4, 4, MYMPD_API_QUEUE_LIST, NULL), 0);
+
+    long expected[] = {1, 2, 4, 3};
+    for (int i = 0; i < 4; i++) {
+        struct t_work_request *request = mympd_queue_shift(test_queue, 50, 0);
+        ASSERT_TRUE(request != NULL);
+        ASSERT_EQ(expected[i], request->id);
+        free_request(request);
+    }
+    mympd_queue_free(test_queue);
+}
+
+UTEST(mympd_queue, cancel) {
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
+    mympd_queue_push(test_queue, create_request(1, 1, MYMPD_API_QUEUE_LIST, NULL), 0);
+    mympd_queue_push(test_queue, create_request(2, 2, MYMPD_API_QUEUE_LIST, NULL), 0);
+    mympd_queue_push(test_queue, create_request(1, 3, MYMPD_API_QUEUE_CLEAR, NULL), 0);
+    mympd_queue_push(test_queue, create_request(1, 4, MYMPD_API_DATABASE_SEARCH, NULL), 0);
+
+    //requests with side effects are not canceled
+    int canceled = mympd_queue_cancel(test_queue, 1);
+    ASSERT_EQ(2, canceled);
+    ASSERT_EQ(2, test_queue->length);
+    struct t_work_request *request = mympd_queue_shift(test_queue, 50, 0);
+    ASSERT_EQ(2, request->id);
+    free_request(request);
+    request = mympd_queue_shift(test_queue, 50, 0);
+    ASSERT_EQ(3, request->id);
+    free_request(request);
+    ASSERT_TRUE(test_queue->tail == NULL);
+    mympd_queue_free(test_queue);
+}
+
+#define BENCH_PRODUCERS 4
+#define BENCH_MESSAGES 25000
+#define BENCH_IDLE_MESSAGES 500
+#define BENCH_IDLE_PAUSE_NS 50000
+
+/**
+ * Arguments for the benchmark producers
+ */
+struct t_bench_args {
+    struct t_mympd_queue *queue;  //!< the queue
+    int messages;                 //!< number of messages to push
+    long pause_ns;                //!< pause between the messages, 0 for none
+};
+
+static _Atomic long long bench_push_ns; //!< time spent in mympd_queue_push by all producers
+
+static void *bench_producer(void *arg) {
+    struct t_bench_args *args = (struct t_bench_args *)arg;
+    struct timespec tic;
+    struct timespec toc;
+    struct timespec pause = {0, args->pause_ns};
+    long long push_ns = 0;
+    for (int i = 0; i < args->messages; i++) {
+        struct t_work_response *response = create_response_new(1, i, MYMPD_API_PLAYER_STATE);
+        clock_gettime(CLOCK_MONOTONIC, &tic);
+        mympd_queue_push(args->queue, response, 0);
+        clock_gettime(CLOCK_MONOTONIC, &toc);
+        push_ns += ((long long)toc.tv_sec * 1000000000 + toc.tv_nsec) -
+            ((long long)tic.tv_sec * 1000000000 + tic.tv_nsec);
+        if (args->pause_ns > 0) {
+            nanosleep(&pause, NULL);
+        }
+    }
+    atomic_fetch_add(&bench_push_ns, push_ns);
+    return NULL;
+}
+
+/**
+ * Pushes messages from BENCH_PRODUCERS threads and shifts them in this thread
+ * @param queue the queue
+ * @param messages messages per producer
+ * @param pause_ns pause between the messages of a producer
+ * @return number of received messages
+ */
+static int bench_run(struct t_mympd_queue *queue, int messages, long pause_ns) {
+    struct t_bench_args args = {queue, messages, pause_ns};
+    atomic_store(&bench_push_ns, 0);
+    pthread_t producers[BENCH_PRODUCERS];
+    struct timespec tic;
+    struct timespec toc;
+    clock_gettime(CLOCK_MONOTONIC, &tic);
+    for (int i = 0; i < BENCH_PRODUCERS; i++) {
+        pthread_create(&producers[i], NULL, bench_producer, &args);
+    }
+    int received = 0;
+    while (received < BENCH_PRODUCERS * messages) {
+        //wait infinite, a missed wakeup blocks the test
+        struct t_work_response *response = mympd_queue_shift(queue, 0, 0);
+        if (response != NULL) {
+            free_response(response);
+            received++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &toc);
+    for (int i = 0; i < BENCH_PRODUCERS; i++) {
+        pthread_join(producers[i], NULL);
+    }
+    long long usec = ((long long)toc.tv_sec * 1000000 + toc.tv_nsec / 1000) -
+        ((long long)tic.tv_sec * 1000000 + tic.tv_nsec / 1000);
+    printf("%d producers, %d messages: %lld us, %.0f messages/s, %lld ns per push\n", BENCH_PRODUCERS, received,
+        usec, (double)received * 1000000 / (double)(usec > 0 ? usec : 1), atomic_load(&bench_push_ns) / received);
+    return received;
+}
+
+UTEST(mympd_queue, contention_benchmark) {
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_RESPONSE);
+    ASSERT_EQ(BENCH_PRODUCERS * BENCH_MESSAGES, bench_run(test_queue, BENCH_MESSAGES, 0));
+    ASSERT_EQ(0, test_queue->length);
+    ASSERT_TRUE(test_queue->head == NULL);
+    mympd_queue_free(test_queue);
+}
+
+UTEST(mympd_queue, idle_consumer_benchmark) {
+    //the consumer sleeps most of the time
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_RESPONSE);
+    ASSERT_EQ(BENCH_PRODUCERS * BENCH_IDLE_MESSAGES, bench_run(test_queue, BENCH_IDLE_MESSAGES, BENCH_IDLE_PAUSE_NS));
+    ASSERT_EQ(0, test_queue->length);
+    ASSERT_TRUE(test_queue->head == NULL);
+    mympd_queue_free(test_queue);
+}
+
+UTEST(mympd_queue, shift_id_index) {
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_RESPONSE);
+    for (long i = 1; i <= 100; i++) {
+        mympd_queue_push(test_queue, create_response_new(-2, i, MYMPD_API_PLAYER_STATE), i % 10);
+    }
+    ASSERT_EQ(100, test_queue->length);
+    //responses with the same id are returned in push order
+    struct t_work_response *response = mympd_queue_shift(test_queue, 50, 5);
+    ASSERT_EQ(5, response->id);
+    free_response(response);
+    response = mympd_queue_shift(test_queue, 50, 5);
+    ASSERT_EQ(15, response->id);
+    free_response(response);
+    //id 0 is the head of the queue
+    response = mympd_queue_shift(test_queue, 50, 0);
+    ASSERT_EQ(1, response->id);
+    free_response(response);
+    response = mympd_queue_shift(test_queue, 50, 11);
+    ASSERT_TRUE(response == NULL);
+    ASSERT_EQ(97, test_queue->length);
+    mympd_queue_free(test_queue);
+}
@@ -0,0 +1,129 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "../utility.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/filehandler.h"
+#include "../../src/lib/play_stats.h"
+#include "../../src/lib/sds_extras.h"
+
+#include <unistd.h>
+
+static void add_event(struct t_play_stats *stats, time_t t, bool skipped, const char *uri,
+        const char *artist, const char *genre)
+{
+    struct t_play_event event = {
+        .time = t,
+        .skipped = skipped,
+        .uri = uri,
+        .title = "title",
+        .artist = artist,
+        .album = "album",
+        .albumartist = artist,
+        .genre = genre
+    };
+    play_stats_add(stats, &event);
+}
+
+static long get_plays(rax *r, const char *key) {
+    void *data = raxFind(r, (unsigned char *)key, strlen(key));
+    return data == raxNotFound
+        ? -1
+        : ((struct t_play_stats_counter *)data)->plays;
+}
+
+static long get_skips(rax *r, const char *key) {
+    void *data = raxFind(r, (unsigned char *)key, strlen(key));
+    return data == raxNotFound
+        ? -1
+        : ((struct t_play_stats_counter *)data)->skips;
+}
+
+UTEST(play_stats, test_play_stats_aggregate) {
+    sds filepath = sdscatfmt(sdsempty(), "%S/state/play_events", workdir);
+    unlink(filepath);
+    time_t now = time(NULL);
+    time_t today = play_stats_day(now);
+    time_t yesterday = play_stats_day(today - 1);
+    time_t expired = today - (PLAY_STATS_DAYS_MAX + 2) * 86400;
+
+    struct t_play_stats stats;
+    play_stats_init(&stats);
+    ASSERT_EQ(0, play_stats_open(&stats, workdir, now));
+    add_event(&stats, today + 10, false, "a.mp3", "Artist1", "Rock");
+    add_event(&stats, today + 20, true, "b.mp3", "Artist2", "Pop");
+    add_event(&stats, yesterday + 10, false, "a.mp3", "Artist1", "Rock");
+    add_event(&stats, yesterday + 20, false, "c.mp3", "Artist2", "");
+    ASSERT_EQ(2, stats.buckets.length);
+
+    struct t_play_stats_counter total;
+    //today
+    rax *merged = play_stats_merge(&stats, PLAY_STATS_DIM_ARTIST, 1, now, &total);
+    ASSERT_EQ(1, total.plays);
+    ASSERT_EQ(1, total.skips);
+    ASSERT_EQ(1, get_plays(merged, "Artist1"));
+    ASSERT_EQ(1, get_skips(merged, "Artist2"));
+    play_stats_merge_free(merged);
+    //today and yesterday
+    merged = play_stats_merge(&stats, PLAY_STATS_DIM_ARTIST, 2, now, &total);
+    ASSERT_EQ(3, total.plays);
+    ASSERT_EQ(2, get_plays(merged, "Artist1"));
+    ASSERT_EQ(1, get_plays(merged, "Artist2"));
+    play_stats_merge_free(merged);
+    //empty tags are not counted
+    merged = play_stats_merge(&stats, PLAY_STATS_DIM_GENRE, 2, now, &total);
+    ASSERT_EQ(2U, raxSize(merged));
+    ASSERT_EQ(2, get_plays(merged, "Rock"));
+    ASSERT_EQ(1, get_skips(merged, "Pop"));
+    play_stats_merge_free(merged);
+    play_stats_close(&stats);
+
+    //prepend an expired event and replay the log
+    FILE *fp = fopen(filepath, "r");
+    sds content = sdsempty();
+    sds line = sdsempty();
+    while (sds_getline(&line, fp, LINE_LENGTH_MAX) == 0) {
+        content = sdscatfmt(content, "%S\n", line);
+    }
+    fclose(fp);
+    fp = fopen(filepath, "w");
+    fprintf(fp, "{\"time\":%lld,\"skipped\":false,\"uri\":\"old.mp3\"}\n", (long long)expired);
+    fputs("invalid\n", fp);
+    fputs(content, fp);
+    fclose(fp);
+    FREE_SDS(content);
+
+    play_stats_init(&stats);
+    ASSERT_EQ(4, play_stats_open(&stats, workdir, now));
+    ASSERT_EQ(2, stats.buckets.length);
+    merged = play_stats_merge(&stats, PLAY_STATS_DIM_SONG, 366, now, &total);
+    ASSERT_EQ(3, total.plays);
+    ASSERT_EQ(1, total.skips);
+    const char song_key[] = "a.mp3\0title";
+    void *data = raxFind(merged, (unsigned char *)song_key, sizeof(song_key) - 1);
+    ASSERT_TRUE(data != raxNotFound);
+    ASSERT_EQ(2, ((struct t_play_stats_counter *)data)->plays);
+    play_stats_merge_free(merged);
+    play_stats_close(&stats);
+
+    //expired event was removed from the log
+    fp = fopen(filepath, "r");
+    ASSERT_EQ(0, sds_getline(&line, fp, LINE_LENGTH_MAX));
+    ASSERT_TRUE(strstr(line, "old.mp3") == NULL);
+    fclose(fp);
+
+    FREE_SDS(line);
+    unlink(filepath);
+    FREE_SDS(filepath);
+}
+
+UTEST(play_stats, test_play_stats_dim_parse) {
+    ASSERT_EQ(PLAY_STATS_DIM_ARTIST, play_stats_dim_parse("Artist"));
+    ASSERT_EQ(PLAY_STATS_DIM_SONG, play_stats_dim_parse("Song"));
+    ASSERT_EQ(PLAY_STATS_DIM_UNKNOWN, play_stats_dim_parse("Title"));
+}
@@ -0,0 +1,80 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/playlist_diff.h"
+
+#include <string.h>
+
+static void populate(struct t_list *l, const char *songs) {
+    for (const char *p = songs; *p != '\0'; p++) {
+        list_push_len(l, p, 1, 0, NULL, 0, NULL);
+    }
+}
+
+/**
+ * Applies the operations to the current list and returns the number of operations
+ */
+static long apply_diff(const char *current_songs, const char *target_songs) {
+    struct t_list current;
+    struct t_list target;
+    struct t_list deletes;
+    struct t_list adds;
+    list_init(&current);
+    list_init(&target);
+    list_init(&deletes);
+    list_init(&adds);
+    populate(&current, current_songs);
+    populate(&target, target_songs);
+    long ops = playlist_diff(&current, &target, &deletes, &adds);
+    struct t_list_node *node;
+    for (node = deletes.head; node != NULL; node = node->next) {
+        list_remove_node(&current, (long)node->value_i);
+    }
+    for (node = adds.head; node != NULL; node = node->next) {
+        if (node->value_i == 0) {
+            list_insert(&current, node->key, 0, NULL, NULL);
+        }
+        else {
+            list_push(&current, node->key, 0, NULL, NULL);
+            list_move_item_pos(&current, current.length - 1, (long)node->value_i);
+        }
+    }
+    char result[64] = "";
+    for (node = current.head; node != NULL; node = node->next) {
+        strcat(result, node->key);
+    }
+    bool equal = strcmp(result, target_songs) == 0;
+    list_clear(&current);
+    list_clear(&target);
+    list_clear(&deletes);
+    list_clear(&adds);
+    return equal == true ? ops : -1;
+}
+
+UTEST(playlist_diff, test_playlist_diff) {
+    //unchanged
+    ASSERT_EQ(0, apply_diff("abcde", "abcde"));
+    ASSERT_EQ(0, apply_diff("", ""));
+    //new playlist
+    ASSERT_EQ(3, apply_diff("", "abc"));
+    //append and remove
+    ASSERT_EQ(1, apply_diff("abcd", "abcde"));
+    ASSERT_EQ(1, apply_diff("abcde", "abde"));
+    ASSERT_EQ(4, apply_diff("abcde", "xbcdy"));
+    //moved song is deleted and added
+    ASSERT_EQ(2, apply_diff("abcde", "bcdea"));
+    ASSERT_EQ(2, apply_diff("abcde", "eabcd"));
+    //duplicates are matched in order
+    ASSERT_EQ(1, apply_diff("abab", "ababa"));
+    ASSERT_EQ(3, apply_diff("abab", "aabab"));
+    ASSERT_EQ(4, apply_diff("aabb", "bbaa"));
+    //complete change
+    ASSERT_EQ(6, apply_diff("abc", "xyz"));
+    ASSERT_EQ(3, apply_diff("abc", ""));
+}
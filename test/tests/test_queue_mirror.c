@@ -0,0 +1,100 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/sds_extras.h"
+#include "../../src/mpd_client/queue_mirror.h"
+#include "../../src/mpd_client/search_local.h"
+
+static struct mpd_song *new_queue_song(const char *uri, const char *pos, const char *duration) {
+    struct mpd_pair pair = { "file", uri };
+    struct mpd_song *song = mpd_song_begin(&pair);
+    pair.name = "Pos";
+    pair.value = pos;
+    mpd_song_feed(song, &pair);
+    pair.name = "Time";
+    pair.value = duration;
+    mpd_song_feed(song, &pair);
+    return song;
+}
+
+UTEST(queue_mirror, test_queue_mirror_changes) {
+    struct t_queue_mirror mirror;
+    queue_mirror_init(&mirror);
+    ASSERT_FALSE(mirror.valid);
+
+    //initial queue
+    queue_mirror_set_length(&mirror, 3);
+    ASSERT_FALSE(queue_mirror_is_complete(&mirror));
+    ASSERT_TRUE(queue_mirror_replace(&mirror, new_queue_song("a.mp3", "0", "10")));
+    ASSERT_TRUE(queue_mirror_replace(&mirror, new_queue_song("b.mp3", "1", "20")));
+    ASSERT_TRUE(queue_mirror_replace(&mirror, new_queue_song("c.mp3", "2", "30")));
+    ASSERT_TRUE(queue_mirror_is_complete(&mirror));
+    ASSERT_EQ(60U, mirror.total_time);
+
+    //remove b.mp3, plchanges reports only the moved song
+    queue_mirror_set_length(&mirror, 2);
+    ASSERT_TRUE(queue_mirror_replace(&mirror, new_queue_song("c.mp3", "1", "30")));
+    ASSERT_TRUE(queue_mirror_is_complete(&mirror));
+    ASSERT_STREQ("a.mp3", mpd_song_get_uri(mirror.songs[0]));
+    ASSERT_STREQ("c.mp3", mpd_song_get_uri(mirror.songs[1]));
+    ASSERT_EQ(40U, mirror.total_time);
+
+    //insert d.mp3 at the first position
+    queue_mirror_set_length(&mirror, 3);
+    ASSERT_TRUE(queue_mirror_replace(&mirror, new_queue_song("d.mp3", "0", "5")));
+    ASSERT_TRUE(queue_mirror_replace(&mirror, new_queue_song("a.mp3", "1", "10")));
+    ASSERT_TRUE(queue_mirror_replace(&mirror, new_queue_song("c.mp3", "2", "30")));
+    ASSERT_STREQ("d.mp3", mpd_song_get_uri(mirror.songs[0]));
+    ASSERT_EQ(2U, mpd_song_get_pos(mirror.songs[2]));
+    ASSERT_EQ(45U, mirror.total_time);
+
+    //positions outside the mirror are rejected
+    struct mpd_song *song = new_queue_song("e.mp3", "3", "1");
+    ASSERT_FALSE(queue_mirror_replace(&mirror, song));
+    mpd_song_free(song);
+
+    //a gap marks the mirror as incomplete
+    queue_mirror_set_length(&mirror, 4);
+    ASSERT_FALSE(queue_mirror_is_complete(&mirror));
+
+    queue_mirror_clear(&mirror);
+    ASSERT_EQ(0U, mirror.length);
+    ASSERT_EQ(0U, mirror.total_time);
+    ASSERT_FALSE(mirror.valid);
+}
+
+UTEST(queue_mirror, test_search_expression_is_local) {
+    const char *local[] = {
+        "((Artist contains 'abc'))",
+        "((Artist == 'abc') AND (any contains 'def'))",
+        "((Title =~ '^a'))",
+        NULL
+    };
+    const char *remote[] = {
+        "((base 'music'))",
+        "((file == 'a.mp3'))",
+        "((Artist contains 'it\\'s'))",
+        "((prio >= 5) AND (Artist contains 'abc'))",
+        NULL
+    };
+    for (const char **p = local; *p != NULL; p++) {
+        sds expression = sdsnew(*p);
+        struct t_list *expr_list = parse_search_expression_to_list(expression);
+        EXPECT_TRUE(search_expression_is_local(expr_list, expression));
+        free_search_expression_list(expr_list);
+        sdsfree(expression);
+    }
+    for (const char **p = remote; *p != NULL; p++) {
+        sds expression = sdsnew(*p);
+        struct t_list *expr_list = parse_search_expression_to_list(expression);
+        EXPECT_FALSE(search_expression_is_local(expr_list, expression));
+        free_search_expression_list(expr_list);
+        sdsfree(expression);
+    }
+}
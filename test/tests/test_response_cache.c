@@ -0,0 +1,155 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/api.h"
+#include "../../src/lib/jsonrpc.h"
+#include "../../src/lib/response_cache.h"
+#include "../../src/lib/sds_extras.h"
+
+#include <string.h>
+
+static struct t_work_request *create_tag_list_request(long request_id, const char *params) {
+    sds data = sdscatfmt(sdsempty(), "{\"jsonrpc\":\"2.0\",\"id\":%l,\"method\":\"MYMPD_API_DATABASE_TAG_LIST\",\"params\":%s}", request_id, params);
+    struct t_work_request *request = create_request(1, request_id, MYMPD_API_DATABASE_TAG_LIST, data);
+    FREE_SDS(data);
+    return request;
+}
+
+UTEST(response_cache, test_response_cache_get) {
+    struct t_response_cache response_cache;
+    response_cache_init(&response_cache);
+    sds buffer = sdsempty();
+
+    struct t_work_request *request = create_tag_list_request(1, "{\"tag\": \"Genre\", \"offset\": 0}");
+    //error responses are not cached
+    buffer = jsonrpc_respond_message(buffer, request->cmd_id, request->id,
+        JSONRPC_FACILITY_DATABASE, JSONRPC_SEVERITY_ERROR, "Error");
+    ASSERT_FALSE(response_cache_add(&response_cache, request, buffer));
+    buffer = jsonrpc_respond_start(buffer, request->cmd_id, request->id);
+    buffer = sdscat(buffer, "\"data\":[\"Rock\"]");
+    buffer = jsonrpc_end(buffer);
+    ASSERT_TRUE(response_cache_add(&response_cache, request, buffer));
+    free_request(request);
+
+    //same params with other whitespace and other jsonrpc id
+    request = create_tag_list_request(5, "{\"tag\":\"Genre\",\"offset\":0}");
+    sds result = sdsempty();
+    ASSERT_TRUE(response_cache_get(&response_cache, request, &result));
+    ASSERT_STREQ("{\"jsonrpc\":\"2.0\",\"id\":5,\"result\":{\"method\":\"MYMPD_API_DATABASE_TAG_LIST\",\"data\":[\"Rock\"]}}", result);
+    free_request(request);
+
+    //other params
+    request = create_tag_list_request(5, "{\"tag\":\"Genre\",\"offset\":50}");
+    ASSERT_FALSE(response_cache_get(&response_cache, request, &result));
+    free_request(request);
+    ASSERT_EQ(1U, response_cache.hits);
+    ASSERT_EQ(1U, response_cache.misses);
+
+    //methods with side effects are never cached
+    request = create_request(1, 0, MYMPD_API_PLAYER_PLAY, "{\"params\":{}}");
+    buffer = jsonrpc_respond_ok(buffer, request->cmd_id, request->id, JSONRPC_FACILITY_PLAYER);
+    ASSERT_FALSE(response_cache_add(&response_cache, request, buffer));
+    free_request(request);
+
+    FREE_SDS(result);
+    FREE_SDS(buffer);
+    response_cache_free(&response_cache);
+}
+
+UTEST(response_cache, test_response_cache_invalidate) {
+    struct t_response_cache response_cache;
+    response_cache_init(&response_cache);
+    struct t_work_request *request = create_tag_list_request(0, "{}");
+    sds buffer = jsonrpc_respond_start(sdsempty(), request->cmd_id, request->id);
+    buffer = jsonrpc_end(buffer);
+    ASSERT_TRUE(response_cache_add(&response_cache, request, buffer));
+
+    //tag list does not depend on stickers
+    response_cache_invalidate(&response_cache, RESPONSE_CACHE_DEP_STICKERS);
+    ASSERT_TRUE(response_cache_get(&response_cache, request, &buffer));
+    for (int i = 0; i < 3; i++) {
+        struct t_work_request *page_request = create_tag_list_request(0, i == 0 ? "{\"offset\":0}" : i == 1 ? "{\"offset\":50}" : "{\"offset\":100}");
+        ASSERT_TRUE(response_cache_add(&response_cache, page_request, buffer));
+        free_request(page_request);
+    }
+    ASSERT_EQ(4U, response_cache.cache->numele);
+    //a new album cache drops database dependent responses
+    response_cache_invalidate_by_method(&response_cache, INTERNAL_API_ALBUMCACHE_CREATED);
+    ASSERT_FALSE(response_cache_get(&response_cache, request, &buffer));
+    ASSERT_EQ(0U, response_cache.cache->numele);
+    ASSERT_EQ(0U, response_cache.size);
+
+    free_request(request);
+    FREE_SDS(buffer);
+    response_cache_free(&response_cache);
+}
+
+UTEST(response_cache, test_response_cache_generation) {
+    struct t_response_cache response_cache;
+    response_cache_init(&response_cache);
+    struct t_work_request *request = create_tag_list_request(0, "{}");
+    sds buffer = jsonrpc_respond_start(sdsempty(), request->cmd_id, request->id);
+    buffer = jsonrpc_end(buffer);
+
+    //response created before an invalidation is not cached
+    unsigned long generation = response_cache_generation(&response_cache);
+    response_cache_invalidate(&response_cache, RESPONSE_CACHE_DEP_STICKERS);
+    ASSERT_FALSE(response_cache_add_generation(&response_cache, request, buffer, generation));
+    ASSERT_EQ(0U, response_cache.cache->numele);
+
+    generation = response_cache_generation(&response_cache);
+    ASSERT_TRUE(response_cache_add_generation(&response_cache, request, buffer, generation));
+    ASSERT_TRUE(response_cache_get(&response_cache, request, &buffer));
+
+    free_request(request);
+    FREE_SDS(buffer);
+    response_cache_free(&response_cache);
+}
+
+UTEST(response_cache, test_response_cache_lru) {
+    struct t_response_cache response_cache;
+    response_cache_init(&response_cache);
+    sds buffer = sdsempty();
+    sds data = sdsempty();
+    data = sdsgrowzero(data, RESPONSE_CACHE_SIZE / 4 - 200);
+    memset(data, 'a', sdslen(data));
+
+    //four entries fill the cache
+    struct t_work_request *requests[5];
+    for (int i = 0; i < 5; i++) {
+        sds params = sdscatfmt(sdsempty(), "{\"offset\":%i}", i);
+        requests[i] = create_tag_list_request(1, params);
+        FREE_SDS(params);
+    }
+    for (int i = 0; i < 4; i++) {
+        buffer = jsonrpc_respond_start(buffer, requests[i]->cmd_id, requests[i]->id);
+        buffer = sdscatfmt(buffer, "\"data\":\"%S\"", data);
+        buffer = jsonrpc_end(buffer);
+        ASSERT_TRUE(response_cache_add(&response_cache, requests[i], buffer));
+    }
+    //the first entry is now the most recently used entry
+    ASSERT_TRUE(response_cache_get(&response_cache, requests[0], &buffer));
+
+    //evicts the second entry
+    buffer = jsonrpc_respond_start(buffer, requests[4]->cmd_id, requests[4]->id);
+    buffer = sdscatfmt(buffer, "\"data\":\"%S\"", data);
+    buffer = jsonrpc_end(buffer);
+    ASSERT_TRUE(response_cache_add(&response_cache, requests[4], buffer));
+    ASSERT_EQ(4U, response_cache.cache->numele);
+    ASSERT_TRUE(response_cache_get(&response_cache, requests[0], &buffer));
+    ASSERT_FALSE(response_cache_get(&response_cache, requests[1], &buffer));
+    ASSERT_TRUE(response_cache_get(&response_cache, requests[2], &buffer));
+
+    for (int i = 0; i < 5; i++) {
+        free_request(requests[i]);
+    }
+    FREE_SDS(data);
+    FREE_SDS(buffer);
+    response_cache_free(&response_cache);
+}
@@ -0,0 +1,147 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/api.h"
+#include "../../src/lib/jsonrpc.h"
+#include "../../src/lib/msg_queue.h"
+#include "../../src/lib/response_stream.h"
+#include "../../src/lib/sds_extras.h"
+
+#include <pthread.h>
+
+UTEST(response_stream, test_response_stream_flush) {
+    web_server_queue = mympd_queue_create("web_server_queue", QUEUE_TYPE_RESPONSE);
+    struct t_work_request *request = create_request(1, 10, MYMPD_API_QUEUE_LIST, NULL);
+    request->stream = true;
+    struct t_response_stream stream;
+    response_stream_init(&stream, request);
+
+    sds buffer = jsonrpc_respond_start(sdsempty(), request->cmd_id, request->id);
+    buffer = sdscat(buffer, "\"data\":[");
+    //small buffers are not sent
+    buffer = response_stream_flush(&stream, buffer);
+    ASSERT_FALSE(stream.started);
+    ASSERT_EQ(0, web_server_queue->length);
+
+    while (sdslen(buffer) < RESPONSE_STREAM_CHUNK_SIZE) {
+        buffer = sdscat(buffer, "{\"uri\":\"song.mp3\"},");
+    }
+    size_t len = sdslen(buffer);
+    buffer = response_stream_flush(&stream, buffer);
+    ASSERT_TRUE(stream.started);
+    ASSERT_EQ(0U, sdslen(buffer));
+    ASSERT_EQ(len, response_stream_pending(1));
+    struct t_work_response *chunk = mympd_queue_shift(web_server_queue, 50, 0);
+    ASSERT_EQ((unsigned)INTERNAL_API_STREAM_CHUNK, chunk->cmd_id);
+    ASSERT_EQ(1, chunk->conn_id);
+    ASSERT_EQ(len, sdslen(chunk->data));
+    response_stream_chunk_sent(1, sdslen(chunk->data));
+    ASSERT_EQ(0U, response_stream_pending(1));
+    free_response(chunk);
+
+    //an error after the first chunk aborts the response
+    struct t_work_response *response = create_response(request);
+    response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+        JSONRPC_FACILITY_QUEUE, JSONRPC_SEVERITY_ERROR, "Error");
+    response_stream_end(&stream, response);
+    ASSERT_EQ((unsigned)INTERNAL_API_STREAM_ABORT, response->cmd_id);
+    free_response(response);
+
+    sdsfree(buffer);
+    free_request(request);
+    web_server_queue = mympd_queue_free(web_server_queue);
+}
+
+#define STREAM_TEST_CHUNKS ((RESPONSE_STREAM_PENDING_MAX / RESPONSE_STREAM_CHUNK_SIZE) + 4)
+
+static void *stream_producer(void *arg) {
+    struct t_response_stream *stream = (struct t_response_stream *)arg;
+    for (int i = 0; i < STREAM_TEST_CHUNKS; i++) {
+        sds buffer = sdsempty();
+        buffer = sdsgrowzero(buffer, RESPONSE_STREAM_CHUNK_SIZE);
+        buffer = response_stream_flush(stream, buffer);
+        sdsfree(buffer);
+    }
+    return NULL;
+}
+
+UTEST(response_stream, test_response_stream_wait) {
+    web_server_queue = mympd_queue_create("web_server_queue", QUEUE_TYPE_RESPONSE);
+    struct t_work_request *request = create_request(1, 10, MYMPD_API_QUEUE_LIST, NULL);
+    request->stream = true;
+    struct t_response_stream stream;
+    response_stream_init(&stream, request);
+    pthread_t producer;
+    pthread_create(&producer, NULL, stream_producer, &stream);
+    //the producer waits until the chunks are written
+    int received = 0;
+    while (received < STREAM_TEST_CHUNKS) {
+        struct t_work_response *chunk = mympd_queue_shift(web_server_queue, 0, 0);
+        ASSERT_TRUE(response_stream_pending(1) <= RESPONSE_STREAM_PENDING_MAX + RESPONSE_STREAM_CHUNK_SIZE);
+        //chunks of other connections do not count
+        ASSERT_EQ(0U, response_stream_pending(2));
+        response_stream_chunk_sent(1, sdslen(chunk->data));
+        free_response(chunk);
+        received++;
+    }
+    pthread_join(producer, NULL);
+    ASSERT_FALSE(stream.aborted);
+    ASSERT_EQ(0U, response_stream_pending(1));
+    struct t_work_response *response = create_response(request);
+    response->data = sdscat(response->data, "]}}");
+    response_stream_end(&stream, response);
+    ASSERT_EQ((unsigned)MYMPD_API_QUEUE_LIST, response->cmd_id);
+    free_response(response);
+    free_request(request);
+    web_server_queue = mympd_queue_free(web_server_queue);
+}
+
+UTEST(response_stream, test_response_stream_abort) {
+    web_server_queue = mympd_queue_create("web_server_queue", QUEUE_TYPE_RESPONSE);
+    struct t_work_request *request = create_request(1, 10, MYMPD_API_QUEUE_LIST, NULL);
+    request->stream = true;
+    struct t_response_stream stream;
+    response_stream_init(&stream, request);
+    stream.wait_left = 200;
+    //the connection reads nothing, the producer gives up after the wait time
+    stream_producer(&stream);
+    ASSERT_TRUE(stream.aborted);
+    ASSERT_TRUE(response_stream_pending(1) <= RESPONSE_STREAM_PENDING_MAX + RESPONSE_STREAM_CHUNK_SIZE);
+    struct t_work_response *response = create_response(request);
+    response->data = sdscat(response->data, "]}}");
+    response_stream_end(&stream, response);
+    ASSERT_EQ((unsigned)INTERNAL_API_STREAM_ABORT, response->cmd_id);
+    free_response(response);
+    //the webserver discards the queued chunks
+    struct t_work_response *chunk;
+    while ((chunk = mympd_queue_shift(web_server_queue, 50, 0)) != NULL) {
+        response_stream_chunk_sent(1, sdslen(chunk->data));
+        free_response(chunk);
+    }
+    ASSERT_EQ(0U, response_stream_pending(1));
+    free_request(request);
+    web_server_queue = mympd_queue_free(web_server_queue);
+}
+
+UTEST(response_stream, test_response_stream_disabled) {
+    //websocket and internal requests are not streamed
+    struct t_work_request *request = create_request(-1, 10, MYMPD_API_QUEUE_LIST, NULL);
+    request->stream = true;
+    struct t_response_stream stream;
+    response_stream_init(&stream, request);
+    sds buffer = sdsempty();
+    while (sdslen(buffer) < RESPONSE_STREAM_CHUNK_SIZE) {
+        buffer = sdscat(buffer, "{\"uri\":\"song.mp3\"},");
+    }
+    buffer = response_stream_flush(&stream, buffer);
+    ASSERT_FALSE(stream.started);
+    ASSERT_TRUE(sdslen(buffer) >= RESPONSE_STREAM_CHUNK_SIZE);
+    sdsfree(buffer);
+    free_request(request);
+}
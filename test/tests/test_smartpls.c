@@ -0,0 +1,128 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "../utility.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/sds_extras.h"
+#include "../../src/lib/smartpls.h"
+
+#include <unistd.h>
+
+static struct mpd_song *new_song(const char *uri, const char *genre, const char *last_modified) {
+    struct mpd_pair pair = { "file", uri };
+    struct mpd_song *song = mpd_song_begin(&pair);
+    pair.name = "Genre";
+    pair.value = genre;
+    mpd_song_feed(song, &pair);
+    pair.name = "Last-Modified";
+    pair.value = last_modified;
+    mpd_song_feed(song, &pair);
+    return song;
+}
+
+static struct t_tags test_tags = {
+    .len = 2,
+    .tags[0] = MPD_TAG_ARTIST,
+    .tags[1] = MPD_TAG_GENRE
+};
+
+UTEST(smartpls, test_smartpls_rule_sticker) {
+    ASSERT_TRUE(smartpls_save_sticker(workdir, "test-sticker", "playCount", 2, 0, ""));
+    struct t_smartpls_rule *rule = smartpls_rule_read(workdir, "test-sticker");
+    ASSERT_TRUE(rule != NULL);
+    ASSERT_EQ(SMARTPLS_TYPE_STICKER, rule->type);
+    ASSERT_TRUE(smartpls_rule_set_local(rule, &test_tags));
+
+    struct t_sticker sticker = { 0, 0, 0, 0, 1 };
+    sticker.play_count = 10;
+    smartpls_rule_eval_sticker(rule, "d.mp3", &sticker);
+    sticker.play_count = 6;
+    smartpls_rule_eval_sticker(rule, "c.mp3", &sticker);
+    sticker.play_count = 4;
+    smartpls_rule_eval_sticker(rule, "b.mp3", &sticker);
+    //not set
+    sticker.play_count = 0;
+    smartpls_rule_eval_sticker(rule, "a.mp3", &sticker);
+    ASSERT_EQ(3, rule->content.length);
+
+    //minimum value is the half of the maximum value, ordered by value
+    smartpls_rule_eval_sticker_finish(rule);
+    ASSERT_EQ(2, rule->content.length);
+    ASSERT_STREQ("c.mp3", rule->content.head->key);
+    ASSERT_STREQ("d.mp3", rule->content.tail->key);
+    smartpls_rule_free(rule);
+
+    //stickers that are not cached are evaluated by mpd
+    ASSERT_TRUE(smartpls_save_sticker(workdir, "test-sticker", "rating", 10, 1, ""));
+    rule = smartpls_rule_read(workdir, "test-sticker");
+    ASSERT_TRUE(rule != NULL);
+    ASSERT_FALSE(smartpls_rule_set_local(rule, &test_tags));
+    smartpls_rule_free(rule);
+    unlink("/tmp/mympd-test/smartpls/test-sticker");
+}
+
+UTEST(smartpls, test_smartpls_rule_search) {
+    ASSERT_TRUE(smartpls_save_search(workdir, "test-search", "((Genre contains 'Rock'))", "Genre"));
+    struct t_smartpls_rule *rule = smartpls_rule_read(workdir, "test-search");
+    ASSERT_TRUE(rule != NULL);
+    ASSERT_TRUE(smartpls_rule_set_local(rule, &test_tags));
+
+    struct mpd_song *song = new_song("a.mp3", "Rock", "2022-01-01T00:00:00Z");
+    smartpls_rule_eval_song(rule, song, &test_tags);
+    mpd_song_free(song);
+    song = new_song("b.mp3", "Pop", "2022-01-01T00:00:00Z");
+    smartpls_rule_eval_song(rule, song, &test_tags);
+    mpd_song_free(song);
+    ASSERT_EQ(1, rule->content.length);
+    ASSERT_STREQ("a.mp3", rule->content.head->key);
+    ASSERT_STREQ("Rock", rule->content.head->value_p);
+    smartpls_rule_free(rule);
+
+    //tags that are not included in the song data
+    ASSERT_TRUE(smartpls_save_search(workdir, "test-search", "((Album contains 'abc'))", ""));
+    rule = smartpls_rule_read(workdir, "test-search");
+    ASSERT_TRUE(rule != NULL);
+    ASSERT_FALSE(smartpls_rule_set_local(rule, &test_tags));
+    smartpls_rule_free(rule);
+
+    //exact matches and the any tag are evaluated by mpd
+    const char *expressions[] = {
+        "((Genre == 'Rock'))",
+        "((Genre != 'Rock'))",
+        "((any contains 'Rock'))",
+        NULL
+    };
+    for (const char **p = expressions; *p != NULL; p++) {
+        ASSERT_TRUE(smartpls_save_search(workdir, "test-search", *p, ""));
+        rule = smartpls_rule_read(workdir, "test-search");
+        ASSERT_TRUE(rule != NULL);
+        EXPECT_FALSE(smartpls_rule_set_local(rule, &test_tags));
+        smartpls_rule_free(rule);
+    }
+    unlink("/tmp/mympd-test/smartpls/test-search");
+}
+
+UTEST(smartpls, test_smartpls_rule_newest) {
+    ASSERT_TRUE(smartpls_save_newest(workdir, "test-newest", 86400, ""));
+    struct t_smartpls_rule *rule = smartpls_rule_read(workdir, "test-newest");
+    ASSERT_TRUE(rule != NULL);
+    ASSERT_TRUE(smartpls_rule_set_local(rule, &test_tags));
+    //2022-01-02T00:00:00Z
+    rule->since = 1641081600 - rule->timerange;
+
+    struct mpd_song *song = new_song("a.mp3", "Rock", "2022-01-01T12:00:00Z");
+    smartpls_rule_eval_song(rule, song, &test_tags);
+    mpd_song_free(song);
+    song = new_song("b.mp3", "Rock", "2021-12-31T12:00:00Z");
+    smartpls_rule_eval_song(rule, song, &test_tags);
+    mpd_song_free(song);
+    ASSERT_EQ(1, rule->content.length);
+    ASSERT_STREQ("a.mp3", rule->content.head->key);
+    smartpls_rule_free(rule);
+    unlink("/tmp/mympd-test/smartpls/test-newest");
+}
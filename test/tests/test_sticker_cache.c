@@ -0,0 +1,154 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "../utility.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/mem.h"
+#include "../../src/lib/sticker_cache.h"
+#include "../../src/lib/sticker_journal.h"
+
+#include <string.h>
+#include <unistd.h>
+
+static void add_sticker(struct t_cache *sticker_cache, const char *uri, long play_count) {
+    struct t_sticker *sticker = malloc_assert(sizeof(struct t_sticker));
+    memset(sticker, 0, sizeof(struct t_sticker));
+    sticker->play_count = play_count;
+    raxInsert(sticker_cache->cache, (unsigned char *)uri, strlen(uri), sticker, NULL);
+}
+
+UTEST(sticker_cache, test_sticker_queue_coalesce) {
+    struct t_cache sticker_cache;
+    sticker_cache.building = false;
+    sticker_cache.cache = raxNew();
+    add_sticker(&sticker_cache, "a.mp3", 5);
+    add_sticker(&sticker_cache, "b.mp3", 0);
+
+    struct t_list sticker_queue;
+    list_init(&sticker_queue);
+    sticker_inc_play_count(&sticker_queue, NULL, "a.mp3");
+    sticker_set_last_played(&sticker_queue, NULL, "a.mp3", 100);
+    sticker_set_like(&sticker_queue, NULL, "b.mp3", 2);
+    sticker_inc_play_count(&sticker_queue, NULL, "a.mp3");
+    sticker_set_last_played(&sticker_queue, NULL, "a.mp3", 200);
+    sticker_set_like(&sticker_queue, NULL, "b.mp3", 0);
+    //not in the sticker cache
+    sticker_inc_play_count(&sticker_queue, NULL, "c.mp3");
+    //stream uris are not queued
+    sticker_inc_play_count(&sticker_queue, NULL, "http://stream");
+    ASSERT_EQ(7, sticker_queue.length);
+
+    struct t_list writes;
+    list_init(&writes);
+    sticker_queue_coalesce(&sticker_queue, &sticker_cache, &writes);
+    ASSERT_EQ(0, sticker_queue.length);
+    ASSERT_EQ(3, writes.length);
+
+    struct t_list_node *current = writes.head;
+    ASSERT_STREQ("a.mp3", current->key);
+    ASSERT_STREQ("playCount", current->value_p);
+    ASSERT_EQ(7, current->value_i);
+    current = current->next;
+    ASSERT_STREQ("a.mp3", current->key);
+    ASSERT_STREQ("lastPlayed", current->value_p);
+    ASSERT_EQ(200, current->value_i);
+    current = current->next;
+    ASSERT_STREQ("b.mp3", current->key);
+    ASSERT_STREQ("like", current->value_p);
+    ASSERT_EQ(0, current->value_i);
+
+    struct t_sticker *sticker = get_sticker_from_cache(&sticker_cache, "a.mp3");
+    ASSERT_EQ(7, sticker->play_count);
+    ASSERT_EQ(200, sticker->last_played);
+
+    list_clear(&writes);
+    sticker_cache_free(&sticker_cache);
+}
+
+static void wait_journal_synced(struct t_sticker_journal *journal) {
+    for (int i = 0; i < 100 && sticker_journal_synced(journal) == false; i++) {
+        usleep(10000);
+    }
+}
+
+UTEST(sticker_cache, test_sticker_journal) {
+    sds filepath = sdscatfmt(sdsempty(), "%S/state/sticker_journal", workdir);
+    unlink(filepath);
+    struct t_sticker_journal journal;
+    sticker_journal_init(&journal);
+    struct t_list sticker_queue;
+    list_init(&sticker_queue);
+    struct t_list sticker_writes;
+    list_init(&sticker_writes);
+    ASSERT_EQ(0, sticker_journal_open(&journal, &sticker_queue, &sticker_writes, workdir));
+
+    sticker_inc_play_count(&sticker_queue, &journal, "a.mp3");
+    sticker_set_last_played(&sticker_queue, &journal, "dir::with::colons.mp3", 100);
+    sticker_inc_play_count(&sticker_queue, &journal, "http://stream");
+    ASSERT_EQ(2, sticker_queue.length);
+    //simulate a restart, the writer thread syncs all entries before it exits
+    sticker_journal_close(&journal);
+    list_clear(&sticker_queue);
+
+    ASSERT_EQ(2, sticker_journal_open(&journal, &sticker_queue, &sticker_writes, workdir));
+    ASSERT_EQ(2, sticker_queue.length);
+    ASSERT_EQ(0, sticker_writes.length);
+    ASSERT_STREQ("a.mp3", sticker_queue.head->key);
+    ASSERT_STREQ("playCount", sticker_queue.head->value_p);
+    ASSERT_EQ(1, sticker_queue.head->value_i);
+    ASSERT_STREQ("dir::with::colons.mp3", sticker_queue.tail->key);
+    ASSERT_STREQ("lastPlayed", sticker_queue.tail->value_p);
+    ASSERT_EQ(100, sticker_queue.tail->value_i);
+
+    //queue was resolved to absolute values, crash before they are removed from the journal
+    list_clear(&sticker_queue);
+    list_push(&sticker_writes, "a.mp3", 7, "playCount", NULL);
+    sticker_journal_rewrite(&journal, &sticker_writes, NULL);
+    wait_journal_synced(&journal);
+    ASSERT_TRUE(sticker_journal_synced(&journal));
+    sticker_journal_close(&journal);
+    list_clear(&sticker_writes);
+
+    ASSERT_EQ(1, sticker_journal_open(&journal, &sticker_queue, &sticker_writes, workdir));
+    ASSERT_EQ(0, sticker_queue.length);
+    ASSERT_EQ(1, sticker_writes.length);
+    ASSERT_STREQ("a.mp3", sticker_writes.head->key);
+    ASSERT_STREQ("playCount", sticker_writes.head->value_p);
+    ASSERT_EQ(7, sticker_writes.head->value_i);
+
+    //values were written to mpd
+    list_clear(&sticker_writes);
+    sticker_journal_rewrite(&journal, NULL, &sticker_queue);
+    sticker_journal_close(&journal);
+    ASSERT_EQ(0, sticker_journal_open(&journal, &sticker_queue, &sticker_writes, workdir));
+    ASSERT_EQ(0, sticker_queue.length);
+    ASSERT_EQ(0, sticker_writes.length);
+
+    sticker_journal_close(&journal);
+
+    //torn last line after a crash, whitespace in uris is preserved
+    FILE *fp = fopen(filepath, "w");
+    ASSERT_TRUE(fp != NULL);
+    fputs("+1::playCount::a.mp3 \n+1::playCount::b.m", fp);
+    fclose(fp);
+    ASSERT_EQ(1, sticker_journal_open(&journal, &sticker_queue, &sticker_writes, workdir));
+    ASSERT_EQ(1, sticker_queue.length);
+    ASSERT_STREQ("a.mp3 ", sticker_queue.head->key);
+    list_clear(&sticker_queue);
+    //the torn line is removed before new entries are appended
+    sticker_inc_play_count(&sticker_queue, &journal, "c.mp3");
+    sticker_journal_close(&journal);
+    list_clear(&sticker_queue);
+    ASSERT_EQ(2, sticker_journal_open(&journal, &sticker_queue, &sticker_writes, workdir));
+    ASSERT_STREQ("c.mp3", sticker_queue.tail->key);
+    list_clear(&sticker_queue);
+
+    sticker_journal_close(&journal);
+    unlink(filepath);
+    sdsfree(filepath);
+}
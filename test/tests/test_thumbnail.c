@@ -0,0 +1,64 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2022 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+
+#include "../../dist/utest/utest.h"
+#include "../../src/lib/mem.h"
+#include "../../src/lib/sds_extras.h"
+#include "../../src/lib/thumbnail.h"
+
+#include <png.h>
+#include <string.h>
+
+static sds create_png(unsigned width, unsigned height) {
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    png.width = width;
+    png.height = height;
+    png.format = PNG_FORMAT_RGB;
+    size_t pixels_len = (size_t)width * height * 3;
+    unsigned char *pixels = malloc_assert(pixels_len);
+    for (size_t i = 0; i < pixels_len; i++) {
+        pixels[i] = (unsigned char)(i % 251);
+    }
+    png_alloc_size_t len = 0;
+    png_image_write_to_memory(&png, NULL, &len, 0, pixels, 0, NULL);
+    sds binary = sdsnewlen(NULL, len);
+    png_image_write_to_memory(&png, binary, &len, 0, pixels, 0, NULL);
+    FREE_PTR(pixels);
+    return binary;
+}
+
+UTEST(thumbnail, test_thumbnail_create) {
+    sds binary = create_png(800, 400);
+    sds thumbnail = sdsempty();
+    bool rc = thumbnail_create(binary, sdslen(binary), 100, 75, &thumbnail);
+    ASSERT_TRUE(rc);
+    ASSERT_TRUE(sdslen(thumbnail) < sdslen(binary));
+    ASSERT_TRUE(memcmp(thumbnail, "\xff\xd8\xff", 3) == 0);
+
+    //create a thumbnail from a jpeg
+    sds thumbnail2 = sdsempty();
+    rc = thumbnail_create(thumbnail, sdslen(thumbnail), 50, 75, &thumbnail2);
+    ASSERT_TRUE(rc);
+    ASSERT_TRUE(memcmp(thumbnail2, "\xff\xd8\xff", 3) == 0);
+
+    //image is already small enough
+    sdsclear(thumbnail2);
+    rc = thumbnail_create(thumbnail, sdslen(thumbnail), 200, 75, &thumbnail2);
+    ASSERT_FALSE(rc);
+    ASSERT_EQ(0U, sdslen(thumbnail2));
+
+    //unsupported format
+    rc = thumbnail_create("GIF89a", 6, 100, 75, &thumbnail2);
+    ASSERT_FALSE(rc);
+
+    sdsfree(binary);
+    sdsfree(thumbnail);
+    sdsfree(thumbnail2);
+}